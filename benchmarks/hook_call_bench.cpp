@@ -0,0 +1,30 @@
+// Measures the cost of calling c++ hooks from JavaScript: version() touches no shell
+// state, cd(0) looks up the isolate's state and returns.
+//
+// usage: hook_call_bench [calls = 10000000]
+
+#include <iostream>
+#include <string>
+
+#include "V8Shell.h"
+
+int main(int argc, char* argv[]) {
+  const auto calls = argc > 1 ? std::stoul(argv[1]) : 10000000ul;
+
+  const auto script = "const calls = " + std::to_string(calls) + ";"
+    "let start = Date.now();"
+    "for (let i = 0; i < calls; i++) version();"
+    "print('version(): ' + (Date.now() - start) * 1e6 / calls + ' ns per call');"
+    "start = Date.now();"
+    "for (let i = 0; i < calls; i++) cd(0);"
+    "print('cd(0):     ' + (Date.now() - start) * 1e6 / calls + ' ns per call');";
+
+  const char* shell_argv[] = {argv[0], "-e", script.c_str()};
+  int exit_code = 0;
+  V8Shell shell(3, shell_argv, exit_code);
+  if (exit_code == 0) {
+    exit_code = shell.Run();
+  }
+
+  return exit_code;
+}
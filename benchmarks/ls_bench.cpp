@@ -0,0 +1,47 @@
+// Compares the object and columnar result modes of ls() on a synthetic directory.
+//
+// usage: ls_bench [entries = 1000000] [directory = ls-bench-dir]
+
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "V8Shell.h"
+
+int main(int argc, char* argv[]) {
+  const auto entries = argc > 1 ? std::stoul(argv[1]) : 1000000ul;
+  const auto directory = fs::absolute(argc > 2 ? argv[2] : "ls-bench-dir");
+
+  // Reuse the directory of an earlier run if it has the right size
+  std::error_code err;
+  fs::create_directories(directory, err);
+  auto existing = 0ul;
+  for (auto it = fs::directory_iterator(directory); it != fs::directory_iterator(); ++it) {
+    existing++;
+  }
+
+  if (existing != entries) {
+    std::cout << "Creating " << entries << " entries in " << directory << std::endl;
+    for (auto i = existing; i < entries; i++) {
+      std::ofstream(directory / ("entry-" + std::to_string(i) + ".txt"));
+    }
+  }
+
+  const auto script = "cd('" + directory.generic_string() + "');"
+    "const runs = 5;"
+    "let start = Date.now();"
+    "for (let i = 0; i < runs; i++) ls(false);"
+    "print('object mode:   ' + (Date.now() - start) / runs + ' ms per call');"
+    "start = Date.now();"
+    "for (let i = 0; i < runs; i++) ls({ columnar: true });"
+    "print('columnar mode: ' + (Date.now() - start) / runs + ' ms per call');";
+
+  const char* shell_argv[] = {argv[0], "-e", script.c_str()};
+  int exit_code = 0;
+  V8Shell shell(3, shell_argv, exit_code);
+  if (exit_code == 0) {
+    exit_code = shell.Run();
+  }
+
+  return exit_code;
+}
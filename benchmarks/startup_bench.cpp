@@ -0,0 +1,77 @@
+// Measures the cold start time of the shell with and without a startup snapshot.
+//
+// usage: startup_bench <path-to-shell> [iterations = 50]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+const char* kSnapshotFile = "startup_bench.snapshot";
+
+/** Runs command the given number of times and returns the duration of each run in ms. */
+std::vector<double> TimeCommand(const std::string& command, int iterations) {
+  std::vector<double> timings;
+  timings.reserve(iterations);
+
+  for (auto i = 0; i < iterations; i++) {
+    const auto start = std::chrono::steady_clock::now();
+    if (std::system(command.c_str()) != 0) {
+      std::cerr << "Command failed: " << command << std::endl;
+      break;
+    }
+    const auto end = std::chrono::steady_clock::now();
+    timings.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+  }
+
+  return timings;
+}
+
+void PrintTimings(const char* label, std::vector<double> timings) {
+  if (timings.empty()) {
+    return;
+  }
+
+  std::sort(timings.begin(), timings.end());
+  auto sum = 0.0;
+  for (auto timing : timings) {
+    sum += timing;
+  }
+
+  std::cout << label << ": mean " << sum / timings.size() << " ms, median "
+            << timings[timings.size() / 2] << " ms, min " << timings.front()
+            << " ms (" << timings.size() << " runs)" << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    std::cerr << "usage: startup_bench <path-to-shell> [iterations = 50]" << std::endl;
+
+    return 1;
+  }
+
+  const auto shell = std::string("\"") + argv[1] + "\"";
+  const auto iterations = argc > 2 ? std::atoi(argv[2]) : 50;
+
+  const auto build_command = shell + " --build-snapshot " + kSnapshotFile;
+  if (std::system(build_command.c_str()) != 0) {
+    std::cerr << "Failed to build the snapshot" << std::endl;
+
+    return 1;
+  }
+
+  PrintTimings("without snapshot", TimeCommand(shell + " -e 0", iterations));
+  PrintTimings("with snapshot   ",
+               TimeCommand(shell + " --snapshot " + kSnapshotFile + " -e 0", iterations));
+
+  std::remove(kSnapshotFile);
+
+  return 0;
+}
@@ -0,0 +1,52 @@
+// This File contains the persistent on-disk cache for compiled scripts
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+
+#include "v8.h"
+
+namespace fs = std::filesystem;
+
+namespace Commands {
+
+class CodeCache {
+ public:
+  struct Stats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t rejected = 0;
+    uint64_t writes = 0;
+    uint64_t evictions = 0;
+  };
+
+  inline static const uintmax_t kDefaultMaxSize = 64 * 1024 * 1024;
+
+  bool SetDirectory(const fs::path& directory);
+  void SetMaxSize(uintmax_t max_size) { max_size_ = max_size; }
+  bool Enabled() const { return !directory_.empty(); }
+  Stats GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+  }
+
+  v8::MaybeLocal<v8::Script> Compile(v8::Local<v8::Context> context,
+    v8::Local<v8::String> source, v8::ScriptOrigin* origin,
+    uint64_t& key /*OUT*/, bool& cache_miss /*OUT*/);
+  void Store(uint64_t key, v8::Local<v8::Script> script);
+
+ private:
+  static uint64_t Key(v8::Isolate* isolate, v8::Local<v8::String> source);
+  fs::path EntryPath(uint64_t key) const;
+  v8::ScriptCompiler::CachedData* Load(uint64_t key);
+  void Evict();
+
+  fs::path directory_;
+  uintmax_t max_size_ = kDefaultMaxSize;
+  // Worker isolates compile on their own threads
+  mutable std::mutex mutex_;
+  Stats stats_;
+};
+
+};
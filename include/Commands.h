@@ -4,10 +4,21 @@
 #include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <iostream>
+#include <iterator>
 #include <filesystem>
 #include <optional>
+#include <initializer_list>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "libplatform/libplatform.h"
 #include "v8.h"
@@ -19,31 +30,78 @@
 #endif
 
 #include "console.hpp"
+#include "CodeCache.h"
+#include "EventLoop.h"
+#include "FileWriter.h"
+#include "IsolateState.h"
+#include "LineReader.h"
+#include "Pipeline.h"
+#include "PoolAllocator.h"
+#include "ProcessPool.h"
+#include "Worker.h"
 
 namespace fs = std::filesystem;
 
 namespace Commands {
 
+// Base of native state owned by a JS object, see WrapNativeObject()
+class NativeObject {
+ public:
+  virtual ~NativeObject() = default;
+
+ private:
+  friend v8::Local<v8::Object> WrapNativeObject(v8::Isolate* isolate, NativeObject* native);
+  v8::Global<v8::Object> object_;
+};
+
+// State shared by all isolates of the process, per isolate state is kept in IsolateState
 struct RuntimeMemory {
-  inline static fs::path current_directoy;
+  inline static CodeCache code_cache;
+  // The ArrayBuffer allocator of all isolates if --ab-allocator=pool is used
+  inline static PoolAllocator* pool_allocator = nullptr;
 };
 
-void SetCWD(fs::path path);
-fs::path GetCWD();
-void PrintCWD();
+void SetCWD(v8::Isolate* isolate, fs::path path);
+fs::path GetCWD(v8::Isolate* isolate);
+void PrintCWD(v8::Isolate* isolate);
 void PrintErrorTag(std::ostream& stream = std::cerr);
 void PrintWarningTag(std::ostream& stream = std::cerr);
 
 // Commands
 void Print(const v8::FunctionCallbackInfo<v8::Value>& args);
 void Read(const v8::FunctionCallbackInfo<v8::Value>& args);
+void ReadBytes(const v8::FunctionCallbackInfo<v8::Value>& args);
+void WriteBytes(const v8::FunctionCallbackInfo<v8::Value>& args);
+void WriteFile(const v8::FunctionCallbackInfo<v8::Value>& args);
+void AppendFile(const v8::FunctionCallbackInfo<v8::Value>& args);
+void OpenWriter(const v8::FunctionCallbackInfo<v8::Value>& args);
+void Lines(const v8::FunctionCallbackInfo<v8::Value>& args);
 void Execute(const v8::FunctionCallbackInfo<v8::Value>& args);
 void Quit(const v8::FunctionCallbackInfo<v8::Value>& args);
 void Version(const v8::FunctionCallbackInfo<v8::Value>& args);
 void ChangeDirectory(const v8::FunctionCallbackInfo<v8::Value>& args);
 void ListFiles(const v8::FunctionCallbackInfo<v8::Value>& args);
+void Walk(const v8::FunctionCallbackInfo<v8::Value>& args);
 void CreateNewFile(const v8::FunctionCallbackInfo<v8::Value>& args);
 void StartProcessSync(const v8::FunctionCallbackInfo<v8::Value>& args);
+void RunProcess(const v8::FunctionCallbackInfo<v8::Value>& args);
+void RunAll(const v8::FunctionCallbackInfo<v8::Value>& args);
+void Pipeline(const v8::FunctionCallbackInfo<v8::Value>& args);
+void SetTimeout(const v8::FunctionCallbackInfo<v8::Value>& args);
+void ReadAsync(const v8::FunctionCallbackInfo<v8::Value>& args);
+void ReadBytesAsync(const v8::FunctionCallbackInfo<v8::Value>& args);
+void WriteAsync(const v8::FunctionCallbackInfo<v8::Value>& args);
+void StatAsync(const v8::FunctionCallbackInfo<v8::Value>& args);
+void ReaddirAsync(const v8::FunctionCallbackInfo<v8::Value>& args);
+void MkdirAsync(const v8::FunctionCallbackInfo<v8::Value>& args);
+void CopyAsync(const v8::FunctionCallbackInfo<v8::Value>& args);
+void MoveAsync(const v8::FunctionCallbackInfo<v8::Value>& args);
+void RemoveAsync(const v8::FunctionCallbackInfo<v8::Value>& args);
+void Batch(const v8::FunctionCallbackInfo<v8::Value>& args);
+void CreateWorker(const v8::FunctionCallbackInfo<v8::Value>& args);
+void ParallelMap(const v8::FunctionCallbackInfo<v8::Value>& args);
+void SetInterval(const v8::FunctionCallbackInfo<v8::Value>& args);
+void ClearTimer(const v8::FunctionCallbackInfo<v8::Value>& args);
 void RemoveFile(const v8::FunctionCallbackInfo<v8::Value>& args);
 void RemoveDir(const v8::FunctionCallbackInfo<v8::Value>& args);
 void RemoveAny(const v8::FunctionCallbackInfo<v8::Value>& args);
@@ -52,17 +110,78 @@ void Move(const v8::FunctionCallbackInfo<v8::Value>& args);
 void Copy(const v8::FunctionCallbackInfo<v8::Value>& args);
 void CreateNewDir(const v8::FunctionCallbackInfo<v8::Value>& args);
 void Help(const v8::FunctionCallbackInfo<v8::Value>& args);
+void CodeCacheStats(const v8::FunctionCallbackInfo<v8::Value>& args);
+void MemoryStats(const v8::FunctionCallbackInfo<v8::Value>& args);
+void CollectGarbage(const v8::FunctionCallbackInfo<v8::Value>& args);
+void LowMemory(const v8::FunctionCallbackInfo<v8::Value>& args);
+void HeapStats(const v8::FunctionCallbackInfo<v8::Value>& args);
+void StartProfile(const v8::FunctionCallbackInfo<v8::Value>& args);
+void StopProfile(const v8::FunctionCallbackInfo<v8::Value>& args);
+void HeapSnapshot(const v8::FunctionCallbackInfo<v8::Value>& args);
+void StartAllocationSampling(const v8::FunctionCallbackInfo<v8::Value>& args);
+void StopAllocationSampling(const v8::FunctionCallbackInfo<v8::Value>& args);
+
+// Methods of the objects returned by openWriter()
+void WriterWrite(const v8::FunctionCallbackInfo<v8::Value>& args);
+void WriterFlush(const v8::FunctionCallbackInfo<v8::Value>& args);
+void WriterClose(const v8::FunctionCallbackInfo<v8::Value>& args);
+
+// Methods of the objects created by 'new Worker()'
+void WorkerPostMessage(const v8::FunctionCallbackInfo<v8::Value>& args);
+void WorkerTerminate(const v8::FunctionCallbackInfo<v8::Value>& args);
+
+// Methods of the iterators returned by lines()
+void LinesNext(const v8::FunctionCallbackInfo<v8::Value>& args);
+void LinesReturn(const v8::FunctionCallbackInfo<v8::Value>& args);
+void LinesIterator(const v8::FunctionCallbackInfo<v8::Value>& args);
+void LinesAsyncIterator(const v8::FunctionCallbackInfo<v8::Value>& args);
+void LinesNextAsync(const v8::FunctionCallbackInfo<v8::Value>& args);
+void LinesReturnAsync(const v8::FunctionCallbackInfo<v8::Value>& args);
 
 /* Scheduled for implementation:
-void SetPermissions(const v8::FunctionCallbackInfo<v8::Value>& args);
-void StartProcess(const v8::FunctionCallbackInfo<v8::Value>& args); */
+void SetPermissions(const v8::FunctionCallbackInfo<v8::Value>& args); */
 
 // Helper functions
 std::optional<v8::MaybeLocal<v8::String>> ReadFile(v8::Isolate* isolate, const char* name);
 bool ExecuteString(v8::Isolate* isolate, v8::Local<v8::String> source,
-  v8::Local<v8::Value> name, bool print_result, bool report_exceptions);
+  v8::Local<v8::Value> name, bool print_result, bool report_exceptions,
+  bool use_code_cache = false);
 void ReportException(v8::Isolate* isolate, v8::TryCatch* handler);
 const char* ToCString(const v8::String::Utf8Value& value);
-void ConstructAbsolutePath(fs::path& path/*OUT*/);
+void ConstructAbsolutePath(v8::Isolate* isolate, fs::path& path/*OUT*/);
+v8::Local<v8::Value> GetOption(v8::Isolate* isolate, v8::Local<v8::Value> options,
+  const char* name);
+std::unique_ptr<v8::BackingStore> NewUninitializedBackingStore(v8::Isolate* isolate,
+  size_t length);
+bool GetBufferContents(v8::Local<v8::Value> value, WriteBuffer& contents /*OUT*/);
+bool GetWriteData(v8::Isolate* isolate, v8::Local<v8::Value> value,
+  WriteBuffer& contents /*OUT*/, std::string& storage /*OUT*/);
+v8::Local<v8::ObjectTemplate> GetObjectTemplate(v8::Isolate* isolate, const char* name,
+  std::initializer_list<const char*> properties);
+v8::Local<v8::Object> WrapNativeObject(v8::Isolate* isolate, NativeObject* native);
+NativeObject* UnwrapNativeObject(const v8::FunctionCallbackInfo<v8::Value>& args);
+void SetMethod(v8::Isolate* isolate, v8::Local<v8::Object> object, v8::Local<v8::Name> name,
+  v8::FunctionCallback callback);
+void SetMethod(v8::Isolate* isolate, v8::Local<v8::Object> object, const char* name,
+  v8::FunctionCallback callback);
+void ThrowErrorWithReason(v8::Isolate* isolate, const char* message,
+  const std::string& reason);
+bool CopiesIntoItself(const fs::path& source, const fs::path& target);
+std::optional<std::string> GetPathArgument(const v8::FunctionCallbackInfo<v8::Value>& args,
+  int index);
+void CopyTreeWithOptions(const v8::FunctionCallbackInfo<v8::Value>& args,
+  const fs::path& source, const fs::path& target);
+void RemoveTreeWithSummary(const v8::FunctionCallbackInfo<v8::Value>& args,
+  const fs::path& path);
+std::vector<std::string> GetProcessArgs(v8::Isolate* isolate, v8::Local<v8::Value> value);
+std::string ResolveCommand(v8::Isolate* isolate, const std::string& command);
+void RunSyncCaptured(const v8::FunctionCallbackInfo<v8::Value>& args,
+  const std::string& command, const std::vector<std::string>& process_args);
+bool GetProcessJobs(v8::Isolate* isolate, v8::Local<v8::Array> array, const char* kind,
+  std::vector<ProcessJob>& jobs /*OUT*/);
+SpawnOptions GetSpawnOptions(v8::Isolate* isolate, v8::Local<v8::Value> value);
+v8::Local<v8::Value> ProcessOutputToString(v8::Isolate* isolate, const std::string& data);
+bool WriteWholeFile(const fs::path& path, const WriteBuffer& data, bool append,
+  bool atomic, std::string& error /*OUT*/);
 
 };
@@ -0,0 +1,114 @@
+// This File contains the event loop that drives asynchronous shell functions
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "libplatform/libplatform.h"
+#include "v8.h"
+
+#if _WIN32
+#include "V8SWindowsApi.h"
+#else // UNIX
+#include "V8SLinuxApi.h"
+#endif
+
+#include "ThreadPool.h"
+
+namespace Commands {
+
+/** Drives everything asynchronous on the isolate's thread: descriptors it waits
+ *  on, such as the pipes and pidfds of child processes, timers kept in a
+ *  min-heap, and completions of jobs run on its worker pool. Run() keeps going
+ *  while any of them is pending, pumping the platform's tasks and the
+ *  microtask queue after every callback. */
+class EventLoop {
+ public:
+  // Isolate data slot that holds the isolate's event loop
+  inline static const uint32_t kIsolateSlot = 0;
+  // Upper bound of a single wait, so tasks posted to the platform don't starve
+  inline static const int kMaxWaitMs = 50;
+
+  using Handler = std::function<void(uint32_t events)>;
+  using Callback = std::function<void()>;
+  // Runs on a worker thread, the callback it returns on the loop's thread
+  using Job = std::function<Callback()>;
+
+  EventLoop(v8::Isolate* isolate, v8::Platform* platform);
+  ~EventLoop();
+
+  EventLoop(const EventLoop&) = delete;
+  EventLoop operator=(const EventLoop&) = delete;
+
+  static EventLoop* From(v8::Isolate* isolate);
+
+  bool Watch(int fd, uint32_t events, Handler handler, std::string& error /*OUT*/);
+  void Unwatch(int fd);
+  uint64_t AddTimer(double delay_ms, bool repeat, Callback callback);
+  void ClearTimer(uint64_t id);
+  void Submit(Job job);
+  void Post(Callback callback);
+  void Ref() { refs_++; }
+  void Unref() { refs_--; }
+  void Stop();
+  bool Alive() const;
+  void Run();
+
+ private:
+  using Clock = std::chrono::steady_clock;
+  static constexpr unsigned int kMinWorkerThreads = 4;
+
+  struct Timer {
+    Clock::time_point due;
+    Clock::duration interval;
+    bool repeat;
+    Callback callback;
+  };
+
+  // Heap entries of timers that were cleared or rescheduled are skipped when popped
+  struct TimerEntry {
+    Clock::time_point due;
+    uint64_t id;
+
+    // Earliest first, timers due at the same time in the order they were added
+    bool operator>(const TimerEntry& other) const {
+      return due != other.due ? due > other.due : id > other.id;
+    }
+  };
+
+  void Drain();
+  int NextTimeout() const;
+  void RunTimers();
+  void RunCompletions();
+  void Invoke(const Callback& callback);
+
+  v8::Isolate* isolate_;
+  v8::Platform* platform_;
+  PollerHandle poller_;
+  std::unordered_map<int, Handler> watchers_;
+  std::vector<PollEvent> events_;
+
+  std::unordered_map<uint64_t, Timer> timers_;
+  std::priority_queue<TimerEntry, std::vector<TimerEntry>, std::greater<TimerEntry>> timer_heap_;
+  uint64_t next_timer_id_ = 1;
+
+  // Pending work that isn't a descriptor or timer, such as submitted jobs
+  size_t refs_ = 0;
+  // Set by Stop(), Run() returns with whatever is still pending
+  std::atomic<bool> stopped_{false};
+
+  std::unique_ptr<WorkStealingPool> pool_;
+  // Callbacks posted from other threads, signalled through wakeup_fd_
+  std::mutex completions_mutex_;
+  std::vector<Callback> completions_;
+  int wakeup_fd_ = -1;
+};
+
+};
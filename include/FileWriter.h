@@ -0,0 +1,40 @@
+// This File contains the buffered file writer behind openWriter()
+#pragma once
+
+#include <memory>
+#include <string>
+
+#if _WIN32
+#include "V8SWindowsApi.h"
+#else // UNIX
+#include "V8SLinuxApi.h"
+#endif
+
+namespace Commands {
+
+class FileWriter {
+ public:
+  inline static const size_t kDefaultBufferSize = 1024 * 1024;
+
+  FileWriter(FileHandle file, size_t buffer_size);
+  ~FileWriter();
+
+  FileWriter(const FileWriter&) = delete;
+  FileWriter operator=(const FileWriter&) = delete;
+
+  bool Write(const char* data, size_t size, std::string& error /*OUT*/);
+  char* Reserve(size_t size, std::string& error /*OUT*/);
+  void Commit(size_t size) { used_ += size; }
+  bool Flush(std::string& error /*OUT*/);
+  bool Close(std::string& error /*OUT*/);
+  bool IsOpen() const { return file_ != kInvalidFileHandle; }
+  size_t Capacity() const { return capacity_; }
+
+ private:
+  FileHandle file_;
+  std::unique_ptr<char[]> buffer_;
+  size_t capacity_;
+  size_t used_ = 0;
+};
+
+};
@@ -0,0 +1,87 @@
+// This File contains the garbage collection history every isolate keeps
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+
+#include "v8.h"
+
+namespace Commands {
+
+/** Records the garbage collections of one isolate: their type, how long the
+ *  script was paused and the heap in use before and after, in a ring buffer
+ *  of the last kHistorySize ones. With --gc-log every collection of every
+ *  isolate is also written to a file as one JSON line. */
+class GcTracker {
+ public:
+  struct Event {
+    v8::GCType type = v8::kGCTypeScavenge;
+    // Requested, e.g. via gc(), or a last resort one freeing all it can
+    bool forced = false;
+    // Milliseconds since the shell started
+    double start = 0;
+    double pause = 0;
+    size_t used_before = 0;
+    size_t used_after = 0;
+  };
+
+  inline static const size_t kHistorySize = 64;
+
+  explicit GcTracker(v8::Isolate* isolate);
+  ~GcTracker();
+
+  GcTracker(const GcTracker&) = delete;
+  GcTracker operator=(const GcTracker&) = delete;
+
+  // Opens the file of --gc-log, shared by all isolates of the process
+  static bool OpenLog(const std::string& path);
+  static void CloseLog();
+  static const char* TypeName(v8::GCType type);
+
+  uint64_t Count() const { return count_; }
+  double TotalPause() const { return total_pause_; }
+  double MaxPause() const { return max_pause_; }
+  // Calls callback with the recorded events, oldest first
+  template <typename Callback>
+  void ForEach(Callback callback) const {
+    const auto recorded = count_ < kHistorySize ? count_ : kHistorySize;
+    for (auto i = count_ - recorded; i < count_; i++) {
+      callback(history_[i % kHistorySize]);
+    }
+  }
+
+ private:
+  // Collections that pause the script, incremental marking steps are part of them
+  inline static const v8::GCType kTrackedTypes = static_cast<v8::GCType>(
+    v8::kGCTypeScavenge | v8::kGCTypeMinorMarkCompact | v8::kGCTypeMarkSweepCompact);
+
+  static void Prologue(v8::Isolate* isolate, v8::GCType type, v8::GCCallbackFlags flags,
+    void* data);
+  static void Epilogue(v8::Isolate* isolate, v8::GCType type, v8::GCCallbackFlags flags,
+    void* data);
+  static double Now();
+  void WriteLog(const Event& event);
+
+  inline static const std::chrono::steady_clock::time_point kStartTime =
+    std::chrono::steady_clock::now();
+  inline static std::mutex log_mutex_;
+  inline static FILE* log_file_ = nullptr;
+  inline static std::atomic<uint32_t> next_id_{0};
+
+  v8::Isolate* isolate_;
+  // Tells the isolates apart in the log
+  uint32_t id_;
+  Event current_;
+  std::array<Event, kHistorySize> history_;
+  uint64_t count_ = 0;
+  double total_pause_ = 0;
+  double max_pause_ = 0;
+};
+
+};
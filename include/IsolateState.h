@@ -0,0 +1,95 @@
+// This File contains the shell state every isolate keeps for itself
+#pragma once
+
+#include <filesystem>
+#include <initializer_list>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "v8.h"
+
+#include "FileWriter.h"
+#include "GcTracker.h"
+#include "Profiler.h"
+
+namespace fs = std::filesystem;
+
+namespace Commands {
+
+/** What the shell functions of one isolate work with: its working directory,
+ *  where its output goes, the writers its scripts left open and the templates
+ *  of the objects its hooks return. Hooks reach it through an isolate data
+ *  slot, so isolates on different threads never share any of it and need no
+ *  locking. It also handles the isolate running out of heap, records its
+ *  garbage collections and owns its profiler. */
+class IsolateState {
+ public:
+  // Isolate data slot that holds the isolate's state, the event loop uses slot 0
+  inline static const uint32_t kIsolateSlot = 1;
+
+  // Without an isolate the state is detached, as in tests of the cwd functions
+  explicit IsolateState(v8::Isolate* isolate = nullptr);
+  ~IsolateState();
+
+  IsolateState(const IsolateState&) = delete;
+  IsolateState operator=(const IsolateState&) = delete;
+
+  static IsolateState* From(v8::Isolate* isolate) {
+    return static_cast<IsolateState*>(isolate->GetData(kIsolateSlot));
+  }
+
+  void SetCWD(fs::path path) { current_directory_ = std::move(path); }
+  const fs::path& GetCWD() const { return current_directory_; }
+
+  // Scripts run by --parallel are batch jobs: print() and uncaught exceptions
+  // write into buffers, and quit() only ends the script with its exit code
+  void SetBatchJob() { batch_job_ = true; }
+  bool BatchJob() const { return batch_job_; }
+  std::ostream& Out() { return batch_job_ ? out_buffer_ : std::cout; }
+  std::ostream& Err() { return batch_job_ ? err_buffer_ : std::cerr; }
+  std::string BufferedOut() const { return out_buffer_.str(); }
+  std::string BufferedErr() const { return err_buffer_.str(); }
+  void SetExitCode(int exit_code) { exit_code_ = exit_code; }
+  std::optional<int> ExitCode() const { return exit_code_; }
+
+  void AddOpenWriter(FileWriter* writer) { open_writers_.insert(writer); }
+  void RemoveOpenWriter(FileWriter* writer) { open_writers_.erase(writer); }
+  void CloseOpenWriters();
+
+  // The --cpu-prof profile of the run, which quit() has to write before exiting
+  void SetCpuProfile(ScopedCpuProfile* cpu_profile) { cpu_profile_ = cpu_profile; }
+  void FinishCpuProfile();
+
+  v8::Local<v8::ObjectTemplate> GetObjectTemplate(const char* name,
+    std::initializer_list<const char*> properties);
+
+  const GcTracker& Gc() const { return gc_tracker_; }
+  Profiler& GetProfiler() { return profiler_; }
+
+ private:
+  static size_t NearHeapLimit(void* data, size_t current_heap_limit, size_t initial_heap_limit);
+
+  v8::Isolate* isolate_;
+  fs::path current_directory_;
+  bool batch_job_ = false;
+  std::ostringstream out_buffer_;
+  std::ostringstream err_buffer_;
+  std::optional<int> exit_code_;
+  // The heap limit may be raised once, the next time the script is terminated
+  bool heap_limit_raised_ = false;
+  // The limit before the first raise, restored for the next script on the isolate
+  size_t initial_heap_limit_ = 0;
+  GcTracker gc_tracker_;
+  Profiler profiler_;
+  // Writers created by openWriter() that still have to be flushed on exit
+  std::unordered_set<FileWriter*> open_writers_;
+  ScopedCpuProfile* cpu_profile_ = nullptr;
+  // Templates of the objects hooks return in bulk, by name
+  std::unordered_map<std::string, v8::Global<v8::ObjectTemplate>> object_templates_;
+};
+
+};
@@ -0,0 +1,44 @@
+// This File contains the chunked line splitters behind lines() and streamed process output
+#pragma once
+
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Commands {
+
+class LineReader {
+ public:
+  inline static const size_t kDefaultChunkSize = 1024 * 1024;
+
+  explicit LineReader(size_t chunk_size) : buffer_(chunk_size), chunk_size_(chunk_size) {}
+
+  bool Open(const std::string& path, std::string& error /*OUT*/);
+  bool NextBatch(std::vector<std::string_view>& lines /*OUT*/, std::string& error /*OUT*/);
+  void Close();
+  bool Done() const { return done_; }
+
+ private:
+  std::ifstream input_;
+  std::vector<char> buffer_;
+  size_t chunk_size_;
+  // Start and length of an incomplete line carried over from the last chunk
+  size_t pending_begin_ = 0;
+  size_t pending_size_ = 0;
+  bool done_ = false;
+};
+
+class LineSplitter {
+ public:
+  void Feed(const char* data, size_t length, std::vector<std::string_view>& lines /*OUT*/);
+  void Finish(std::vector<std::string_view>& lines /*OUT*/);
+
+ private:
+  std::vector<char> buffer_;
+  // Start and length of an incomplete line carried over from the last piece
+  size_t pending_begin_ = 0;
+  size_t pending_size_ = 0;
+};
+
+};
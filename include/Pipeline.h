@@ -0,0 +1,40 @@
+// This File contains the process pipelines behind pipeline()
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "ProcessPool.h"
+
+namespace Commands {
+
+enum class PipelineInput { kNull, kFile, kData };
+enum class PipelineOutput { kInherit, kFile, kStream };
+
+struct PipelineOptions {
+  PipelineInput input = PipelineInput::kNull;
+  // File the first stage reads from
+  std::string input_path;
+  // Bytes written to the first stage, must stay alive until the pipeline finished
+  WriteBuffer input_data = {nullptr, 0};
+  PipelineOutput output = PipelineOutput::kInherit;
+  // File the last stage writes to, created or truncated
+  std::string output_path;
+};
+
+struct PipelineResult {
+  // One entry per stage
+  std::vector<ChildExit> exits;
+  // Bytes handed to the sink
+  uint64_t output_bytes = 0;
+  double duration_ms = 0;
+};
+
+// Receives the last stage's output in pieces, returning false stops the pipeline
+using PipelineSink = std::function<bool(const char* data, size_t length)>;
+
+bool RunPipeline(const std::vector<ProcessJob>& stages, const PipelineOptions& options,
+  const PipelineSink& sink, PipelineResult& result /*OUT*/, std::string& error /*OUT*/);
+
+};
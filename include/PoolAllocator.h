@@ -0,0 +1,107 @@
+// This File contains the pooling ArrayBuffer allocator selected by --ab-allocator=pool
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "v8.h"
+
+namespace Commands {
+
+/** An ArrayBuffer allocator for scripts that create and drop many buffers.
+ *  Small buffers come from free lists of power of two size classes, carved
+ *  out of slabs. Large ones get pages of their own, which are kept for reuse
+ *  when freed: up to kMaxResidentPages as they are, beyond that with their
+ *  memory given back to the system, so they come back zeroed without a
+ *  memset and without mapping new ones. AllocateUninitialized() never
+ *  zeroes. With the V8 sandbox all pages come from the sandbox, where
+ *  backing stores have to live. All isolates of the process share it, so it
+ *  is thread-safe. */
+class PoolAllocator : public v8::ArrayBuffer::Allocator {
+ public:
+  struct Stats {
+    uint64_t allocations = 0;
+    uint64_t frees = 0;
+    // Allocations served from a free list or from cached pages
+    uint64_t reused = 0;
+    uint64_t live_bytes = 0;
+    uint64_t peak_bytes = 0;
+    // Free blocks of the size classes
+    uint64_t pooled_bytes = 0;
+    // Freed pages of large buffers kept for reuse, with and without their memory
+    uint64_t resident_page_bytes = 0;
+    uint64_t discarded_page_bytes = 0;
+  };
+
+  // Sizes up to kMaxSmallSize come from size classes, larger ones get pages
+  inline static const size_t kMinSmallSize = 16;
+  inline static const size_t kMaxSmallSize = 64 * 1024;
+  // Size classes take memory in slabs of this size
+  inline static const size_t kSlabSize = 256 * 1024;
+  // Upper bounds of the freed pages kept for reuse. Resident ones are reused
+  // fastest, discarded ones only cost address space but fault in again
+  inline static const size_t kMaxResidentPages = 64 * 1024 * 1024;
+  inline static const size_t kMaxDiscardedPages = 1024 * 1024 * 1024;
+
+  PoolAllocator();
+  ~PoolAllocator() override;
+
+  PoolAllocator(const PoolAllocator&) = delete;
+  PoolAllocator operator=(const PoolAllocator&) = delete;
+
+  void* Allocate(size_t length) override;
+  void* AllocateUninitialized(size_t length) override;
+  void Free(void* data, size_t length) override;
+
+  Stats GetStats() const;
+  void Trim();
+
+ private:
+  struct SizeClass {
+    std::mutex mutex;
+    std::vector<void*> free_blocks;
+    std::vector<void*> slabs;
+  };
+
+  // 16 B, 32 B, ... 64 KiB
+  inline static const size_t kClassCount = 13;
+
+  static size_t ClassIndex(size_t length);
+  void* AllocateSmall(size_t length);
+  void* AllocateLarge(size_t length, bool zeroed);
+  void* TakeCachedPages(std::multimap<size_t, void*>& cached, size_t& size /*IN-OUT*/);
+  void FreeLarge(void* data);
+  void Allocated(size_t length, bool reused);
+
+  // Page level memory, from the sandbox if V8 has one
+  void* MapPages(size_t size);
+  void UnmapPages(void* address, size_t size);
+  bool DiscardPages(void* address, size_t size);
+  bool ReusePages(void* address, size_t size);
+
+  size_t granularity_;
+  SizeClass classes_[kClassCount];
+
+  std::mutex pages_mutex_;
+  // Freed pages of large buffers by size
+  std::multimap<size_t, void*> resident_pages_;
+  std::multimap<size_t, void*> discarded_pages_;
+  // Sizes of the pages in use, reused pages can be larger than their buffer
+  std::unordered_map<void*, size_t> page_sizes_;
+
+  std::atomic<uint64_t> allocations_{0};
+  std::atomic<uint64_t> frees_{0};
+  std::atomic<uint64_t> reused_{0};
+  std::atomic<uint64_t> live_bytes_{0};
+  std::atomic<uint64_t> peak_bytes_{0};
+  std::atomic<uint64_t> pooled_bytes_{0};
+  std::atomic<uint64_t> resident_page_bytes_{0};
+  std::atomic<uint64_t> discarded_page_bytes_{0};
+};
+
+};
@@ -0,0 +1,55 @@
+// This File contains the bounded process pool behind runAll() and captured runSync() calls
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#if _WIN32
+#include "V8SWindowsApi.h"
+#else // UNIX
+#include "V8SLinuxApi.h"
+#endif
+
+namespace Commands {
+
+struct ProcessJob {
+  std::string command;
+  std::vector<std::string> args;
+  SpawnOptions options;
+};
+
+struct ProcessJobResult {
+  // Set if the job could not be started
+  std::string error;
+  ChildExit exit;
+  std::string stdout_data;
+  std::string stderr_data;
+  double duration_ms = 0;
+  // Killed for exceeding the timeout
+  bool timed_out = false;
+  // Never started because an earlier job failed with fail_fast set
+  bool skipped = false;
+};
+
+struct ProcessPoolOptions {
+  // Children in flight at once, zero means one per core
+  unsigned int concurrency = 0;
+  // Stop starting jobs and terminate the running ones after the first failure
+  bool fail_fast = false;
+  // Per-job limit after which the child is killed, zero means none
+  double timeout_ms = 0;
+};
+
+enum class OutputStream { kStdout, kStderr };
+
+// Receives a child's output as it arrives, returning false terminates the child
+using OutputSink = std::function<bool(OutputStream stream, const char* data, size_t length)>;
+
+bool RunProcessJobs(const std::vector<ProcessJob>& jobs, const ProcessPoolOptions& options,
+  std::vector<ProcessJobResult>& results /*OUT*/, std::string& error /*OUT*/);
+
+bool RunCapturing(const ProcessJob& job, const OutputSink& sink, ChildExit& exit /*OUT*/,
+  std::string& error /*OUT*/);
+
+};
@@ -0,0 +1,78 @@
+// This File contains the profilers of an isolate
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <ostream>
+#include <string>
+
+#include "v8.h"
+#include "v8-profiler.h"
+
+namespace fs = std::filesystem;
+
+namespace Commands {
+
+/** The profilers of one isolate. The CPU profiler is created on first use,
+ *  several CPU profiles can be recorded at once, told apart by their names.
+ *  Heap snapshots are streamed to their file as they are serialized, and
+ *  allocations can be sampled to find what keeps memory alive. Everything is
+ *  written in the formats of the Chrome DevTools. */
+class Profiler {
+ public:
+  // Default interval between two samples
+  inline static const int kDefaultSamplingInterval = 1000;
+  // Default bytes allocated between two allocation samples
+  inline static const uint64_t kDefaultAllocationInterval = 512 * 1024;
+
+  explicit Profiler(v8::Isolate* isolate) : isolate_(isolate) {}
+  ~Profiler();
+
+  Profiler(const Profiler&) = delete;
+  Profiler operator=(const Profiler&) = delete;
+
+  bool StartCpuProfile(v8::Local<v8::String> name, int sampling_interval_us,
+    std::string& error /*OUT*/);
+  // Returns nullptr if no profile of that name is recorded
+  v8::CpuProfile* StopCpuProfile(v8::Local<v8::String> name);
+  static bool WriteCpuProfile(const v8::CpuProfile* profile, std::ostream& out);
+
+  bool WriteHeapSnapshot(const fs::path& path, std::string& error /*OUT*/);
+
+  bool StartAllocationSampling(uint64_t interval);
+  // Returns the allocations still alive, nullptr if none are sampled
+  std::unique_ptr<v8::AllocationProfile> StopAllocationSampling();
+  static bool WriteAllocationProfile(v8::AllocationProfile* profile, std::ostream& out);
+
+ private:
+  v8::Isolate* isolate_;
+  v8::CpuProfiler* cpu_profiler_ = nullptr;
+  size_t recording_ = 0;
+  bool sampling_allocations_ = false;
+};
+
+/** Records a CPU profile of the isolate for as long as it lives and writes
+ *  it to a file, used for --cpu-prof. quit() finishes it early through the
+ *  isolate's state, the process exits without unwinding. */
+class ScopedCpuProfile {
+ public:
+  ScopedCpuProfile(v8::Isolate* isolate, std::string path);
+  ~ScopedCpuProfile();
+
+  ScopedCpuProfile(const ScopedCpuProfile&) = delete;
+  ScopedCpuProfile operator=(const ScopedCpuProfile&) = delete;
+
+  void Finish();
+
+ private:
+  // An empty name would stop whichever profile was started last
+  inline static const char kName[] = "--cpu-prof";
+
+  v8::Isolate* isolate_;
+  std::string path_;
+  bool started_ = false;
+};
+
+};
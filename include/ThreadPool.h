@@ -0,0 +1,166 @@
+// This File contains the thread pool shared by the parallel file system operations
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Commands {
+
+/** Runs tasks on a fixed set of threads. Every worker owns a deque: tasks
+ *  submitted by a worker go to the front of its own deque, so each worker
+ *  proceeds depth first, while idle workers steal from the back of the others. */
+class WorkStealingPool {
+ public:
+  using Task = std::function<void()>;
+
+  explicit WorkStealingPool(unsigned int threads = 0) {
+    if (threads == 0) {
+      threads = DefaultThreads();
+    }
+
+    for (unsigned int i = 0; i < threads; i++) {
+      queues_.push_back(std::make_unique<Queue>());
+    }
+    for (unsigned int i = 0; i < threads; i++) {
+      threads_.emplace_back(&WorkStealingPool::WorkerLoop, this, i);
+    }
+  }
+
+  ~WorkStealingPool() {
+    {
+      std::lock_guard<std::mutex> lock(wake_mutex_);
+      stop_ = true;
+    }
+    wake_.notify_all();
+
+    for (auto& thread : threads_) {
+      thread.join();
+    }
+  }
+
+  WorkStealingPool(const WorkStealingPool&) = delete;
+  WorkStealingPool operator=(const WorkStealingPool&) = delete;
+
+  static unsigned int DefaultThreads() {
+    const auto threads = std::thread::hardware_concurrency();
+
+    return threads == 0 ? 4 : threads;
+  }
+
+  unsigned int Size() const { return static_cast<unsigned int>(threads_.size()); }
+
+  /** Queues a task, may be called from any thread including the workers. */
+  void Submit(Task task) {
+    pending_++;
+
+    // Workers keep their own tasks local, everyone else distributes round robin
+    const auto index = current_pool_ == this
+      ? current_index_
+      : static_cast<unsigned int>(next_queue_++ % queues_.size());
+    {
+      std::lock_guard<std::mutex> lock(queues_[index]->mutex);
+      queues_[index]->tasks.push_front(std::move(task));
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(wake_mutex_);
+      queued_++;
+    }
+    wake_.notify_one();
+  }
+
+  /** Blocks until all submitted tasks, including the ones they submitted, finished. */
+  void Wait() {
+    std::unique_lock<std::mutex> lock(wake_mutex_);
+    idle_.wait(lock, [this] { return pending_ == 0; });
+  }
+
+ private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  bool TryTake(unsigned int index, Task& task /*OUT*/) {
+    // Own tasks come from the front, stolen ones from the back
+    for (size_t i = 0; i < queues_.size(); i++) {
+      auto& queue = *queues_[(index + i) % queues_.size()];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+
+      if (!queue.tasks.empty()) {
+        if (i == 0) {
+          task = std::move(queue.tasks.front());
+          queue.tasks.pop_front();
+        } else {
+          task = std::move(queue.tasks.back());
+          queue.tasks.pop_back();
+        }
+
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  void WorkerLoop(unsigned int index) {
+    current_pool_ = this;
+    current_index_ = index;
+
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(wake_mutex_);
+        wake_.wait(lock, [this] { return queued_ > 0 || stop_; });
+        if (stop_) {
+          return;
+        }
+      }
+
+      Task task;
+      if (!TryTake(index, task)) {
+        continue;
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        queued_--;
+      }
+
+      try {
+        task();
+      } catch (...) {
+        // Tasks report their own errors, a throwing one must not take down the pool
+      }
+      // Whatever the task captured is released before it counts as finished
+      task = nullptr;
+
+      if (--pending_ == 0) {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        idle_.notify_all();
+      }
+    }
+  }
+
+  std::vector<std::unique_ptr<Queue>> queues_;
+  std::vector<std::thread> threads_;
+  std::mutex wake_mutex_;
+  std::condition_variable wake_;
+  std::condition_variable idle_;
+  // Tasks sitting in a queue, guarded by wake_mutex_
+  size_t queued_ = 0;
+  // Tasks submitted but not yet finished
+  std::atomic<size_t> pending_{0};
+  std::atomic<size_t> next_queue_{0};
+  bool stop_ = false;
+
+  inline static thread_local WorkStealingPool* current_pool_ = nullptr;
+  inline static thread_local unsigned int current_index_ = 0;
+};
+
+};
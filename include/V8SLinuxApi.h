@@ -2,14 +2,255 @@
 #pragma once
 
 #include <spawn.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/wait.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <atomic>
+#include <climits>
 #include <iostream>
+#include <cstdint>
 #include <cstring>
+#include <functional>
+#include <string>
 #include <unistd.h>
 #include <vector>
 
 namespace Commands {
 
+// A read-only or copy-on-write view of a file region
+struct MappedFile {
+  char* data = nullptr;
+  size_t size = 0;
+  // Start and length of the whole mapping, data may point into it
+  void* mapping = nullptr;
+  size_t mapping_size = 0;
+};
+
+using FileHandle = int;
+const FileHandle kInvalidFileHandle = -1;
+
+struct WriteBuffer {
+  const char* data;
+  size_t size;
+};
+
+struct DirectoryEntry {
+  std::string name;
+  bool is_directory;
+  uint64_t size;
+  // Last modification in ms since the unix epoch
+  double mtime;
+};
+
+using PollerHandle = int;
+const PollerHandle kInvalidPoller = -1;
+
+// Readiness flags of WatchDescriptor() and PollEvent
+constexpr uint32_t kPollReadable = EPOLLIN;
+constexpr uint32_t kPollWritable = EPOLLOUT;
+constexpr uint32_t kPollClosed = EPOLLHUP | EPOLLERR;
+
+struct PollEvent {
+  int fd;
+  uint32_t events;
+};
+
+struct SpawnOptions {
+  // Working directory of the child, empty inherits the shell process's
+  std::string cwd;
+  // NAME=value entries added to, or overriding, the inherited environment
+  std::vector<std::string> env;
+  // Connect stdout/stderr to pipes read by the shell instead of its own streams
+  bool capture_stdout = false;
+  bool capture_stderr = false;
+  // Read stdin from /dev/null, so children cannot compete with the shell for input
+  bool null_stdin = false;
+  // Descriptors handed to the child as its stdin/stdout, -1 leaves them to the
+  // options above. The shell keeps its own copies and closes them after the spawn
+  int stdin_fd = -1;
+  int stdout_fd = -1;
+};
+
+struct ChildProcess {
+  pid_t pid = -1;
+  // Becomes readable once the child exited, -1 if the kernel has no pidfd_open
+  int pidfd = -1;
+  // Non-blocking read ends of the capture pipes, -1 if not captured
+  int stdout_fd = -1;
+  int stderr_fd = -1;
+};
+
+struct ChildExit {
+  // Exit code, -1 if the child was killed by a signal
+  int code = 0;
+  // Name of the terminating signal, empty if the child exited normally
+  std::string signal;
+  // Resource usage reported by wait4
+  double user_time_ms = 0;
+  double system_time_ms = 0;
+  long max_rss_kb = 0;
+};
+
+enum class WalkEntryType : uint8_t { kFile, kDirectory, kSymlink, kOther };
+
+struct WalkEntry {
+  // Path relative to the walked root, always '/' separated
+  std::string path;
+  WalkEntryType type;
+  uint64_t size = 0;
+  // Last modification in ms since the unix epoch
+  double mtime = 0;
+};
+
+struct WalkOptions {
+  // Deepest level reported, the root's children are level 1. Negative means unlimited
+  int max_depth = -1;
+  // Glob patterns. One without a '/' is matched against the entry name, otherwise
+  // against the relative path. Excluded directories are not descended into
+  std::vector<std::string> include;
+  std::vector<std::string> exclude;
+  bool follow_symlinks = false;
+  // Fill in size and mtime, which costs a stat call per entry
+  bool stats = false;
+  // Zero uses one thread per core
+  unsigned int threads = 0;
+  // Maximum number of entries handed to the sink at once
+  size_t batch_size = 4096;
+  // Checked between directories, set it to stop the walk early
+  const std::atomic<bool>* cancel = nullptr;
+};
+
+struct WalkResult {
+  uint64_t entries = 0;
+  uint64_t directories = 0;
+  // Directories that could not be read, the walk continues past them
+  uint64_t errors = 0;
+  std::string first_error;
+};
+
+// Receives the entries in batches, called concurrently from the walker threads
+using WalkSink = std::function<void(std::vector<WalkEntry>& batch)>;
+
+struct PathStat {
+  WalkEntryType type = WalkEntryType::kOther;
+  uint64_t size = 0;
+  // Last modification in ms since the unix epoch
+  double mtime = 0;
+  // Permission bits, zero where the platform has none
+  uint32_t mode = 0;
+};
+
+enum class BatchOpType : uint8_t { kStat, kLstat, kRead, kUnlink, kRmdir, kRename, kMkdir };
+
+struct BatchOp {
+  BatchOpType type;
+  std::string path;
+  // Destination of kRename
+  std::string target;
+};
+
+struct BatchOpResult {
+  // Empty on success, otherwise why the operation failed
+  std::string error;
+  // Filled by kStat and kLstat
+  PathStat stat;
+  // Contents read by kRead
+  std::string data;
+};
+
+struct CopyOptions {
+  // Copy directories with all their contents, otherwise only single files are accepted
+  bool recursive = false;
+  // Zero uses one thread per core
+  unsigned int threads = 0;
+  // Clone file extents where the file system supports it instead of copying data
+  bool reflink = true;
+};
+
+struct CopyResult {
+  uint64_t files = 0;
+  uint64_t directories = 0;
+  uint64_t bytes = 0;
+  // Files that were cloned instead of copied
+  uint64_t reflinked = 0;
+  // Entries that could not be copied, the copy continues past them
+  uint64_t errors = 0;
+  std::string first_error;
+};
+
+struct RemoveOptions {
+  // Zero uses one thread per core
+  unsigned int threads = 0;
+};
+
+struct RemoveResult {
+  uint64_t files = 0;
+  uint64_t directories = 0;
+  // Disk space of the removed files, hard links to files that live on are not counted
+  uint64_t bytes_freed = 0;
+  // Entries that could not be removed, the removal continues past them
+  uint64_t errors = 0;
+  std::string first_error;
+};
+
 void CreateNewProcess(std::string& process_path, std::vector<std::string>& args, bool verbose);
+PollerHandle CreatePoller(std::string& error /*OUT*/);
+void ClosePoller(PollerHandle poller);
+bool WatchDescriptor(PollerHandle poller, int fd, uint32_t events, std::string& error /*OUT*/);
+void UnwatchDescriptor(PollerHandle poller, int fd);
+bool WaitForEvents(PollerHandle poller, int timeout_ms, std::vector<PollEvent>& events /*OUT*/,
+  std::string& error /*OUT*/);
+int OpenDescriptor(const char* path, bool writable, std::string& error /*OUT*/);
+bool CreatePipe(int& read_fd /*OUT*/, int& write_fd /*OUT*/, std::string& error /*OUT*/);
+void SetNonBlocking(int fd);
+int CreateWakeup(std::string& error /*OUT*/);
+void SignalWakeup(int fd);
+void ClearWakeup(int fd);
+long ReadAvailable(int fd, char* buffer, size_t length);
+long WriteAvailable(int fd, const char* buffer, size_t length);
+void CloseDescriptor(int fd);
+bool SpawnChildProcess(const std::string& command, const std::vector<std::string>& args,
+  const SpawnOptions& options, ChildProcess& child /*OUT*/, std::string& error /*OUT*/);
+bool ReapChildProcess(ChildProcess& child, bool block, ChildExit& exit /*OUT*/);
+void TerminateChildProcess(const ChildProcess& child, bool force);
+void CloseChildProcess(ChildProcess& child);
+FileHandle OpenFileForWriting(const char* path, bool append, std::string& error /*OUT*/);
+bool WriteFileBuffers(FileHandle file, std::vector<WriteBuffer> buffers,
+  std::string& error /*OUT*/);
+bool ReadFileInto(const char* path, uint64_t offset, char* buffer, size_t length,
+  std::string& error /*OUT*/);
+void CloseFile(FileHandle file);
+FileHandle CreateTempFileFor(const char* target_path, std::string& temp_path /*OUT*/,
+  std::string& error /*OUT*/);
+bool SyncFile(FileHandle file, std::string& error /*OUT*/);
+bool RenameFileOver(const char* from, const char* to, std::string& error /*OUT*/);
+bool MapFile(const char* path, uint64_t offset, uint64_t length, bool writable,
+  MappedFile& file /*OUT*/, std::string& error /*OUT*/);
+void UnmapFile(MappedFile& file);
+size_t MemoryPageSize();
+uint64_t PhysicalMemorySize();
+void* MapMemory(size_t size, std::string& error /*OUT*/);
+void UnmapMemory(void* address, size_t size);
+void DiscardMemory(void* address, size_t size);
+bool ListDirectory(const char* path, bool with_stats, std::vector<DirectoryEntry>& entries /*OUT*/,
+  std::string& error /*OUT*/);
+
+bool StatPath(const char* path, bool follow_symlinks, PathStat& stat /*OUT*/,
+  std::string& error /*OUT*/);
+bool WalkTree(const char* root, const WalkOptions& options, const WalkSink& sink,
+  WalkResult& result /*OUT*/, std::string& error /*OUT*/);
+bool CopyTree(const char* from, const char* to, const CopyOptions& options,
+  CopyResult& result /*OUT*/, std::string& error /*OUT*/);
+bool RemoveTree(const char* path, const RemoveOptions& options, RemoveResult& result /*OUT*/,
+  std::string& error /*OUT*/);
+bool UringAvailable();
+bool RunBatchWithUring(const std::vector<BatchOp>& ops, std::vector<BatchOpResult>& results /*OUT*/,
+  std::string& error /*OUT*/);
+void RunBatchOp(const BatchOp& op, BatchOpResult& result /*OUT*/);
 
 };
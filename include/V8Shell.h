@@ -1,5 +1,10 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <mutex>
+#include <thread>
 #include <tuple>
 #include <vector>
 
@@ -7,6 +12,23 @@
 
 struct Settings {
   bool run_shell;
+  // --snapshot <file>: boot the isolate from a previously built startup snapshot
+  std::string snapshot_file;
+  // --build-snapshot <file>: serialize the shell context into a snapshot and exit
+  std::string build_snapshot_file;
+  // --parallel <n>: run the script files concurrently on n isolates
+  unsigned int parallel_jobs = 0;
+  // --jobs-file <file>: run the scripts listed in file, one path per line
+  std::string jobs_file;
+  // --ab-allocator=default|pool: the ArrayBuffer allocator of all isolates
+  std::string ab_allocator = "default";
+  // --max-heap, --young-gen-size, --initial-heap <MiB>: heap sizes of all
+  // isolates, zero keeps the defaults derived from the physical memory
+  size_t max_heap_size = 0;
+  size_t young_generation_size = 0;
+  size_t initial_heap_size = 0;
+  // --cpu-prof[=file]: record a CPU profile of the whole run into file
+  std::string cpu_profile_file;
   inline const static std::string current_version = "0.4.0";
 };
 
@@ -16,7 +38,7 @@ class V8Shell {
   V8Shell(int argc, const char** argv, int& exit_code /*OUT*/);
   ~V8Shell();
 
-  // V8 isolates are supposed to be unique per process
+  // The shell owns the process-wide V8 platform, workers get isolates of their own
   V8Shell(const V8Shell&) = delete;
   V8Shell operator=(const V8Shell&) = delete;
 
@@ -25,24 +47,72 @@ class V8Shell {
   bool RemoveHook(std::string& js_function);
   bool RemoveHook(v8::FunctionCallback cb);
  private:
+  void ParseStartupFlags();
   bool SetupV8Isolate();
+  void ConfigureHeap();
+  bool LoadSnapshot();
+  int BuildSnapshot();
   v8::Local<v8::Context> CreateShellContext();
   void RunShell(v8::Local<v8::Context> context);
+  int RunParallel();
+  bool CollectBatchScripts(std::vector<std::string>& scripts /*OUT*/);
+  int RunBatchScript(v8::Isolate* isolate, v8::Local<v8::ObjectTemplate> global_template,
+    const std::string& script);
+
+  static v8::Local<v8::ObjectTemplate> CreateGlobalTemplate(v8::Isolate* isolate);
+  static const intptr_t* ExternalReferences();
+  static std::string SnapshotHeader();
 
   inline static std::vector<std::tuple<std::string, v8::FunctionCallback>>
     cpp_hooks {
                 std::tuple("print", &Commands::Print),
                 std::tuple("read", &Commands::Read),
+                std::tuple("readBytes", &Commands::ReadBytes),
+                std::tuple("writeBytes", &Commands::WriteBytes),
+                std::tuple("writeFile", &Commands::WriteFile),
+                std::tuple("appendFile", &Commands::AppendFile),
+                std::tuple("openWriter", &Commands::OpenWriter),
+                std::tuple("lines", &Commands::Lines),
                 std::tuple("execute", &Commands::Execute),
                 std::tuple("quit", &Commands::Quit),
                 std::tuple("exit", &Commands::Quit),
                 std::tuple("version", &Commands::Version),
+                std::tuple("codeCacheStats", &Commands::CodeCacheStats),
+                std::tuple("memoryStats", &Commands::MemoryStats),
+                std::tuple("gc", &Commands::CollectGarbage),
+                std::tuple("lowMemory", &Commands::LowMemory),
+                std::tuple("heapStats", &Commands::HeapStats),
+                std::tuple("profile.start", &Commands::StartProfile),
+                std::tuple("profile.stop", &Commands::StopProfile),
+                std::tuple("heapSnapshot", &Commands::HeapSnapshot),
+                std::tuple("allocationSampling.start", &Commands::StartAllocationSampling),
+                std::tuple("allocationSampling.stop", &Commands::StopAllocationSampling),
                 std::tuple("cd", &Commands::ChangeDirectory),
                 std::tuple("changeDirectory", &Commands::ChangeDirectory),
                 std::tuple("changeDir", &Commands::ChangeDirectory),
                 std::tuple("ls", &Commands::ListFiles),
                 std::tuple("ll", &Commands::ListFiles),
+                std::tuple("walk", &Commands::Walk),
                 std::tuple("runSync", &Commands::StartProcessSync),
+                std::tuple("run", &Commands::RunProcess),
+                std::tuple("runAll", &Commands::RunAll),
+                std::tuple("pipeline", &Commands::Pipeline),
+                std::tuple("setTimeout", &Commands::SetTimeout),
+                std::tuple("setInterval", &Commands::SetInterval),
+                std::tuple("clearTimeout", &Commands::ClearTimer),
+                std::tuple("clearInterval", &Commands::ClearTimer),
+                std::tuple("fs.readAsync", &Commands::ReadAsync),
+                std::tuple("fs.readBytesAsync", &Commands::ReadBytesAsync),
+                std::tuple("fs.writeAsync", &Commands::WriteAsync),
+                std::tuple("fs.statAsync", &Commands::StatAsync),
+                std::tuple("fs.readdirAsync", &Commands::ReaddirAsync),
+                std::tuple("fs.mkdirAsync", &Commands::MkdirAsync),
+                std::tuple("fs.copyAsync", &Commands::CopyAsync),
+                std::tuple("fs.moveAsync", &Commands::MoveAsync),
+                std::tuple("fs.removeAsync", &Commands::RemoveAsync),
+                std::tuple("fs.batch", &Commands::Batch),
+                std::tuple("Worker", &Commands::CreateWorker),
+                std::tuple("parallelMap", &Commands::ParallelMap),
                 std::tuple("createFile", &Commands::CreateNewFile),
                 std::tuple("touch", &Commands::CreateNewFile),
                 std::tuple("removeFile", &Commands::RemoveFile),
@@ -62,9 +132,15 @@ class V8Shell {
                 std::tuple("help", &Commands::Help)};
   int argc_;
   const char** argv_;
+  // Marks arguments already consumed as startup flags, Run() skips those
+  std::vector<bool> startup_args_;
 
   std::unique_ptr<v8::Platform> platform_;
   v8::Isolate::CreateParams create_params_;
-  v8::Isolate* isolate_;
+  v8::Isolate* isolate_ = nullptr;
+  std::unique_ptr<Commands::EventLoop> event_loop_;
+  std::unique_ptr<Commands::IsolateState> isolate_state_;
+  std::string snapshot_data_;
+  v8::StartupData snapshot_blob_ = { nullptr, 0 };
   Settings settings_;
 };
@@ -0,0 +1,129 @@
+// This File contains worker isolates that run scripts on threads of their own
+#pragma once
+
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "libplatform/libplatform.h"
+#include "v8.h"
+
+#include "EventLoop.h"
+
+namespace fs = std::filesystem;
+
+namespace Commands {
+
+/** A value written by v8::ValueSerializer. ArrayBuffers in the transfer list
+ *  travel as their backing stores and SharedArrayBuffers share theirs, so
+ *  neither is copied. */
+struct SerializedMessage {
+  struct FreeData {
+    void operator()(uint8_t* data) const { free(data); }
+  };
+
+  std::unique_ptr<uint8_t, FreeData> data;
+  size_t size = 0;
+  std::vector<std::shared_ptr<v8::BackingStore>> transferred;
+  std::vector<std::shared_ptr<v8::BackingStore>> shared;
+};
+
+bool SerializeMessage(v8::Isolate* isolate, v8::Local<v8::Value> value,
+  v8::Local<v8::Value> transfer_list, SerializedMessage& message /*OUT*/);
+v8::MaybeLocal<v8::Value> DeserializeMessage(v8::Isolate* isolate, SerializedMessage& message);
+
+/** What every worker isolate is created with, provided by the shell. All
+ *  isolates share one ArrayBuffer allocator, so backing stores can move
+ *  between them. */
+struct WorkerEnvironment {
+  v8::Platform* platform = nullptr;
+  v8::ArrayBuffer::Allocator* allocator = nullptr;
+  // Heap sizes, the same as the shell's isolate
+  v8::ResourceConstraints constraints;
+  // Template of the global object with all c++ hooks
+  v8::Local<v8::ObjectTemplate> (*global_template)(v8::Isolate* isolate) = nullptr;
+};
+
+/** An isolate running a script on its own thread, with its own event loop.
+ *  Messages go both ways serialized: the worker's inbox is drained on the
+ *  worker's thread, its messages to the host are posted to the host's loop,
+ *  where Handlers are called. The host's loop is kept alive until the worker
+ *  exited, which it does once its script and loop are done and it has no
+ *  'onmessage' handler, or when it is terminated or calls close(). */
+class WorkerThread : public std::enable_shared_from_this<WorkerThread> {
+ public:
+  enum class Mode {
+    // Runs a script with postMessage(), close() and onmessage like a web worker
+    kScript,
+    // The script evaluates to a function, which maps every {start, items}
+    // message to {start, results}
+    kMap,
+  };
+
+  // Called on the host's thread
+  struct Handlers {
+    std::function<void(v8::Isolate* isolate, SerializedMessage& message)> on_message;
+    std::function<void(v8::Isolate* isolate, const std::string& error)> on_error;
+    // exit_code is what the worker passed to quit(), 0 otherwise
+    std::function<void(v8::Isolate* isolate, int exit_code)> on_exit;
+  };
+
+  static void Configure(const WorkerEnvironment& environment);
+  static std::shared_ptr<WorkerThread> Start(v8::Isolate* host, const std::string& script_path,
+    Mode mode, Handlers handlers);
+  static void TerminateAll(v8::Isolate* host);
+
+  WorkerThread(v8::Isolate* host, const std::string& script_path, Mode mode, Handlers handlers);
+  ~WorkerThread();
+
+  WorkerThread(const WorkerThread&) = delete;
+  WorkerThread operator=(const WorkerThread&) = delete;
+
+  void PostToWorker(SerializedMessage message);
+  void PostToHost(SerializedMessage message);
+  void Terminate();
+  void Close();
+  void Quit(int exit_code);
+
+ private:
+  void Main();
+  bool RunScript(v8::Local<v8::Context> context);
+  void RunLoop(v8::Local<v8::Context> context);
+  bool Listening(v8::Local<v8::Context> context);
+  void DeliverMessages();
+  void Dispatch(v8::Local<v8::Context> context, SerializedMessage& message);
+  void ReportError(v8::TryCatch& try_catch);
+  void Exited();
+
+  inline static WorkerEnvironment environment_;
+
+  // Host side, only used on the host's thread
+  v8::Isolate* host_;
+  EventLoop* host_loop_;
+  Handlers handlers_;
+  std::thread thread_;
+
+  const std::string script_path_;
+  const fs::path cwd_;
+  const Mode mode_;
+  v8::Global<v8::Function> map_function_;
+
+  std::mutex mutex_;
+  std::condition_variable wakeup_;
+  std::deque<SerializedMessage> inbox_;
+  bool terminating_ = false;
+  // Set while the worker's loop runs, messages are posted to it then
+  bool in_run_ = false;
+  int exit_code_ = 0;
+  v8::Isolate* isolate_ = nullptr;
+  EventLoop* loop_ = nullptr;
+};
+
+};
@@ -0,0 +1,242 @@
+// This File contains the persistent on-disk cache for compiled scripts
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#include "CodeCache.h"
+
+namespace Commands {
+
+namespace {
+
+const uint32_t kEntryMagic = 0x43533856;  // "V8SC"
+
+struct EntryHeader {
+  uint32_t magic;
+  uint32_t version_tag;
+  uint64_t key;
+  uint64_t data_length;
+};
+
+/** FNV-1a, continuing from hash. */
+uint64_t Hash(const char* data, size_t length, uint64_t hash = 14695981039346656037ull) {
+  for (size_t i = 0; i < length; i++) {
+    hash = (hash ^ static_cast<unsigned char>(data[i])) * 1099511628211ull;
+  }
+
+  return hash;
+}
+
+}  // namespace
+
+/** Enables the cache, storing entries in directory. Returns false if the
+ *  directory cannot be created. */
+bool CodeCache::SetDirectory(const fs::path& directory) {
+  std::error_code err;
+  fs::create_directories(directory, err);
+
+  if (!fs::is_directory(directory, err)) {
+    return false;
+  }
+
+  directory_ = directory;
+  return true;
+}
+
+/** Compiles source, consuming a cached entry if there is a valid one.
+ *  cache_miss is set if the caller should Store() the script afterwards,
+ *  which is done after running it so lazily compiled functions get cached too. */
+v8::MaybeLocal<v8::Script> CodeCache::Compile(v8::Local<v8::Context> context,
+  v8::Local<v8::String> source, v8::ScriptOrigin* origin,
+  uint64_t& key /*OUT*/, bool& cache_miss /*OUT*/) {
+  auto* isolate = context->GetIsolate();
+  key = Key(isolate, source);
+  cache_miss = true;
+
+  auto* cached_data = Load(key);
+  if (cached_data == nullptr) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stats_.misses++;
+    }
+    v8::ScriptCompiler::Source script_source(source, *origin);
+
+    return v8::ScriptCompiler::Compile(context, &script_source);
+  }
+
+  // Source takes ownership of the cached data
+  v8::ScriptCompiler::Source script_source(source, *origin, cached_data);
+  auto script = v8::ScriptCompiler::Compile(context, &script_source,
+    v8::ScriptCompiler::kConsumeCodeCache);
+
+  // v8 rejects data produced by a different version or with different flags
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (script_source.GetCachedData()->rejected) {
+    stats_.rejected++;
+    std::error_code err;
+    fs::remove(EntryPath(key), err);
+  } else {
+    stats_.hits++;
+    cache_miss = false;
+
+    // Refresh the entry so eviction drops the least recently used ones first
+    std::error_code err;
+    fs::last_write_time(EntryPath(key), fs::file_time_type::clock::now(), err);
+  }
+
+  return script;
+}
+
+/** Writes the code cache of an already compiled script to disk. */
+void CodeCache::Store(uint64_t key, v8::Local<v8::Script> script) {
+  std::unique_ptr<v8::ScriptCompiler::CachedData> cached_data(
+    v8::ScriptCompiler::CreateCodeCache(script->GetUnboundScript()));
+
+  if (cached_data == nullptr || cached_data->length <= 0) {
+    return;
+  }
+
+  EntryHeader header = {kEntryMagic, v8::ScriptCompiler::CachedDataVersionTag(), key,
+                        static_cast<uint64_t>(cached_data->length)};
+
+  // Write to a temporary file first so concurrent shells never see partial entries
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto entry_path = EntryPath(key);
+  auto temp_path = entry_path;
+  temp_path += ".tmp";
+
+  std::ofstream output_file(temp_path, std::ios::binary);
+  output_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  output_file.write(reinterpret_cast<const char*>(cached_data->data), cached_data->length);
+  output_file.close();
+
+  std::error_code err;
+  if (!output_file) {
+    fs::remove(temp_path, err);
+
+    return;
+  }
+
+  fs::rename(temp_path, entry_path, err);
+  if (err) {
+    fs::remove(temp_path, err);
+
+    return;
+  }
+
+  stats_.writes++;
+  Evict();
+}
+
+/** Identifies a source across runs, mixing in the v8 version and flags. */
+uint64_t CodeCache::Key(v8::Isolate* isolate, v8::Local<v8::String> source) {
+  const auto version_tag = v8::ScriptCompiler::CachedDataVersionTag();
+  auto hash = Hash(reinterpret_cast<const char*>(&version_tag), sizeof(version_tag));
+
+  if (source->IsExternalOneByte()) {
+    const auto* resource = source->GetExternalOneByteStringResource();
+
+    return Hash(resource->data(), resource->length(), hash);
+  }
+
+  v8::String::Utf8Value utf8_source(isolate, source);
+
+  return Hash(*utf8_source, utf8_source.length(), hash);
+}
+
+/** Path of the cache file of an entry. */
+fs::path CodeCache::EntryPath(uint64_t key) const {
+  char filename[32];
+  snprintf(filename, sizeof(filename), "%016llx.v8cache",
+           static_cast<unsigned long long>(key));
+
+  return directory_ / filename;
+}
+
+/** Reads an entry from disk. Returns nullptr if there is none or it is stale. */
+v8::ScriptCompiler::CachedData* CodeCache::Load(uint64_t key) {
+  const auto entry_path = EntryPath(key);
+  std::ifstream input_file(entry_path, std::ios::binary);
+  if (!input_file) {
+    return nullptr;
+  }
+
+  EntryHeader header;
+  input_file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+  const auto stale = !input_file || header.magic != kEntryMagic ||
+    header.version_tag != v8::ScriptCompiler::CachedDataVersionTag() ||
+    header.key != key || header.data_length > INT32_MAX;
+
+  auto* data = stale ? nullptr : new uint8_t[header.data_length];
+  if (data != nullptr) {
+    input_file.read(reinterpret_cast<char*>(data), header.data_length);
+  }
+
+  if (stale || input_file.gcount() != static_cast<std::streamsize>(header.data_length)) {
+    delete[] data;
+    input_file.close();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stats_.rejected++;
+    }
+
+    std::error_code err;
+    fs::remove(entry_path, err);
+
+    return nullptr;
+  }
+
+  return new v8::ScriptCompiler::CachedData(data, static_cast<int>(header.data_length),
+    v8::ScriptCompiler::CachedData::BufferOwned);
+}
+
+/** Removes the least recently used entries until the cache fits its size limit. */
+void CodeCache::Evict() {
+  struct Entry {
+    fs::path path;
+    uintmax_t size;
+    fs::file_time_type last_used;
+  };
+
+  std::vector<Entry> entries;
+  uintmax_t total_size = 0;
+  std::error_code err;
+
+  for (auto const& dir_entry : fs::directory_iterator(directory_, err)) {
+    if (dir_entry.path().extension() != ".v8cache") {
+      continue;
+    }
+
+    Entry entry = {dir_entry.path(), dir_entry.file_size(err), dir_entry.last_write_time(err)};
+    if (err) {
+      continue;
+    }
+
+    total_size += entry.size;
+    entries.push_back(entry);
+  }
+
+  if (total_size <= max_size_) {
+    return;
+  }
+
+  std::sort(entries.begin(), entries.end(), [](const Entry& lhs, const Entry& rhs) {
+    return lhs.last_used < rhs.last_used;
+  });
+
+  for (auto const& entry : entries) {
+    if (total_size <= max_size_) {
+      break;
+    }
+
+    if (fs::remove(entry.path, err)) {
+      total_size -= entry.size;
+      stats_.evictions++;
+    }
+  }
+}
+
+};
@@ -18,16 +18,19 @@ fs::path operator+(fs::path const& lhs, std::string const& rhs) {
   return result;
 }
 
-/** Setter for the current working directory of the shell. */
-void SetCWD(fs::path path) { RuntimeMemory::current_directoy = path; }
+/** Setter for the current working directory of the isolate. */
+void SetCWD(v8::Isolate* isolate, fs::path path) {
+	IsolateState::From(isolate)->SetCWD(std::move(path));
+}
 
-/** Getter for the current working directory of the shell. */
-fs::path GetCWD() { return RuntimeMemory::current_directoy; }
+/** Getter for the current working directory of the isolate. */
+fs::path GetCWD(v8::Isolate* isolate) { return IsolateState::From(isolate)->GetCWD(); }
 
-/** Prints colorized cwd to standard out. */
-void PrintCWD() {
-	auto path = RuntimeMemory::current_directoy.generic_string();
-	std::cout << rang::fg::green << path << "> " << rang::fg::reset;
+/** Prints colorized cwd to the isolate's output. */
+void PrintCWD(v8::Isolate* isolate) {
+	auto* state = IsolateState::From(isolate);
+	auto path = state->GetCWD().generic_string();
+	state->Out() << rang::fg::green << path << "> " << rang::fg::reset;
 }
 
 /** Prints a colorized error tag. Used to prepend error messages. */
@@ -46,19 +49,20 @@ void PrintWarningTag(std::ostream& stream) {
  *   function is called. Sends its arguments to stdout separated by
  *   semicolons and ending with a newline. */
 void Print(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	auto& out = IsolateState::From(args.GetIsolate())->Out();
 	bool first = true;
 	for (int i = 0; i < args.Length(); i++) {
 		v8::HandleScope handle_scope(args.GetIsolate());
 		if (first) {
 			first = false;
 		} else {
-			std::cout << ";";
+			out << ";";
 		}
 		v8::String::Utf8Value str(args.GetIsolate(), args[i]);
-		std::cout << ToCString(str);
+		out << ToCString(str);
 	}
 
-	std::cout << std::endl;
+	out << std::endl;
 }
 
 /** The callback that is invoked by v8 whenever the JavaScript 'read'
@@ -90,6 +94,486 @@ void Read(const v8::FunctionCallbackInfo<v8::Value>& args) {
 	args.GetReturnValue().Set(source);
 }
 
+/** Writes data to path. Atomic writes go to a temporary file first that is
+ *  renamed over path, so readers never see a partially written file. */
+bool WriteWholeFile(const fs::path& path, const WriteBuffer& data, bool append,
+	bool atomic, std::string& error /*OUT*/) {
+	if (!atomic) {
+		auto file = OpenFileForWriting(path.string().c_str(), append, error);
+		if (file == kInvalidFileHandle) {
+			return false;
+		}
+
+		auto OK = WriteFileBuffers(file, {data}, error);
+		CloseFile(file);
+
+		return OK;
+	}
+
+	std::string temp_path;
+	auto file = CreateTempFileFor(path.string().c_str(), temp_path, error);
+	if (file == kInvalidFileHandle) {
+		return false;
+	}
+
+	auto OK = WriteFileBuffers(file, {data}, error) && SyncFile(file, error);
+	CloseFile(file);
+
+	if (!OK || !RenameFileOver(temp_path.c_str(), path.string().c_str(), error)) {
+		std::error_code err;
+		fs::remove(temp_path, err);
+
+		return false;
+	}
+
+	return true;
+}
+
+/** The callback that is invoked by v8 whenever the JavaScript 'readBytes'
+ *   function is called. Loads the file in argument 0 into an ArrayBuffer.
+ *   The optional options object in argument 1 selects a region of the file
+ *   via 'offset' and 'length'. */
+void ReadBytes(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	auto* isolate = args.GetIsolate();
+	auto context = isolate->GetCurrentContext();
+
+	if (args.Length() < 1 || !args[0]->IsString()) {
+		isolate->ThrowError("[Error] No file name passed");
+		return;
+	}
+
+	v8::String::Utf8Value file(isolate, args[0]);
+	auto filename = fs::path(ToCString(file));
+	ConstructAbsolutePath(isolate, filename);
+
+	uint64_t offset = 0;
+	uint64_t length = 0;
+	auto offset_option = GetOption(isolate, args[1], "offset");
+	auto length_option = GetOption(isolate, args[1], "length");
+	if (offset_option->IsNumber()) {
+		offset = static_cast<uint64_t>(std::max<int64_t>(
+			offset_option->IntegerValue(context).FromMaybe(0), 0));
+	}
+	if (length_option->IsNumber()) {
+		length = static_cast<uint64_t>(std::max<int64_t>(
+			length_option->IntegerValue(context).FromMaybe(0), 0));
+	}
+
+	std::string error;
+	std::unique_ptr<v8::BackingStore> backing_store;
+
+#ifdef V8_ENABLE_SANDBOX
+	// Backing stores have to live inside the sandbox, so the file cannot be
+	// mapped. Instead it is read straight into an uninitialized backing store.
+	std::error_code err;
+	const auto file_size = fs::file_size(filename, err);
+	if (err) {
+		ThrowErrorWithReason(isolate, "Cannot read file", err.message());
+		return;
+	}
+
+	offset = std::min<uint64_t>(offset, file_size);
+	if (length == 0 || length > file_size - offset) {
+		length = file_size - offset;
+	}
+
+	backing_store = NewUninitializedBackingStore(isolate, static_cast<size_t>(length));
+	if (backing_store == nullptr) {
+		isolate->ThrowException(v8::Exception::RangeError(
+			v8::String::NewFromUtf8Literal(isolate, "Array buffer allocation failed")));
+		return;
+	}
+	if (length != 0 && !ReadFileInto(filename.string().c_str(), offset,
+																	 static_cast<char*>(backing_store->Data()),
+																	 static_cast<size_t>(length), error)) {
+		ThrowErrorWithReason(isolate, "Cannot read file", error);
+		return;
+	}
+#else
+	// Map the file region, the mapping is released once the ArrayBuffer is collected
+	MappedFile mapped_file;
+	if (!MapFile(filename.string().c_str(), offset, length, true, mapped_file, error)) {
+		ThrowErrorWithReason(isolate, "Cannot read file", error);
+		return;
+	}
+
+	backing_store = v8::ArrayBuffer::NewBackingStore(
+		mapped_file.data, mapped_file.size,
+		[](void*, size_t, void* deleter_data) {
+			auto* file = static_cast<MappedFile*>(deleter_data);
+			UnmapFile(*file);
+			delete file;
+		},
+		new MappedFile(mapped_file));
+#endif
+
+	args.GetReturnValue().Set(v8::ArrayBuffer::New(isolate, std::move(backing_store)));
+}
+
+/** The callback that is invoked by v8 whenever the JavaScript 'writeBytes'
+ *   function is called. Writes the contents of the ArrayBuffer, TypedArray or
+ *   DataView in argument 1 to the file in argument 0, replacing its contents. */
+void WriteBytes(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	auto* isolate = args.GetIsolate();
+
+	if (args.Length() < 1 || !args[0]->IsString()) {
+		isolate->ThrowError("[Error] No file name passed");
+		return;
+	}
+
+	WriteBuffer contents;
+	if (!GetBufferContents(args[1], contents)) {
+		isolate->ThrowError("[Error] Expected an ArrayBuffer, TypedArray or DataView");
+		return;
+	}
+
+	v8::String::Utf8Value file(isolate, args[0]);
+	auto filename = fs::path(ToCString(file));
+	ConstructAbsolutePath(isolate, filename);
+
+	// Written straight from the backing store, no intermediate copies
+	std::string error;
+	if (!WriteWholeFile(filename, contents, false, false, error)) {
+		ThrowErrorWithReason(isolate, "Cannot write file", error);
+	}
+}
+
+/** The callback that is invoked by v8 whenever the JavaScript 'writeFile'
+ *   function is called. Writes the string (as UTF-8) or buffer in argument 1
+ *   to the file in argument 0, replacing its contents. If the options object
+ *   in argument 2 has 'atomic' set, the file is replaced atomically. */
+void WriteFile(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	auto* isolate = args.GetIsolate();
+
+	if (args.Length() < 2 || !args[0]->IsString()) {
+		isolate->ThrowError("[Error] Bad parameters");
+		return;
+	}
+
+	WriteBuffer data;
+	std::string storage;
+	if (!GetWriteData(isolate, args[1], data, storage)) {
+		isolate->ThrowError("[Error] Expected a string, ArrayBuffer or typed array");
+		return;
+	}
+
+	v8::String::Utf8Value file(isolate, args[0]);
+	auto filename = fs::path(ToCString(file));
+	ConstructAbsolutePath(isolate, filename);
+
+	const auto atomic = GetOption(isolate, args[2], "atomic")->BooleanValue(isolate);
+	std::string error;
+	if (!WriteWholeFile(filename, data, false, atomic, error)) {
+		ThrowErrorWithReason(isolate, "Cannot write file", error);
+	}
+}
+
+/** The callback that is invoked by v8 whenever the JavaScript 'appendFile'
+ *   function is called. Appends the string (as UTF-8) or buffer in argument 1
+ *   to the file in argument 0, creating it if needed. */
+void AppendFile(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	auto* isolate = args.GetIsolate();
+
+	if (args.Length() < 2 || !args[0]->IsString()) {
+		isolate->ThrowError("[Error] Bad parameters");
+		return;
+	}
+
+	WriteBuffer data;
+	std::string storage;
+	if (!GetWriteData(isolate, args[1], data, storage)) {
+		isolate->ThrowError("[Error] Expected a string, ArrayBuffer or typed array");
+		return;
+	}
+
+	v8::String::Utf8Value file(isolate, args[0]);
+	auto filename = fs::path(ToCString(file));
+	ConstructAbsolutePath(isolate, filename);
+
+	std::string error;
+	if (!WriteWholeFile(filename, data, true, false, error)) {
+		ThrowErrorWithReason(isolate, "Cannot append to file", error);
+	}
+}
+
+/** Owns the FileWriter of an object returned by openWriter(). */
+struct WriterBinding : public NativeObject {
+	std::unique_ptr<FileWriter> writer;
+	IsolateState* state = nullptr;
+
+	~WriterBinding() override { state->RemoveOpenWriter(writer.get()); }
+};
+
+/** Gets the writer behind the object a writer method is bound to. */
+FileWriter* GetWriter(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	return static_cast<WriterBinding*>(UnwrapNativeObject(args))->writer.get();
+}
+
+/** The callback that is invoked by v8 whenever the JavaScript 'openWriter'
+ *   function is called. Opens the file in argument 0 for buffered writing and
+ *   returns an object with write(data), flush() and close() methods. The optional
+ *   options object in argument 1 takes 'append' and 'bufferSize' (in bytes). */
+void OpenWriter(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	auto* isolate = args.GetIsolate();
+	auto context = isolate->GetCurrentContext();
+
+	if (args.Length() < 1 || !args[0]->IsString()) {
+		isolate->ThrowError("[Error] No file name passed");
+		return;
+	}
+
+	v8::String::Utf8Value file(isolate, args[0]);
+	auto filename = fs::path(ToCString(file));
+	ConstructAbsolutePath(isolate, filename);
+
+	const auto append = GetOption(isolate, args[1], "append")->BooleanValue(isolate);
+	auto buffer_size = FileWriter::kDefaultBufferSize;
+	auto buffer_size_option = GetOption(isolate, args[1], "bufferSize");
+	if (buffer_size_option->IsNumber()) {
+		buffer_size = static_cast<size_t>(std::max<int64_t>(
+			buffer_size_option->IntegerValue(context).FromMaybe(0), 4096));
+	}
+
+	std::string error;
+	auto handle = OpenFileForWriting(filename.string().c_str(), append, error);
+	if (handle == kInvalidFileHandle) {
+		ThrowErrorWithReason(isolate, "Cannot open file", error);
+		return;
+	}
+
+	auto* binding = new WriterBinding();
+	binding->writer = std::make_unique<FileWriter>(handle, buffer_size);
+	binding->state = IsolateState::From(isolate);
+	binding->state->AddOpenWriter(binding->writer.get());
+
+	// The file is flushed and closed once the writer is garbage collected
+	auto object = WrapNativeObject(isolate, binding);
+	SetMethod(isolate, object, "write", WriterWrite);
+	SetMethod(isolate, object, "flush", WriterFlush);
+	SetMethod(isolate, object, "close", WriterClose);
+
+	args.GetReturnValue().Set(object);
+}
+
+/** write(data) method of writer objects. Strings are encoded as UTF-8
+ *  straight into the writer's buffer. */
+void WriterWrite(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	auto* isolate = args.GetIsolate();
+	auto* writer = GetWriter(args);
+	std::string error;
+
+	if (args[0]->IsString()) {
+		auto string = args[0].As<v8::String>();
+		const auto length = static_cast<size_t>(string->Utf8Length(isolate));
+
+		auto* destination = writer->Reserve(length, error);
+		if (destination != nullptr) {
+			string->WriteUtf8(isolate, destination, static_cast<int>(length), nullptr,
+				v8::String::NO_NULL_TERMINATION | v8::String::REPLACE_INVALID_UTF8);
+			writer->Commit(length);
+
+			return;
+		}
+
+		if (!error.empty()) {
+			ThrowErrorWithReason(isolate, "Cannot write", error);
+
+			return;
+		}
+	}
+
+	// Buffers and strings larger than the writer's buffer
+	WriteBuffer data;
+	std::string storage;
+	if (!GetWriteData(isolate, args[0], data, storage)) {
+		isolate->ThrowError("[Error] Expected a string, ArrayBuffer or typed array");
+		return;
+	}
+
+	if (!writer->Write(data.data, data.size, error)) {
+		ThrowErrorWithReason(isolate, "Cannot write", error);
+	}
+}
+
+/** flush() method of writer objects. */
+void WriterFlush(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	std::string error;
+	if (!GetWriter(args)->Flush(error)) {
+		ThrowErrorWithReason(args.GetIsolate(), "Cannot flush", error);
+	}
+}
+
+/** close() method of writer objects. */
+void WriterClose(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	auto* writer = GetWriter(args);
+	IsolateState::From(args.GetIsolate())->RemoveOpenWriter(writer);
+
+	std::string error;
+	if (!writer->Close(error)) {
+		ThrowErrorWithReason(args.GetIsolate(), "Cannot close", error);
+	}
+}
+
+/** Owns the LineReader of an object returned by lines(). */
+struct LinesBinding : public NativeObject {
+	std::unique_ptr<LineReader> reader;
+};
+
+/** The callback that is invoked by v8 whenever the JavaScript 'lines'
+ *   function is called. Returns an iterator over the lines of the file in
+ *   argument 0 that yields them in batches (arrays of strings), one batch per
+ *   chunk read. Memory use is bounded by the chunk size, which can be set with
+ *   the 'chunkSize' option of the options object in argument 1. */
+void Lines(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	auto* isolate = args.GetIsolate();
+	auto context = isolate->GetCurrentContext();
+
+	if (args.Length() < 1 || !args[0]->IsString()) {
+		isolate->ThrowError("[Error] No file name passed");
+		return;
+	}
+
+	v8::String::Utf8Value file(isolate, args[0]);
+	auto filename = fs::path(ToCString(file));
+	ConstructAbsolutePath(isolate, filename);
+
+	auto chunk_size = LineReader::kDefaultChunkSize;
+	auto chunk_size_option = GetOption(isolate, args[1], "chunkSize");
+	if (chunk_size_option->IsNumber()) {
+		chunk_size = static_cast<size_t>(std::max<int64_t>(
+			chunk_size_option->IntegerValue(context).FromMaybe(0), 4096));
+	}
+
+	auto* binding = new LinesBinding();
+	binding->reader = std::make_unique<LineReader>(chunk_size);
+
+	std::string error;
+	if (!binding->reader->Open(filename.string(), error)) {
+		delete binding;
+		ThrowErrorWithReason(isolate, "Cannot open file", error);
+		return;
+	}
+
+	auto object = WrapNativeObject(isolate, binding);
+	SetMethod(isolate, object, "next", LinesNext);
+	SetMethod(isolate, object, "return", LinesReturn);
+	SetMethod(isolate, object, v8::Symbol::GetIterator(isolate), LinesIterator);
+	SetMethod(isolate, object, v8::Symbol::GetAsyncIterator(isolate), LinesAsyncIterator);
+
+	args.GetReturnValue().Set(object);
+}
+
+/** Creates an iterator result object for value. */
+v8::Local<v8::Object> NewIteratorResult(v8::Isolate* isolate, v8::Local<v8::Value> value,
+	bool done) {
+	auto context = isolate->GetCurrentContext();
+	auto result = v8::Object::New(isolate);
+	result->Set(context, v8::String::NewFromUtf8Literal(isolate, "value"), value).Check();
+	result->Set(context, v8::String::NewFromUtf8Literal(isolate, "done"),
+							v8::Boolean::New(isolate, done)).Check();
+
+	return result;
+}
+
+/** Reads the next batch of lines into an iterator result. Returns an empty
+ *  handle and sets error if reading fails. */
+v8::MaybeLocal<v8::Object> NextLinesResult(v8::Isolate* isolate, LineReader& reader,
+	std::string& error /*OUT*/) {
+	std::vector<std::string_view> lines;
+	if (!reader.NextBatch(lines, error)) {
+		return v8::MaybeLocal<v8::Object>();
+	}
+
+	if (lines.empty()) {
+		return NewIteratorResult(isolate, v8::Undefined(isolate), true);
+	}
+
+	std::vector<v8::Local<v8::Value>> strings;
+	strings.reserve(lines.size());
+	for (auto line : lines) {
+		strings.push_back(v8::String::NewFromUtf8(isolate, line.data(),
+			v8::NewStringType::kNormal, static_cast<int>(line.size())).ToLocalChecked());
+	}
+
+	return NewIteratorResult(isolate, v8::Array::New(isolate, strings.data(), strings.size()),
+		false);
+}
+
+/** next() method of line iterators. */
+void LinesNext(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	auto* isolate = args.GetIsolate();
+	auto* reader = static_cast<LinesBinding*>(UnwrapNativeObject(args))->reader.get();
+
+	std::string error;
+	v8::Local<v8::Object> result;
+	if (!NextLinesResult(isolate, *reader, error).ToLocal(&result)) {
+		ThrowErrorWithReason(isolate, "Cannot read file", error);
+		return;
+	}
+
+	args.GetReturnValue().Set(result);
+}
+
+/** return() method of line iterators, closes the file when a loop is left early. */
+void LinesReturn(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	auto* isolate = args.GetIsolate();
+	static_cast<LinesBinding*>(UnwrapNativeObject(args))->reader->Close();
+
+	args.GetReturnValue().Set(NewIteratorResult(isolate, v8::Undefined(isolate), true));
+}
+
+/** [Symbol.iterator]() method of line iterators, which are their own iterator. */
+void LinesIterator(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	args.GetReturnValue().Set(args.Data());
+}
+
+/** [Symbol.asyncIterator]() method of line iterators. Returns an iterator
+ *  sharing the same reader whose methods return promises. */
+void LinesAsyncIterator(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	auto* isolate = args.GetIsolate();
+	auto context = isolate->GetCurrentContext();
+	auto lines_object = args.Data();
+
+	auto iterator = v8::Object::New(isolate);
+	iterator->Set(context, v8::String::NewFromUtf8Literal(isolate, "next"),
+		v8::Function::New(context, LinesNextAsync, lines_object).ToLocalChecked()).Check();
+	iterator->Set(context, v8::String::NewFromUtf8Literal(isolate, "return"),
+		v8::Function::New(context, LinesReturnAsync, lines_object).ToLocalChecked()).Check();
+
+	args.GetReturnValue().Set(iterator);
+}
+
+/** next() method of asynchronous line iterators. */
+void LinesNextAsync(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	auto* isolate = args.GetIsolate();
+	auto context = isolate->GetCurrentContext();
+	auto* reader = static_cast<LinesBinding*>(UnwrapNativeObject(args))->reader.get();
+	auto resolver = v8::Promise::Resolver::New(context).ToLocalChecked();
+
+	std::string error;
+	v8::Local<v8::Object> result;
+	if (NextLinesResult(isolate, *reader, error).ToLocal(&result)) {
+		resolver->Resolve(context, result).Check();
+	} else {
+		auto message = v8::String::NewFromUtf8(isolate,
+			("[Error] Cannot read file: " + error).c_str()).ToLocalChecked();
+		resolver->Reject(context, v8::Exception::Error(message)).Check();
+	}
+
+	args.GetReturnValue().Set(resolver->GetPromise());
+}
+
+/** return() method of asynchronous line iterators. */
+void LinesReturnAsync(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	auto* isolate = args.GetIsolate();
+	auto context = isolate->GetCurrentContext();
+	static_cast<LinesBinding*>(UnwrapNativeObject(args))->reader->Close();
+
+	auto resolver = v8::Promise::Resolver::New(context).ToLocalChecked();
+	resolver->Resolve(context, NewIteratorResult(isolate, v8::Undefined(isolate), true)).Check();
+	args.GetReturnValue().Set(resolver->GetPromise());
+}
+
 /** The callback that is invoked by v8 whenever the JavaScript 'execute'
  *   function is called. Loads, parses, compiles and executes its argument
  *   JavaScript file. */
@@ -114,7 +598,7 @@ void Execute(const v8::FunctionCallbackInfo<v8::Value>& args) {
       args.GetIsolate()->ThrowError("[Error] Cannot stringify file content");
     }
 
-		if (!ExecuteString(args.GetIsolate(), source, args[i], false, false)) {
+		if (!ExecuteString(args.GetIsolate(), source, args[i], false, false, true)) {
 			args.GetIsolate()->ThrowError("[Error] Failure to execute file content");
 			return;
 		}
@@ -122,12 +606,27 @@ void Execute(const v8::FunctionCallbackInfo<v8::Value>& args) {
 }
 
 /** The callback that is invoked by v8 whenever the JavaScript 'quit'
- *   function is called. Terminates execution. */
+ *   function is called. Terminates execution, after flushing open writers
+ *   and writing the --cpu-prof profile. */
 void Quit(const v8::FunctionCallbackInfo<v8::Value>& args) {
 	// If not arguments are given args[0] will yield undefined which
 	// is coerced into the integer value 0.
 	int exit_code =
 			args[0]->Int32Value(args.GetIsolate()->GetCurrentContext()).FromMaybe(0);
+	auto* isolate = args.GetIsolate();
+	auto* state = IsolateState::From(isolate);
+	state->CloseOpenWriters();
+
+	// A batch job shares the process with other scripts, only the script ends
+	if (state->BatchJob()) {
+		state->SetExitCode(exit_code);
+		EventLoop::From(isolate)->Stop();
+		isolate->TerminateExecution();
+
+		return;
+	}
+
+	state->FinishCpuProfile();
 	fflush(stdout);
 	fflush(stderr);
 	exit(exit_code);
@@ -153,6 +652,7 @@ void ChangeDirectory(const v8::FunctionCallbackInfo<v8::Value>& args) {
 
 	v8::HandleScope handle_scope(args.GetIsolate());
 	auto* isolate = args.GetIsolate();
+	auto* state = IsolateState::From(isolate);
 
 	if (args[0]->IsNumber()) {
 		const auto js_value = args[0]->Int32Value(isolate->GetCurrentContext());
@@ -168,8 +668,7 @@ void ChangeDirectory(const v8::FunctionCallbackInfo<v8::Value>& args) {
 		const auto num = abs(js_value.FromJust());
 
 		for (auto i = 0; i < num; i++) {
-			RuntimeMemory::current_directoy =
-					RuntimeMemory::current_directoy.parent_path();
+			state->SetCWD(state->GetCWD().parent_path());
 		}
 	}
 
@@ -188,385 +687,2830 @@ void ChangeDirectory(const v8::FunctionCallbackInfo<v8::Value>& args) {
 
 		fs::path try_path = fs::path(value).is_absolute()
 														? fs::path(value)
-														: RuntimeMemory::current_directoy + value;
+														: state->GetCWD() + value;
 
 		if (!fs::is_directory(try_path)) {
-			PrintErrorTag();
-			std::cerr << " " << try_path.generic_string() << " is not a directory"
+			auto& err_out = state->Err();
+			PrintErrorTag(err_out);
+			err_out << " " << try_path.generic_string() << " is not a directory"
 								<< std::endl;
 
 			return;
 		}
 
-		RuntimeMemory::current_directoy = try_path;
+		state->SetCWD(try_path);
 	}
 }
 
 /** The callback that is invoked by v8 whenever the JavaScript 'ls'
  *  function is called. Returns void and prints the content of the
  *  current working directory to standard out.
- *  Returns an array of directory entry objects if 'true' is passed. */
+ *  Returns an array of directory entry objects if 'false' is passed.
+ *  If an options object with 'columnar' set is passed, returns one object
+ *  of parallel arrays instead, which is much cheaper for large directories. */
 void ListFiles(const v8::FunctionCallbackInfo<v8::Value>& args) {
 	bool print_to_std = true;
+	bool columnar = false;
 	v8::HandleScope handle_scope(args.GetIsolate());
 	auto* isolate = args.GetIsolate();
+	auto context = isolate->GetCurrentContext();
 
 	if (args.Length() != 0) {
 		if (args[0]->IsBoolean() &&
 				!(args[0]->ToBoolean(isolate)->BooleanValue(isolate))) {
 			print_to_std = false;
 		}
+		if (args[0]->IsObject()) {
+			print_to_std = false;
+			columnar = GetOption(isolate, args[0], "columnar")->BooleanValue(isolate);
+		}
 	}
 
-	v8::Local<v8::Array> result = v8::Array::New(isolate, 3);
-	auto result_index = 0;
+	const auto& cwd = IsolateState::From(isolate)->GetCWD();
+	auto directory = cwd.empty() ? std::string(".") : cwd.string();
 
-	for (auto const& dir_entry :
-			 std::filesystem::directory_iterator(RuntimeMemory::current_directoy)) {
-		const auto filename = dir_entry.path().filename().generic_string();
+	std::vector<DirectoryEntry> entries;
+	std::string error;
+	if (!ListDirectory(directory.c_str(), columnar, entries, error)) {
+		auto& err_out = IsolateState::From(isolate)->Err();
+		PrintErrorTag(err_out);
+		err_out << " Cannot list " << directory << ": " << error << std::endl;
 
-		if (dir_entry.is_directory()) {
-			if (print_to_std) {
-				std::cout << rang::fg::cyan;
-			} else {
-				auto object = v8::Object::New(isolate);
-				object->Set(
-						isolate->GetCurrentContext(),
-						v8::String::NewFromUtf8(isolate, "isDirectory").ToLocalChecked(),
-						v8::Boolean::New(isolate, true)).Check();
-
-				object->Set(
-						isolate->GetCurrentContext(),
-						v8::String::NewFromUtf8(isolate, "filename").ToLocalChecked(),
-						v8::String::NewFromUtf8(isolate, filename.c_str())
-								.ToLocalChecked()).Check();
-
-				result->Set(isolate->GetCurrentContext(), result_index, object).Check();
-				result_index++;
+		return;
+	}
+
+	if (print_to_std) {
+		auto& out = IsolateState::From(isolate)->Out();
+		for (auto const& entry : entries) {
+			if (entry.is_directory) {
+				out << rang::fg::cyan;
 			}
+			out << entry.name << std::endl;
+			out << rang::fg::reset;
 		}
 
-		if (print_to_std) {
-			std::cout << filename << std::endl;
-			std::cout << rang::fg::reset;
-		} else {
-			auto object = v8::Object::New(isolate);
-			object->Set(
-					isolate->GetCurrentContext(),
-					v8::String::NewFromUtf8(isolate, "isDirectory").ToLocalChecked(),
-					v8::Boolean::New(isolate, false)).Check();
-
-			object->Set(
-					isolate->GetCurrentContext(),
-					v8::String::NewFromUtf8(isolate, "filename").ToLocalChecked(),
-					v8::String::NewFromUtf8(isolate, filename.c_str()).ToLocalChecked()).Check();
+		return;
+	}
 
-			result->Set(isolate->GetCurrentContext(), result_index, object).Check();
-			result_index++;
+	const auto count = entries.size();
+	std::vector<v8::Local<v8::Value>> elements;
+	elements.reserve(count);
+
+	if (!columnar) {
+		auto entry_template = GetObjectTemplate(isolate, "dirEntry", {"filename", "isDirectory"});
+		auto filename_key = v8::String::NewFromUtf8Literal(isolate, "filename",
+			v8::NewStringType::kInternalized);
+		auto is_directory_key = v8::String::NewFromUtf8Literal(isolate, "isDirectory",
+			v8::NewStringType::kInternalized);
+
+		for (auto const& entry : entries) {
+			auto object = entry_template->NewInstance(context).ToLocalChecked();
+			object->Set(context, filename_key,
+				v8::String::NewFromUtf8(isolate, entry.name.c_str()).ToLocalChecked()).Check();
+			object->Set(context, is_directory_key,
+				v8::Boolean::New(isolate, entry.is_directory)).Check();
+			elements.push_back(object);
 		}
-	}
 
-	if (!print_to_std) {
-		args.GetReturnValue().Set(result);
+		args.GetReturnValue().Set(v8::Array::New(isolate, elements.data(), count));
+		return;
 	}
-}
-
-/** The callback that is invoked by v8 whenever the JavaScript 'createFile'
- *  function is called. Creates a new file in the cwd. */
-void CreateNewFile(const v8::FunctionCallbackInfo<v8::Value>& args) {
-	v8::String::Utf8Value file(args.GetIsolate(), args[0]);
-	auto filename = fs::path(ToCString(file));
-  ConstructAbsolutePath(filename);
-
-	if (fs::exists(filename)) {
-		PrintErrorTag();
-		std::cerr << " File " << filename << " already exists." << std::endl;
 
-		return;
+	// Columnar mode, the typed arrays are filled in place
+	auto is_directory = v8::ArrayBuffer::New(isolate, count);
+	auto sizes = v8::ArrayBuffer::New(isolate, count * sizeof(double));
+	auto mtimes = v8::ArrayBuffer::New(isolate, count * sizeof(double));
+	auto* is_directory_data = static_cast<uint8_t*>(is_directory->Data());
+	auto* sizes_data = static_cast<double*>(sizes->Data());
+	auto* mtimes_data = static_cast<double*>(mtimes->Data());
+
+	for (size_t i = 0; i < count; i++) {
+		auto const& entry = entries[i];
+		elements.push_back(
+			v8::String::NewFromUtf8(isolate, entry.name.c_str()).ToLocalChecked());
+		is_directory_data[i] = entry.is_directory ? 1 : 0;
+		sizes_data[i] = static_cast<double>(entry.size);
+		mtimes_data[i] = entry.mtime;
 	}
 
-	std::ofstream out_filestream(filename);
-	out_filestream.close();
+	auto result = v8::Object::New(isolate);
+	result->Set(context, v8::String::NewFromUtf8Literal(isolate, "names"),
+		v8::Array::New(isolate, elements.data(), count)).Check();
+	result->Set(context, v8::String::NewFromUtf8Literal(isolate, "isDirectory"),
+		v8::Uint8Array::New(is_directory, 0, count)).Check();
+	result->Set(context, v8::String::NewFromUtf8Literal(isolate, "size"),
+		v8::Float64Array::New(sizes, 0, count)).Check();
+	result->Set(context, v8::String::NewFromUtf8Literal(isolate, "mtime"),
+		v8::Float64Array::New(mtimes, 0, count)).Check();
+
+	args.GetReturnValue().Set(result);
 }
 
-/** The callback that is invoked by v8 whenever the JavaScript 'removeFile'
- *  function is called. Deletes the file mentioned in arg[0]. */
-void RemoveFile(const v8::FunctionCallbackInfo<v8::Value>& args) {
-	v8::String::Utf8Value file(args.GetIsolate(), args[0]);
-	auto filename = fs::path(ToCString(file));
-  ConstructAbsolutePath(filename);
-	
-	if (!fs::exists(filename)) {
-	  PrintErrorTag();
-	  std::cerr << " File " << rang::style::bold << filename << rang::style::reset
-						  << " doesnt exists." << std::endl;
+/** Reads a glob option, which is either a single pattern or an array of them. */
+std::vector<std::string> GetPatterns(v8::Isolate* isolate, v8::Local<v8::Value> value) {
+	std::vector<std::string> patterns;
+	auto context = isolate->GetCurrentContext();
 
-		return;
+	if (value->IsString()) {
+		v8::String::Utf8Value pattern(isolate, value);
+		patterns.emplace_back(ToCString(pattern));
+	} else if (value->IsArray()) {
+		auto array = value.As<v8::Array>();
+		for (uint32_t i = 0; i < array->Length(); i++) {
+			v8::String::Utf8Value pattern(isolate, array->Get(context, i).ToLocalChecked());
+			patterns.emplace_back(ToCString(pattern));
+		}
 	}
-	if (fs::is_directory(filename)) {
-		PrintErrorTag();
-		std::cerr << " Entity " << rang::style::bold << filename << rang::style::reset << " is a directory."
-							<< " Try removeDir('" << filename << "') or rm('"
-							<< filename << "') instead."
-									 
-			<< std::endl;
 
-		return;
-	}
+	return patterns;
+}
 
-	std::error_code err;
-	auto OK = fs::remove(filename, err);
-	if (!OK) {
-		PrintErrorTag();
-		std::cerr << " " << std::system_category().message(errno)
-							<< std::endl;
+/** Converts a batch of walk() results into an array of entry objects. */
+v8::Local<v8::Array> WalkEntriesToArray(v8::Isolate* isolate,
+	const std::vector<WalkEntry>& entries, bool stats) {
+	auto context = isolate->GetCurrentContext();
+	auto entry_template = stats
+		? GetObjectTemplate(isolate, "walkEntryStats", {"path", "type", "size", "mtime"})
+		: GetObjectTemplate(isolate, "walkEntry", {"path", "type"});
+
+	auto path_key = v8::String::NewFromUtf8Literal(isolate, "path",
+		v8::NewStringType::kInternalized);
+	auto type_key = v8::String::NewFromUtf8Literal(isolate, "type",
+		v8::NewStringType::kInternalized);
+	auto size_key = v8::String::NewFromUtf8Literal(isolate, "size",
+		v8::NewStringType::kInternalized);
+	auto mtime_key = v8::String::NewFromUtf8Literal(isolate, "mtime",
+		v8::NewStringType::kInternalized);
+	// Indexed by WalkEntryType
+	v8::Local<v8::Value> type_names[] = {
+		v8::String::NewFromUtf8Literal(isolate, "file", v8::NewStringType::kInternalized),
+		v8::String::NewFromUtf8Literal(isolate, "directory", v8::NewStringType::kInternalized),
+		v8::String::NewFromUtf8Literal(isolate, "symlink", v8::NewStringType::kInternalized),
+		v8::String::NewFromUtf8Literal(isolate, "other", v8::NewStringType::kInternalized)};
+
+	std::vector<v8::Local<v8::Value>> elements;
+	elements.reserve(entries.size());
+
+	for (const auto& entry : entries) {
+		auto object = entry_template->NewInstance(context).ToLocalChecked();
+		object->Set(context, path_key, v8::String::NewFromUtf8(isolate, entry.path.data(),
+			v8::NewStringType::kNormal, static_cast<int>(entry.path.size())).ToLocalChecked()).Check();
+		object->Set(context, type_key, type_names[static_cast<size_t>(entry.type)]).Check();
+		if (stats) {
+			object->Set(context, size_key,
+				v8::Number::New(isolate, static_cast<double>(entry.size))).Check();
+			object->Set(context, mtime_key, v8::Number::New(isolate, entry.mtime)).Check();
+		}
+		elements.push_back(object);
 	}
+
+	return v8::Array::New(isolate, elements.data(), elements.size());
 }
 
-/** The callback that is invoked by v8 whenever the JavaScript 'removeDir'
- *  function is called. Recursively deletes the directory mentioned in arg[0]. */
-void RemoveDir(const v8::FunctionCallbackInfo<v8::Value>& args) {
-	v8::String::Utf8Value dir(args.GetIsolate(), args[0]);
-	auto dirname = fs::path(ToCString(dir));
-  ConstructAbsolutePath(dirname);
+// Batches a streaming walk() may queue before the walker threads wait for the callback
+constexpr size_t kMaxQueuedWalkBatches = 64;
 
-	if (!fs::exists(dirname)) {
-		PrintErrorTag();
-		std::cerr << " Directory " << rang::style::bold << dirname
-							<< rang::style::reset << " doesnt exists." << std::endl;
+/** The callback that is invoked by v8 whenever the JavaScript 'walk'
+ *  function is called. Recursively traverses a directory tree on a pool of
+ *  threads. Returns an array of entries, or if a callback is passed, hands
+ *  the entries over in chunks as they are found and returns a summary. */
+void Walk(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	auto* isolate = args.GetIsolate();
+	auto context = isolate->GetCurrentContext();
+
+	if (args.Length() < 1 || !args[0]->IsString()) {
+		isolate->ThrowError("[Error] No root directory passed");
+		return;
+	}
+
+	v8::String::Utf8Value root_arg(isolate, args[0]);
+	auto root = fs::path(ToCString(root_arg));
+	ConstructAbsolutePath(isolate, root);
+
+	// Both walk(root, callback) and walk(root, options, callback) are accepted
+	auto options = args[1];
+	auto callback_arg = args[1]->IsFunction() ? args[1] : args[2];
+
+	WalkOptions walk_options;
+	auto max_depth = GetOption(isolate, options, "maxDepth");
+	if (max_depth->IsNumber()) {
+		walk_options.max_depth = max_depth->Int32Value(context).FromMaybe(-1);
+	}
+	walk_options.include = GetPatterns(isolate, GetOption(isolate, options, "include"));
+	walk_options.exclude = GetPatterns(isolate, GetOption(isolate, options, "exclude"));
+	walk_options.follow_symlinks =
+		GetOption(isolate, options, "followSymlinks")->BooleanValue(isolate);
+	walk_options.stats = GetOption(isolate, options, "stats")->BooleanValue(isolate);
+	auto threads = GetOption(isolate, options, "threads");
+	if (threads->IsNumber()) {
+		walk_options.threads = static_cast<unsigned int>(
+			std::clamp<int64_t>(threads->IntegerValue(context).FromMaybe(0), 1, 256));
+	}
+	auto chunk_size = GetOption(isolate, options, "chunkSize");
+	if (chunk_size->IsNumber()) {
+		walk_options.batch_size = static_cast<size_t>(
+			std::max<int64_t>(chunk_size->IntegerValue(context).FromMaybe(0), 1));
+	}
+
+	WalkResult result;
+	std::string error;
+
+	if (!callback_arg->IsFunction()) {
+		std::mutex entries_mutex;
+		std::vector<WalkEntry> entries;
+		auto sink = [&](std::vector<WalkEntry>& batch) {
+			std::lock_guard<std::mutex> lock(entries_mutex);
+			std::move(batch.begin(), batch.end(), std::back_inserter(entries));
+		};
+
+		if (!WalkTree(root.string().c_str(), walk_options, sink, result, error)) {
+			ThrowErrorWithReason(isolate, "Cannot walk directory", error);
+			return;
+		}
+		if (result.errors != 0) {
+			auto& err_out = IsolateState::From(isolate)->Err();
+			PrintWarningTag(err_out);
+			err_out << " walk() skipped " << result.errors << " unreadable directories, first: "
+								<< result.first_error << std::endl;
+		}
+
+		args.GetReturnValue().Set(WalkEntriesToArray(isolate, entries, walk_options.stats));
+		return;
+	}
+
+	// Streaming mode: the walker threads queue batches, this thread hands them to JS
+	auto callback = callback_arg.As<v8::Function>();
+	std::mutex queue_mutex;
+	std::condition_variable batch_ready;
+	std::condition_variable queue_space;
+	std::deque<std::vector<WalkEntry>> queue;
+	std::atomic<bool> cancel{false};
+	bool done = false;
+	bool walked = false;
+	walk_options.cancel = &cancel;
+
+	auto sink = [&](std::vector<WalkEntry>& batch) {
+		std::unique_lock<std::mutex> lock(queue_mutex);
+		queue_space.wait(lock, [&] { return queue.size() < kMaxQueuedWalkBatches || cancel; });
+		if (cancel) {
+			return;
+		}
+		queue.push_back(std::move(batch));
+		batch_ready.notify_one();
+	};
+
+	std::thread walker([&] {
+		walked = WalkTree(root.string().c_str(), walk_options, sink, result, error);
+
+		std::lock_guard<std::mutex> lock(queue_mutex);
+		done = true;
+		batch_ready.notify_one();
+	});
+
+	v8::Global<v8::Value> exception;
+	while (true) {
+		std::vector<WalkEntry> batch;
+		{
+			std::unique_lock<std::mutex> lock(queue_mutex);
+			batch_ready.wait(lock, [&] { return !queue.empty() || done; });
+			if (queue.empty()) {
+				break;
+			}
+			batch = std::move(queue.front());
+			queue.pop_front();
+		}
+		queue_space.notify_one();
+
+		if (cancel) {
+			continue;
+		}
+
+		v8::HandleScope handle_scope(isolate);
+		v8::TryCatch try_catch(isolate);
+		v8::Local<v8::Value> chunk = WalkEntriesToArray(isolate, batch, walk_options.stats);
+		if (callback->Call(context, v8::Undefined(isolate), 1, &chunk).IsEmpty()) {
+			// Stop the walk, the exception is rethrown once the threads are done
+			{
+				std::lock_guard<std::mutex> lock(queue_mutex);
+				cancel = true;
+			}
+			queue_space.notify_all();
+			if (try_catch.HasCaught() && !try_catch.HasTerminated()) {
+				exception.Reset(isolate, try_catch.Exception());
+			}
+		}
+	}
+	walker.join();
+
+	if (!exception.IsEmpty()) {
+		isolate->ThrowException(exception.Get(isolate));
+		return;
+	}
+	if (cancel) {
+		// Terminated while inside the callback
+		return;
+	}
+	if (!walked) {
+		ThrowErrorWithReason(isolate, "Cannot walk directory", error);
+		return;
+	}
+
+	auto summary = v8::Object::New(isolate);
+	summary->Set(context, v8::String::NewFromUtf8Literal(isolate, "entries"),
+		v8::Number::New(isolate, static_cast<double>(result.entries))).Check();
+	summary->Set(context, v8::String::NewFromUtf8Literal(isolate, "directories"),
+		v8::Number::New(isolate, static_cast<double>(result.directories))).Check();
+	summary->Set(context, v8::String::NewFromUtf8Literal(isolate, "errors"),
+		v8::Number::New(isolate, static_cast<double>(result.errors))).Check();
+
+	args.GetReturnValue().Set(summary);
+}
+
+/** The callback that is invoked by v8 whenever the JavaScript 'createFile'
+ *  function is called. Creates a new file in the cwd. */
+void CreateNewFile(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	v8::String::Utf8Value file(args.GetIsolate(), args[0]);
+	auto filename = fs::path(ToCString(file));
+	ConstructAbsolutePath(args.GetIsolate(), filename);
+
+	if (fs::exists(filename)) {
+		auto& err_out = IsolateState::From(args.GetIsolate())->Err();
+		PrintErrorTag(err_out);
+		err_out << " File " << filename << " already exists." << std::endl;
+
+		return;
+	}
+
+	std::ofstream out_filestream(filename);
+	out_filestream.close();
+}
+
+/** The callback that is invoked by v8 whenever the JavaScript 'removeFile'
+ *  function is called. Deletes the file mentioned in arg[0]. */
+void RemoveFile(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	v8::String::Utf8Value file(args.GetIsolate(), args[0]);
+	auto filename = fs::path(ToCString(file));
+	ConstructAbsolutePath(args.GetIsolate(), filename);
+	
+	if (!fs::exists(filename)) {
+	  auto& err_out = IsolateState::From(args.GetIsolate())->Err();
+	  PrintErrorTag(err_out);
+	  err_out << " File " << rang::style::bold << filename << rang::style::reset
+						  << " doesnt exists." << std::endl;
+
+		return;
+	}
+	if (fs::is_directory(filename)) {
+		auto& err_out = IsolateState::From(args.GetIsolate())->Err();
+		PrintErrorTag(err_out);
+		err_out << " Entity " << rang::style::bold << filename << rang::style::reset << " is a directory."
+							<< " Try removeDir('" << filename << "') or rm('"
+							<< filename << "') instead."
+									 
+			<< std::endl;
+
+		return;
+	}
+
+	std::error_code err;
+	auto OK = fs::remove(filename, err);
+	if (!OK) {
+		auto& err_out = IsolateState::From(args.GetIsolate())->Err();
+		PrintErrorTag(err_out);
+		err_out << " " << std::system_category().message(errno)
+							<< std::endl;
+	}
+}
+
+/** Removes path and everything below it on a pool of threads, whose size
+ *  can be set with the 'threads' option in args[1]. Returns the number of
+ *  removed files and directories, the freed bytes and the elapsed time. */
+void RemoveTreeWithSummary(const v8::FunctionCallbackInfo<v8::Value>& args,
+	const fs::path& path) {
+	auto* isolate = args.GetIsolate();
+	auto context = isolate->GetCurrentContext();
+
+	RemoveOptions remove_options;
+	auto threads = GetOption(isolate, args[1], "threads");
+	if (threads->IsNumber()) {
+		remove_options.threads = static_cast<unsigned int>(
+			std::clamp<int64_t>(threads->IntegerValue(context).FromMaybe(0), 1, 256));
+	}
+
+	RemoveResult result;
+	std::string error;
+	const auto start = std::chrono::steady_clock::now();
+	if (!RemoveTree(path.string().c_str(), remove_options, result, error)) {
+		auto& err_out = IsolateState::From(isolate)->Err();
+		PrintErrorTag(err_out);
+		err_out << " " << error << std::endl;
+
+		return;
+	}
+	const double elapsed_ms = std::chrono::duration<double, std::milli>(
+		std::chrono::steady_clock::now() - start).count();
+
+	if (result.errors != 0) {
+		auto& err_out = IsolateState::From(isolate)->Err();
+		PrintErrorTag(err_out);
+		err_out << " Could not remove " << result.errors << " entries, first: "
+							<< result.first_error << std::endl;
+	}
+
+	auto summary = v8::Object::New(isolate);
+	auto set = [&](const char* name, double value) {
+		summary->Set(context, v8::String::NewFromUtf8(isolate, name).ToLocalChecked(),
+			v8::Number::New(isolate, value)).Check();
+	};
+	set("files", static_cast<double>(result.files));
+	set("dirs", static_cast<double>(result.directories));
+	set("bytesFreed", static_cast<double>(result.bytes_freed));
+	set("errors", static_cast<double>(result.errors));
+	set("elapsedMs", elapsed_ms);
+
+	args.GetReturnValue().Set(summary);
+}
+
+/** The callback that is invoked by v8 whenever the JavaScript 'removeDir'
+ *  function is called. Recursively deletes the directory mentioned in arg[0].
+ *  Takes an optional options object, see RemoveTreeWithSummary(). */
+void RemoveDir(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	v8::String::Utf8Value dir(args.GetIsolate(), args[0]);
+	auto dirname = fs::path(ToCString(dir));
+	ConstructAbsolutePath(args.GetIsolate(), dirname);
+
+	if (!fs::exists(dirname)) {
+		auto& err_out = IsolateState::From(args.GetIsolate())->Err();
+		PrintErrorTag(err_out);
+		err_out << " Directory " << rang::style::bold << dirname
+							<< rang::style::reset << " doesnt exists." << std::endl;
 
 		return;
 	}
 	if (!fs::is_directory(dirname)) {
-		PrintErrorTag();
-		std::cerr << " Entity " << rang::style::bold << dirname
+		auto& err_out = IsolateState::From(args.GetIsolate())->Err();
+		PrintErrorTag(err_out);
+		err_out << " Entity " << rang::style::bold << dirname
 							<< rang::style::reset << " is a file."
 							<< " Try removeFile('" << dirname << "') or rm('" << dirname
 							<< "') instead."
 
 							<< std::endl;
 
-		return;
+		return;
+	}
+
+	RemoveTreeWithSummary(args, dirname);
+}
+
+/** The callback that is invoked by v8 whenever the JavaScript 'rm'
+ *  function is called. (Recursively) deletes the path entity mentioned in arg[0].
+ *  Takes an optional options object, see RemoveTreeWithSummary(). */
+void RemoveAny(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	v8::String::Utf8Value path_entity(args.GetIsolate(), args[0]);
+	auto pathname = fs::path(ToCString(path_entity));
+	ConstructAbsolutePath(args.GetIsolate(), pathname);
+
+	RemoveTreeWithSummary(args, pathname);
+}
+
+/** The callback that is invoked by v8 whenever the JavaScript 'rename'
+ *  function is called. Renames the passed file or directory
+ *  to the new name in arg[1]. This function guarantees that the new
+ *  entity is in the same directory as the old one */
+void Rename(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	v8::String::Utf8Value path_entity(args.GetIsolate(), args[0]);
+	auto old_pathname = fs::path(ToCString(path_entity));
+	ConstructAbsolutePath(args.GetIsolate(), old_pathname);
+
+	v8::String::Utf8Value new_path_entity(args.GetIsolate(), args[1]);
+	auto new_pathname = fs::path(ToCString(new_path_entity));
+	ConstructAbsolutePath(args.GetIsolate(), new_pathname);
+
+	if (new_pathname.parent_path() != old_pathname.parent_path()) {
+		auto& err_out = IsolateState::From(args.GetIsolate())->Err();
+		PrintErrorTag(err_out);
+		err_out << " Tried to move file " << rang::style::bold << old_pathname
+							<< rang::style::reset << " to new location."
+							<< " Use the move('from', 'to') function instead." << std::endl;
+
+		return;
+	}
+
+	std::error_code err;
+	fs::rename(old_pathname, new_pathname, err);
+
+	if (err.value() != 0) {
+		auto& err_out = IsolateState::From(args.GetIsolate())->Err();
+		PrintErrorTag(err_out);
+		err_out << " " << std::system_category().message(errno)
+							<< std::endl;
+	}
+}
+
+/** The callback that is invoked by v8 whenever the JavaScript 'move'
+ *  function is called. Moves the passed file or directory
+ *  to the new path in arg[1]. */
+void Move(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	v8::String::Utf8Value path_entity(args.GetIsolate(), args[0]);
+	auto old_path = fs::path(ToCString(path_entity));
+	ConstructAbsolutePath(args.GetIsolate(), old_path);
+
+	v8::String::Utf8Value new_path_entity(args.GetIsolate(), args[1]);
+	auto new_path = fs::path(ToCString(new_path_entity));
+	ConstructAbsolutePath(args.GetIsolate(), new_path);
+
+	std::error_code err;
+	fs::rename(old_path, new_path, err);
+
+	if (err.value() != 0) {
+		auto& err_out = IsolateState::From(args.GetIsolate())->Err();
+		PrintErrorTag(err_out);
+		err_out << " " << std::system_category().message(errno)
+							<< std::endl;
+	}
+}
+
+/** Copies source to target as configured by the options object in args[2]:
+ *  'recursive' copies directories, 'threads' sizes the worker pool, 'reflink'
+ *  (default true) clones file extents where possible and 'verbose' (default
+ *  true) prints a summary. Returns counters, the elapsed time and throughput. */
+void CopyTreeWithOptions(const v8::FunctionCallbackInfo<v8::Value>& args,
+	const fs::path& source, const fs::path& target) {
+	auto* isolate = args.GetIsolate();
+	auto context = isolate->GetCurrentContext();
+	auto options = args[2];
+
+	CopyOptions copy_options;
+	copy_options.recursive = GetOption(isolate, options, "recursive")->BooleanValue(isolate);
+	auto reflink = GetOption(isolate, options, "reflink");
+	copy_options.reflink = reflink->IsUndefined() || reflink->BooleanValue(isolate);
+	auto threads = GetOption(isolate, options, "threads");
+	if (threads->IsNumber()) {
+		copy_options.threads = static_cast<unsigned int>(
+			std::clamp<int64_t>(threads->IntegerValue(context).FromMaybe(0), 1, 256));
+	}
+	auto verbose_option = GetOption(isolate, options, "verbose");
+	const bool verbose = verbose_option->IsUndefined() || verbose_option->BooleanValue(isolate);
+
+	if (CopiesIntoItself(source, target)) {
+		isolate->ThrowError("[Error] Cannot copy something into itself");
+		return;
+	}
+
+	CopyResult result;
+	std::string error;
+	const auto start = std::chrono::steady_clock::now();
+	if (!CopyTree(source.string().c_str(), target.string().c_str(), copy_options, result,
+			error)) {
+		ThrowErrorWithReason(isolate, "Cannot copy", error);
+		return;
+	}
+	const double elapsed_ms = std::chrono::duration<double, std::milli>(
+		std::chrono::steady_clock::now() - start).count();
+	const double bytes_per_sec = elapsed_ms > 0
+		? static_cast<double>(result.bytes) * 1000.0 / elapsed_ms : 0;
+
+	if (result.errors != 0) {
+		auto& err_out = IsolateState::From(isolate)->Err();
+		PrintWarningTag(err_out);
+		err_out << " copy() failed for " << result.errors << " entries, first: "
+							<< result.first_error << std::endl;
+	}
+	if (verbose) {
+		IsolateState::From(isolate)->Out() << "Copied " << result.files << " files and " << result.directories
+							<< " directories, " << result.bytes / (1024.0 * 1024.0) << " MiB in "
+							<< elapsed_ms << " ms (" << bytes_per_sec / (1024.0 * 1024.0) << " MiB/s)"
+							<< std::endl;
+	}
+
+	auto summary = v8::Object::New(isolate);
+	auto set = [&](const char* name, double value) {
+		summary->Set(context, v8::String::NewFromUtf8(isolate, name).ToLocalChecked(),
+			v8::Number::New(isolate, value)).Check();
+	};
+	set("files", static_cast<double>(result.files));
+	set("directories", static_cast<double>(result.directories));
+	set("bytes", static_cast<double>(result.bytes));
+	set("reflinked", static_cast<double>(result.reflinked));
+	set("errors", static_cast<double>(result.errors));
+	set("elapsedMs", elapsed_ms);
+	set("bytesPerSec", bytes_per_sec);
+
+	args.GetReturnValue().Set(summary);
+}
+
+/** Returns true if target is source or lies within it. A copy into its own
+ *  source would keep finding the entries it just created. */
+bool CopiesIntoItself(const fs::path& source, const fs::path& target) {
+	std::error_code err;
+	const auto canonical_source = fs::weakly_canonical(source, err);
+	const auto canonical_target = fs::weakly_canonical(target, err);
+	const auto relative = canonical_target.lexically_relative(canonical_source);
+
+	return !err && !relative.empty() && *relative.begin() != "..";
+}
+
+/** The callback that is invoked by v8 whenever the JavaScript 'copy'
+ *  function is called. Copies the passed file or directory
+ *  to the new path in arg[1].
+ *  If an options object is passed, copies the tree in parallel and
+ *  returns statistics about the copy, see CopyTreeWithOptions(). */
+void Copy(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	v8::String::Utf8Value path_entity(args.GetIsolate(), args[0]);
+	auto source_path = fs::path(ToCString(path_entity));
+	ConstructAbsolutePath(args.GetIsolate(), source_path);
+
+	v8::String::Utf8Value new_path_entity(args.GetIsolate(), args[1]);
+	auto dest_path = fs::path(ToCString(new_path_entity));
+	ConstructAbsolutePath(args.GetIsolate(), dest_path);
+
+	if (args[2]->IsObject()) {
+		CopyTreeWithOptions(args, source_path, dest_path);
+		return;
+	}
+
+	std::error_code err;
+	fs::copy(source_path, dest_path, err);
+
+	if (err.value() != 0) {
+		auto& err_out = IsolateState::From(args.GetIsolate())->Err();
+		PrintErrorTag(err_out);
+		err_out << " " << std::system_category().message(errno)
+							<< std::endl;
+	}
+}
+
+/** The callback that is invoked by v8 whenever the JavaScript 'mkdir'
+ *  function is called. Creates a new directory. */
+void CreateNewDir(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	v8::String::Utf8Value dirname(args.GetIsolate(), args[0]);
+	auto new_dir = fs::path(ToCString(dirname));
+	ConstructAbsolutePath(args.GetIsolate(), new_dir);
+
+  if (fs::exists(new_dir) && fs::is_directory(new_dir)) {
+		auto& err_out = IsolateState::From(args.GetIsolate())->Err();
+		PrintErrorTag(err_out);
+		err_out << " Directory " << new_dir.generic_string() << " already exists.";
+
+    return;
+  }
+
+	std::error_code err;
+	fs::create_directory(new_dir, err);
+
+	if (err.value() != 0) {
+		auto& err_out = IsolateState::From(args.GetIsolate())->Err();
+		PrintErrorTag(err_out);
+		err_out << " " << std::system_category().message(errno)
+							<< std::endl;
+	}
+}
+
+/** Collects output of unknown size in ArrayBuffer allocator memory, doubling
+ *  its capacity whenever it is full. Hands the memory over to an ArrayBuffer
+ *  without another copy, so large outputs never pass through JS strings. */
+class OutputArena {
+ public:
+	explicit OutputArena(v8::Isolate* isolate) : allocator_(isolate->GetArrayBufferAllocator()) {}
+	OutputArena(const OutputArena&) = delete;
+	OutputArena& operator=(const OutputArena&) = delete;
+
+	~OutputArena() {
+		if (data_ != nullptr) {
+			allocator_->Free(data_, capacity_);
+		}
+	}
+
+	/** Returns false if the allocator ran out of memory. */
+	bool Append(const char* data, size_t length) {
+		if (length > capacity_ - size_) {
+			auto capacity = std::max(capacity_, kInitialCapacity);
+			while (capacity - size_ < length) {
+				capacity *= 2;
+			}
+
+			auto* grown = static_cast<char*>(allocator_->AllocateUninitialized(capacity));
+			if (grown == nullptr) {
+				return false;
+			}
+			if (data_ != nullptr) {
+				memcpy(grown, data_, size_);
+				allocator_->Free(data_, capacity_);
+			}
+			data_ = grown;
+			capacity_ = capacity;
+		}
+
+		memcpy(data_ + size_, data, length);
+		size_ += length;
+
+		return true;
+	}
+
+	/** Returns the collected bytes as an ArrayBuffer and empties the arena. */
+	v8::Local<v8::ArrayBuffer> Release(v8::Isolate* isolate) {
+		if (data_ == nullptr) {
+			return v8::ArrayBuffer::New(isolate, 0);
+		}
+
+		// The allocator has to be told the full capacity when the buffer is freed
+		auto store = v8::ArrayBuffer::NewBackingStore(data_, size_,
+			[](void* data, size_t, void* allocation) {
+				auto* arena = static_cast<Allocation*>(allocation);
+				arena->allocator->Free(data, arena->capacity);
+				delete arena;
+			},
+			new Allocation{allocator_, capacity_});
+		data_ = nullptr;
+		size_ = capacity_ = 0;
+
+		return v8::ArrayBuffer::New(isolate, std::move(store));
+	}
+
+ private:
+	struct Allocation {
+		v8::ArrayBuffer::Allocator* allocator;
+		size_t capacity;
+	};
+
+	inline static const size_t kInitialCapacity = 64 * 1024;
+
+	v8::ArrayBuffer::Allocator* allocator_;
+	char* data_ = nullptr;
+	size_t size_ = 0;
+	size_t capacity_ = 0;
+};
+
+// KiB of each stream kept by runSync() with capture: 'tail' unless tailKb says otherwise
+constexpr size_t kDefaultTailKb = 64;
+
+/** Keeps the last bytes of a stream in a ring buffer of fixed size. */
+class TailBuffer {
+ public:
+	explicit TailBuffer(size_t capacity) : data_(capacity) {}
+
+	void Append(const char* data, size_t length) {
+		const auto capacity = data_.size();
+		if (capacity == 0) {
+			return;
+		}
+		if (length > capacity) {
+			data += length - capacity;
+			length = capacity;
+		}
+
+		const auto first = std::min(length, capacity - end_);
+		memcpy(data_.data() + end_, data, first);
+		memcpy(data_.data(), data + first, length - first);
+		end_ = (end_ + length) % capacity;
+		stored_ = std::min(stored_ + length, capacity);
+	}
+
+	std::string Contents() const {
+		const auto capacity = data_.size();
+		std::string contents;
+		if (stored_ == 0) {
+			return contents;
+		}
+
+		const auto begin = (end_ + capacity - stored_) % capacity;
+		const auto first = std::min(stored_, capacity - begin);
+		contents.reserve(stored_);
+		contents.append(data_.data() + begin, first);
+		contents.append(data_.data(), stored_ - first);
+
+		return contents;
+	}
+
+ private:
+	std::vector<char> data_;
+	// Where the next byte goes and how many of the buffer's bytes are in use
+	size_t end_ = 0;
+	size_t stored_ = 0;
+};
+
+/** Calls callback with a batch of lines as an array of strings, followed by
+ *  an optional second argument. Returns false if the callback threw. */
+bool CallWithLines(v8::Isolate* isolate, v8::Local<v8::Function> callback,
+	const std::vector<std::string_view>& lines, v8::Local<v8::Value> argument = {}) {
+	if (lines.empty()) {
+		return true;
+	}
+
+	std::vector<v8::Local<v8::Value>> strings;
+	strings.reserve(lines.size());
+	for (auto line : lines) {
+		strings.push_back(v8::String::NewFromUtf8(isolate, line.data(),
+			v8::NewStringType::kNormal, static_cast<int>(line.size())).ToLocalChecked());
+	}
+
+	v8::Local<v8::Value> call_args[] = {
+		v8::Array::New(isolate, strings.data(), strings.size()), argument};
+	auto context = isolate->GetCurrentContext();
+
+	return !callback->Call(context, v8::Undefined(isolate), argument.IsEmpty() ? 1 : 2,
+		call_args).IsEmpty();
+}
+
+/** The callback that is invoked by v8 whenever the JavaScript 'runSync'
+ *  function is called. Creates a child process and halts execution
+ *  of the shell until the child process terminates.
+ *  First argument is the application to be executed which is first
+ *  looked for in the current executable's directory, otherwise the
+ *  PATH is searched. Second argument is an optional additional
+ *  object with parameeters to be passed to the executable.
+ *  Third argument is controls verbosity of this functions, or an options
+ *  object that may ask for the output to be captured (see RunSyncCaptured). */
+void StartProcessSync(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	auto* isolate = args.GetIsolate();
+	bool verbose = true;
+
+	if (!(args[0]->IsString())) {
+		auto& err_out = IsolateState::From(isolate)->Err();
+		PrintErrorTag(err_out);
+		err_out << " No executable filename or path passed!" << std::endl;
+
+		return;
+	}
+
+	auto process_args = GetProcessArgs(isolate, args[1]);
+
+	if (args.Length() > 2) {
+		if (args[2]->IsBoolean() &&
+				!(args[2]->ToBoolean(isolate)->BooleanValue(isolate))) {
+			 verbose = false;
+		}
+	}
+
+	v8::String::Utf8Value str(isolate, args[0]);
+	auto process_command = ResolveCommand(isolate, ToCString(str));
+
+	// An options object with a capture mode collects the output instead of printing it
+	if (GetOption(isolate, args[2], "capture")->IsString()) {
+		RunSyncCaptured(args, process_command, process_args);
+		return;
+	}
+	if (args[2]->IsObject() && GetOption(isolate, args[2], "verbose")->IsFalse()) {
+		verbose = false;
+	}
+
+	CreateNewProcess(process_command, process_args, verbose);
+}
+
+/** Runs a runSync() call whose options ask for its output, blocking until the
+ *  child exited. 'capture' is 'buffer' to return stdout and stderr as
+ *  ArrayBuffers, 'lines' to call 'onLines' with batches of lines and the
+ *  stream they came from, or 'tail' to return the last 'tailKb' KiB of each. */
+void RunSyncCaptured(const v8::FunctionCallbackInfo<v8::Value>& args,
+	const std::string& command, const std::vector<std::string>& process_args) {
+	auto* isolate = args.GetIsolate();
+	auto context = isolate->GetCurrentContext();
+
+	enum class Capture { kBuffer, kLines, kTail } capture;
+	v8::String::Utf8Value capture_option(isolate, GetOption(isolate, args[2], "capture"));
+	if (strcmp(ToCString(capture_option), "buffer") == 0) {
+		capture = Capture::kBuffer;
+	} else if (strcmp(ToCString(capture_option), "lines") == 0) {
+		capture = Capture::kLines;
+	} else if (strcmp(ToCString(capture_option), "tail") == 0) {
+		capture = Capture::kTail;
+	} else {
+		isolate->ThrowError("[Error] capture must be 'buffer', 'lines' or 'tail'");
+		return;
+	}
+
+	auto on_lines = GetOption(isolate, args[2], "onLines");
+	if (capture == Capture::kLines && !on_lines->IsFunction()) {
+		isolate->ThrowError("[Error] capture: 'lines' needs an onLines function");
+		return;
+	}
+
+	size_t tail_size = 0;
+	if (capture == Capture::kTail) {
+		tail_size = kDefaultTailKb * 1024;
+		auto tail_option = GetOption(isolate, args[2], "tailKb");
+		if (tail_option->IsNumber()) {
+			tail_size = static_cast<size_t>(
+				std::clamp(tail_option.As<v8::Number>()->Value(), 1.0, 1024.0 * 1024.0)) * 1024;
+		}
+	}
+
+	ProcessJob job;
+	job.command = command;
+	job.args = process_args;
+	job.options = GetSpawnOptions(isolate, args[2]);
+	// Like without capturing, the child may read the shell's input
+	job.options.null_stdin = false;
+
+	struct CapturedStream {
+		CapturedStream(v8::Isolate* isolate, size_t tail_size) : arena(isolate), tail(tail_size) {}
+
+		OutputArena arena;
+		TailBuffer tail;
+		LineSplitter splitter;
+		uint64_t bytes = 0;
+	};
+	CapturedStream captured_stdout(isolate, tail_size);
+	CapturedStream captured_stderr(isolate, tail_size);
+	auto stdout_name = v8::String::NewFromUtf8Literal(isolate, "stdout");
+	auto stderr_name = v8::String::NewFromUtf8Literal(isolate, "stderr");
+
+	std::vector<std::string_view> lines;
+	bool out_of_memory = false;
+	auto sink = [&](OutputStream stream, const char* data, size_t length) {
+		auto& captured = stream == OutputStream::kStdout ? captured_stdout : captured_stderr;
+		captured.bytes += length;
+
+		switch (capture) {
+			case Capture::kBuffer:
+				out_of_memory = !captured.arena.Append(data, length);
+				return !out_of_memory;
+			case Capture::kTail:
+				captured.tail.Append(data, length);
+				return true;
+			default:
+				captured.splitter.Feed(data, length, lines);
+				return CallWithLines(isolate, on_lines.As<v8::Function>(), lines,
+					stream == OutputStream::kStdout ? stdout_name : stderr_name);
+		}
+	};
+
+	const auto start = std::chrono::steady_clock::now();
+	ChildExit exit;
+	std::string error;
+	bool ran;
+	{
+		// An exception thrown by onLines terminates the child and is passed on
+		v8::TryCatch try_catch(isolate);
+		ran = RunCapturing(job, sink, exit, error);
+		if (ran && capture == Capture::kLines && !try_catch.HasCaught()) {
+			captured_stdout.splitter.Finish(lines);
+			if (CallWithLines(isolate, on_lines.As<v8::Function>(), lines, stdout_name)) {
+				captured_stderr.splitter.Finish(lines);
+				CallWithLines(isolate, on_lines.As<v8::Function>(), lines, stderr_name);
+			}
+		}
+		if (try_catch.HasCaught()) {
+			try_catch.ReThrow();
+			return;
+		}
+	}
+	if (!ran) {
+		ThrowErrorWithReason(isolate, "Cannot run process", error);
+		return;
+	}
+	if (out_of_memory) {
+		isolate->ThrowError("[Error] Out of memory while capturing the process's output");
+		return;
+	}
+
+	auto result = v8::Object::New(isolate);
+	auto set = [&](const char* key, v8::Local<v8::Value> value) {
+		result->Set(context, v8::String::NewFromUtf8(isolate, key).ToLocalChecked(),
+								value).Check();
+	};
+
+	set("code", v8::Integer::New(isolate, exit.code));
+	set("signal", exit.signal.empty()
+		? v8::Local<v8::Value>(v8::Null(isolate))
+		: v8::Local<v8::Value>(v8::String::NewFromUtf8(isolate, exit.signal.c_str())
+				.ToLocalChecked()));
+	set("durationMs", v8::Number::New(isolate, std::chrono::duration<double, std::milli>(
+		std::chrono::steady_clock::now() - start).count()));
+	set("stdoutBytes", v8::Number::New(isolate, static_cast<double>(captured_stdout.bytes)));
+	set("stderrBytes", v8::Number::New(isolate, static_cast<double>(captured_stderr.bytes)));
+	if (capture == Capture::kBuffer) {
+		set("stdout", captured_stdout.arena.Release(isolate));
+		set("stderr", captured_stderr.arena.Release(isolate));
+	} else if (capture == Capture::kTail) {
+		set("stdout", ProcessOutputToString(isolate, captured_stdout.tail.Contents()));
+		set("stderr", ProcessOutputToString(isolate, captured_stderr.tail.Contents()));
+	}
+
+	args.GetReturnValue().Set(result);
+}
+
+/** Converts the arguments for a child process. An array of strings is
+ *  passed on as is. An object is formatted like runSync() documents it,
+ *  keys become '-k'/'--key value' options and the special '_PREPEND' and
+ *  '_APPEND' keys are placed before respectively after all others. */
+std::vector<std::string> GetProcessArgs(v8::Isolate* isolate, v8::Local<v8::Value> value) {
+	auto context = isolate->GetCurrentContext();
+  std::vector<std::string> process_args;
+
+	if (value.IsEmpty() || !value->IsObject()) {
+		return process_args;
+	}
+
+	if (value->IsArray()) {
+		auto array = value.As<v8::Array>();
+		for (uint32_t i = 0; i < array->Length(); i++) {
+			v8::String::Utf8Value arg(isolate, array->Get(context, i).ToLocalChecked());
+			process_args.emplace_back(ToCString(arg));
+		}
+
+		return process_args;
+	}
+
+  const char* kAppendix = "_APPEND";
+  const char* kPrependix = "_PREPEND";
+	std::optional<std::string> appendix;
+
+	auto object = value.As<v8::Object>();
+	auto params = object->GetOwnPropertyNames(context).FromMaybe(v8::Array::New(isolate));
+	auto params_count = params->Length();
+
+	// Iterate over object entries
+	for (unsigned int i = 0; i < params_count; i++) {
+		auto param = params->Get(context, i).ToLocalChecked();
+
+		// Parse Object key-val pairs as strings
+		v8::String::Utf8Value parameter(isolate, param);
+		v8::String::Utf8Value param_value(
+				isolate, object->Get(context, param).ToLocalChecked());
+
+		auto c_param = ToCString(parameter);
+		auto c_value = ToCString(param_value);
+
+		// _PREPEND
+		if (strcmp(c_param, kPrependix) == 0) {
+			process_args.insert(process_args.begin(), c_value);
+
+			continue;
+		}
+		// _APPEND
+		if (strcmp(c_param, kAppendix) == 0) {
+			appendix = c_value;
+
+			continue;
+		}
+
+		// -h vs --help
+		std::string arg = (parameter.length() == 1 ? "-" : "--");
+		arg.append(c_param);
+
+		// Check if value is an empty string
+		if (c_value[0] != '\0') {
+			arg.append(" ").append(c_value);
+		}
+
+		process_args.emplace_back(arg);
+  }
+
+	if (appendix.has_value()) {
+		process_args.emplace_back(appendix.value());
+	}
+
+	return process_args;
+}
+
+/** Returns the path of command if the cwd contains a file with that name,
+ *  otherwise command itself, to be searched in the PATH. */
+std::string ResolveCommand(v8::Isolate* isolate, const std::string& command) {
+	fs::path try_local_file = IsolateState::From(isolate)->GetCWD();
+	try_local_file.append(command);
+	if (fs::exists(try_local_file) && !fs::is_directory(try_local_file)) {
+		return try_local_file.generic_string();
+	}
+
+	return command;
+}
+
+/** Builds the spawn options of a child from a run()/runAll() option object:
+ *  the working directory 'cwd', relative to the shell's cwd, and additional
+ *  'env' variables. Output is always captured and stdin is /dev/null. */
+SpawnOptions GetSpawnOptions(v8::Isolate* isolate, v8::Local<v8::Value> value) {
+	auto context = isolate->GetCurrentContext();
+
+	SpawnOptions options;
+	options.capture_stdout = true;
+	options.capture_stderr = true;
+	options.null_stdin = true;
+
+	auto cwd = IsolateState::From(isolate)->GetCWD();
+	auto cwd_option = GetOption(isolate, value, "cwd");
+	if (cwd_option->IsString()) {
+		v8::String::Utf8Value cwd_value(isolate, cwd_option);
+		cwd = fs::path(ToCString(cwd_value));
+		ConstructAbsolutePath(isolate, cwd);
+	}
+	options.cwd = cwd.string();
+
+	auto env_option = GetOption(isolate, value, "env");
+	if (env_option->IsObject()) {
+		auto env = env_option.As<v8::Object>();
+		auto names = env->GetOwnPropertyNames(context).FromMaybe(v8::Array::New(isolate));
+		for (uint32_t i = 0; i < names->Length(); i++) {
+			auto name = names->Get(context, i).ToLocalChecked();
+			v8::String::Utf8Value name_value(isolate, name);
+			v8::String::Utf8Value value(isolate, env->Get(context, name).ToLocalChecked());
+			options.env.push_back(std::string(ToCString(name_value)) + "=" + ToCString(value));
+		}
+	}
+
+	return options;
+}
+
+/** Returns captured output as a string, or null if it exceeds the maximum
+ *  string length. */
+v8::Local<v8::Value> ProcessOutputToString(v8::Isolate* isolate, const std::string& data) {
+	v8::Local<v8::String> string;
+	if (!v8::String::NewFromUtf8(isolate, data.data(), v8::NewStringType::kNormal,
+			static_cast<int>(data.size())).ToLocal(&string)) {
+		return v8::Null(isolate);
+	}
+
+	return string;
+}
+
+/** Reads a list of processes for runAll()/pipeline(), each either
+ *  [command, args] or {cmd, args, cwd, env}. Throws and returns false if one
+ *  lacks a command, naming it with kind and its index. */
+bool GetProcessJobs(v8::Isolate* isolate, v8::Local<v8::Array> array, const char* kind,
+	std::vector<ProcessJob>& jobs /*OUT*/) {
+	auto context = isolate->GetCurrentContext();
+
+	jobs.reserve(array->Length());
+	for (uint32_t i = 0; i < array->Length(); i++) {
+		auto value = array->Get(context, i).ToLocalChecked();
+		v8::Local<v8::Value> command;
+		v8::Local<v8::Value> process_args;
+		v8::Local<v8::Value> options;
+		if (value->IsArray()) {
+			auto pair = value.As<v8::Array>();
+			command = pair->Get(context, 0).ToLocalChecked();
+			process_args = pair->Get(context, 1).ToLocalChecked();
+		} else {
+			command = GetOption(isolate, value, "cmd");
+			process_args = GetOption(isolate, value, "args");
+			options = value;
+		}
+
+		if (!command->IsString()) {
+			auto message = std::string("[Error] ") + kind + " " + std::to_string(i) +
+				" has no executable filename or path";
+			isolate->ThrowError(v8::String::NewFromUtf8(isolate, message.c_str()).ToLocalChecked());
+			return false;
+		}
+
+		v8::String::Utf8Value command_value(isolate, command);
+		ProcessJob job;
+		job.command = ResolveCommand(isolate, ToCString(command_value));
+		job.args = GetProcessArgs(isolate, process_args);
+		job.options = GetSpawnOptions(isolate, options);
+		jobs.push_back(std::move(job));
+	}
+
+	return true;
+}
+
+// Size of the reads that collect a child's output
+constexpr size_t kProcessReadSize = 64 * 1024;
+
+/** A child started by run(), alive until its promise is settled. */
+struct RunningProcess {
+	ChildProcess child;
+	v8::Global<v8::Promise::Resolver> resolver;
+	std::string stdout_data;
+	std::string stderr_data;
+	std::chrono::steady_clock::time_point start;
+};
+
+/** Appends everything fd has to offer right now to output. Returns false
+ *  once the stream ended, in which case fd is unwatched and closed. */
+bool CollectOutput(EventLoop* event_loop, int& fd /*IN-OUT*/, std::string& output /*OUT*/) {
+	if (fd == -1) {
+		return false;
+	}
+
+	char buffer[kProcessReadSize];
+	while (true) {
+		const auto read = ReadAvailable(fd, buffer, sizeof(buffer));
+		if (read < 0) {
+			return true;
+		}
+		if (read == 0) {
+			event_loop->Unwatch(fd);
+			CloseDescriptor(fd);
+			fd = -1;
+
+			return false;
+		}
+		output.append(buffer, static_cast<size_t>(read));
+	}
+}
+
+/** Settles the promise of a child that exited, with whatever output is left
+ *  in its pipes. Output of grandchildren that outlive it is not waited for. */
+void FinishRunningProcess(v8::Isolate* isolate, EventLoop* event_loop,
+	const std::shared_ptr<RunningProcess>& process, const ChildExit& exit) {
+	auto context = isolate->GetCurrentContext();
+
+	CollectOutput(event_loop, process->child.stdout_fd, process->stdout_data);
+	CollectOutput(event_loop, process->child.stderr_fd, process->stderr_data);
+	for (auto fd : {process->child.pidfd, process->child.stdout_fd, process->child.stderr_fd}) {
+		if (fd != -1) {
+			event_loop->Unwatch(fd);
+		}
+	}
+	CloseChildProcess(process->child);
+
+	const double duration_ms = std::chrono::duration<double, std::milli>(
+		std::chrono::steady_clock::now() - process->start).count();
+	auto result = v8::Object::New(isolate);
+	result->Set(context, v8::String::NewFromUtf8Literal(isolate, "code"),
+		v8::Integer::New(isolate, exit.code)).Check();
+	result->Set(context, v8::String::NewFromUtf8Literal(isolate, "signal"),
+		exit.signal.empty()
+			? v8::Local<v8::Value>(v8::Null(isolate))
+			: v8::Local<v8::Value>(v8::String::NewFromUtf8(isolate, exit.signal.c_str())
+					.ToLocalChecked())).Check();
+	result->Set(context, v8::String::NewFromUtf8Literal(isolate, "stdout"),
+		ProcessOutputToString(isolate, process->stdout_data)).Check();
+	result->Set(context, v8::String::NewFromUtf8Literal(isolate, "stderr"),
+		ProcessOutputToString(isolate, process->stderr_data)).Check();
+	result->Set(context, v8::String::NewFromUtf8Literal(isolate, "durationMs"),
+		v8::Number::New(isolate, duration_ms)).Check();
+
+	process->resolver.Get(isolate)->Resolve(context, result).Check();
+	process->resolver.Reset();
+}
+
+/** Collects a child's output until both of its pipes ended, for a child
+ *  the event loop could not watch. Reaping it without draining them would
+ *  block forever once it filled a pipe, so it is killed if even a poller of
+ *  its own cannot be set up. */
+void DrainRunningProcess(EventLoop* event_loop, RunningProcess& process) {
+	auto& child = process.child;
+	for (auto fd : {child.pidfd, child.stdout_fd, child.stderr_fd}) {
+		if (fd != -1) {
+			event_loop->Unwatch(fd);
+		}
+	}
+
+	std::string error;
+	auto poller = CreatePoller(error);
+	bool watched = poller != kInvalidPoller;
+	for (auto fd : {child.stdout_fd, child.stderr_fd}) {
+		if (watched && fd != -1) {
+			watched = WatchDescriptor(poller, fd, kPollReadable, error);
+		}
+	}
+
+	std::vector<PollEvent> events;
+	while (watched && (child.stdout_fd != -1 || child.stderr_fd != -1)) {
+		if (!WaitForEvents(poller, -1, events, error)) {
+			watched = false;
+			break;
+		}
+		CollectOutput(event_loop, child.stdout_fd, process.stdout_data);
+		CollectOutput(event_loop, child.stderr_fd, process.stderr_data);
+	}
+
+	if (!watched) {
+		TerminateChildProcess(child, true);
+	}
+	if (poller != kInvalidPoller) {
+		ClosePoller(poller);
+	}
+}
+
+/** The callback that is invoked by v8 whenever the JavaScript 'run'
+ *  function is called. Starts a child process without waiting for it and
+ *  returns a promise that resolves to its exit code or signal, its captured
+ *  stdout and stderr and its run time once it exited.
+ *  Arguments are an array of strings or a runSync() parameter object,
+ *  options are the working directory 'cwd' and additional 'env' variables. */
+void RunProcess(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	auto* isolate = args.GetIsolate();
+	auto context = isolate->GetCurrentContext();
+
+	if (args.Length() < 1 || !args[0]->IsString()) {
+		isolate->ThrowError("[Error] No executable filename or path passed");
+		return;
+	}
+
+	v8::String::Utf8Value command(isolate, args[0]);
+	auto process_command = ResolveCommand(isolate, ToCString(command));
+	auto process_args = GetProcessArgs(isolate, args[1]);
+
+	auto options = GetSpawnOptions(isolate, args[2]);
+
+	auto resolver = v8::Promise::Resolver::New(context).ToLocalChecked();
+	args.GetReturnValue().Set(resolver->GetPromise());
+
+	auto process = std::make_shared<RunningProcess>();
+	process->start = std::chrono::steady_clock::now();
+
+	std::string error;
+	if (!SpawnChildProcess(process_command, process_args, options, process->child, error)) {
+		auto message = "Cannot start " + process_command + ": " + error;
+		resolver->Reject(context, v8::Exception::Error(
+			v8::String::NewFromUtf8(isolate, message.c_str()).ToLocalChecked())).Check();
+		return;
+	}
+	process->resolver.Reset(isolate, resolver);
+
+	auto* event_loop = EventLoop::From(isolate);
+	auto on_output = [isolate, event_loop, process](uint32_t) {
+		CollectOutput(event_loop, process->child.stdout_fd, process->stdout_data);
+		CollectOutput(event_loop, process->child.stderr_fd, process->stderr_data);
+
+		// Without a pidfd the end of both streams is the best sign of an exit
+		if (process->child.pidfd == -1 && process->child.stdout_fd == -1 &&
+				process->child.stderr_fd == -1) {
+			ChildExit exit;
+			ReapChildProcess(process->child, true, exit);
+			FinishRunningProcess(isolate, event_loop, process, exit);
+		}
+	};
+	auto on_exit = [isolate, event_loop, process](uint32_t) {
+		ChildExit exit;
+		if (ReapChildProcess(process->child, false, exit)) {
+			FinishRunningProcess(isolate, event_loop, process, exit);
+		}
+	};
+
+	bool watched = event_loop->Watch(process->child.stdout_fd, kPollReadable, on_output, error) &&
+								 event_loop->Watch(process->child.stderr_fd, kPollReadable, on_output, error) &&
+								 (process->child.pidfd == -1 ||
+									event_loop->Watch(process->child.pidfd, kPollReadable, on_exit, error));
+	if (!watched) {
+		// Nothing would ever settle the promise, wait for the child right here instead
+		DrainRunningProcess(event_loop, *process);
+		ChildExit exit;
+		ReapChildProcess(process->child, true, exit);
+		FinishRunningProcess(isolate, event_loop, process, exit);
+	}
+}
+
+/** The callback that is invoked by v8 whenever the JavaScript 'runAll'
+ *  function is called. Runs a list of jobs, each either [command, args] or
+ *  {cmd, args, cwd, env}, with at most 'concurrency' children at once and
+ *  blocks until all of them finished. Returns an array of per-job results in
+ *  input order. With 'failFast' the first failing job stops the rest, jobs
+ *  exceeding 'timeoutMs' are killed. */
+void RunAll(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	auto* isolate = args.GetIsolate();
+	auto context = isolate->GetCurrentContext();
+
+	if (args.Length() < 1 || !args[0]->IsArray()) {
+		isolate->ThrowError("[Error] No array of jobs passed");
+		return;
+	}
+
+	std::vector<ProcessJob> jobs;
+	if (!GetProcessJobs(isolate, args[0].As<v8::Array>(), "Job", jobs)) {
+		return;
+	}
+
+	ProcessPoolOptions pool_options;
+	auto concurrency = GetOption(isolate, args[1], "concurrency");
+	if (concurrency->IsNumber()) {
+		pool_options.concurrency = static_cast<unsigned int>(
+			std::clamp(concurrency.As<v8::Number>()->Value(), 1.0, 1024.0));
+	}
+	pool_options.fail_fast = GetOption(isolate, args[1], "failFast")->BooleanValue(isolate);
+	auto timeout = GetOption(isolate, args[1], "timeoutMs");
+	if (timeout->IsNumber()) {
+		pool_options.timeout_ms = std::max(timeout.As<v8::Number>()->Value(), 0.0);
+	}
+
+	std::vector<ProcessJobResult> results;
+	std::string error;
+	if (!RunProcessJobs(jobs, pool_options, results, error)) {
+		ThrowErrorWithReason(isolate, "Cannot run jobs", error);
+		return;
+	}
+
+	auto result_array = v8::Array::New(isolate, static_cast<int>(results.size()));
+	for (size_t i = 0; i < results.size(); i++) {
+		const auto& job_result = results[i];
+		const auto& exit = job_result.exit;
+		auto result = v8::Object::New(isolate);
+		auto set = [&](const char* key, v8::Local<v8::Value> value) {
+			result->Set(context, v8::String::NewFromUtf8(isolate, key).ToLocalChecked(),
+									value).Check();
+		};
+
+		set("code", v8::Integer::New(isolate, exit.code));
+		set("signal", exit.signal.empty()
+			? v8::Local<v8::Value>(v8::Null(isolate))
+			: v8::Local<v8::Value>(v8::String::NewFromUtf8(isolate, exit.signal.c_str())
+					.ToLocalChecked()));
+		set("stdout", ProcessOutputToString(isolate, job_result.stdout_data));
+		set("stderr", ProcessOutputToString(isolate, job_result.stderr_data));
+		set("durationMs", v8::Number::New(isolate, job_result.duration_ms));
+		set("userMs", v8::Number::New(isolate, exit.user_time_ms));
+		set("systemMs", v8::Number::New(isolate, exit.system_time_ms));
+		set("maxRssKb", v8::Number::New(isolate, static_cast<double>(exit.max_rss_kb)));
+		set("timedOut", v8::Boolean::New(isolate, job_result.timed_out));
+		set("skipped", v8::Boolean::New(isolate, job_result.skipped));
+		if (!job_result.error.empty()) {
+			set("error", v8::String::NewFromUtf8(isolate, job_result.error.c_str()).ToLocalChecked());
+		}
+
+		result_array->Set(context, static_cast<uint32_t>(i), result).Check();
+	}
+
+	args.GetReturnValue().Set(result_array);
+}
+
+/** The callback that is invoked by v8 whenever the JavaScript 'pipeline'
+ *  function is called. Runs processes connected like 'a | b | c' and blocks
+ *  until all of them exited. Stages are given like runAll() jobs. 'stdin' is a
+ *  file name or an ArrayBuffer/TypedArray fed to the first stage, 'stdoutTo'
+ *  a file name, 'buffer' to return the output as an ArrayBuffer, or a function
+ *  called with batches of output lines. Without it the output goes to the
+ *  shell's stdout. */
+void Pipeline(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	auto* isolate = args.GetIsolate();
+	auto context = isolate->GetCurrentContext();
+
+	if (args.Length() < 1 || !args[0]->IsArray() || args[0].As<v8::Array>()->Length() == 0) {
+		isolate->ThrowError("[Error] No array of stages passed");
+		return;
+	}
+
+	std::vector<ProcessJob> stages;
+	if (!GetProcessJobs(isolate, args[0].As<v8::Array>(), "Stage", stages)) {
+		return;
+	}
+
+	PipelineOptions options;
+	auto stdin_option = GetOption(isolate, args[1], "stdin");
+	if (stdin_option->IsString()) {
+		v8::String::Utf8Value file(isolate, stdin_option);
+		auto path = fs::path(ToCString(file));
+		ConstructAbsolutePath(isolate, path);
+		options.input = PipelineInput::kFile;
+		options.input_path = path.string();
+	} else if (GetBufferContents(stdin_option, options.input_data)) {
+		options.input = PipelineInput::kData;
+	} else if (!stdin_option->IsNullOrUndefined()) {
+		isolate->ThrowError("[Error] stdin must be a file name, an ArrayBuffer or a TypedArray");
+		return;
+	}
+
+	enum class Target { kNone, kBuffer, kLines } target = Target::kNone;
+	auto stdout_option = GetOption(isolate, args[1], "stdoutTo");
+	if (stdout_option->IsFunction()) {
+		target = Target::kLines;
+		options.output = PipelineOutput::kStream;
+	} else if (stdout_option->IsString()) {
+		v8::String::Utf8Value file(isolate, stdout_option);
+		if (strcmp(ToCString(file), "buffer") == 0) {
+			target = Target::kBuffer;
+			options.output = PipelineOutput::kStream;
+		} else {
+			auto path = fs::path(ToCString(file));
+			ConstructAbsolutePath(isolate, path);
+			options.output = PipelineOutput::kFile;
+			options.output_path = path.string();
+		}
+	} else if (!stdout_option->IsNullOrUndefined()) {
+		isolate->ThrowError("[Error] stdoutTo must be a file name, 'buffer' or a function");
+		return;
+	}
+
+	OutputArena output(isolate);
+	bool out_of_memory = false;
+	LineSplitter splitter;
+	std::vector<std::string_view> lines;
+	auto sink = [&](const char* data, size_t length) {
+		if (target == Target::kBuffer) {
+			out_of_memory = !output.Append(data, length);
+
+			return !out_of_memory;
+		}
+
+		splitter.Feed(data, length, lines);
+		return CallWithLines(isolate, stdout_option.As<v8::Function>(), lines);
+	};
+
+	PipelineResult result;
+	std::string error;
+	bool ran;
+	{
+		// An exception thrown by the callback stops the pipeline and is passed on
+		v8::TryCatch try_catch(isolate);
+		ran = RunPipeline(stages, options, sink, result, error);
+		if (ran && target == Target::kLines && !try_catch.HasCaught()) {
+			splitter.Finish(lines);
+			CallWithLines(isolate, stdout_option.As<v8::Function>(), lines);
+		}
+		if (try_catch.HasCaught()) {
+			try_catch.ReThrow();
+			return;
+		}
+	}
+	if (!ran) {
+		ThrowErrorWithReason(isolate, "Cannot run pipeline", error);
+		return;
+	}
+	if (out_of_memory) {
+		isolate->ThrowError("[Error] Out of memory while collecting the pipeline's output");
+		return;
+	}
+
+	auto stage_results = v8::Array::New(isolate, static_cast<int>(result.exits.size()));
+	for (size_t i = 0; i < result.exits.size(); i++) {
+		const auto& exit = result.exits[i];
+		auto stage = v8::Object::New(isolate);
+		auto set = [&](const char* key, v8::Local<v8::Value> value) {
+			stage->Set(context, v8::String::NewFromUtf8(isolate, key).ToLocalChecked(),
+								 value).Check();
+		};
+
+		set("code", v8::Integer::New(isolate, exit.code));
+		set("signal", exit.signal.empty()
+			? v8::Local<v8::Value>(v8::Null(isolate))
+			: v8::Local<v8::Value>(v8::String::NewFromUtf8(isolate, exit.signal.c_str())
+					.ToLocalChecked()));
+		set("userMs", v8::Number::New(isolate, exit.user_time_ms));
+		set("systemMs", v8::Number::New(isolate, exit.system_time_ms));
+		set("maxRssKb", v8::Number::New(isolate, static_cast<double>(exit.max_rss_kb)));
+
+		stage_results->Set(context, static_cast<uint32_t>(i), stage).Check();
+	}
+
+	auto summary = v8::Object::New(isolate);
+	auto set = [&](const char* key, v8::Local<v8::Value> value) {
+		summary->Set(context, v8::String::NewFromUtf8(isolate, key).ToLocalChecked(),
+								 value).Check();
+	};
+
+	// Like in a shell, the pipeline's code is the last stage's
+	set("code", v8::Integer::New(isolate, result.exits.back().code));
+	set("stages", stage_results);
+	set("bytes", v8::Number::New(isolate, static_cast<double>(result.output_bytes)));
+	set("durationMs", v8::Number::New(isolate, result.duration_ms));
+	if (target == Target::kBuffer) {
+		set("stdout", output.Release(isolate));
+	}
+
+	args.GetReturnValue().Set(summary);
+}
+
+/** Schedules the callback in args[0] to be called with args[2...] after
+ *  args[1] ms, once or repeatedly. Returns the timer's id. */
+void AddJsTimer(const v8::FunctionCallbackInfo<v8::Value>& args, bool repeat) {
+	auto* isolate = args.GetIsolate();
+	auto context = isolate->GetCurrentContext();
+
+	if (args.Length() < 1 || !args[0]->IsFunction()) {
+		isolate->ThrowError("[Error] No callback function passed");
+		return;
+	}
+
+	double delay = 0;
+	if (args.Length() > 1) {
+		delay = args[1]->NumberValue(context).FromMaybe(0);
+		if (std::isnan(delay)) {
+			delay = 0;
+		}
+	}
+
+	struct TimerCall {
+		v8::Global<v8::Function> callback;
+		std::vector<v8::Global<v8::Value>> args;
+	};
+	auto call = std::make_shared<TimerCall>();
+	call->callback.Reset(isolate, args[0].As<v8::Function>());
+	for (int i = 2; i < args.Length(); i++) {
+		call->args.emplace_back(isolate, args[i]);
+	}
+
+	auto id = EventLoop::From(isolate)->AddTimer(delay, repeat, [isolate, call]() {
+		auto context = isolate->GetCurrentContext();
+		std::vector<v8::Local<v8::Value>> call_args;
+		for (const auto& arg : call->args) {
+			call_args.push_back(arg.Get(isolate));
+		}
+
+		// Like in browsers, an exception is reported and the loop goes on
+		v8::TryCatch try_catch(isolate);
+		if (call->callback.Get(isolate)->Call(context, context->Global(),
+				static_cast<int>(call_args.size()), call_args.data()).IsEmpty()) {
+			ReportException(isolate, &try_catch);
+		}
+	});
+
+	args.GetReturnValue().Set(v8::Number::New(isolate, static_cast<double>(id)));
+}
+
+/** The callback that is invoked by v8 whenever the JavaScript 'setTimeout'
+ *  function is called. Calls a function once after a delay in ms. */
+void SetTimeout(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	AddJsTimer(args, false);
+}
+
+/** The callback that is invoked by v8 whenever the JavaScript 'setInterval'
+ *  function is called. Calls a function every time a delay in ms passed. */
+void SetInterval(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	AddJsTimer(args, true);
+}
+
+/** The callback that is invoked by v8 whenever the JavaScript 'clearTimeout'
+ *  or 'clearInterval' function is called. Cancels a timer by its id. */
+void ClearTimer(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	auto* isolate = args.GetIsolate();
+	auto context = isolate->GetCurrentContext();
+
+	if (args.Length() < 1 || !args[0]->IsNumber()) {
+		return;
+	}
+
+	const auto id = args[0]->NumberValue(context).FromMaybe(0);
+	if (id >= 1) {
+		EventLoop::From(isolate)->ClearTimer(static_cast<uint64_t>(id));
+	}
+}
+
+/** Starts an fs.*Async operation and returns a promise for its result. work
+ *  runs on the event loop's worker pool and must not touch V8. It returns an
+ *  empty string on success, otherwise the reason it failed, which rejects the
+ *  promise with "[Error] failure: reason". materialize turns the result into
+ *  a JS value on the isolate's thread. */
+template <typename Result>
+v8::Local<v8::Promise> RunFsJob(v8::Isolate* isolate, std::string failure,
+	std::function<std::string(Result& result /*OUT*/)> work,
+	std::function<v8::MaybeLocal<v8::Value>(v8::Isolate* isolate, Result& result)> materialize) {
+	auto context = isolate->GetCurrentContext();
+	auto resolver = v8::Promise::Resolver::New(context).ToLocalChecked();
+	auto pending = std::make_shared<v8::Global<v8::Promise::Resolver>>(isolate, resolver);
+
+	EventLoop::From(isolate)->Submit([isolate, pending, failure = std::move(failure),
+			work = std::move(work), materialize = std::move(materialize)]() -> EventLoop::Callback {
+		auto result = std::make_shared<Result>();
+		auto error = work(*result);
+
+		return [isolate, pending, failure, materialize, result, error]() {
+			auto context = isolate->GetCurrentContext();
+			auto resolver = pending->Get(isolate);
+			v8::Local<v8::Value> value;
+			if (error.empty() && materialize(isolate, *result).ToLocal(&value)) {
+				resolver->Resolve(context, value).Check();
+			} else {
+				auto message = "[Error] " + failure + ": " +
+					(error.empty() ? std::string("Result is too large") : error);
+				resolver->Reject(context, v8::Exception::Error(
+					v8::String::NewFromUtf8(isolate, message.c_str()).ToLocalChecked())).Check();
+			}
+			// Released here, the job may outlive this callback on its worker thread
+			pending->Reset();
+		};
+	});
+
+	return resolver->GetPromise();
+}
+
+/** Returns the absolute path in args[index], or throws and returns nothing
+ *  if it isn't a string. */
+std::optional<std::string> GetPathArgument(const v8::FunctionCallbackInfo<v8::Value>& args,
+	int index) {
+	auto* isolate = args.GetIsolate();
+
+	if (args.Length() <= index || !args[index]->IsString()) {
+		isolate->ThrowError("[Error] No path passed");
+		return std::nullopt;
+	}
+
+	v8::String::Utf8Value value(isolate, args[index]);
+	auto path = fs::path(ToCString(value));
+	ConstructAbsolutePath(isolate, path);
+
+	return path.string();
+}
+
+/** Reads a whole file into buffer, which has to provide space for it through
+ *  allocate. Returns an empty string on success, otherwise the reason. */
+std::string ReadWholeFileInto(const std::string& path,
+	const std::function<char*(size_t size)>& allocate) {
+	PathStat stat;
+	std::string error;
+	if (!StatPath(path.c_str(), true, stat, error)) {
+		return error;
+	}
+	if (stat.type == WalkEntryType::kDirectory) {
+		return "Is a directory";
+	}
+
+	auto* buffer = allocate(static_cast<size_t>(stat.size));
+	if (buffer == nullptr && stat.size != 0) {
+		return "Out of memory";
+	}
+	if (stat.size != 0 && !ReadFileInto(path.c_str(), 0, buffer, static_cast<size_t>(stat.size),
+			error)) {
+		return error;
+	}
+
+	return "";
+}
+
+/** The callback that is invoked by v8 whenever the JavaScript 'fs.readAsync'
+ *  function is called. Returns a promise resolving to the contents of a UTF-8
+ *  file as a string. */
+void ReadAsync(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	auto* isolate = args.GetIsolate();
+	auto path = GetPathArgument(args, 0);
+	if (!path) {
+		return;
+	}
+
+	args.GetReturnValue().Set(RunFsJob<std::string>(isolate, "Cannot read file",
+		[path = *path](std::string& contents) {
+			return ReadWholeFileInto(path, [&](size_t size) {
+				contents.resize(size);
+				return contents.data();
+			});
+		},
+		[](v8::Isolate* isolate, std::string& contents) -> v8::MaybeLocal<v8::Value> {
+			v8::Local<v8::String> string;
+			if (!v8::String::NewFromUtf8(isolate, contents.data(), v8::NewStringType::kNormal,
+					static_cast<int>(contents.size())).ToLocal(&string)) {
+				return {};
+			}
+
+			return string;
+		}));
+}
+
+/** Memory from the ArrayBuffer allocator that becomes an ArrayBuffer's
+ *  backing store, or is freed if it never does. */
+struct AllocatedBytes {
+	~AllocatedBytes() {
+		if (data != nullptr) {
+			allocator->Free(data, size);
+		}
+	}
+
+	v8::ArrayBuffer::Allocator* allocator = nullptr;
+	char* data = nullptr;
+	size_t size = 0;
+};
+
+/** The callback that is invoked by v8 whenever the JavaScript 'fs.readBytesAsync'
+ *  function is called. Returns a promise resolving to the contents of a file
+ *  as an ArrayBuffer. The file is read straight into the buffer's memory. */
+void ReadBytesAsync(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	auto* isolate = args.GetIsolate();
+	auto path = GetPathArgument(args, 0);
+	if (!path) {
+		return;
+	}
+
+	args.GetReturnValue().Set(RunFsJob<AllocatedBytes>(isolate, "Cannot read file",
+		[path = *path, allocator = isolate->GetArrayBufferAllocator()](AllocatedBytes& bytes) {
+			bytes.allocator = allocator;
+			return ReadWholeFileInto(path, [&](size_t size) {
+				bytes.data = size != 0 ? static_cast<char*>(allocator->AllocateUninitialized(size))
+															 : nullptr;
+				bytes.size = bytes.data != nullptr ? size : 0;
+				return bytes.data;
+			});
+		},
+		[](v8::Isolate* isolate, AllocatedBytes& bytes) -> v8::MaybeLocal<v8::Value> {
+			if (bytes.data == nullptr) {
+				return v8::ArrayBuffer::New(isolate, 0);
+			}
+
+			auto store = v8::ArrayBuffer::NewBackingStore(bytes.data, bytes.size,
+				[](void* data, size_t length, void* allocator) {
+					static_cast<v8::ArrayBuffer::Allocator*>(allocator)->Free(data, length);
+				},
+				bytes.allocator);
+			bytes.data = nullptr;
+
+			return v8::ArrayBuffer::New(isolate, std::move(store));
+		}));
+}
+
+/** Placeholder result of operations that resolve to undefined. */
+struct NoResult {};
+
+v8::MaybeLocal<v8::Value> MaterializeUndefined(v8::Isolate* isolate, NoResult&) {
+	return v8::Undefined(isolate);
+}
+
+/** The callback that is invoked by v8 whenever the JavaScript 'fs.writeAsync'
+ *  function is called. Writes a string (as UTF-8) or buffer to a file and
+ *  returns a promise. Options are 'append' and 'atomic', like writeFile(). */
+void WriteAsync(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	auto* isolate = args.GetIsolate();
+	auto path = GetPathArgument(args, 0);
+	if (!path) {
+		return;
+	}
+
+	WriteBuffer data;
+	std::string storage;
+	if (!GetWriteData(isolate, args[1], data, storage)) {
+		isolate->ThrowError("[Error] Expected a string, ArrayBuffer or typed array");
+		return;
+	}
+	// The script may change or detach its buffer while the write is in flight
+	if (storage.empty()) {
+		storage.assign(data.data, data.size);
+	}
+
+	const auto append = GetOption(isolate, args[2], "append")->BooleanValue(isolate);
+	const auto atomic = GetOption(isolate, args[2], "atomic")->BooleanValue(isolate);
+	args.GetReturnValue().Set(RunFsJob<NoResult>(isolate, "Cannot write file",
+		[path = *path, storage = std::move(storage), append, atomic](NoResult&) {
+			std::string error;
+			WriteWholeFile(path, {storage.data(), storage.size()}, append, atomic, error);
+			return error;
+		},
+		MaterializeUndefined));
+}
+
+/** The callback that is invoked by v8 whenever the JavaScript 'fs.statAsync'
+ *  function is called. Returns a promise resolving to {isFile, isDirectory,
+ *  isSymlink, size, mtime, mode}. Symlinks are followed unless the option
+ *  'followSymlinks' is false. */
+void StatAsync(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	auto* isolate = args.GetIsolate();
+	auto path = GetPathArgument(args, 0);
+	if (!path) {
+		return;
+	}
+
+	auto follow_option = GetOption(isolate, args[1], "followSymlinks");
+	const bool follow = follow_option->IsUndefined() || follow_option->BooleanValue(isolate);
+	args.GetReturnValue().Set(RunFsJob<PathStat>(isolate, "Cannot stat",
+		[path = *path, follow](PathStat& stat) {
+			std::string error;
+			StatPath(path.c_str(), follow, stat, error);
+			return error;
+		},
+		[](v8::Isolate* isolate, PathStat& stat) -> v8::MaybeLocal<v8::Value> {
+			auto context = isolate->GetCurrentContext();
+			auto entry_template = GetObjectTemplate(isolate, "stat",
+				{"isFile", "isDirectory", "isSymlink", "size", "mtime", "mode"});
+			auto object = entry_template->NewInstance(context).ToLocalChecked();
+			auto set = [&](const char* key, v8::Local<v8::Value> value) {
+				object->Set(context, v8::String::NewFromUtf8(isolate, key).ToLocalChecked(),
+										value).Check();
+			};
+
+			set("isFile", v8::Boolean::New(isolate, stat.type == WalkEntryType::kFile));
+			set("isDirectory", v8::Boolean::New(isolate, stat.type == WalkEntryType::kDirectory));
+			set("isSymlink", v8::Boolean::New(isolate, stat.type == WalkEntryType::kSymlink));
+			set("size", v8::Number::New(isolate, static_cast<double>(stat.size)));
+			set("mtime", v8::Number::New(isolate, stat.mtime));
+			set("mode", v8::Integer::NewFromUnsigned(isolate, stat.mode));
+
+			return object;
+		}));
+}
+
+/** The callback that is invoked by v8 whenever the JavaScript 'fs.readdirAsync'
+ *  function is called. Returns a promise resolving to the entries of a
+ *  directory like ls(false) does. */
+void ReaddirAsync(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	auto* isolate = args.GetIsolate();
+	auto path = GetPathArgument(args, 0);
+	if (!path) {
+		return;
+	}
+
+	args.GetReturnValue().Set(RunFsJob<std::vector<DirectoryEntry>>(isolate,
+		"Cannot list directory",
+		[path = *path](std::vector<DirectoryEntry>& entries) {
+			std::string error;
+			ListDirectory(path.c_str(), false, entries, error);
+			return error;
+		},
+		[](v8::Isolate* isolate, std::vector<DirectoryEntry>& entries) -> v8::MaybeLocal<v8::Value> {
+			auto context = isolate->GetCurrentContext();
+			auto entry_template = GetObjectTemplate(isolate, "dirEntry", {"filename", "isDirectory"});
+			auto filename_key = v8::String::NewFromUtf8Literal(isolate, "filename",
+				v8::NewStringType::kInternalized);
+			auto is_directory_key = v8::String::NewFromUtf8Literal(isolate, "isDirectory",
+				v8::NewStringType::kInternalized);
+
+			std::vector<v8::Local<v8::Value>> elements;
+			elements.reserve(entries.size());
+			for (const auto& entry : entries) {
+				auto object = entry_template->NewInstance(context).ToLocalChecked();
+				object->Set(context, filename_key,
+					v8::String::NewFromUtf8(isolate, entry.name.c_str()).ToLocalChecked()).Check();
+				object->Set(context, is_directory_key,
+					v8::Boolean::New(isolate, entry.is_directory)).Check();
+				elements.push_back(object);
+			}
+
+			return v8::Array::New(isolate, elements.data(), elements.size());
+		}));
+}
+
+/** The callback that is invoked by v8 whenever the JavaScript 'fs.mkdirAsync'
+ *  function is called. Creates a directory, with all missing parents if the
+ *  option 'recursive' is set, and returns a promise. */
+void MkdirAsync(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	auto* isolate = args.GetIsolate();
+	auto path = GetPathArgument(args, 0);
+	if (!path) {
+		return;
+	}
+
+	const auto recursive = GetOption(isolate, args[1], "recursive")->BooleanValue(isolate);
+	args.GetReturnValue().Set(RunFsJob<NoResult>(isolate, "Cannot create directory",
+		[path = *path, recursive](NoResult&) -> std::string {
+			std::error_code err;
+			if (recursive) {
+				fs::create_directories(path, err);
+			} else if (!fs::create_directory(path, err) && !err) {
+				return "File exists";
+			}
+
+			return err ? err.message() : "";
+		},
+		MaterializeUndefined));
+}
+
+/** The callback that is invoked by v8 whenever the JavaScript 'fs.copyAsync'
+ *  function is called. Copies a file, or a directory tree with the option
+ *  'recursive', and returns a promise resolving to {files, directories,
+ *  bytes, reflinked, errors}. 'reflink' and 'threads' (default 1) work like
+ *  in copy(). */
+void CopyAsync(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	auto* isolate = args.GetIsolate();
+	auto context = isolate->GetCurrentContext();
+	auto source = GetPathArgument(args, 0);
+	if (!source) {
+		return;
+	}
+	auto target = GetPathArgument(args, 1);
+	if (!target) {
+		return;
+	}
+
+	if (CopiesIntoItself(*source, *target)) {
+		isolate->ThrowError("[Error] Cannot copy something into itself");
+		return;
+	}
+
+	CopyOptions options;
+	options.recursive = GetOption(isolate, args[2], "recursive")->BooleanValue(isolate);
+	auto reflink = GetOption(isolate, args[2], "reflink");
+	options.reflink = reflink->IsUndefined() || reflink->BooleanValue(isolate);
+	// Many copies run at once, each gets one thread unless asked otherwise
+	options.threads = 1;
+	auto threads = GetOption(isolate, args[2], "threads");
+	if (threads->IsNumber()) {
+		options.threads = static_cast<unsigned int>(
+			std::clamp<int64_t>(threads->IntegerValue(context).FromMaybe(0), 1, 256));
+	}
+
+	args.GetReturnValue().Set(RunFsJob<CopyResult>(isolate, "Cannot copy",
+		[source = *source, target = *target, options](CopyResult& result) {
+			std::string error;
+			CopyTree(source.c_str(), target.c_str(), options, result, error);
+			return error;
+		},
+		[](v8::Isolate* isolate, CopyResult& result) -> v8::MaybeLocal<v8::Value> {
+			auto context = isolate->GetCurrentContext();
+			auto summary = v8::Object::New(isolate);
+			auto set = [&](const char* key, uint64_t value) {
+				summary->Set(context, v8::String::NewFromUtf8(isolate, key).ToLocalChecked(),
+										 v8::Number::New(isolate, static_cast<double>(value))).Check();
+			};
+
+			set("files", result.files);
+			set("directories", result.directories);
+			set("bytes", result.bytes);
+			set("reflinked", result.reflinked);
+			set("errors", result.errors);
+
+			return summary;
+		}));
+}
+
+/** The callback that is invoked by v8 whenever the JavaScript 'fs.moveAsync'
+ *  function is called. Moves a file or directory and returns a promise. */
+void MoveAsync(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	auto* isolate = args.GetIsolate();
+	auto source = GetPathArgument(args, 0);
+	if (!source) {
+		return;
+	}
+	auto target = GetPathArgument(args, 1);
+	if (!target) {
+		return;
+	}
+
+	args.GetReturnValue().Set(RunFsJob<NoResult>(isolate, "Cannot move",
+		[source = *source, target = *target](NoResult&) {
+			std::error_code err;
+			fs::rename(source, target, err);
+			return err ? err.message() : std::string();
+		},
+		MaterializeUndefined));
+}
+
+/** The callback that is invoked by v8 whenever the JavaScript 'fs.removeAsync'
+ *  function is called. Removes a file or a directory tree and returns a
+ *  promise resolving to {files, dirs, bytesFreed, errors}, like rm() does.
+ *  The option 'threads' defaults to 1. */
+void RemoveAsync(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	auto* isolate = args.GetIsolate();
+	auto context = isolate->GetCurrentContext();
+	auto path = GetPathArgument(args, 0);
+	if (!path) {
+		return;
+	}
+
+	RemoveOptions options;
+	options.threads = 1;
+	auto threads = GetOption(isolate, args[1], "threads");
+	if (threads->IsNumber()) {
+		options.threads = static_cast<unsigned int>(
+			std::clamp<int64_t>(threads->IntegerValue(context).FromMaybe(0), 1, 256));
+	}
+
+	args.GetReturnValue().Set(RunFsJob<RemoveResult>(isolate, "Cannot remove",
+		[path = *path, options](RemoveResult& result) {
+			std::string error;
+			RemoveTree(path.c_str(), options, result, error);
+			return error;
+		},
+		[](v8::Isolate* isolate, RemoveResult& result) -> v8::MaybeLocal<v8::Value> {
+			auto context = isolate->GetCurrentContext();
+			auto summary = v8::Object::New(isolate);
+			auto set = [&](const char* key, uint64_t value) {
+				summary->Set(context, v8::String::NewFromUtf8(isolate, key).ToLocalChecked(),
+										 v8::Number::New(isolate, static_cast<double>(value))).Check();
+			};
+
+			set("files", result.files);
+			set("dirs", result.directories);
+			set("bytesFreed", result.bytes_freed);
+			set("errors", result.errors);
+
+			return summary;
+		}));
+}
+
+/** Operations of a batch handed to one pool thread when io_uring is not used */
+constexpr size_t kBatchChunkOps = 64;
+
+/** A running fs.batch() call, finished once its last chunk completed. */
+struct BatchState {
+	std::vector<BatchOp> ops;
+	std::vector<BatchOpResult> results;
+	size_t pending_chunks = 0;
+	v8::Global<v8::Promise::Resolver> resolver;
+};
+
+/** Parses the JS description of a batch operation, returns false if it is
+ *  not one. */
+bool GetBatchOp(v8::Isolate* isolate, v8::Local<v8::Value> value, BatchOp& op /*OUT*/) {
+	static const std::unordered_map<std::string, BatchOpType> op_types = {
+		{"stat", BatchOpType::kStat}, {"lstat", BatchOpType::kLstat},
+		{"read", BatchOpType::kRead}, {"unlink", BatchOpType::kUnlink},
+		{"rmdir", BatchOpType::kRmdir}, {"rename", BatchOpType::kRename},
+		{"mkdir", BatchOpType::kMkdir}};
+
+	auto type = GetOption(isolate, value, "op");
+	auto path = GetOption(isolate, value, "path");
+	if (!type->IsString() || !path->IsString()) {
+		return false;
+	}
+
+	v8::String::Utf8Value type_name(isolate, type);
+	auto found = op_types.find(ToCString(type_name));
+	if (found == op_types.end()) {
+		return false;
+	}
+	op.type = found->second;
+
+	v8::String::Utf8Value path_value(isolate, path);
+	auto absolute_path = fs::path(ToCString(path_value));
+	ConstructAbsolutePath(isolate, absolute_path);
+	op.path = absolute_path.string();
+
+	if (op.type == BatchOpType::kRename) {
+		auto target = GetOption(isolate, value, "to");
+		if (!target->IsString()) {
+			return false;
+		}
+
+		v8::String::Utf8Value target_value(isolate, target);
+		auto absolute_target = fs::path(ToCString(target_value));
+		ConstructAbsolutePath(isolate, absolute_target);
+		op.target = absolute_target.string();
+	}
+
+	return true;
+}
+
+/** Resolves the promise of a batch with one result object per operation. */
+void FinishBatch(v8::Isolate* isolate, BatchState& state) {
+	auto context = isolate->GetCurrentContext();
+	auto resolver = state.resolver.Get(isolate);
+	auto key = [isolate](const char* name) {
+		return v8::String::NewFromUtf8(isolate, name, v8::NewStringType::kInternalized)
+			.ToLocalChecked();
+	};
+	auto ok_key = key("ok");
+	auto error_key = key("error");
+	auto data_key = key("data");
+
+	std::vector<v8::Local<v8::Value>> elements;
+	elements.reserve(state.results.size());
+	for (size_t i = 0; i < state.results.size(); i++) {
+		const auto& result = state.results[i];
+		auto object = v8::Object::New(isolate);
+		object->Set(context, ok_key, v8::Boolean::New(isolate, result.error.empty())).Check();
+
+		if (!result.error.empty()) {
+			object->Set(context, error_key,
+				v8::String::NewFromUtf8(isolate, result.error.c_str()).ToLocalChecked()).Check();
+		} else if (state.ops[i].type == BatchOpType::kRead) {
+			v8::Local<v8::String> data;
+			if (!v8::String::NewFromUtf8(isolate, result.data.data(), v8::NewStringType::kNormal,
+					static_cast<int>(result.data.size())).ToLocal(&data)) {
+				object->Set(context, ok_key, v8::False(isolate)).Check();
+				object->Set(context, error_key, key("File is too large")).Check();
+			} else {
+				object->Set(context, data_key, data).Check();
+			}
+		} else if (state.ops[i].type == BatchOpType::kStat ||
+							 state.ops[i].type == BatchOpType::kLstat) {
+			const auto& stat = result.stat;
+			object->Set(context, key("isFile"),
+				v8::Boolean::New(isolate, stat.type == WalkEntryType::kFile)).Check();
+			object->Set(context, key("isDirectory"),
+				v8::Boolean::New(isolate, stat.type == WalkEntryType::kDirectory)).Check();
+			object->Set(context, key("isSymlink"),
+				v8::Boolean::New(isolate, stat.type == WalkEntryType::kSymlink)).Check();
+			object->Set(context, key("size"),
+				v8::Number::New(isolate, static_cast<double>(stat.size))).Check();
+			object->Set(context, key("mtime"), v8::Number::New(isolate, stat.mtime)).Check();
+			object->Set(context, key("mode"), v8::Integer::NewFromUnsigned(isolate, stat.mode)).Check();
+		}
+		elements.push_back(object);
+	}
+
+	resolver->Resolve(context, v8::Array::New(isolate, elements.data(), elements.size())).Check();
+	state.resolver.Reset();
+}
+
+/** The callback that is invoked by v8 whenever the JavaScript 'fs.batch'
+ *  function is called. Runs an array of {op, path} operations, with op one
+ *  of 'stat', 'lstat', 'read', 'unlink', 'rmdir', 'rename' (with 'to') or
+ *  'mkdir', and returns a promise resolving to one {ok, error} result per
+ *  operation, in the order of the operations. These run concurrently and
+ *  complete in any order, so none may depend on another. On Linux the whole
+ *  batch goes through io_uring, elsewhere or with the option 'uring' set to
+ *  false it is split across the worker pool. */
+void Batch(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	auto* isolate = args.GetIsolate();
+	auto context = isolate->GetCurrentContext();
+
+	if (args.Length() < 1 || !args[0]->IsArray()) {
+		isolate->ThrowError("[Error] Expected an array of operations");
+		return;
+	}
+
+	auto state = std::make_shared<BatchState>();
+	auto array = args[0].As<v8::Array>();
+	state->ops.resize(array->Length());
+	for (uint32_t i = 0; i < array->Length(); i++) {
+		v8::Local<v8::Value> element;
+		if (!array->Get(context, i).ToLocal(&element) ||
+				!GetBatchOp(isolate, element, state->ops[i])) {
+			auto message = "[Error] Invalid batch operation at index " + std::to_string(i);
+			isolate->ThrowError(v8::String::NewFromUtf8(isolate, message.c_str()).ToLocalChecked());
+			return;
+		}
+	}
+	state->results.resize(state->ops.size());
+
+	auto resolver = v8::Promise::Resolver::New(context).ToLocalChecked();
+	state->resolver.Reset(isolate, resolver);
+	args.GetReturnValue().Set(resolver->GetPromise());
+
+	if (state->ops.empty()) {
+		FinishBatch(isolate, *state);
+		return;
+	}
+
+	auto uring_option = GetOption(isolate, args[1], "uring");
+	const bool use_uring = (uring_option->IsUndefined() || uring_option->BooleanValue(isolate)) &&
+		UringAvailable();
+	const size_t chunk_size = use_uring ? state->ops.size() : kBatchChunkOps;
+
+	auto* loop = EventLoop::From(isolate);
+	for (size_t begin = 0; begin < state->ops.size(); begin += chunk_size) {
+		const auto end = std::min(begin + chunk_size, state->ops.size());
+		state->pending_chunks++;
+
+		loop->Submit([isolate, state, begin, end, use_uring]() -> EventLoop::Callback {
+			std::string error;
+			if (!use_uring || !RunBatchWithUring(state->ops, state->results, error)) {
+				for (auto i = begin; i < end; i++) {
+					RunBatchOp(state->ops[i], state->results[i]);
+				}
+			}
+
+			return [isolate, state]() {
+				if (--state->pending_chunks == 0) {
+					FinishBatch(isolate, *state);
+				}
+			};
+		});
+	}
+}
+
+/** Owns the WorkerThread of an object created by 'new Worker()'. */
+struct WorkerBinding : public NativeObject {
+	std::shared_ptr<WorkerThread> worker;
+};
+
+/** Calls the function in property name of object with argument, if it has one.
+ *  Exceptions are reported like the ones of timers. */
+void CallHandler(v8::Isolate* isolate, v8::Local<v8::Object> object, const char* name,
+	v8::Local<v8::Value> argument) {
+	auto context = isolate->GetCurrentContext();
+	v8::TryCatch try_catch(isolate);
+
+	auto handler = GetOption(isolate, object, name);
+	if (!handler->IsFunction()) {
+		return;
+	}
+
+	v8::Local<v8::Value> call_args[] = {argument};
+	if (handler.As<v8::Function>()->Call(context, object, 1, call_args).IsEmpty()) {
+		ReportException(isolate, &try_catch);
+	}
+}
+
+/** The callback that is invoked by v8 whenever the JavaScript 'Worker'
+ *  function is called, usually as 'new Worker(scriptPath)'. Runs the script on
+ *  a new isolate on its own thread and returns an object with postMessage()
+ *  and terminate(). The worker's messages arrive as {data} at its 'onmessage'
+ *  handler, uncaught exceptions as Error at its 'onerror' handler and its
+ *  exit code at its 'onexit' handler once it ended. */
+void CreateWorker(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	auto* isolate = args.GetIsolate();
+	auto path = GetPathArgument(args, 0);
+	if (!path) {
+		return;
+	}
+
+	// Kept alive while the worker runs, so its handlers get called
+	auto object = std::make_shared<v8::Global<v8::Object>>();
+
+	WorkerThread::Handlers handlers;
+	handlers.on_message = [object](v8::Isolate* isolate, SerializedMessage& message) {
+		auto context = isolate->GetCurrentContext();
+		v8::TryCatch try_catch(isolate);
+
+		v8::Local<v8::Value> data;
+		if (!DeserializeMessage(isolate, message).ToLocal(&data)) {
+			ReportException(isolate, &try_catch);
+			return;
+		}
+
+		auto event = v8::Object::New(isolate);
+		event->Set(context, v8::String::NewFromUtf8Literal(isolate, "data"), data).Check();
+		CallHandler(isolate, object->Get(isolate), "onmessage", event);
+	};
+	handlers.on_error = [object](v8::Isolate* isolate, const std::string& error) {
+		auto exception = v8::Exception::Error(
+			v8::String::NewFromUtf8(isolate, error.c_str()).ToLocalChecked());
+		CallHandler(isolate, object->Get(isolate), "onerror", exception);
+	};
+	handlers.on_exit = [object](v8::Isolate* isolate, int exit_code) {
+		CallHandler(isolate, object->Get(isolate), "onexit", v8::Integer::New(isolate, exit_code));
+		object->Reset();
+	};
+
+	auto* binding = new WorkerBinding();
+	binding->worker = WorkerThread::Start(isolate, *path, WorkerThread::Mode::kScript,
+																				std::move(handlers));
+
+	auto worker_object = WrapNativeObject(isolate, binding);
+	object->Reset(isolate, worker_object);
+	SetMethod(isolate, worker_object, "postMessage", WorkerPostMessage);
+	SetMethod(isolate, worker_object, "terminate", WorkerTerminate);
+
+	args.GetReturnValue().Set(worker_object);
+}
+
+/** postMessage(value, transferList) method of worker objects. The value is
+ *  cloned, ArrayBuffers in transferList move to the worker and are detached
+ *  here. SharedArrayBuffers are shared. */
+void WorkerPostMessage(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	auto* binding = static_cast<WorkerBinding*>(UnwrapNativeObject(args));
+
+	SerializedMessage message;
+	if (SerializeMessage(args.GetIsolate(), args[0], args[1], message)) {
+		binding->worker->PostToWorker(std::move(message));
+	}
+}
+
+/** terminate() method of worker objects. */
+void WorkerTerminate(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	static_cast<WorkerBinding*>(UnwrapNativeObject(args))->worker->Terminate();
+}
+
+/** A running parallelMap() call. */
+struct ParallelMapState {
+	v8::Global<v8::Promise::Resolver> resolver;
+	v8::Global<v8::Array> input;
+	v8::Global<v8::Array> output;
+	std::vector<std::shared_ptr<WorkerThread>> workers;
+	uint32_t length = 0;
+	uint32_t chunk_size = 1;
+	// First item not handed to a worker yet
+	uint32_t next = 0;
+	uint32_t mapped = 0;
+	bool settled = false;
+};
+
+/** Resolves or, with an error, rejects the promise of a parallelMap() call
+ *  and terminates its workers. */
+void SettleMap(v8::Isolate* isolate, ParallelMapState& state, const std::string& error) {
+	if (state.settled) {
+		return;
+	}
+	state.settled = true;
+
+	for (auto& worker : state.workers) {
+		worker->Terminate();
+	}
+	state.workers.clear();
+
+	auto context = isolate->GetCurrentContext();
+	auto resolver = state.resolver.Get(isolate);
+	if (error.empty()) {
+		resolver->Resolve(context, state.output.Get(isolate)).Check();
+	} else {
+		auto text = "[Error] parallelMap failed: " + error;
+		resolver->Reject(context, v8::Exception::Error(
+			v8::String::NewFromUtf8(isolate, text.c_str()).ToLocalChecked())).Check();
+	}
+
+	state.resolver.Reset();
+	state.input.Reset();
+	state.output.Reset();
+}
+
+/** Hands the next chunk of items to worker, if there is one left. */
+void SendMapChunk(v8::Isolate* isolate, ParallelMapState& state, WorkerThread& worker) {
+	if (state.next >= state.length) {
+		return;
+	}
+
+	auto context = isolate->GetCurrentContext();
+	auto input = state.input.Get(isolate);
+	const auto end = std::min(state.length, state.next + state.chunk_size);
+
+	std::vector<v8::Local<v8::Value>> items;
+	items.reserve(end - state.next);
+	for (auto i = state.next; i < end; i++) {
+		items.push_back(input->Get(context, i).ToLocalChecked());
+	}
+
+	auto chunk = v8::Object::New(isolate);
+	chunk->Set(context, v8::String::NewFromUtf8Literal(isolate, "start"),
+		v8::Integer::NewFromUnsigned(isolate, state.next)).Check();
+	chunk->Set(context, v8::String::NewFromUtf8Literal(isolate, "items"),
+		v8::Array::New(isolate, items.data(), items.size())).Check();
+	state.next = end;
+
+	SerializedMessage message;
+	v8::TryCatch try_catch(isolate);
+	if (!SerializeMessage(isolate, chunk, v8::Local<v8::Value>(), message)) {
+		v8::String::Utf8Value exception(isolate, try_catch.Exception());
+		SettleMap(isolate, state, ToCString(exception));
+		return;
+	}
+	worker.PostToWorker(std::move(message));
+}
+
+/** The callback that is invoked by v8 whenever the JavaScript 'parallelMap'
+ *  function is called. Maps an array with the function the script in argument
+ *  1 evaluates to, called as fn(item, index) on a pool of workers. Returns a
+ *  promise resolving to the results in order. Items and results are cloned
+ *  between the isolates. The option 'threads' defaults to one per core. */
+void ParallelMap(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	auto* isolate = args.GetIsolate();
+	auto context = isolate->GetCurrentContext();
+
+	if (args.Length() < 1 || !args[0]->IsArray()) {
+		isolate->ThrowError("[Error] Expected an array to map");
+		return;
+	}
+	auto path = GetPathArgument(args, 1);
+	if (!path) {
+		return;
+	}
+
+	auto state = std::make_shared<ParallelMapState>();
+	auto input = args[0].As<v8::Array>();
+	state->length = input->Length();
+
+	auto resolver = v8::Promise::Resolver::New(context).ToLocalChecked();
+	args.GetReturnValue().Set(resolver->GetPromise());
+	if (state->length == 0) {
+		resolver->Resolve(context, v8::Array::New(isolate)).Check();
+		return;
+	}
+
+	state->resolver.Reset(isolate, resolver);
+	state->input.Reset(isolate, input);
+	state->output.Reset(isolate, v8::Array::New(isolate, static_cast<int>(state->length)));
+
+	auto threads = WorkStealingPool::DefaultThreads();
+	auto threads_option = GetOption(isolate, args[2], "threads");
+	if (threads_option->IsNumber()) {
+		threads = static_cast<unsigned int>(
+			std::clamp<int64_t>(threads_option->IntegerValue(context).FromMaybe(0), 1, 256));
+	}
+	threads = std::min(threads, state->length);
+	// A few chunks per worker, so the workers that finish early take over the rest
+	state->chunk_size = std::max(1u, state->length / (threads * 4));
+
+	for (unsigned int i = 0; i < threads; i++) {
+		WorkerThread::Handlers handlers;
+		handlers.on_message = [state, i](v8::Isolate* isolate, SerializedMessage& message) {
+			if (state->settled) {
+				return;
+			}
+
+			auto context = isolate->GetCurrentContext();
+			v8::TryCatch try_catch(isolate);
+			v8::Local<v8::Value> reply;
+			if (!DeserializeMessage(isolate, message).ToLocal(&reply)) {
+				v8::String::Utf8Value exception(isolate, try_catch.Exception());
+				SettleMap(isolate, *state, ToCString(exception));
+				return;
+			}
+
+			const auto start = GetOption(isolate, reply, "start")->Uint32Value(context).FromMaybe(0);
+			auto results = GetOption(isolate, reply, "results").As<v8::Array>();
+			auto output = state->output.Get(isolate);
+			for (uint32_t j = 0; j < results->Length(); j++) {
+				output->Set(context, start + j, results->Get(context, j).ToLocalChecked()).Check();
+			}
+
+			state->mapped += results->Length();
+			if (state->mapped == state->length) {
+				SettleMap(isolate, *state, "");
+			} else {
+				SendMapChunk(isolate, *state, *state->workers[i]);
+			}
+		};
+		handlers.on_error = [state](v8::Isolate* isolate, const std::string& error) {
+			SettleMap(isolate, *state, error);
+		};
+		handlers.on_exit = [state](v8::Isolate* isolate, int) {
+			SettleMap(isolate, *state, "Worker exited");
+		};
+
+		state->workers.push_back(WorkerThread::Start(isolate, *path, WorkerThread::Mode::kMap,
+																								 std::move(handlers)));
 	}
 
-	std::error_code err;
-	auto OK = fs::remove_all(dirname, err);
-	if (!OK) {
-		PrintErrorTag();
-		std::cerr << " " << std::system_category().message(errno)
-							<< std::endl;
+	// Every worker starts with one chunk, more follow as results come in
+	for (unsigned int i = 0; i < threads && !state->settled; i++) {
+		SendMapChunk(isolate, *state, *state->workers[i]);
 	}
 }
 
-/** The callback that is invoked by v8 whenever the JavaScript 'rm'
- *  function is called. (Recursively) deletes the path entity mentioned in arg[0]. */
-void RemoveAny(const v8::FunctionCallbackInfo<v8::Value>& args) {
-	v8::String::Utf8Value path_entity(args.GetIsolate(), args[0]);
-	auto pathname = fs::path(ToCString(path_entity));
-	ConstructAbsolutePath(pathname);
+/** The callback that is invoked by v8 whenever the JavaScript 'codeCacheStats'
+ *  function is called. Returns an object with the hit/miss counters of the
+ *  on-disk code cache. */
+void CodeCacheStats(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	auto* isolate = args.GetIsolate();
+	auto context = isolate->GetCurrentContext();
+	const auto& code_cache = RuntimeMemory::code_cache;
+	const auto stats = code_cache.GetStats();
+
+	auto result = v8::Object::New(isolate);
+	auto set = [&](const char* key, v8::Local<v8::Value> value) {
+		result->Set(context, v8::String::NewFromUtf8(isolate, key).ToLocalChecked(),
+								value).Check();
+	};
+
+	set("enabled", v8::Boolean::New(isolate, code_cache.Enabled()));
+	set("hits", v8::Number::New(isolate, static_cast<double>(stats.hits)));
+	set("misses", v8::Number::New(isolate, static_cast<double>(stats.misses)));
+	set("rejected", v8::Number::New(isolate, static_cast<double>(stats.rejected)));
+	set("writes", v8::Number::New(isolate, static_cast<double>(stats.writes)));
+	set("evictions", v8::Number::New(isolate, static_cast<double>(stats.evictions)));
+
+	args.GetReturnValue().Set(result);
+}
 
-	std::error_code err;
-	auto OK = fs::remove_all(pathname, err);
-	if (!OK) {
-		PrintErrorTag();
-		std::cerr << " " << std::system_category().message(errno)
-							<< std::endl;
+/** The callback that is invoked by v8 whenever the JavaScript 'memoryStats'
+ *  function is called. Returns an object with the counters of the ArrayBuffer
+ *  allocator chosen by --ab-allocator, only the default one keeps none. */
+void MemoryStats(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	auto* isolate = args.GetIsolate();
+	auto context = isolate->GetCurrentContext();
+	auto* pool_allocator = RuntimeMemory::pool_allocator;
+
+	auto result = v8::Object::New(isolate);
+	auto set = [&](const char* key, v8::Local<v8::Value> value) {
+		result->Set(context, v8::String::NewFromUtf8(isolate, key).ToLocalChecked(),
+								value).Check();
+	};
+	auto set_number = [&](const char* key, uint64_t value) {
+		set(key, v8::Number::New(isolate, static_cast<double>(value)));
+	};
+
+	set("allocator", v8::String::NewFromUtf8(isolate,
+		pool_allocator != nullptr ? "pool" : "default").ToLocalChecked());
+	if (pool_allocator != nullptr) {
+		const auto stats = pool_allocator->GetStats();
+		set_number("allocations", stats.allocations);
+		set_number("frees", stats.frees);
+		set_number("reused", stats.reused);
+		set_number("liveBytes", stats.live_bytes);
+		set_number("peakBytes", stats.peak_bytes);
+		set_number("pooledBytes", stats.pooled_bytes);
+		set_number("residentPageBytes", stats.resident_page_bytes);
+		set_number("discardedPageBytes", stats.discarded_page_bytes);
 	}
-}
 
-/** The callback that is invoked by v8 whenever the JavaScript 'rename'
- *  function is called. Renames the passed file or directory
- *  to the new name in arg[1]. This function guarantees that the new
- *  entity is in the same directory as the old one */
-void Rename(const v8::FunctionCallbackInfo<v8::Value>& args) {
-	v8::String::Utf8Value path_entity(args.GetIsolate(), args[0]);
-	auto old_pathname = fs::path(ToCString(path_entity));
-	ConstructAbsolutePath(old_pathname);
+	args.GetReturnValue().Set(result);
+}
 
-	v8::String::Utf8Value new_path_entity(args.GetIsolate(), args[1]);
-	auto new_pathname = fs::path(ToCString(new_path_entity));
-	ConstructAbsolutePath(new_pathname);
+/** Returns the bytes of the isolate's heap in use. */
+double UsedHeapSize(v8::Isolate* isolate) {
+	v8::HeapStatistics heap;
+	isolate->GetHeapStatistics(&heap);
 
-	if (new_pathname.parent_path() != old_pathname.parent_path()) {
-		PrintErrorTag();
-		std::cerr << " Tried to move file " << rang::style::bold << old_pathname
-							<< rang::style::reset << " to new location."
-							<< " Use the move('from', 'to') function instead." << std::endl;
+	return static_cast<double>(heap.used_heap_size());
+}
 
-		return;
-	}
+/** The callback that is invoked by v8 whenever the JavaScript 'gc'
+ *  function is called. Runs a full garbage collection right away, so a
+ *  script can clean up between phases, and returns the bytes of the heap
+ *  still in use. */
+void CollectGarbage(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	auto* isolate = args.GetIsolate();
+	// Critical pressure collects synchronously on the isolate's thread
+	isolate->MemoryPressureNotification(v8::MemoryPressureLevel::kCritical);
+	isolate->MemoryPressureNotification(v8::MemoryPressureLevel::kNone);
 
-	std::error_code err;
-	fs::rename(old_pathname, new_pathname, err);
+	args.GetReturnValue().Set(UsedHeapSize(isolate));
+}
 
-	if (err.value() != 0) {
-		PrintErrorTag();
-		std::cerr << " " << std::system_category().message(errno)
-							<< std::endl;
+/** The callback that is invoked by v8 whenever the JavaScript 'lowMemory'
+ *  function is called. Like gc(), but also drops v8's caches, shrinks the
+ *  heap and unmaps the pages the pool allocator keeps for reuse. Returns the
+ *  bytes of the heap still in use. */
+void LowMemory(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	auto* isolate = args.GetIsolate();
+	isolate->LowMemoryNotification();
+	if (RuntimeMemory::pool_allocator != nullptr) {
+		RuntimeMemory::pool_allocator->Trim();
 	}
-}
 
-/** The callback that is invoked by v8 whenever the JavaScript 'move'
- *  function is called. Moves the passed file or directory
- *  to the new path in arg[1]. */
-void Move(const v8::FunctionCallbackInfo<v8::Value>& args) {
-	v8::String::Utf8Value path_entity(args.GetIsolate(), args[0]);
-	auto old_path = fs::path(ToCString(path_entity));
-	ConstructAbsolutePath(old_path);
+	args.GetReturnValue().Set(UsedHeapSize(isolate));
+}
 
-	v8::String::Utf8Value new_path_entity(args.GetIsolate(), args[1]);
-	auto new_path = fs::path(ToCString(new_path_entity));
-	ConstructAbsolutePath(new_path);
+/** The callback that is invoked by v8 whenever the JavaScript 'heapStats'
+ *  function is called. Returns the isolate's heap statistics, the statistics
+ *  of every heap space and the history of its last garbage collections. */
+void HeapStats(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	auto* isolate = args.GetIsolate();
+	auto context = isolate->GetCurrentContext();
 
-	std::error_code err;
-	fs::rename(old_path, new_path, err);
+	const auto new_object = [&](auto fill) {
+		auto object = v8::Object::New(isolate);
+		auto set = [&](const char* key, v8::Local<v8::Value> value) {
+			object->Set(context, v8::String::NewFromUtf8(isolate, key).ToLocalChecked(),
+									value).Check();
+		};
+		auto set_number = [&](const char* key, double value) {
+			set(key, v8::Number::New(isolate, value));
+		};
+		fill(set, set_number);
+
+		return object;
+	};
+	const auto to_double = [](size_t value) { return static_cast<double>(value); };
+
+	v8::HeapStatistics heap;
+	isolate->GetHeapStatistics(&heap);
+
+	std::vector<v8::Local<v8::Value>> spaces;
+	for (size_t i = 0; i < isolate->NumberOfHeapSpaces(); i++) {
+		v8::HeapSpaceStatistics space;
+		if (!isolate->GetHeapSpaceStatistics(&space, i)) {
+			continue;
+		}
 
-	if (err.value() != 0) {
-		PrintErrorTag();
-		std::cerr << " " << std::system_category().message(errno)
-							<< std::endl;
+		spaces.push_back(new_object([&](auto& set, auto& set_number) {
+			set("name", v8::String::NewFromUtf8(isolate, space.space_name()).ToLocalChecked());
+			set_number("size", to_double(space.space_size()));
+			set_number("used", to_double(space.space_used_size()));
+			set_number("available", to_double(space.space_available_size()));
+			set_number("physical", to_double(space.physical_space_size()));
+		}));
 	}
+
+	const auto& gc_tracker = IsolateState::From(isolate)->Gc();
+	std::vector<v8::Local<v8::Value>> history;
+	gc_tracker.ForEach([&](const GcTracker::Event& event) {
+		history.push_back(new_object([&](auto& set, auto& set_number) {
+			set("type", v8::String::NewFromUtf8(isolate,
+				GcTracker::TypeName(event.type)).ToLocalChecked());
+			set("forced", v8::Boolean::New(isolate, event.forced));
+			set_number("start", event.start);
+			set_number("pause", event.pause);
+			set_number("usedBefore", to_double(event.used_before));
+			set_number("usedAfter", to_double(event.used_after));
+		}));
+	});
+
+	auto result = new_object([&](auto& set, auto& set_number) {
+		set_number("totalHeapSize", to_double(heap.total_heap_size()));
+		set_number("totalPhysicalSize", to_double(heap.total_physical_size()));
+		set_number("totalAvailableSize", to_double(heap.total_available_size()));
+		set_number("usedHeapSize", to_double(heap.used_heap_size()));
+		set_number("heapSizeLimit", to_double(heap.heap_size_limit()));
+		set_number("mallocedMemory", to_double(heap.malloced_memory()));
+		set_number("externalMemory", to_double(heap.external_memory()));
+		set_number("nativeContexts", to_double(heap.number_of_native_contexts()));
+		set_number("detachedContexts", to_double(heap.number_of_detached_contexts()));
+		set("spaces", v8::Array::New(isolate, spaces.data(), spaces.size()));
+		set("gc", new_object([&](auto& set, auto& set_number) {
+			set_number("count", static_cast<double>(gc_tracker.Count()));
+			set_number("totalPause", gc_tracker.TotalPause());
+			set_number("maxPause", gc_tracker.MaxPause());
+			set("history", v8::Array::New(isolate, history.data(), history.size()));
+		}));
+	});
+
+	args.GetReturnValue().Set(result);
 }
 
-/** The callback that is invoked by v8 whenever the JavaScript 'copy'
- *  function is called. Copies the passed file or directory
- *  to the new path in arg[1]. */
-void Copy(const v8::FunctionCallbackInfo<v8::Value>& args) {
-	v8::String::Utf8Value path_entity(args.GetIsolate(), args[0]);
-	auto source_path = fs::path(ToCString(path_entity));
-	ConstructAbsolutePath(source_path);
+/** The callback that is invoked by v8 whenever the JavaScript
+ *  'profile.start' function is called. Starts recording a CPU profile named
+ *  by argument 0, the options in argument 1 may set samplingIntervalUs. */
+void StartProfile(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	auto* isolate = args.GetIsolate();
+	auto context = isolate->GetCurrentContext();
 
-	v8::String::Utf8Value new_path_entity(args.GetIsolate(), args[1]);
-	auto dest_path = fs::path(ToCString(new_path_entity));
-	ConstructAbsolutePath(dest_path);
+	if (args.Length() < 1 || !args[0]->IsString() || args[0].As<v8::String>()->Length() == 0) {
+		isolate->ThrowError("[Error] Expected a profile name");
+		return;
+	}
 
-	std::error_code err;
-	fs::copy(source_path, dest_path, err);
+	auto interval = Profiler::kDefaultSamplingInterval;
+	auto interval_option = GetOption(isolate, args[1], "samplingIntervalUs");
+	if (!interval_option->IsUndefined()) {
+		interval = interval_option->Int32Value(context).FromMaybe(0);
+		if (interval <= 0) {
+			isolate->ThrowError("[Error] samplingIntervalUs has to be a positive number");
+			return;
+		}
+	}
 
-	if (err.value() != 0) {
-		PrintErrorTag();
-		std::cerr << " " << std::system_category().message(errno)
-							<< std::endl;
+	std::string error;
+	if (!IsolateState::From(isolate)->GetProfiler().StartCpuProfile(
+				args[0].As<v8::String>(), interval, error)) {
+		ThrowErrorWithReason(isolate, "Cannot start profile", error);
 	}
 }
 
-/** The callback that is invoked by v8 whenever the JavaScript 'mkdir'
- *  function is called. Creates a new directory. */
-void CreateNewDir(const v8::FunctionCallbackInfo<v8::Value>& args) {
-	v8::String::Utf8Value dirname(args.GetIsolate(), args[0]);
-	auto new_dir = fs::path(ToCString(dirname));
-	ConstructAbsolutePath(new_dir);
+/** The callback that is invoked by v8 whenever the JavaScript 'profile.stop'
+ *  function is called. Stops the CPU profile named by argument 0 and writes
+ *  it as a .cpuprofile to the file in argument 1, or returns it as a string
+ *  without one. */
+void StopProfile(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	auto* isolate = args.GetIsolate();
 
-  if (fs::exists(new_dir) && fs::is_directory(new_dir)) {
-    PrintErrorTag();
-    std::cerr << " Directory " << new_dir.generic_string() << " already exists.";
+	if (args.Length() < 1 || !args[0]->IsString() || args[0].As<v8::String>()->Length() == 0) {
+		isolate->ThrowError("[Error] Expected a profile name");
+		return;
+	}
+	if (args.Length() > 1 && !args[1]->IsString()) {
+		isolate->ThrowError("[Error] Expected a file path");
+		return;
+	}
 
-    return;
-  }
+	auto* profile = IsolateState::From(isolate)->GetProfiler().StopCpuProfile(
+		args[0].As<v8::String>());
+	if (profile == nullptr) {
+		isolate->ThrowError("[Error] No profile of that name is recorded");
+		return;
+	}
 
-	std::error_code err;
-	fs::create_directory(new_dir, err);
+	if (args.Length() < 2) {
+		std::ostringstream output;
+		Profiler::WriteCpuProfile(profile, output);
+		profile->Delete();
 
-	if (err.value() != 0) {
-		PrintErrorTag();
-		std::cerr << " " << std::system_category().message(errno)
-							<< std::endl;
+		const auto json = output.str();
+		args.GetReturnValue().Set(v8::String::NewFromUtf8(isolate, json.c_str(),
+			v8::NewStringType::kNormal, static_cast<int>(json.size())).ToLocalChecked());
+		return;
+	}
+
+	v8::String::Utf8Value file(isolate, args[1]);
+	auto filename = fs::path(ToCString(file));
+	ConstructAbsolutePath(isolate, filename);
+
+	std::ofstream output_file(filename);
+	const auto written = Profiler::WriteCpuProfile(profile, output_file);
+	profile->Delete();
+	if (!written) {
+		isolate->ThrowError(v8::String::NewFromUtf8(isolate,
+			("[Error] Cannot write profile " + filename.string()).c_str()).ToLocalChecked());
 	}
 }
 
-/** The callback that is invoked by v8 whenever the JavaScript 'runSync'
- *  function is called. Creates a child process and halts execution
- *  of the shell until the child process terminates.
- *  First argument is the application to be executed which is first
- *  looked for in the current executable's directory, otherwise the
- *  PATH is searched. Second argument is an optional additional
- *  object with parameeters to be passed to the executable.
- *  Third argument is controls verbosity of this functions. */
-void StartProcessSync(const v8::FunctionCallbackInfo<v8::Value>& args) {
+/** The callback that is invoked by v8 whenever the JavaScript 'heapSnapshot'
+ *  function is called. Writes a snapshot of the heap to the file in
+ *  argument 0, in the .heapsnapshot format of the Chrome DevTools. */
+void HeapSnapshot(const v8::FunctionCallbackInfo<v8::Value>& args) {
 	auto* isolate = args.GetIsolate();
-	auto context = isolate->GetCurrentContext();
-	bool verbose = true;
-
-	if (!(args[0]->IsString())) {
-		PrintErrorTag();
-		std::cerr << " No executable filename or path passed!" << std::endl;
 
+	if (args.Length() < 1 || !args[0]->IsString()) {
+		isolate->ThrowError("[Error] Expected a file path");
 		return;
 	}
 
-  std::vector<std::string> process_args;
-  const char* kAppendix = "_APPEND";
-  const char* kPrependix = "_PREPEND";
-  const char* appendix = nullptr;
-
-	// Format additional parameters
-	if (args.Length() > 1 && (args[1]->IsObject())) {
-		auto object = args[1]->ToObject(isolate->GetCurrentContext()).FromMaybe(
-			v8::Object::New(isolate));
-		auto params = object->GetOwnPropertyNames(isolate->GetCurrentContext()).FromMaybe(
-			v8::Array::New(isolate));
-		auto params_count = params->Length();
-
-		// Iterate over object entries
-    for (unsigned int i = 0; i < params_count; i++) {
-      auto param = params->Get(context, i).ToLocalChecked();
-
-      // Parse Object key-val pairs as strings
-      v8::String::Utf8Value parameter(isolate, param);
-      v8::String::Utf8Value value(
-          isolate, object->Get(context, param).ToLocalChecked());
+	v8::String::Utf8Value file(isolate, args[0]);
+	auto filename = fs::path(ToCString(file));
+	ConstructAbsolutePath(isolate, filename);
 
-      auto c_param = ToCString(parameter);
-      auto c_value = ToCString(value);
+	std::string error;
+	if (!IsolateState::From(isolate)->GetProfiler().WriteHeapSnapshot(filename, error)) {
+		ThrowErrorWithReason(isolate, "Cannot write heap snapshot", error);
+	}
+}
 
-      // _PREPEND
-      if (strcmp(c_param, kPrependix) == 0) {
-        process_args.insert(process_args.begin(), c_value);
+/** The callback that is invoked by v8 whenever the JavaScript
+ *  'allocationSampling.start' function is called. Starts sampling an
+ *  allocation about every number of bytes in argument 0. */
+void StartAllocationSampling(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	auto* isolate = args.GetIsolate();
+	auto context = isolate->GetCurrentContext();
 
-        continue;
-      }
-      // _APPEND
-      if (strcmp(c_param, kAppendix) == 0) {
-        appendix = c_value;
+	auto interval = Profiler::kDefaultAllocationInterval;
+	if (args.Length() > 0 && !args[0]->IsUndefined()) {
+		const auto bytes = args[0]->NumberValue(context).FromMaybe(0);
+		if (!(bytes >= 1)) {
+			isolate->ThrowError("[Error] Expected a positive sampling interval");
+			return;
+		}
+		interval = static_cast<uint64_t>(bytes);
+	}
 
-        continue;
-      }
+	if (!IsolateState::From(isolate)->GetProfiler().StartAllocationSampling(interval)) {
+		isolate->ThrowError("[Error] Allocations are sampled already");
+	}
+}
 
-      // -h vs --help
-      std::string arg = (parameter.length() == 1 ? "-" : "--");
-      arg.append(c_param);
+/** The callback that is invoked by v8 whenever the JavaScript
+ *  'allocationSampling.stop' function is called. Stops sampling and writes
+ *  the sampled allocations still alive as a .heapprofile to the file in
+ *  argument 0, or returns them as a string without one. */
+void StopAllocationSampling(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	auto* isolate = args.GetIsolate();
 
-      // Check if value is an empty string
-      if (c_value[0] != '\0') {
-        arg.append(" ").append(c_value);
-      }
+	if (args.Length() > 0 && !args[0]->IsString()) {
+		isolate->ThrowError("[Error] Expected a file path");
+		return;
+	}
 
-      process_args.emplace_back(arg);
-		}   
+	auto profile = IsolateState::From(isolate)->GetProfiler().StopAllocationSampling();
+	if (profile == nullptr) {
+		isolate->ThrowError("[Error] Allocations are not sampled");
+		return;
 	}
 
-  if (appendix != nullptr) {
-    process_args.emplace_back(appendix);
-  }
+	if (args.Length() < 1) {
+		std::ostringstream output;
+		Profiler::WriteAllocationProfile(profile.get(), output);
 
-	if (args.Length() > 2) {
-		if (args[2]->IsBoolean() &&
-				!(args[2]->ToBoolean(isolate)->BooleanValue(isolate))) {
-			 verbose = false;
-		}
+		const auto json = output.str();
+		args.GetReturnValue().Set(v8::String::NewFromUtf8(isolate, json.c_str(),
+			v8::NewStringType::kNormal, static_cast<int>(json.size())).ToLocalChecked());
+		return;
 	}
 
-	v8::String::Utf8Value str(isolate, args[0]);
-	std::string process_command = ToCString(str);
+	v8::String::Utf8Value file(isolate, args[0]);
+	auto filename = fs::path(ToCString(file));
+	ConstructAbsolutePath(isolate, filename);
 
-	// Check if cwd contains a file with that name
-	fs::path try_local_file = RuntimeMemory::current_directoy;
-	try_local_file.append(process_command);
-	if (fs::exists(try_local_file) && !fs::is_directory(try_local_file)) {
-		process_command = try_local_file.generic_string();
+	std::ofstream output_file(filename);
+	if (!Profiler::WriteAllocationProfile(profile.get(), output_file)) {
+		isolate->ThrowError(v8::String::NewFromUtf8(isolate,
+			("[Error] Cannot write allocation profile " + filename.string()).c_str()).ToLocalChecked());
 	}
-
-  CreateNewProcess(process_command, process_args, verbose);
 }
 
 /** The callback that is invoked by v8 whenever the JavaScript 'help'
@@ -583,7 +3527,12 @@ void Help(const v8::FunctionCallbackInfo<v8::Value>& args) {
 			<< std::endl << rang::fg::magenta << "ls(printToStd = true)/ll(printToStd = true)"
 			<< rang::style::reset << " - Prints all files and directories"
 			<< " in the current working directory. If 'false' is passed, it prints an array of"
-			<< " objects describing the directory content."
+			<< " objects describing the directory content. ls({columnar: true}) returns"
+			<< " parallel arrays of names, isDirectory flags, sizes and mtimes instead."
+			<< std::endl << rang::fg::magenta << "walk(root, options, callback)"
+			<< rang::style::reset << " - Recursively lists a directory tree in parallel, options"
+			<< " are maxDepth, include, exclude, followSymlinks, stats, threads and chunkSize. A"
+			<< " callback receives the entries in chunks while walking."
 			<< std::endl << rang::fg::magenta << "createFile(filename)/touch(filename)"
 			<< rang::style::reset << " - Creates a new file."
 			<< std::endl << rang::fg::magenta << "createDirectory(filename)/mkdir(filename)"
@@ -594,13 +3543,15 @@ void Help(const v8::FunctionCallbackInfo<v8::Value>& args) {
 			<< rang::style::reset
 			<< " - Recursively removes a Directory and it's contents."
 			<< std::endl << rang::fg::magenta << "rm(entity)" << rang::style::reset
-			<< " - Removes a file or recursively a directory and it's contents."
+			<< " - Removes a file or recursively a directory and it's contents. Both take a"
+			<< " {threads} option and return a summary of what was removed."
 			<< std::endl << rang::fg::magenta << "rename(entity)" << rang::style::reset
 			<< " - Renames the file or directory."
 			<< std::endl << rang::fg::magenta << "move(from, to)/mv(from, to)"
 			<< rang::style::reset << " - Moves a file or directory to a new location."
-			<< std::endl << rang::fg::magenta << "copy(from, to)" << rang::style::reset
-			<< " - Copies a file or directory to a new location."
+			<< std::endl << rang::fg::magenta << "copy(from, to, options)" << rang::style::reset
+			<< " - Copies a file or directory to a new location. With {recursive, threads, reflink}"
+			<< " options, copies whole trees in parallel and returns throughput statistics."
 			<< std::endl;
 
 	std::cout << rang::style::underline << "Execution:" << rang::style::reset 
@@ -613,7 +3564,67 @@ void Help(const v8::FunctionCallbackInfo<v8::Value>& args) {
 			<< rang::style::reset << " - Spawns a child process executing"
 			<< " the chosen file. The 'parameters' argument is an optional object with additional"
 			<< " parameters passed to the executable. Holds execution of the shell until the child"
-			<< " process terminates and redirects standard streams to the shell."
+			<< " process terminates and redirects standard streams to the shell. With"
+			<< " {capture: 'buffer' | 'lines' | 'tail'} as third argument, the output is returned as"
+			<< " ArrayBuffers, passed to an onLines callback or cut down to its last tailKb KiB."
+			<< std::endl
+			<< rang::fg::magenta << "run(filename, args, {cwd, env})" << rang::style::reset
+			<< " - Starts a child process without waiting for it. Returns a promise resolving to"
+			<< " {code, signal, stdout, stderr, durationMs} once the process exited."
+			<< std::endl << rang::fg::magenta << "runAll(jobs, {concurrency, failFast, timeoutMs})"
+			<< rang::style::reset << " - Runs many [filename, args] jobs with a bounded number of"
+			<< " processes at once and returns their results in input order."
+			<< std::endl << rang::fg::magenta << "pipeline(stages, {stdin, stdoutTo})"
+			<< rang::style::reset << " - Runs [filename, args] stages connected by pipes, like"
+			<< " 'a | b | c'. Output goes to a file, an ArrayBuffer ('buffer') or a callback"
+			<< " receiving batches of lines."
+			<< std::endl;
+
+	std::cout << rang::style::underline << "Timers:" << rang::style::reset
+						<< std::endl;
+	std::cout
+			<< rang::fg::magenta << "setTimeout(callback, delay, ...args)" << rang::style::reset
+			<< " - Calls callback with args once delay ms passed. Returns the timer's id."
+			<< std::endl << rang::fg::magenta << "setInterval(callback, delay, ...args)"
+			<< rang::style::reset << " - Calls callback with args every delay ms."
+			<< std::endl << rang::fg::magenta << "clearTimeout(id)/clearInterval(id)"
+			<< rang::style::reset << " - Cancels a timer."
+			<< std::endl;
+
+	std::cout << rang::style::underline << "Asynchronous File System (fs):" << rang::style::reset
+						<< std::endl;
+	std::cout
+			<< rang::fg::magenta << "fs.readAsync(path)/fs.readBytesAsync(path)" << rang::style::reset
+			<< " - Reads a file as UTF-8 string/ArrayBuffer."
+			<< std::endl << rang::fg::magenta << "fs.writeAsync(path, data, options)"
+			<< rang::style::reset << " - Writes a string or buffer to a file."
+			<< std::endl << rang::fg::magenta << "fs.statAsync(path, options)"
+			<< rang::style::reset << " - Gets the type, size, mtime and mode of a path."
+			<< std::endl << rang::fg::magenta << "fs.readdirAsync(path)"
+			<< rang::style::reset << " - Lists the entries of a directory."
+			<< std::endl << rang::fg::magenta << "fs.mkdirAsync(path, options)"
+			<< rang::style::reset << " - Creates a directory."
+			<< std::endl << rang::fg::magenta << "fs.copyAsync(from, to, options)"
+			<< rang::style::reset << " - Copies a file or directory tree."
+			<< std::endl << rang::fg::magenta << "fs.moveAsync(from, to)"
+			<< rang::style::reset << " - Moves a file or directory."
+			<< std::endl << rang::fg::magenta << "fs.removeAsync(path, options)"
+			<< rang::style::reset << " - Removes a file or directory tree."
+			<< std::endl << rang::fg::magenta << "fs.batch(operations, options)"
+			<< rang::style::reset << " - Runs many stat, read, unlink, rmdir, rename and mkdir"
+			<< " operations at once."
+			<< std::endl << "All of them return a promise."
+			<< std::endl;
+
+	std::cout << rang::style::underline << "Workers:" << rang::style::reset
+						<< std::endl;
+	std::cout
+			<< rang::fg::magenta << "new Worker(scriptPath)" << rang::style::reset
+			<< " - Runs a script on its own thread. Talk to it with postMessage(value, transfer)"
+			<< " and onmessage."
+			<< std::endl << rang::fg::magenta << "parallelMap(array, fnFile, options)"
+			<< rang::style::reset << " - Maps an array on a pool of workers with the function"
+			<< " fnFile evaluates to."
 			<< std::endl;
 
 	std::cout << rang::style::underline << "General Functions:" << rang::style::reset 
@@ -624,61 +3635,188 @@ void Help(const v8::FunctionCallbackInfo<v8::Value>& args) {
 			<< rang::fg::magenta << "read(filename)" << rang::style::reset <<
 			" - Reads a file and returns it's content as a string."
 			<< std::endl
+			<< rang::fg::magenta << "readBytes(filename, {offset, length})" << rang::style::reset <<
+			" - Reads a file (region) and returns it's content as an ArrayBuffer."
+			<< std::endl
+			<< rang::fg::magenta << "writeBytes(filename, data)" << rang::style::reset <<
+			" - Writes an ArrayBuffer or typed array to a file."
+			<< std::endl
+			<< rang::fg::magenta << "writeFile(filename, data, {atomic})" << rang::style::reset <<
+			" - Writes a string or buffer to a file, optionally replacing it atomically."
+			<< std::endl
+			<< rang::fg::magenta << "appendFile(filename, data)" << rang::style::reset <<
+			" - Appends a string or buffer to a file."
+			<< std::endl
+			<< rang::fg::magenta << "openWriter(filename, {append, bufferSize})" << rang::style::reset <<
+			" - Returns a buffered writer object with write(data), flush() and close() methods."
+			<< std::endl
+			<< rang::fg::magenta << "lines(filename, {chunkSize})" << rang::style::reset <<
+			" - Returns an iterator yielding the lines of a file in batches, using constant memory."
+			<< std::endl
 			<< rang::fg::magenta << "quit()/exit()" << rang::style::reset
 			<< " - Terminates the shell."
 			<< std::endl
 			<< rang::fg::magenta << "version()" << rang::style::reset
 			<< " - Returns a string with the used v8 engine version."
+			<< std::endl
+			<< rang::fg::magenta << "codeCacheStats()" << rang::style::reset
+			<< " - Returns the hit/miss counters of the code cache (see --code-cache-dir)."
+			<< std::endl
+			<< rang::fg::magenta << "memoryStats()" << rang::style::reset
+			<< " - Returns the counters of the ArrayBuffer allocator (see --ab-allocator)."
+			<< std::endl
+			<< rang::fg::magenta << "gc()" << rang::style::reset
+			<< " - Runs a full garbage collection, returns the bytes of the heap in use."
+			<< std::endl
+			<< rang::fg::magenta << "lowMemory()" << rang::style::reset
+			<< " - Like gc(), but also drops caches and gives unused memory back."
+			<< std::endl
+			<< rang::fg::magenta << "heapStats()" << rang::style::reset
+			<< " - Returns the heap's statistics and the last garbage collections (see --gc-log)."
+			<< std::endl
+			<< rang::fg::magenta << "profile.start(name, options)" << rang::style::reset
+			<< " - Starts recording a CPU profile, options: { samplingIntervalUs }."
+			<< std::endl
+			<< rang::fg::magenta << "profile.stop(name, [path])" << rang::style::reset
+			<< " - Stops the CPU profile and writes it to path as .cpuprofile, or returns it."
+			<< std::endl
+			<< rang::fg::magenta << "heapSnapshot(path)" << rang::style::reset
+			<< " - Writes a snapshot of the heap to path as .heapsnapshot."
+			<< std::endl
+			<< rang::fg::magenta << "allocationSampling.start([intervalBytes])" << rang::style::reset
+			<< " - Starts sampling allocations, by default one per 512 KiB."
+			<< std::endl
+			<< rang::fg::magenta << "allocationSampling.stop([path])" << rang::style::reset
+			<< " - Writes the sampled allocations still alive to path as .heapprofile, or returns them."
 			<< std::endl;
 }
 
-/** Reads the content of a file into a v8 string. */
+/** A v8 string resource that owns a copy of a file's content, v8 disposes
+ *  it once the string is garbage collected. Unlike a mapping of the file,
+ *  the copy doesn't change when the file does, as v8 requires. */
+class FileStringResource : public v8::String::ExternalOneByteStringResource {
+ public:
+	FileStringResource(std::unique_ptr<char[]> data, size_t length)
+		: data_(std::move(data)), length_(length) {}
+
+	const char* data() const override { return data_.get(); }
+	size_t length() const override { return length_; }
+
+ private:
+	std::unique_ptr<char[]> data_;
+	size_t length_;
+};
+
+/** Checks whether data only contains 7 bit ASCII characters. */
+bool IsAscii(const char* data, size_t length) {
+	const uint64_t kHighBits = 0x8080808080808080ull;
+	size_t i = 0;
+
+	// Test a word at a time
+	for (; i + sizeof(uint64_t) <= length; i += sizeof(uint64_t)) {
+		uint64_t word;
+		memcpy(&word, data + i, sizeof(word));
+		if (word & kHighBits) {
+			return false;
+		}
+	}
+
+	for (; i < length; i++) {
+		if (data[i] & 0x80) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/** Reads the content of a file into a v8 string. Large ASCII files are copied
+ *  once into buffers handed to v8 as external strings, outside of its heap.
+ *  Everything else is decoded straight from the mapping with a single copy. */
 std::optional<v8::MaybeLocal<v8::String>> ReadFile(v8::Isolate* isolate, const char* name) {
-	std::ifstream input_file;
-	input_file.open(name, std::ios::binary);
-	if (!input_file) {
-		PrintErrorTag();
-		std::cerr << " Cannot open input file " << name << std::endl;
+	// External strings have some overhead, small files are just copied
+	const size_t kExternalStringThreshold = 64 * 1024;
+
+	MappedFile file;
+	std::string error;
+	if (!MapFile(name, 0, 0, false, file, error)) {
+		auto& err_out = IsolateState::From(isolate)->Err();
+		PrintErrorTag(err_out);
+		err_out << " Cannot open input file " << name << ": " << error << std::endl;
 
 		return std::nullopt;
 	}
 
-	// get length of file:
-	input_file.seekg(0, input_file.end);
-	const auto size = input_file.tellg();
-
-	// tellg() returns -1 if it fails
-	if (size == -1) {
-		PrintErrorTag();
-		std::cerr << " Cannot tellg() file content length" << std::endl;
+	if (file.size > static_cast<size_t>(v8::String::kMaxLength)) {
+		UnmapFile(file);
+		auto& err_out = IsolateState::From(isolate)->Err();
+		PrintErrorTag(err_out);
+		err_out << " File " << name << " is too large to be read into a string" << std::endl;
 
 		return std::nullopt;
 	}
 
-	// reqind to beginning
-	input_file.seekg(0, std::ifstream::beg);
-	auto* buffer = new char[size];
+	if (file.size >= kExternalStringThreshold && IsAscii(file.data, file.size)) {
+		std::unique_ptr<char[]> data(new char[file.size]);
+		memcpy(data.get(), file.data, file.size);
+		auto* resource = new FileStringResource(std::move(data), file.size);
+		UnmapFile(file);
+		auto result = v8::String::NewExternalOneByte(isolate, resource);
+
+		// v8 only takes ownership of the resource on success
+		if (result.IsEmpty()) {
+			delete resource;
+		}
 
-	input_file.read(buffer, static_cast<int>(size));
-	input_file.close();
+		return result;
+	}
 
-	v8::MaybeLocal<v8::String> result = v8::String::NewFromUtf8(
-		isolate, buffer, v8::NewStringType::kNormal, static_cast<int>(size));
+	v8::MaybeLocal<v8::String> result;
+	const auto* bytes = reinterpret_cast<const unsigned char*>(file.data);
+
+	// UTF-16 is only recognized by its byte order mark
+	if (file.size >= 2 && bytes[0] == 0xFF && bytes[1] == 0xFE) {
+		result = v8::String::NewFromTwoByte(isolate,
+			reinterpret_cast<const uint16_t*>(file.data + 2), v8::NewStringType::kNormal,
+			static_cast<int>((file.size - 2) / 2));
+	} else if (file.size >= 2 && bytes[0] == 0xFE && bytes[1] == 0xFF) {
+		std::vector<uint16_t> swapped((file.size - 2) / 2);
+		for (size_t i = 0; i < swapped.size(); i++) {
+			swapped[i] = static_cast<uint16_t>(bytes[2 + 2 * i] << 8 | bytes[3 + 2 * i]);
+		}
+		result = v8::String::NewFromTwoByte(isolate, swapped.data(),
+			v8::NewStringType::kNormal, static_cast<int>(swapped.size()));
+	} else {
+		result = v8::String::NewFromUtf8(isolate, file.data, v8::NewStringType::kNormal,
+			static_cast<int>(file.size));
+	}
 
-	delete[] buffer;
+	UnmapFile(file);
 	return result;
 }
 
-/** Parses and executes a string within the current v8 context. */
+/** Parses and executes a string within the current v8 context. Sources
+ *  loaded from files should pass use_code_cache, which consults the on-disk
+ *  code cache if one was configured via --code-cache-dir. */
 bool ExecuteString(v8::Isolate* isolate, v8::Local<v8::String> source,
-	v8::Local<v8::Value> name, bool print_result, bool report_exceptions) {
+	v8::Local<v8::Value> name, bool print_result, bool report_exceptions,
+	bool use_code_cache) {
 	v8::HandleScope handle_scope(isolate);
 	v8::TryCatch try_catch(isolate);
 	v8::ScriptOrigin origin(isolate, name);
 	v8::Local<v8::Context> context(isolate->GetCurrentContext());
 	v8::Local<v8::Script> script;
 
-	if (!v8::Script::Compile(context, source, &origin).ToLocal(&script)) {
+	auto& code_cache = RuntimeMemory::code_cache;
+	use_code_cache = use_code_cache && code_cache.Enabled();
+	uint64_t cache_key = 0;
+	bool cache_miss = false;
+
+	auto compiled = use_code_cache
+		? code_cache.Compile(context, source, &origin, cache_key, cache_miss)
+		: v8::Script::Compile(context, source, &origin);
+
+	if (!compiled.ToLocal(&script)) {
 		// Print errors that happened during compilation.
 		if (report_exceptions)
 			ReportException(isolate, &try_catch);
@@ -686,7 +3824,14 @@ bool ExecuteString(v8::Isolate* isolate, v8::Local<v8::String> source,
 	}
 	else {
 		v8::Local<v8::Value> result;
-		if (!script->Run(context).ToLocal(&result)) {
+		auto ran = script->Run(context).ToLocal(&result);
+
+		// Cache after running so lazily compiled functions are included
+		if (use_code_cache && cache_miss) {
+			code_cache.Store(cache_key, script);
+		}
+
+		if (!ran) {
 			assert(try_catch.HasCaught());
 			// Print errors that happened during execution.
 			if (report_exceptions)
@@ -700,9 +3845,9 @@ bool ExecuteString(v8::Isolate* isolate, v8::Local<v8::String> source,
 					// If all went well and the result wasn't undefined then print
 					// the returned value.
 					v8::String::Utf8Value str(isolate, result);
-					std::cout << ToCString(str) << std::endl;
+					IsolateState::From(isolate)->Out() << ToCString(str) << std::endl;
 				} 
-				PrintCWD();
+				PrintCWD(isolate);
 			} 
 			return true;
 		}
@@ -712,14 +3857,20 @@ bool ExecuteString(v8::Isolate* isolate, v8::Local<v8::String> source,
 /** Runs a v8 stack trace and reports the exception together with
 *   the code that caused it. */
 void ReportException(v8::Isolate* isolate, v8::TryCatch* try_catch) {
+	// Terminating, e.g. by quit() in a batch job, is no error
+	if (try_catch->HasTerminated()) {
+		return;
+	}
+
 	v8::HandleScope handle_scope(isolate);
+	auto& err = IsolateState::From(isolate)->Err();
 	v8::String::Utf8Value exception(isolate, try_catch->Exception());
 	const char* exception_string = ToCString(exception);
 	v8::Local<v8::Message> message = try_catch->Message();
 	if (message.IsEmpty()) {
 		// V8 didn't provide any extra information about this error; just
 		// print the exception.
-		std::cerr << exception_string << std::endl;
+		err << exception_string << std::endl;
 	}
 	else {
 		// Print (filename):(line number) - (message).
@@ -728,33 +3879,33 @@ void ReportException(v8::Isolate* isolate, v8::TryCatch* try_catch) {
 		v8::Local<v8::Context> context(isolate->GetCurrentContext());
 		const auto* filename_string = ToCString(filename);
 		int linenum = message->GetLineNumber(context).FromJust();
-		std::cerr << filename_string << ":" << linenum << " - " << exception_string
+		err << filename_string << ":" << linenum << " - " << exception_string
 			<< std::endl;
 
 		// Print line of faulty source code.
 		v8::String::Utf8Value sourceline(
 			isolate, message->GetSourceLine(context).ToLocalChecked());
-		std::cerr << ToCString(sourceline) << std::endl;
+		err << ToCString(sourceline) << std::endl;
 
 		// Print wavy underline
 		int start = message->GetStartColumn(context).FromJust();
 		for (int i = 0; i < start; i++) {
-			std::cerr << " ";
+			err << " ";
 		}
 		int end = message->GetEndColumn(context).FromJust();
 		for (int i = start; i < end; i++) {
-			std::cerr << "^";
+			err << "^";
 		}
-		std::cerr << std::endl;
+		err << std::endl;
 
 		v8::Local<v8::Value> stack_trace;
 		if (try_catch->StackTrace(context).ToLocal(&stack_trace) &&
 				stack_trace->IsString() && stack_trace.As<v8::String>()->Length() > 0) {
 			v8::String::Utf8Value stack_trace_result(isolate, stack_trace);
-			std::cerr << ToCString(stack_trace_result) << std::endl;
+			err << ToCString(stack_trace_result) << std::endl;
 		}
 
-		PrintCWD();
+		PrintCWD(isolate);
 	}
 }
 
@@ -763,14 +3914,169 @@ const char* ToCString(const v8::String::Utf8Value& value) {
 	return *value ? *value : "[Error] string conversion failed";
 }
 
+/** Returns the property name of an options object, or undefined if options
+ *  is not an object or does not have that property. */
+v8::Local<v8::Value> GetOption(v8::Isolate* isolate, v8::Local<v8::Value> options,
+	const char* name) {
+	if (options.IsEmpty() || !options->IsObject()) {
+		return v8::Undefined(isolate);
+	}
+
+	auto context = isolate->GetCurrentContext();
+	auto key = v8::String::NewFromUtf8(isolate, name).ToLocalChecked();
+
+	return options.As<v8::Object>()->Get(context, key).FromMaybe(
+		v8::Local<v8::Value>(v8::Undefined(isolate)));
+}
+
+/** Allocates a backing store through the isolate's ArrayBuffer allocator
+ *  without zeroing it, for buffers that get filled right away. Returns
+ *  nullptr if the memory cannot be allocated. */
+std::unique_ptr<v8::BackingStore> NewUninitializedBackingStore(v8::Isolate* isolate,
+	size_t length) {
+#ifdef V8_ENABLE_SANDBOX
+	// Larger backing stores are not allowed inside the sandbox
+	if (length > v8::internal::kMaxSafeBufferSizeForSandbox) {
+		return nullptr;
+	}
+#endif
+
+	auto* allocator = isolate->GetArrayBufferAllocator();
+	auto* data = length != 0 ? allocator->AllocateUninitialized(length) : nullptr;
+	if (length != 0 && data == nullptr) {
+		return nullptr;
+	}
+
+	return v8::ArrayBuffer::NewBackingStore(data, length,
+		[](void* data, size_t length, void* allocator) {
+			static_cast<v8::ArrayBuffer::Allocator*>(allocator)->Free(data, length);
+		},
+		allocator);
+}
+
+/** Gets the memory behind an ArrayBuffer, SharedArrayBuffer, TypedArray or DataView.
+ *  Returns false for any other value. */
+bool GetBufferContents(v8::Local<v8::Value> value, WriteBuffer& contents /*OUT*/) {
+	if (value.IsEmpty()) {
+		return false;
+	}
+
+	if (value->IsArrayBufferView()) {
+		auto view = value.As<v8::ArrayBufferView>();
+		auto* data = static_cast<const char*>(view->Buffer()->Data());
+		contents = {data + view->ByteOffset(), view->ByteLength()};
+
+		return true;
+	}
+
+	if (value->IsArrayBuffer()) {
+		auto buffer = value.As<v8::ArrayBuffer>();
+		contents = {static_cast<const char*>(buffer->Data()), buffer->ByteLength()};
+
+		return true;
+	}
+
+	if (value->IsSharedArrayBuffer()) {
+		auto buffer = value.As<v8::SharedArrayBuffer>();
+		contents = {static_cast<const char*>(buffer->Data()), buffer->ByteLength()};
+
+		return true;
+	}
+
+	return false;
+}
+
+/** Gets the bytes to write for a string (encoded as UTF-8) or a buffer.
+ *  storage keeps the encoded string alive. Returns false for other values. */
+bool GetWriteData(v8::Isolate* isolate, v8::Local<v8::Value> value,
+	WriteBuffer& contents /*OUT*/, std::string& storage /*OUT*/) {
+	if (value.IsEmpty()) {
+		return false;
+	}
+
+	if (value->IsString()) {
+		auto string = value.As<v8::String>();
+		storage.resize(static_cast<size_t>(string->Utf8Length(isolate)));
+		string->WriteUtf8(isolate, storage.data(), static_cast<int>(storage.size()), nullptr,
+			v8::String::NO_NULL_TERMINATION | v8::String::REPLACE_INVALID_UTF8);
+		contents = {storage.data(), storage.size()};
+
+		return true;
+	}
+
+	return GetBufferContents(value, contents);
+}
+
+/** Throws a JS error consisting of message and the reason it failed. */
+void ThrowErrorWithReason(v8::Isolate* isolate, const char* message,
+	const std::string& reason) {
+	auto text = std::string("[Error] ") + message + ": " + reason;
+	isolate->ThrowError(v8::String::NewFromUtf8(isolate, text.c_str()).ToLocalChecked());
+}
+
+/** Key of the private property linking a JS object to its NativeObject. */
+v8::Local<v8::Private> NativeObjectKey(v8::Isolate* isolate) {
+	return v8::Private::ForApi(isolate,
+		v8::String::NewFromUtf8Literal(isolate, "V8Shell::NativeObject"));
+}
+
+/** Creates a JS object that owns native. native is deleted once the object
+ *  is garbage collected. */
+v8::Local<v8::Object> WrapNativeObject(v8::Isolate* isolate, NativeObject* native) {
+	auto context = isolate->GetCurrentContext();
+	auto object = v8::Object::New(isolate);
+	object->SetPrivate(context, NativeObjectKey(isolate),
+										 v8::External::New(isolate, native)).Check();
+
+	native->object_.Reset(isolate, object);
+	native->object_.SetWeak(native, [](const v8::WeakCallbackInfo<NativeObject>& info) {
+		auto* native = info.GetParameter();
+		native->object_.Reset();
+		delete native;
+	}, v8::WeakCallbackType::kParameter);
+
+	return object;
+}
+
+/** Gets the NativeObject of the object a method created by SetMethod is bound to. */
+NativeObject* UnwrapNativeObject(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	auto* isolate = args.GetIsolate();
+	auto native = args.Data().As<v8::Object>()->GetPrivate(isolate->GetCurrentContext(),
+		NativeObjectKey(isolate)).ToLocalChecked().As<v8::External>();
+
+	return static_cast<NativeObject*>(native->Value());
+}
+
+/** Adds a method to object. The method is bound to object rather than relying
+ *  on 'this', so it keeps working when it is detached. */
+void SetMethod(v8::Isolate* isolate, v8::Local<v8::Object> object, v8::Local<v8::Name> name,
+	v8::FunctionCallback callback) {
+	auto context = isolate->GetCurrentContext();
+	object->Set(context, name, v8::Function::New(context, callback, object).ToLocalChecked())
+		.Check();
+}
+
+void SetMethod(v8::Isolate* isolate, v8::Local<v8::Object> object, const char* name,
+	v8::FunctionCallback callback) {
+	SetMethod(isolate, object, v8::String::NewFromUtf8(isolate, name).ToLocalChecked(),
+						callback);
+}
+
+/** Returns the template cached under name in the isolate's state, see
+ *  IsolateState::GetObjectTemplate(). */
+v8::Local<v8::ObjectTemplate> GetObjectTemplate(v8::Isolate* isolate, const char* name,
+	std::initializer_list<const char*> properties) {
+	return IsolateState::From(isolate)->GetObjectTemplate(name, properties);
+}
+
 /** Constructs a path relative to the cwd if path is relative. */
-void ConstructAbsolutePath(fs::path& path /*IN-OUT*/) {
+void ConstructAbsolutePath(v8::Isolate* isolate, fs::path& path /*IN-OUT*/) {
 	// Nothing needs to be done if path is already absolute
 	if (path.is_absolute()) {
 		return;
 	}
 
-	fs::path cwd = RuntimeMemory::current_directoy;
+	fs::path cwd = IsolateState::From(isolate)->GetCWD();
 	path = cwd.append(path.generic_string());
 }
 
@@ -0,0 +1,261 @@
+// This File contains the event loop that drives asynchronous shell functions
+
+#include <algorithm>
+#include <iostream>
+#include <thread>
+
+#include "Commands.h"
+#include "EventLoop.h"
+#include "IsolateState.h"
+
+namespace Commands {
+
+EventLoop::EventLoop(v8::Isolate* isolate, v8::Platform* platform)
+    : isolate_(isolate), platform_(platform) {
+  std::string error;
+  poller_ = CreatePoller(error);
+
+  if (poller_ != kInvalidPoller) {
+    wakeup_fd_ = CreateWakeup(error);
+    if (wakeup_fd_ != -1 && !WatchDescriptor(poller_, wakeup_fd_, kPollReadable, error)) {
+      CloseDescriptor(wakeup_fd_);
+      wakeup_fd_ = -1;
+    }
+  }
+
+  isolate_->SetData(kIsolateSlot, this);
+}
+
+EventLoop::~EventLoop() {
+  // Jobs still running post their callbacks, which are dropped unrun below
+  pool_.reset();
+  completions_.clear();
+  timers_.clear();
+  watchers_.clear();
+
+  isolate_->SetData(kIsolateSlot, nullptr);
+
+  CloseDescriptor(wakeup_fd_);
+  if (poller_ != kInvalidPoller) {
+    ClosePoller(poller_);
+  }
+}
+
+EventLoop* EventLoop::From(v8::Isolate* isolate) {
+  return static_cast<EventLoop*>(isolate->GetData(kIsolateSlot));
+}
+
+/** Calls handler with the ready events whenever fd becomes ready, until the
+ *  fd is unwatched. Watched descriptors keep Run() going. */
+bool EventLoop::Watch(int fd, uint32_t events, Handler handler, std::string& error /*OUT*/) {
+  if (poller_ == kInvalidPoller) {
+    error = "Not supported on this platform yet";
+
+    return false;
+  }
+  if (!WatchDescriptor(poller_, fd, events, error)) {
+    return false;
+  }
+
+  watchers_[fd] = std::move(handler);
+  return true;
+}
+
+/** Stops watching fd, safe to call from within its own handler. */
+void EventLoop::Unwatch(int fd) {
+  if (watchers_.erase(fd) != 0) {
+    UnwatchDescriptor(poller_, fd);
+  }
+}
+
+/** Calls callback once delay_ms passed, and every delay_ms after that if
+ *  repeat is set, until the timer is cleared. Returns the timer's id. */
+uint64_t EventLoop::AddTimer(double delay_ms, bool repeat, Callback callback) {
+  const auto interval = std::chrono::duration_cast<Clock::duration>(
+    std::chrono::duration<double, std::milli>(std::max(delay_ms, 0.0)));
+  const auto id = next_timer_id_++;
+  const auto due = Clock::now() + interval;
+
+  timers_.emplace(id, Timer{due, interval, repeat, std::move(callback)});
+  timer_heap_.push({due, id});
+
+  return id;
+}
+
+/** Cancels a timer, safe to call from within its own callback and with ids
+ *  of timers that already fired. */
+void EventLoop::ClearTimer(uint64_t id) {
+  timers_.erase(id);
+}
+
+/** Runs job on the loop's worker pool and then the callback it returns on the
+ *  loop's thread. Pending jobs keep Run() going. */
+void EventLoop::Submit(Job job) {
+  if (!pool_) {
+    // Jobs mostly wait on the file system, small machines still get some overlap
+    pool_ = std::make_unique<WorkStealingPool>(
+      std::max(kMinWorkerThreads, WorkStealingPool::DefaultThreads()));
+  }
+
+  Ref();
+  pool_->Submit([this, job = std::move(job)]() {
+    auto callback = job();
+    Post([this, callback = std::move(callback)]() {
+      Unref();
+      if (callback) {
+        callback();
+      }
+    });
+  });
+}
+
+/** Queues callback to run on the loop's thread, may be called from any thread. */
+void EventLoop::Post(Callback callback) {
+  {
+    std::lock_guard<std::mutex> lock(completions_mutex_);
+    completions_.push_back(std::move(callback));
+  }
+
+  if (wakeup_fd_ != -1) {
+    SignalWakeup(wakeup_fd_);
+  }
+}
+
+/** Makes Run() return as soon as possible and for good, may be called from
+ *  any thread. Used to terminate worker isolates. */
+void EventLoop::Stop() {
+  stopped_ = true;
+
+  if (wakeup_fd_ != -1) {
+    SignalWakeup(wakeup_fd_);
+  }
+}
+
+bool EventLoop::Alive() const {
+  return !stopped_ && (!watchers_.empty() || !timers_.empty() || refs_ != 0);
+}
+
+/** Runs posted platform tasks and pending microtasks. */
+void EventLoop::Drain() {
+  while (v8::platform::PumpMessageLoop(platform_, isolate_)) continue;
+  isolate_->PerformMicrotaskCheckpoint();
+}
+
+/** Calls a callback the way all of the loop's callbacks are called: in a
+ *  fresh handle scope and followed by the microtasks it queued. Exceptions
+ *  the callback left uncaught are reported like those of scripts. */
+void EventLoop::Invoke(const Callback& callback) {
+  v8::HandleScope handle_scope(isolate_);
+  v8::TryCatch try_catch(isolate_);
+  callback();
+  if (try_catch.HasCaught()) {
+    ReportException(isolate_, &try_catch);
+  }
+  isolate_->PerformMicrotaskCheckpoint();
+}
+
+/** Returns how long to wait for events, bounded by the next timer. */
+int EventLoop::NextTimeout() const {
+  if (timer_heap_.empty()) {
+    return kMaxWaitMs;
+  }
+
+  const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+    timer_heap_.top().due - Clock::now()).count();
+  // Rounded up, waking early would only mean another round
+  return static_cast<int>(std::clamp<int64_t>(remaining + 1, 0, kMaxWaitMs));
+}
+
+/** Calls the callbacks of all timers that are due. Timers added by those
+ *  callbacks wait for the next round, even with a delay of zero. */
+void EventLoop::RunTimers() {
+  const auto now = Clock::now();
+
+  std::vector<TimerEntry> due_entries;
+  while (!timer_heap_.empty() && timer_heap_.top().due <= now) {
+    due_entries.push_back(timer_heap_.top());
+    timer_heap_.pop();
+  }
+
+  for (const auto& entry : due_entries) {
+    auto timer = timers_.find(entry.id);
+    if (timer == timers_.end() || timer->second.due != entry.due) {
+      continue;
+    }
+
+    // Copied, the callback may clear and thereby destroy its timer
+    auto callback = timer->second.callback;
+    if (timer->second.repeat) {
+      timer->second.due = now + timer->second.interval;
+      timer_heap_.push({timer->second.due, entry.id});
+    } else {
+      timers_.erase(timer);
+    }
+
+    Invoke(callback);
+  }
+
+  // Entries of cleared timers only go away when popped, don't let them pile up
+  if (timers_.empty()) {
+    timer_heap_ = decltype(timer_heap_)();
+  }
+}
+
+/** Calls everything posted from other threads so far. */
+void EventLoop::RunCompletions() {
+  std::vector<Callback> completions;
+  {
+    std::lock_guard<std::mutex> lock(completions_mutex_);
+    completions.swap(completions_);
+  }
+
+  for (const auto& completion : completions) {
+    Invoke(completion);
+  }
+}
+
+/** Dispatches events, timers and completions until nothing is pending. */
+void EventLoop::Run() {
+  Drain();
+
+  while (Alive()) {
+    const auto timeout = NextTimeout();
+    if (poller_ != kInvalidPoller) {
+      std::string error;
+      if (!WaitForEvents(poller_, timeout, events_, error)) {
+        auto& err = IsolateState::From(isolate_)->Err();
+        PrintErrorTag(err);
+        err << " Event loop failed: " << error << std::endl;
+
+        return;
+      }
+    } else {
+      // Without a poller only timers and completions can be pending
+      std::this_thread::sleep_for(std::chrono::milliseconds(timeout));
+      events_.clear();
+    }
+
+    for (const auto& event : events_) {
+      if (event.fd == wakeup_fd_) {
+        ClearWakeup(wakeup_fd_);
+        continue;
+      }
+
+      auto watcher = watchers_.find(event.fd);
+      // An earlier handler of this round may have unwatched it
+      if (watcher == watchers_.end()) {
+        continue;
+      }
+
+      // Copied, the handler may unwatch and thereby destroy itself
+      auto handler = watcher->second;
+      Invoke([&]() { handler(event.events); });
+    }
+
+    RunCompletions();
+    RunTimers();
+    Drain();
+  }
+}
+
+};
@@ -0,0 +1,86 @@
+// This File contains the buffered file writer behind openWriter()
+
+#include <cstring>
+
+#include "FileWriter.h"
+
+namespace Commands {
+
+FileWriter::FileWriter(FileHandle file, size_t buffer_size)
+    : file_(file), buffer_(new char[buffer_size]), capacity_(buffer_size) {}
+
+FileWriter::~FileWriter() {
+  std::string error;
+  Close(error);
+}
+
+/** Appends data to the buffer. Once it overflows, the buffered data and
+ *  data are written together with a single writev. */
+bool FileWriter::Write(const char* data, size_t size, std::string& error /*OUT*/) {
+  if (!IsOpen()) {
+    error = "Writer is closed";
+
+    return false;
+  }
+
+  if (size <= capacity_ - used_) {
+    memcpy(buffer_.get() + used_, data, size);
+    used_ += size;
+
+    return true;
+  }
+
+  const auto buffered = used_;
+  used_ = 0;
+
+  return WriteFileBuffers(file_, {{buffer_.get(), buffered}, {data, size}}, error);
+}
+
+/** Returns space for size bytes at the end of the buffer, to be filled in
+ *  place and then committed. Returns nullptr if size exceeds the capacity. */
+char* FileWriter::Reserve(size_t size, std::string& error /*OUT*/) {
+  if (!IsOpen()) {
+    error = "Writer is closed";
+
+    return nullptr;
+  }
+
+  if (size > capacity_) {
+    return nullptr;
+  }
+
+  if (size > capacity_ - used_ && !Flush(error)) {
+    return nullptr;
+  }
+
+  return buffer_.get() + used_;
+}
+
+/** Writes out the buffered data. */
+bool FileWriter::Flush(std::string& error /*OUT*/) {
+  if (!IsOpen()) {
+    error = "Writer is closed";
+
+    return false;
+  }
+
+  const auto buffered = used_;
+  used_ = 0;
+
+  return WriteFileBuffers(file_, {{buffer_.get(), buffered}}, error);
+}
+
+/** Flushes and closes the file. Closing an already closed writer does nothing. */
+bool FileWriter::Close(std::string& error /*OUT*/) {
+  if (!IsOpen()) {
+    return true;
+  }
+
+  auto OK = Flush(error);
+  CloseFile(file_);
+  file_ = kInvalidFileHandle;
+
+  return OK;
+}
+
+};
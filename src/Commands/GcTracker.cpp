@@ -0,0 +1,114 @@
+// This File contains the garbage collection history every isolate keeps
+
+#include "GcTracker.h"
+
+namespace Commands {
+
+GcTracker::GcTracker(v8::Isolate* isolate) : isolate_(isolate), id_(next_id_++) {
+  if (isolate_ != nullptr) {
+    isolate_->AddGCPrologueCallback(&GcTracker::Prologue, this, kTrackedTypes);
+    isolate_->AddGCEpilogueCallback(&GcTracker::Epilogue, this, kTrackedTypes);
+  }
+}
+
+GcTracker::~GcTracker() {
+  if (isolate_ != nullptr) {
+    isolate_->RemoveGCPrologueCallback(&GcTracker::Prologue, this);
+    isolate_->RemoveGCEpilogueCallback(&GcTracker::Epilogue, this);
+  }
+}
+
+/** The log is written through a large stdio buffer, a collection only costs
+ *  formatting one line. */
+bool GcTracker::OpenLog(const std::string& path) {
+  std::lock_guard<std::mutex> lock(log_mutex_);
+  if (log_file_ != nullptr) {
+    fclose(log_file_);
+  }
+
+  log_file_ = fopen(path.c_str(), "w");
+  if (log_file_ == nullptr) {
+    return false;
+  }
+  setvbuf(log_file_, nullptr, _IOFBF, 64 * 1024);
+
+  return true;
+}
+
+void GcTracker::CloseLog() {
+  std::lock_guard<std::mutex> lock(log_mutex_);
+  if (log_file_ != nullptr) {
+    fclose(log_file_);
+    log_file_ = nullptr;
+  }
+}
+
+const char* GcTracker::TypeName(v8::GCType type) {
+  switch (type) {
+    case v8::kGCTypeScavenge:
+      return "scavenge";
+    case v8::kGCTypeMinorMarkCompact:
+      return "minor-mark-compact";
+    case v8::kGCTypeMarkSweepCompact:
+      return "mark-sweep-compact";
+    case v8::kGCTypeIncrementalMarking:
+      return "incremental-marking";
+    case v8::kGCTypeProcessWeakCallbacks:
+      return "weak-callbacks";
+    default:
+      return "unknown";
+  }
+}
+
+void GcTracker::Prologue(v8::Isolate* isolate, v8::GCType type, v8::GCCallbackFlags flags,
+  void* data) {
+  auto* tracker = static_cast<GcTracker*>(data);
+  v8::HeapStatistics heap;
+  isolate->GetHeapStatistics(&heap);
+
+  auto& event = tracker->current_;
+  event.type = type;
+  event.forced =
+    (flags & (v8::kGCCallbackFlagForced | v8::kGCCallbackFlagCollectAllAvailableGarbage)) != 0;
+  event.used_before = heap.used_heap_size();
+  event.start = Now();
+}
+
+void GcTracker::Epilogue(v8::Isolate* isolate, v8::GCType, v8::GCCallbackFlags, void* data) {
+  auto* tracker = static_cast<GcTracker*>(data);
+  auto& event = tracker->current_;
+  event.pause = Now() - event.start;
+
+  v8::HeapStatistics heap;
+  isolate->GetHeapStatistics(&heap);
+  event.used_after = heap.used_heap_size();
+
+  tracker->history_[tracker->count_ % kHistorySize] = event;
+  tracker->count_++;
+  tracker->total_pause_ += event.pause;
+  if (event.pause > tracker->max_pause_) {
+    tracker->max_pause_ = event.pause;
+  }
+
+  tracker->WriteLog(event);
+}
+
+double GcTracker::Now() {
+  return std::chrono::duration<double, std::milli>(
+    std::chrono::steady_clock::now() - kStartTime).count();
+}
+
+void GcTracker::WriteLog(const Event& event) {
+  std::lock_guard<std::mutex> lock(log_mutex_);
+  if (log_file_ == nullptr) {
+    return;
+  }
+
+  fprintf(log_file_,
+    "{\"isolate\":%u,\"type\":\"%s\",\"forced\":%s,\"start\":%.3f,\"pause\":%.3f,"
+    "\"usedBefore\":%zu,\"usedAfter\":%zu}\n",
+    id_, TypeName(event.type), event.forced ? "true" : "false", event.start, event.pause,
+    event.used_before, event.used_after);
+}
+
+};
@@ -0,0 +1,109 @@
+// This File contains the shell state every isolate keeps for itself
+
+#include <iostream>
+
+#include "Commands.h"
+#include "IsolateState.h"
+
+namespace Commands {
+
+IsolateState::IsolateState(v8::Isolate* isolate)
+  : isolate_(isolate), gc_tracker_(isolate), profiler_(isolate) {
+  if (isolate_ != nullptr) {
+    isolate_->SetData(kIsolateSlot, this);
+    isolate_->AddNearHeapLimitCallback(&IsolateState::NearHeapLimit, this);
+  }
+}
+
+/** Has to run before the isolate is disposed, the cached templates are
+ *  handles into it. */
+IsolateState::~IsolateState() {
+  CloseOpenWriters();
+  object_templates_.clear();
+
+  if (isolate_ != nullptr) {
+    // Undoes the raises, they must not carry over to the next script
+    isolate_->RemoveNearHeapLimitCallback(&IsolateState::NearHeapLimit, initial_heap_limit_);
+    isolate_->SetData(kIsolateSlot, nullptr);
+  }
+}
+
+/** Flushes and closes all writers that scripts left open. */
+void IsolateState::CloseOpenWriters() {
+  for (auto* writer : open_writers_) {
+    std::string error;
+    if (!writer->Close(error)) {
+      PrintErrorTag();
+      std::cerr << " Cannot flush writer: " << error << std::endl;
+    }
+  }
+
+  open_writers_.clear();
+}
+
+/** Stops the --cpu-prof profile and writes it, if the run records one. */
+void IsolateState::FinishCpuProfile() {
+  if (cpu_profile_ != nullptr) {
+    cpu_profile_->Finish();
+  }
+}
+
+/** Called by v8 when garbage collections cannot keep the heap below its
+ *  limit anymore. Logs the heap's state and raises the limit by half of the
+ *  initial one the first time. The second time the script is terminated
+ *  instead of v8 aborting the process, with a little room to unwind. */
+size_t IsolateState::NearHeapLimit(void* data, size_t current_heap_limit,
+  size_t initial_heap_limit) {
+  auto* state = static_cast<IsolateState*>(data);
+  auto* isolate = state->isolate_;
+  const auto mib = [](size_t bytes) { return bytes / (1024 * 1024); };
+
+  v8::HeapStatistics heap;
+  isolate->GetHeapStatistics(&heap);
+
+  auto& err = state->Err();
+  PrintWarningTag(err);
+  err << " Heap is near its limit of " << mib(current_heap_limit) << " MiB: "
+      << mib(heap.used_heap_size()) << " MiB used, " << mib(heap.total_heap_size())
+      << " MiB committed, " << mib(heap.external_memory()) << " MiB external" << std::endl;
+
+  if (!state->heap_limit_raised_) {
+    state->heap_limit_raised_ = true;
+    state->initial_heap_limit_ = current_heap_limit;
+    const auto raised_limit = current_heap_limit + initial_heap_limit / 2;
+    err << "Raising the heap limit once to " << mib(raised_limit)
+        << " MiB, see --max-heap" << std::endl;
+
+    return raised_limit;
+  }
+
+  PrintErrorTag(err);
+  err << " Out of memory, terminating the script" << std::endl;
+  isolate->TerminateExecution();
+  if (auto* loop = EventLoop::From(isolate)) {
+    loop->Stop();
+  }
+
+  return current_heap_limit + initial_heap_limit / 8;
+}
+
+/** Returns the template cached under name, creating it with the given
+ *  properties on first use. Instances share one hidden class, so filling them in
+ *  doesn't transition maps. */
+v8::Local<v8::ObjectTemplate> IsolateState::GetObjectTemplate(const char* name,
+  std::initializer_list<const char*> properties) {
+  auto& cached = object_templates_[name];
+  if (!cached.IsEmpty()) {
+    return cached.Get(isolate_);
+  }
+
+  auto object_template = v8::ObjectTemplate::New(isolate_);
+  for (const auto* property : properties) {
+    object_template->Set(isolate_, property, v8::Undefined(isolate_));
+  }
+  cached.Reset(isolate_, object_template);
+
+  return object_template;
+}
+
+};
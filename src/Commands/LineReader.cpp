@@ -0,0 +1,130 @@
+// This File contains the chunked line splitters behind lines() and streamed process output
+
+#include <cstring>
+
+#include "LineReader.h"
+
+namespace Commands {
+
+namespace {
+
+/** Appends the complete lines in data[0, end) to lines, without terminators.
+ *  Returns the start of the incomplete line that remains. */
+size_t SplitLines(const char* data, size_t end, std::vector<std::string_view>& lines /*OUT*/) {
+  size_t line_begin = 0;
+
+  // memchr is vectorized by the C library
+  while (line_begin < end) {
+    auto* newline = static_cast<const char*>(memchr(data + line_begin, '\n', end - line_begin));
+    if (newline == nullptr) {
+      break;
+    }
+
+    auto line_end = static_cast<size_t>(newline - data);
+    auto line_size = line_end - line_begin;
+    if (line_size != 0 && data[line_end - 1] == '\r') {
+      line_size--;
+    }
+
+    lines.emplace_back(data + line_begin, line_size);
+    line_begin = line_end + 1;
+  }
+
+  return line_begin;
+}
+
+};
+
+bool LineReader::Open(const std::string& path, std::string& error /*OUT*/) {
+  input_.open(path, std::ios::binary);
+  if (!input_) {
+    error = std::strerror(errno);
+
+    return false;
+  }
+
+  return true;
+}
+
+/** Reads the next chunk and splits it into lines, without line terminators.
+ *  The lines point into the reader's buffer and stay valid until the next call.
+ *  A line that doesn't end within the chunk is completed by the following ones.
+ *  lines is empty once the whole file is consumed. */
+bool LineReader::NextBatch(std::vector<std::string_view>& lines /*OUT*/,
+  std::string& error /*OUT*/) {
+  lines.clear();
+
+  while (lines.empty() && !done_) {
+    // Move the incomplete line to the front, growing the buffer for overlong lines
+    memmove(buffer_.data(), buffer_.data() + pending_begin_, pending_size_);
+    pending_begin_ = 0;
+    if (buffer_.size() - pending_size_ < chunk_size_) {
+      buffer_.resize(pending_size_ + chunk_size_);
+    }
+
+    input_.read(buffer_.data() + pending_size_, static_cast<std::streamsize>(chunk_size_));
+    const auto bytes_read = static_cast<size_t>(input_.gcount());
+    if (input_.bad()) {
+      error = "Failed to read file";
+
+      return false;
+    }
+
+    const auto end = pending_size_ + bytes_read;
+    auto* data = buffer_.data();
+    const auto line_begin = SplitLines(data, end, lines);
+
+    pending_begin_ = line_begin;
+    pending_size_ = end - line_begin;
+
+    if (bytes_read == 0) {
+      // The last line of a file doesn't need a terminator
+      if (pending_size_ != 0) {
+        lines.emplace_back(data + pending_begin_, pending_size_);
+        pending_size_ = 0;
+      }
+
+      Close();
+    }
+  }
+
+  return true;
+}
+
+void LineReader::Close() {
+  input_.close();
+  done_ = true;
+}
+
+/** Splits the next piece of a stream into lines, without line terminators.
+ *  The lines point into the splitter's buffer and stay valid until the next call.
+ *  A line that doesn't end within the piece is completed by the following ones. */
+void LineSplitter::Feed(const char* data, size_t length,
+  std::vector<std::string_view>& lines /*OUT*/) {
+  lines.clear();
+
+  if (pending_size_ != 0) {
+    memmove(buffer_.data(), buffer_.data() + pending_begin_, pending_size_);
+  }
+  pending_begin_ = 0;
+  if (buffer_.size() < pending_size_ + length) {
+    buffer_.resize(pending_size_ + length);
+  }
+  memcpy(buffer_.data() + pending_size_, data, length);
+
+  const auto end = pending_size_ + length;
+  pending_begin_ = SplitLines(buffer_.data(), end, lines);
+  pending_size_ = end - pending_begin_;
+}
+
+/** Returns the last line of a stream that ended without a terminator, if any. */
+void LineSplitter::Finish(std::vector<std::string_view>& lines /*OUT*/) {
+  lines.clear();
+
+  if (pending_size_ != 0) {
+    lines.emplace_back(buffer_.data() + pending_begin_, pending_size_);
+    pending_size_ = 0;
+  }
+}
+
+};
@@ -1,14 +1,23 @@
 // This File contains functions with Linux-specific api calls
 
+#include <algorithm>
+#include <csignal>
+#include <random>
+
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+
 #include "V8SLinuxApi.h"
 
 extern char** environ;
 
 namespace Commands {
 
-void CreateNewProcess(std::string& process_path, std::vector<std::string>& args, bool verbose) {
-  pid_t pid;
-
+/** Builds the nullptr terminated argument vector for posix_spawnp, the
+ *  pointers stay valid as long as process_path and args do. */
+static std::vector<const char*> BuildArgv(const std::string& process_path,
+  const std::vector<std::string>& args) {
   std::vector<const char*> argv;
   // Add two extra spaces (process name and nullptr terminator)
   argv.reserve(args.size() + 2);
@@ -20,6 +29,14 @@ void CreateNewProcess(std::string& process_path, std::vector<std::string>& args,
   // Nullptr terminates the argument vector
   argv.push_back(nullptr);
 
+  return argv;
+}
+
+void CreateNewProcess(std::string& process_path, std::vector<std::string>& args, bool verbose) {
+  pid_t pid;
+
+  auto argv = BuildArgv(process_path, args);
+
   int status = posix_spawnp(&pid, process_path.c_str(), NULL, NULL,
     const_cast<char**>(&(argv[0])), environ);
 
@@ -41,4 +58,634 @@ void CreateNewProcess(std::string& process_path, std::vector<std::string>& args,
   }
 }
 
+PollerHandle CreatePoller(std::string& error /*OUT*/) {
+  const int poller = epoll_create1(EPOLL_CLOEXEC);
+  if (poller == -1) {
+    error = std::strerror(errno);
+  }
+
+  return poller;
+}
+
+void ClosePoller(PollerHandle poller) {
+  close(poller);
+}
+
+bool WatchDescriptor(PollerHandle poller, int fd, uint32_t events, std::string& error /*OUT*/) {
+  struct epoll_event event = {};
+  event.events = events;
+  event.data.fd = fd;
+
+  if (epoll_ctl(poller, EPOLL_CTL_ADD, fd, &event) == -1) {
+    error = std::strerror(errno);
+
+    return false;
+  }
+
+  return true;
+}
+
+void UnwatchDescriptor(PollerHandle poller, int fd) {
+  epoll_ctl(poller, EPOLL_CTL_DEL, fd, nullptr);
+}
+
+/** Waits up to timeout_ms (-1 for no limit) until one of the watched
+ *  descriptors is ready. An interrupted wait returns without events. */
+bool WaitForEvents(PollerHandle poller, int timeout_ms, std::vector<PollEvent>& events /*OUT*/,
+  std::string& error /*OUT*/) {
+  struct epoll_event ready[64];
+  events.clear();
+
+  const int count = epoll_wait(poller, ready, 64, timeout_ms);
+  if (count == -1) {
+    if (errno == EINTR) {
+      return true;
+    }
+    error = std::strerror(errno);
+
+    return false;
+  }
+
+  for (int i = 0; i < count; i++) {
+    events.push_back({ready[i].data.fd, ready[i].events});
+  }
+
+  return true;
+}
+
+/** Creates a descriptor that becomes readable once SignalWakeup was called
+ *  on it, from any thread, and stays so until ClearWakeup. */
+int CreateWakeup(std::string& error /*OUT*/) {
+  const int fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (fd == -1) {
+    error = std::strerror(errno);
+  }
+
+  return fd;
+}
+
+void SignalWakeup(int fd) {
+  const uint64_t one = 1;
+  // Fails only if the counter would overflow, in which case it is readable anyway
+  [[maybe_unused]] auto written = write(fd, &one, sizeof(one));
+}
+
+void ClearWakeup(int fd) {
+  uint64_t count;
+  [[maybe_unused]] auto read_bytes = read(fd, &count, sizeof(count));
+}
+
+/** Opens path for reading, or for writing after creating or truncating it.
+ *  The descriptor is not inherited by children unless handed to them. */
+int OpenDescriptor(const char* path, bool writable, std::string& error /*OUT*/) {
+  const auto flags = O_CLOEXEC | (writable ? O_WRONLY | O_CREAT | O_TRUNC : O_RDONLY);
+  const int fd = open(path, flags, 0666);
+  if (fd == -1) {
+    error = std::strerror(errno);
+  }
+
+  return fd;
+}
+
+/** Creates a pipe whose ends are not inherited by children unless handed to them. */
+bool CreatePipe(int& read_fd /*OUT*/, int& write_fd /*OUT*/, std::string& error /*OUT*/) {
+  int fds[2];
+  if (pipe2(fds, O_CLOEXEC) == -1) {
+    error = std::strerror(errno);
+
+    return false;
+  }
+
+  read_fd = fds[0];
+  write_fd = fds[1];
+
+  return true;
+}
+
+void SetNonBlocking(int fd) {
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+/** Reads what is available without blocking. Returns the number of bytes
+ *  read, 0 at the end of the stream and -1 if nothing is available right now. */
+long ReadAvailable(int fd, char* buffer, size_t length) {
+  while (true) {
+    const auto result = read(fd, buffer, length);
+    if (result >= 0) {
+      return static_cast<long>(result);
+    }
+    if (errno == EINTR) {
+      continue;
+    }
+
+    // Errors other than EAGAIN end the stream as well
+    return errno == EAGAIN || errno == EWOULDBLOCK ? -1 : 0;
+  }
+}
+
+/** Writes as much of buffer as a non-blocking fd takes right now. Returns the
+ *  number of bytes written, 0 if the fd is full and -1 once its reader is gone.
+ *  SIGPIPE is held back while writing, so a closed pipe doesn't end the shell. */
+long WriteAvailable(int fd, const char* buffer, size_t length) {
+  sigset_t pipe_signal;
+  sigset_t previous;
+  sigemptyset(&pipe_signal);
+  sigaddset(&pipe_signal, SIGPIPE);
+  pthread_sigmask(SIG_BLOCK, &pipe_signal, &previous);
+
+  ssize_t result;
+  do {
+    result = write(fd, buffer, length);
+  } while (result == -1 && errno == EINTR);
+
+  const int write_error = errno;
+  // Consume the signal this write raised before unblocking it again. A write
+  // that was cut short by the reader leaving raises it without failing
+  sigset_t pending;
+  sigpending(&pending);
+  if (sigismember(&pending, SIGPIPE)) {
+    const timespec no_wait = {0, 0};
+    sigtimedwait(&pipe_signal, nullptr, &no_wait);
+  }
+  pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+
+  if (result >= 0) {
+    return static_cast<long>(result);
+  }
+
+  return write_error == EAGAIN || write_error == EWOULDBLOCK ? 0 : -1;
+}
+
+void CloseDescriptor(int fd) {
+  if (fd != -1) {
+    close(fd);
+  }
+}
+
+/** Starts command with args without waiting for it. Depending on options
+ *  the child's output is captured through non-blocking pipes. */
+bool SpawnChildProcess(const std::string& command, const std::vector<std::string>& args,
+  const SpawnOptions& options, ChildProcess& child /*OUT*/, std::string& error /*OUT*/) {
+  child = ChildProcess();
+
+  int stdout_pipe[2] = {-1, -1};
+  int stderr_pipe[2] = {-1, -1};
+  auto close_pipes = [&] {
+    for (auto fd : {stdout_pipe[0], stdout_pipe[1], stderr_pipe[0], stderr_pipe[1]}) {
+      CloseDescriptor(fd);
+    }
+  };
+
+  const bool capture_stdout = options.capture_stdout && options.stdout_fd == -1;
+  if ((capture_stdout && pipe2(stdout_pipe, O_CLOEXEC) == -1) ||
+      (options.capture_stderr && pipe2(stderr_pipe, O_CLOEXEC) == -1)) {
+    error = std::strerror(errno);
+    close_pipes();
+
+    return false;
+  }
+
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  if (options.stdin_fd != -1) {
+    posix_spawn_file_actions_adddup2(&actions, options.stdin_fd, STDIN_FILENO);
+  } else if (options.null_stdin) {
+    posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+  }
+  // dup2 clears O_CLOEXEC on the child's copy
+  if (options.stdout_fd != -1) {
+    posix_spawn_file_actions_adddup2(&actions, options.stdout_fd, STDOUT_FILENO);
+  } else if (options.capture_stdout) {
+    posix_spawn_file_actions_adddup2(&actions, stdout_pipe[1], STDOUT_FILENO);
+  }
+  if (options.capture_stderr) {
+    posix_spawn_file_actions_adddup2(&actions, stderr_pipe[1], STDERR_FILENO);
+  }
+  if (!options.cwd.empty()) {
+    posix_spawn_file_actions_addchdir_np(&actions, options.cwd.c_str());
+  }
+
+  // Overrides replace inherited entries of the same name
+  std::vector<const char*> envp;
+  for (char** entry = environ; *entry != nullptr; entry++) {
+    const auto name_length = strcspn(*entry, "=");
+    const bool overridden = std::any_of(options.env.begin(), options.env.end(),
+      [&](const std::string& added) {
+        return added.compare(0, name_length + 1, *entry, name_length + 1) == 0;
+      });
+    if (!overridden) {
+      envp.push_back(*entry);
+    }
+  }
+  for (const auto& added : options.env) {
+    envp.push_back(added.c_str());
+  }
+  envp.push_back(nullptr);
+
+  auto argv = BuildArgv(command, args);
+  pid_t pid;
+  const int status = posix_spawnp(&pid, command.c_str(), &actions, nullptr,
+    const_cast<char**>(argv.data()), const_cast<char**>(envp.data()));
+  posix_spawn_file_actions_destroy(&actions);
+
+  // The write ends belong to the child now
+  CloseDescriptor(stdout_pipe[1]);
+  CloseDescriptor(stderr_pipe[1]);
+  stdout_pipe[1] = stderr_pipe[1] = -1;
+
+  if (status != 0) {
+    error = std::strerror(status);
+    close_pipes();
+
+    return false;
+  }
+
+  child.pid = pid;
+  child.stdout_fd = stdout_pipe[0];
+  child.stderr_fd = stderr_pipe[0];
+  for (auto fd : {child.stdout_fd, child.stderr_fd}) {
+    if (fd != -1) {
+      fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    }
+  }
+
+#ifdef SYS_pidfd_open
+  child.pidfd = static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+  if (child.pidfd != -1) {
+    fcntl(child.pidfd, F_SETFD, FD_CLOEXEC);
+  }
+#endif
+
+  return true;
+}
+
+/** Collects the exit status of child. Without block, returns false while
+ *  the child is still running. */
+bool ReapChildProcess(ChildProcess& child, bool block, ChildExit& exit /*OUT*/) {
+  int status = 0;
+  struct rusage usage = {};
+
+  pid_t result;
+  do {
+    result = wait4(child.pid, &status, block ? 0 : WNOHANG, &usage);
+  } while (result == -1 && errno == EINTR);
+
+  if (result == 0) {
+    return false;
+  }
+
+  exit = ChildExit();
+  if (result == -1) {
+    // Already reaped elsewhere, nothing more to learn about it
+    exit.code = -1;
+  } else if (WIFSIGNALED(status)) {
+    exit.code = -1;
+    const char* abbreviation = sigabbrev_np(WTERMSIG(status));
+    exit.signal = abbreviation != nullptr
+      ? std::string("SIG") + abbreviation : std::to_string(WTERMSIG(status));
+  } else {
+    exit.code = WEXITSTATUS(status);
+  }
+
+  exit.user_time_ms = static_cast<double>(usage.ru_utime.tv_sec) * 1000.0 +
+                      static_cast<double>(usage.ru_utime.tv_usec) / 1000.0;
+  exit.system_time_ms = static_cast<double>(usage.ru_stime.tv_sec) * 1000.0 +
+                        static_cast<double>(usage.ru_stime.tv_usec) / 1000.0;
+  exit.max_rss_kb = usage.ru_maxrss;
+  child.pid = -1;
+
+  return true;
+}
+
+/** Asks child to terminate, or kills it right away if force is set. */
+void TerminateChildProcess(const ChildProcess& child, bool force) {
+  if (child.pid > 0) {
+    kill(child.pid, force ? SIGKILL : SIGTERM);
+  }
+}
+
+/** Closes the descriptors held for child, the process itself is not touched. */
+void CloseChildProcess(ChildProcess& child) {
+  CloseDescriptor(child.pidfd);
+  CloseDescriptor(child.stdout_fd);
+  CloseDescriptor(child.stderr_fd);
+  child.pidfd = child.stdout_fd = child.stderr_fd = -1;
+}
+
+/** Maps length bytes of a file starting at offset into memory, length 0 maps
+ *  until the end of the file. Writable mappings are private copy-on-write views,
+ *  so changes never reach the file. */
+bool MapFile(const char* path, uint64_t offset, uint64_t length, bool writable,
+  MappedFile& file /*OUT*/, std::string& error /*OUT*/) {
+  file = MappedFile();
+
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    error = std::strerror(errno);
+
+    return false;
+  }
+
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) == -1) {
+    error = std::strerror(errno);
+    close(fd);
+
+    return false;
+  }
+
+  const auto file_size = static_cast<uint64_t>(file_stat.st_size);
+  if (offset > file_size) {
+    error = "Offset is beyond the end of the file";
+    close(fd);
+
+    return false;
+  }
+
+  if (length == 0 || length > file_size - offset) {
+    length = file_size - offset;
+  }
+
+  // Nothing to map, e.g. empty files
+  if (length == 0) {
+    close(fd);
+
+    return true;
+  }
+
+  // mmap offsets must be page aligned
+  const auto page_size = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+  const auto aligned_offset = offset - offset % page_size;
+  const auto mapping_size = static_cast<size_t>(length + offset - aligned_offset);
+
+  const auto protection = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+  void* mapping = mmap(nullptr, mapping_size, protection, MAP_PRIVATE, fd,
+    static_cast<off_t>(aligned_offset));
+  close(fd);
+
+  if (mapping == MAP_FAILED) {
+    error = std::strerror(errno);
+
+    return false;
+  }
+
+  file.mapping = mapping;
+  file.mapping_size = mapping_size;
+  file.data = static_cast<char*>(mapping) + (offset - aligned_offset);
+  file.size = static_cast<size_t>(length);
+
+  return true;
+}
+
+/** Releases a mapping created by MapFile. */
+void UnmapFile(MappedFile& file) {
+  if (file.mapping != nullptr) {
+    munmap(file.mapping, file.mapping_size);
+  }
+
+  file = MappedFile();
+}
+
+size_t MemoryPageSize() {
+  static const auto page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+  return page_size;
+}
+
+uint64_t PhysicalMemorySize() {
+  return static_cast<uint64_t>(sysconf(_SC_PHYS_PAGES)) * MemoryPageSize();
+}
+
+/** Maps size bytes of zeroed anonymous memory, size has to be a multiple of
+ *  the page size. */
+void* MapMemory(size_t size, std::string& error /*OUT*/) {
+  auto* address = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (address == MAP_FAILED) {
+    error = std::strerror(errno);
+
+    return nullptr;
+  }
+
+  return address;
+}
+
+void UnmapMemory(void* address, size_t size) { munmap(address, size); }
+
+/** Gives the physical pages of a mapping back to the system but keeps the
+ *  address range, it reads as zeros afterwards. */
+void DiscardMemory(void* address, size_t size) { madvise(address, size, MADV_DONTNEED); }
+
+/** Opens a file for writing, creating it if needed. The file is truncated
+ *  unless append is set. */
+FileHandle OpenFileForWriting(const char* path, bool append, std::string& error /*OUT*/) {
+  const auto flags = O_WRONLY | O_CREAT | O_CLOEXEC | (append ? O_APPEND : O_TRUNC);
+  FileHandle file = open(path, flags, 0666);
+
+  if (file == kInvalidFileHandle) {
+    error = std::strerror(errno);
+  }
+
+  return file;
+}
+
+/** Writes all buffers in order with as few writev calls as possible. */
+bool WriteFileBuffers(FileHandle file, std::vector<WriteBuffer> buffers,
+  std::string& error /*OUT*/) {
+  std::vector<iovec> vectors;
+  vectors.reserve(buffers.size());
+  for (auto& buffer : buffers) {
+    if (buffer.size != 0) {
+      vectors.push_back({const_cast<char*>(buffer.data), buffer.size});
+    }
+  }
+
+  size_t first = 0;
+  while (first < vectors.size()) {
+    const auto count = std::min(vectors.size() - first, static_cast<size_t>(IOV_MAX));
+    auto written = writev(file, &vectors[first], static_cast<int>(count));
+
+    if (written == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      error = std::strerror(errno);
+
+      return false;
+    }
+
+    // Skip fully written buffers and advance into a partially written one
+    while (first < vectors.size() && static_cast<size_t>(written) >= vectors[first].iov_len) {
+      written -= vectors[first].iov_len;
+      first++;
+    }
+    if (first < vectors.size()) {
+      vectors[first].iov_base = static_cast<char*>(vectors[first].iov_base) + written;
+      vectors[first].iov_len -= written;
+    }
+  }
+
+  return true;
+}
+
+/** Reads exactly length bytes of a file starting at offset into buffer. */
+bool ReadFileInto(const char* path, uint64_t offset, char* buffer, size_t length,
+  std::string& error /*OUT*/) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    error = std::strerror(errno);
+
+    return false;
+  }
+
+  size_t total = 0;
+  while (total < length) {
+    auto bytes_read = pread(fd, buffer + total, length - total,
+      static_cast<off_t>(offset + total));
+
+    if (bytes_read == -1 && errno == EINTR) {
+      continue;
+    }
+    if (bytes_read <= 0) {
+      error = bytes_read == 0 ? "Unexpected end of file" : std::strerror(errno);
+      close(fd);
+
+      return false;
+    }
+    total += static_cast<size_t>(bytes_read);
+  }
+
+  close(fd);
+  return true;
+}
+
+/** Closes a file opened by OpenFileForWriting. */
+void CloseFile(FileHandle file) {
+  if (file != kInvalidFileHandle) {
+    close(file);
+  }
+}
+
+/** Creates a uniquely named file next to target_path, to be renamed over it
+ *  once it is complete. The file gets the permissions the target has, or would
+ *  get if it was newly created. */
+FileHandle CreateTempFileFor(const char* target_path, std::string& temp_path /*OUT*/,
+  std::string& error /*OUT*/) {
+  // Unlike mkostemp, which creates files with 0600, this lets the kernel
+  // apply the umask. Reading the umask would mean setting it process-wide.
+  thread_local std::mt19937_64 random(std::random_device{}());
+  const char kLetters[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+
+  FileHandle file = kInvalidFileHandle;
+  errno = EEXIST;
+  for (int attempt = 0; attempt < 100 && file == kInvalidFileHandle && errno == EEXIST; attempt++) {
+    temp_path = target_path;
+    temp_path += ".tmp-";
+    for (int i = 0; i < 6; i++) {
+      temp_path += kLetters[random() % (sizeof(kLetters) - 1)];
+    }
+
+    file = open(temp_path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+  }
+
+  if (file == kInvalidFileHandle) {
+    error = std::strerror(errno);
+
+    return file;
+  }
+
+  struct stat target_stat;
+  if (stat(target_path, &target_stat) == 0) {
+    fchmod(file, target_stat.st_mode & 07777);
+  }
+
+  return file;
+}
+
+/** Flushes a file's contents to the storage device. */
+bool SyncFile(FileHandle file, std::string& error /*OUT*/) {
+  if (fdatasync(file) == -1) {
+    error = std::strerror(errno);
+
+    return false;
+  }
+
+  return true;
+}
+
+/** Renames from to to, atomically replacing to if it exists. */
+bool RenameFileOver(const char* from, const char* to, std::string& error /*OUT*/) {
+  if (rename(from, to) == -1) {
+    error = std::strerror(errno);
+
+    return false;
+  }
+
+  return true;
+}
+
+/** Lists the entries of a directory. Symlinks are followed to tell whether
+ *  they point to a directory. Size and mtime are only filled in with_stats,
+ *  as they cost an extra fstatat per entry. */
+bool ListDirectory(const char* path, bool with_stats, std::vector<DirectoryEntry>& entries /*OUT*/,
+  std::string& error /*OUT*/) {
+  DIR* directory = opendir(path);
+  if (directory == nullptr) {
+    error = std::strerror(errno);
+
+    return false;
+  }
+
+  const int directory_fd = dirfd(directory);
+
+  while (auto* dir_entry = readdir(directory)) {
+    const char* name = dir_entry->d_name;
+    if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
+      continue;
+    }
+
+    DirectoryEntry entry = {name, dir_entry->d_type == DT_DIR, 0, 0};
+    const auto type_known = dir_entry->d_type != DT_UNKNOWN && dir_entry->d_type != DT_LNK;
+
+    if (with_stats || !type_known) {
+      struct stat entry_stat;
+      // Broken symlinks are reported as what they are
+      if (fstatat(directory_fd, name, &entry_stat, 0) == 0 ||
+          fstatat(directory_fd, name, &entry_stat, AT_SYMLINK_NOFOLLOW) == 0) {
+        entry.is_directory = S_ISDIR(entry_stat.st_mode);
+        entry.size = entry.is_directory ? 0 : static_cast<uint64_t>(entry_stat.st_size);
+        entry.mtime = static_cast<double>(entry_stat.st_mtim.tv_sec) * 1000.0 +
+                      static_cast<double>(entry_stat.st_mtim.tv_nsec) / 1e6;
+      }
+    }
+
+    entries.push_back(std::move(entry));
+  }
+
+  closedir(directory);
+  return true;
+}
+
+/** Gets type, size, modification time and permissions of path, of the link
+ *  itself unless follow_symlinks is set. */
+bool StatPath(const char* path, bool follow_symlinks, PathStat& stat /*OUT*/,
+  std::string& error /*OUT*/) {
+  struct stat path_stat;
+  if ((follow_symlinks ? ::stat(path, &path_stat) : lstat(path, &path_stat)) != 0) {
+    error = std::strerror(errno);
+
+    return false;
+  }
+
+  stat.type = S_ISREG(path_stat.st_mode)   ? WalkEntryType::kFile
+              : S_ISDIR(path_stat.st_mode) ? WalkEntryType::kDirectory
+              : S_ISLNK(path_stat.st_mode) ? WalkEntryType::kSymlink
+                                           : WalkEntryType::kOther;
+  stat.size = static_cast<uint64_t>(path_stat.st_size);
+  stat.mtime = static_cast<double>(path_stat.st_mtim.tv_sec) * 1000.0 +
+               static_cast<double>(path_stat.st_mtim.tv_nsec) / 1e6;
+  stat.mode = static_cast<uint32_t>(path_stat.st_mode & 07777);
+
+  return true;
+}
+
 };
@@ -0,0 +1,830 @@
+#include "V8SLinuxApi.h"
+#include "ThreadPool.h"
+
+#include <fnmatch.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+
+#include <memory>
+#include <mutex>
+#include <set>
+#include <utility>
+
+namespace Commands {
+
+namespace {
+
+// Record layout returned by the getdents64 syscall
+struct LinuxDirent64 {
+  ino64_t d_ino;
+  off64_t d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[];
+};
+
+constexpr size_t kDirentBufferSize = 64 * 1024;
+
+// A directory descriptor shared by the tasks scanning its subdirectories,
+// closed once the last of them finished
+struct DirectoryFd {
+  explicit DirectoryFd(int fd) : fd(fd) {}
+  ~DirectoryFd() { close(fd); }
+
+  const int fd;
+};
+
+bool MatchesAny(const std::vector<std::string>& patterns, const char* name,
+    const std::string& relative_path) {
+  for (const auto& pattern : patterns) {
+    const char* subject = pattern.find('/') == std::string::npos
+      ? name : relative_path.c_str();
+    if (fnmatch(pattern.c_str(), subject, 0) == 0) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+double ToMilliseconds(const struct timespec& time) {
+  return static_cast<double>(time.tv_sec) * 1000.0 +
+         static_cast<double>(time.tv_nsec) / 1e6;
+}
+
+WalkEntryType TypeFromMode(mode_t mode) {
+  if (S_ISREG(mode)) {
+    return WalkEntryType::kFile;
+  }
+  if (S_ISDIR(mode)) {
+    return WalkEntryType::kDirectory;
+  }
+  if (S_ISLNK(mode)) {
+    return WalkEntryType::kSymlink;
+  }
+
+  return WalkEntryType::kOther;
+}
+
+class TreeWalker {
+ public:
+  TreeWalker(const WalkOptions& options, const WalkSink& sink)
+    : options_(options), sink_(sink), pool_(options.threads) {}
+
+  void Run(int root_fd, WalkResult& result /*OUT*/) {
+    auto root = std::make_shared<DirectoryFd>(root_fd);
+    if (options_.follow_symlinks) {
+      RememberDirectory(root_fd);
+    }
+
+    pool_.Submit([this, root] { ScanDirectory(root, std::string(), 0); });
+    pool_.Wait();
+
+    result.entries = entries_;
+    result.directories = directories_;
+    result.errors = errors_;
+    result.first_error = first_error_;
+  }
+
+ private:
+  bool Cancelled() const {
+    return options_.cancel != nullptr && options_.cancel->load(std::memory_order_relaxed);
+  }
+
+  void RecordError(const std::string& relative_path, int error_number) {
+    std::lock_guard<std::mutex> lock(error_mutex_);
+    if (errors_++ == 0) {
+      first_error_ = (relative_path.empty() ? std::string(".") : relative_path) + ": " +
+                     std::strerror(error_number);
+    }
+  }
+
+  // Returns false if the directory was seen before, which only happens through symlink cycles
+  bool RememberDirectory(int fd) {
+    struct stat directory_stat;
+    if (fstat(fd, &directory_stat) != 0) {
+      return true;
+    }
+
+    std::lock_guard<std::mutex> lock(visited_mutex_);
+    return visited_.emplace(directory_stat.st_dev, directory_stat.st_ino).second;
+  }
+
+  void OpenAndScan(const std::shared_ptr<DirectoryFd>& parent, const std::string& name,
+      const std::string& relative_path, int depth) {
+    if (Cancelled()) {
+      return;
+    }
+
+    const int flags = O_RDONLY | O_DIRECTORY | O_CLOEXEC |
+                      (options_.follow_symlinks ? 0 : O_NOFOLLOW);
+    const int fd = openat(parent->fd, name.c_str(), flags);
+    if (fd < 0) {
+      RecordError(relative_path, errno);
+      return;
+    }
+
+    if (options_.follow_symlinks && !RememberDirectory(fd)) {
+      close(fd);
+      return;
+    }
+
+    ScanDirectory(std::make_shared<DirectoryFd>(fd), relative_path, depth);
+  }
+
+  void ScanDirectory(const std::shared_ptr<DirectoryFd>& directory,
+      const std::string& relative_path, int depth) {
+    directories_++;
+
+    thread_local std::unique_ptr<char[]> buffer(new char[kDirentBufferSize]);
+    std::vector<WalkEntry> batch;
+    const int child_depth = depth + 1;
+    const bool report_children = options_.max_depth < 0 || child_depth <= options_.max_depth;
+    const bool descend = options_.max_depth < 0 || child_depth < options_.max_depth;
+
+    while (true) {
+      const auto read = syscall(SYS_getdents64, directory->fd, buffer.get(), kDirentBufferSize);
+      if (read < 0) {
+        RecordError(relative_path, errno);
+        break;
+      }
+      if (read == 0) {
+        break;
+      }
+
+      for (long offset = 0; offset < read;) {
+        auto* dirent = reinterpret_cast<LinuxDirent64*>(buffer.get() + offset);
+        offset += dirent->d_reclen;
+
+        const char* name = dirent->d_name;
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+          continue;
+        }
+
+        auto child_path = relative_path.empty()
+          ? std::string(name) : relative_path + '/' + name;
+        if (!options_.exclude.empty() && MatchesAny(options_.exclude, name, child_path)) {
+          continue;
+        }
+
+        WalkEntry entry;
+        switch (dirent->d_type) {
+          case DT_REG: entry.type = WalkEntryType::kFile; break;
+          case DT_DIR: entry.type = WalkEntryType::kDirectory; break;
+          case DT_LNK: entry.type = WalkEntryType::kSymlink; break;
+          default: entry.type = WalkEntryType::kOther; break;
+        }
+
+        // Only stat when the type is unknown, a link has to be resolved or stats were asked for
+        const bool resolve_link = options_.follow_symlinks && dirent->d_type == DT_LNK;
+        if (dirent->d_type == DT_UNKNOWN || resolve_link || options_.stats) {
+          struct stat entry_stat;
+          const int flags = options_.follow_symlinks ? 0 : AT_SYMLINK_NOFOLLOW;
+          // Broken symlinks are reported as what they are
+          if (fstatat(directory->fd, name, &entry_stat, flags) == 0 ||
+              (flags == 0 &&
+               fstatat(directory->fd, name, &entry_stat, AT_SYMLINK_NOFOLLOW) == 0)) {
+            entry.type = TypeFromMode(entry_stat.st_mode);
+            if (entry.type != WalkEntryType::kDirectory) {
+              entry.size = static_cast<uint64_t>(entry_stat.st_size);
+            }
+            entry.mtime = ToMilliseconds(entry_stat.st_mtim);
+          }
+        }
+
+        const bool is_directory = entry.type == WalkEntryType::kDirectory;
+        if (is_directory && descend) {
+          pool_.Submit([this, directory, child_name = std::string(name), child_path,
+              child_depth] {
+            OpenAndScan(directory, child_name, child_path, child_depth);
+          });
+        }
+
+        if (report_children &&
+            (options_.include.empty() || MatchesAny(options_.include, name, child_path))) {
+          entry.path = std::move(child_path);
+          batch.push_back(std::move(entry));
+
+          if (batch.size() >= options_.batch_size) {
+            Flush(batch);
+          }
+        }
+      }
+    }
+
+    Flush(batch);
+  }
+
+  void Flush(std::vector<WalkEntry>& batch) {
+    if (batch.empty()) {
+      return;
+    }
+
+    entries_ += batch.size();
+    sink_(batch);
+    batch.clear();
+  }
+
+  const WalkOptions& options_;
+  const WalkSink& sink_;
+  WorkStealingPool pool_;
+  std::atomic<uint64_t> entries_{0};
+  std::atomic<uint64_t> directories_{0};
+  std::mutex error_mutex_;
+  uint64_t errors_ = 0;
+  std::string first_error_;
+  std::mutex visited_mutex_;
+  std::set<std::pair<dev_t, ino_t>> visited_;
+};
+
+};
+
+bool WalkTree(const char* root, const WalkOptions& options, const WalkSink& sink,
+    WalkResult& result /*OUT*/, std::string& error /*OUT*/) {
+  const int root_fd = open(root, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (root_fd < 0) {
+    error = std::strerror(errno);
+
+    return false;
+  }
+
+  auto walk_options = options;
+  if (walk_options.batch_size == 0) {
+    walk_options.batch_size = 1;
+  }
+
+  TreeWalker walker(walk_options, sink);
+  walker.Run(root_fd, result);
+
+  return true;
+}
+
+namespace {
+
+// Largest amount handed to a single copy_file_range/sendfile call
+constexpr size_t kCopyChunkSize = 1 << 30;
+constexpr size_t kCopyBufferSize = 256 * 1024;
+
+enum class CopyStatus { kDone, kUnsupported, kFailed };
+
+// Copies the remaining content of in to out through the kernel, reports kUnsupported
+// if nothing was copied because the files don't support copy_file_range
+CopyStatus CopyFileRange(int in, int out, uint64_t& copied /*OUT*/) {
+  while (true) {
+    const auto written = copy_file_range(in, nullptr, out, nullptr, kCopyChunkSize, 0);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (copied == 0 && (errno == ENOSYS || errno == EXDEV || errno == EINVAL ||
+                          errno == EOPNOTSUPP)) {
+        return CopyStatus::kUnsupported;
+      }
+      return CopyStatus::kFailed;
+    }
+    if (written == 0) {
+      return CopyStatus::kDone;
+    }
+    copied += static_cast<uint64_t>(written);
+  }
+}
+
+CopyStatus SendFile(int in, int out, uint64_t& copied /*OUT*/) {
+  while (true) {
+    const auto written = sendfile(out, in, nullptr, kCopyChunkSize);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (copied == 0 && (errno == ENOSYS || errno == EINVAL)) {
+        return CopyStatus::kUnsupported;
+      }
+      return CopyStatus::kFailed;
+    }
+    if (written == 0) {
+      return CopyStatus::kDone;
+    }
+    copied += static_cast<uint64_t>(written);
+  }
+}
+
+CopyStatus ReadWrite(int in, int out, uint64_t& copied /*OUT*/) {
+  thread_local std::unique_ptr<char[]> buffer(new char[kCopyBufferSize]);
+
+  while (true) {
+    const auto read = ::read(in, buffer.get(), kCopyBufferSize);
+    if (read < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return CopyStatus::kFailed;
+    }
+    if (read == 0) {
+      return CopyStatus::kDone;
+    }
+
+    for (ssize_t done = 0; done < read;) {
+      const auto written = ::write(out, buffer.get() + done, static_cast<size_t>(read - done));
+      if (written < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return CopyStatus::kFailed;
+      }
+      done += written;
+    }
+    copied += static_cast<uint64_t>(read);
+  }
+}
+
+class TreeCopier;
+
+// A directory being copied. The last task referencing it restores the target's mode
+// and times, which has to happen after all its entries were written
+struct CopyDirectory {
+  CopyDirectory(TreeCopier* copier, int source, int target, const struct stat& source_stat,
+      std::shared_ptr<CopyDirectory> parent)
+    : copier(copier), source(source), target(target), source_stat(source_stat),
+      parent(std::move(parent)) {}
+  ~CopyDirectory();
+
+  TreeCopier* const copier;
+  const int source;
+  const int target;
+  const struct stat source_stat;
+  // Keeps the parent unfinished until this directory is done
+  const std::shared_ptr<CopyDirectory> parent;
+  std::string relative_path;
+};
+
+class TreeCopier {
+ public:
+  explicit TreeCopier(const CopyOptions& options)
+    : options_(options), reflink_(options.reflink), pool_(options.threads) {}
+
+  void Run(int source, int target, const struct stat& source_stat, CopyResult& result /*OUT*/) {
+    {
+      auto root = std::make_shared<CopyDirectory>(this, source, target, source_stat, nullptr);
+      pool_.Submit([this, root] { ScanDirectory(root); });
+    }
+    pool_.Wait();
+
+    Collect(result);
+  }
+
+  /** Copies one regular file, both names are relative to their directory fds. */
+  bool CopyRegularFile(int source_dir, const char* source_name, int target_dir, const char* target_name,
+      const struct stat& source_stat, const std::string& relative_path) {
+    const int in = openat(source_dir, source_name, O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+    if (in < 0) {
+      RecordError(relative_path, errno);
+      return false;
+    }
+    const int out = openat(target_dir, target_name, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                           S_IRUSR | S_IWUSR);
+    if (out < 0) {
+      RecordError(relative_path, errno);
+      close(in);
+      return false;
+    }
+
+    uint64_t copied = 0;
+    auto status = CopyStatus::kUnsupported;
+    if (reflink_.load(std::memory_order_relaxed)) {
+      if (ioctl(out, FICLONE, in) == 0) {
+        copied = static_cast<uint64_t>(source_stat.st_size);
+        status = CopyStatus::kDone;
+        reflinked_++;
+      } else if (errno == EOPNOTSUPP || errno == ENOTTY || errno == EXDEV || errno == EINVAL) {
+        // Same file systems on both sides for the whole copy, no use retrying
+        reflink_ = false;
+      }
+    }
+    if (status == CopyStatus::kUnsupported && copy_file_range_.load(std::memory_order_relaxed)) {
+      status = CopyFileRange(in, out, copied);
+      if (status == CopyStatus::kUnsupported) {
+        copy_file_range_ = false;
+      }
+    }
+    if (status == CopyStatus::kUnsupported) {
+      status = SendFile(in, out, copied);
+    }
+    if (status == CopyStatus::kUnsupported) {
+      status = ReadWrite(in, out, copied);
+    }
+
+    bool copied_ok = status == CopyStatus::kDone;
+    if (!copied_ok) {
+      RecordError(relative_path, errno);
+    } else {
+      const struct timespec times[2] = {source_stat.st_atim, source_stat.st_mtim};
+      if (fchmod(out, source_stat.st_mode & 07777) != 0 || futimens(out, times) != 0) {
+        RecordError(relative_path, errno);
+        copied_ok = false;
+      }
+    }
+
+    close(in);
+    close(out);
+
+    if (copied_ok) {
+      files_++;
+      bytes_ += copied;
+    }
+    return copied_ok;
+  }
+
+  void RecordError(const std::string& relative_path, int error_number) {
+    RecordError(relative_path, std::string(std::strerror(error_number)));
+  }
+
+  void RecordError(const std::string& relative_path, const std::string& message) {
+    std::lock_guard<std::mutex> lock(error_mutex_);
+    if (errors_++ == 0) {
+      first_error_ = (relative_path.empty() ? std::string(".") : relative_path) + ": " + message;
+    }
+  }
+
+  void Collect(CopyResult& result /*OUT*/) {
+    result.files = files_;
+    result.directories = directories_;
+    result.bytes = bytes_;
+    result.reflinked = reflinked_;
+    result.errors = errors_;
+    result.first_error = first_error_;
+  }
+
+ private:
+  void OpenAndScan(const std::shared_ptr<CopyDirectory>& parent, const std::string& name,
+      const struct stat& source_stat, std::string relative_path) {
+    const int flags = O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC;
+    const int source = openat(parent->source, name.c_str(), flags);
+    const int target = source < 0 ? -1 : openat(parent->target, name.c_str(), flags);
+    if (target < 0) {
+      RecordError(relative_path, errno);
+      if (source >= 0) {
+        close(source);
+      }
+      return;
+    }
+
+    auto directory = std::make_shared<CopyDirectory>(this, source, target, source_stat, parent);
+    directory->relative_path = std::move(relative_path);
+    ScanDirectory(directory);
+  }
+
+  void ScanDirectory(const std::shared_ptr<CopyDirectory>& directory) {
+    directories_++;
+
+    thread_local std::unique_ptr<char[]> buffer(new char[kDirentBufferSize]);
+    const auto& relative_path = directory->relative_path;
+
+    while (true) {
+      const auto read = syscall(SYS_getdents64, directory->source, buffer.get(),
+                                kDirentBufferSize);
+      if (read < 0) {
+        RecordError(relative_path, errno);
+        break;
+      }
+      if (read == 0) {
+        break;
+      }
+
+      for (long offset = 0; offset < read;) {
+        auto* dirent = reinterpret_cast<LinuxDirent64*>(buffer.get() + offset);
+        offset += dirent->d_reclen;
+
+        const char* name = dirent->d_name;
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+          continue;
+        }
+
+        auto child_path = relative_path.empty()
+          ? std::string(name) : relative_path + '/' + name;
+        struct stat entry_stat;
+        if (fstatat(directory->source, name, &entry_stat, AT_SYMLINK_NOFOLLOW) != 0) {
+          RecordError(child_path, errno);
+          continue;
+        }
+
+        if (S_ISDIR(entry_stat.st_mode)) {
+          // Writable until its mode is restored once its content is copied
+          if (mkdirat(directory->target, name, S_IRWXU) != 0 && errno != EEXIST) {
+            RecordError(child_path, errno);
+            continue;
+          }
+
+          // Opened by the task, so queued directories hold no descriptors
+          pool_.Submit([this, directory, child_name = std::string(name), entry_stat, child_path] {
+            OpenAndScan(directory, child_name, entry_stat, child_path);
+          });
+        } else if (S_ISREG(entry_stat.st_mode)) {
+          pool_.Submit([this, directory, file_name = std::string(name), entry_stat, child_path] {
+            CopyRegularFile(directory->source, file_name.c_str(), directory->target, file_name.c_str(),
+                     entry_stat, child_path);
+          });
+        } else if (S_ISLNK(entry_stat.st_mode)) {
+          CopySymlink(*directory, name, entry_stat, child_path);
+        } else {
+          RecordError(child_path, "Unsupported file type");
+        }
+      }
+    }
+  }
+
+  void CopySymlink(const CopyDirectory& directory, const char* name,
+      const struct stat& link_stat, const std::string& relative_path) {
+    std::string link_target(static_cast<size_t>(link_stat.st_size) + 1, '\0');
+    const auto length = readlinkat(directory.source, name, link_target.data(), link_target.size());
+    if (length < 0) {
+      RecordError(relative_path, errno);
+      return;
+    }
+    link_target.resize(static_cast<size_t>(length));
+
+    if (symlinkat(link_target.c_str(), directory.target, name) != 0) {
+      if (errno != EEXIST || unlinkat(directory.target, name, 0) != 0 ||
+          symlinkat(link_target.c_str(), directory.target, name) != 0) {
+        RecordError(relative_path, errno);
+        return;
+      }
+    }
+
+    const struct timespec times[2] = {link_stat.st_atim, link_stat.st_mtim};
+    utimensat(directory.target, name, times, AT_SYMLINK_NOFOLLOW);
+    files_++;
+  }
+
+  const CopyOptions& options_;
+  std::atomic<bool> reflink_;
+  std::atomic<bool> copy_file_range_{true};
+  WorkStealingPool pool_;
+  std::atomic<uint64_t> files_{0};
+  std::atomic<uint64_t> directories_{0};
+  std::atomic<uint64_t> bytes_{0};
+  std::atomic<uint64_t> reflinked_{0};
+  std::mutex error_mutex_;
+  uint64_t errors_ = 0;
+  std::string first_error_;
+};
+
+CopyDirectory::~CopyDirectory() {
+  const struct timespec times[2] = {source_stat.st_atim, source_stat.st_mtim};
+  if (fchmod(target, source_stat.st_mode & 07777) != 0 || futimens(target, times) != 0) {
+    copier->RecordError(relative_path, errno);
+  }
+
+  close(source);
+  close(target);
+}
+
+};
+
+bool CopyTree(const char* from, const char* to, const CopyOptions& options,
+    CopyResult& result /*OUT*/, std::string& error /*OUT*/) {
+  struct stat source_stat;
+  if (stat(from, &source_stat) != 0) {
+    error = std::strerror(errno);
+
+    return false;
+  }
+
+  if (S_ISREG(source_stat.st_mode)) {
+    auto single_file_options = options;
+    single_file_options.threads = 1;
+    TreeCopier copier(single_file_options);
+    if (!copier.CopyRegularFile(AT_FDCWD, from, AT_FDCWD, to, source_stat, to)) {
+      copier.Collect(result);
+      error = result.first_error;
+
+      return false;
+    }
+
+    copier.Collect(result);
+    return true;
+  }
+
+  if (!S_ISDIR(source_stat.st_mode)) {
+    error = "Unsupported file type";
+
+    return false;
+  }
+  if (!options.recursive) {
+    error = "Is a directory, pass recursive to copy it";
+
+    return false;
+  }
+
+  if (mkdir(to, S_IRWXU) != 0 && errno != EEXIST) {
+    error = std::strerror(errno);
+
+    return false;
+  }
+
+  const int flags = O_RDONLY | O_DIRECTORY | O_CLOEXEC;
+  const int source = open(from, flags);
+  const int target = source < 0 ? -1 : open(to, flags);
+  if (target < 0) {
+    error = std::strerror(errno);
+    if (source >= 0) {
+      close(source);
+    }
+
+    return false;
+  }
+
+  TreeCopier copier(options);
+  copier.Run(source, target, source_stat, result);
+
+  return true;
+}
+
+
+namespace {
+
+class TreeRemover;
+
+// A directory being emptied. The last task referencing it removes the directory
+// itself, which only succeeds once all its entries are gone
+struct RemoveDirectory {
+  RemoveDirectory(TreeRemover* remover, int fd, std::shared_ptr<RemoveDirectory> parent,
+      std::string name)
+    : remover(remover), fd(fd), parent(std::move(parent)), name(std::move(name)) {}
+  ~RemoveDirectory();
+
+  TreeRemover* const remover;
+  const int fd;
+  // Null for the root, which is removed by path
+  const std::shared_ptr<RemoveDirectory> parent;
+  const std::string name;
+  std::string relative_path;
+};
+
+class TreeRemover {
+ public:
+  explicit TreeRemover(const RemoveOptions& options) : pool_(options.threads) {}
+
+  void Run(int fd, RemoveResult& result /*OUT*/) {
+    {
+      auto root = std::make_shared<RemoveDirectory>(this, fd, nullptr, std::string());
+      pool_.Submit([this, root] { ScanDirectory(root); });
+    }
+    pool_.Wait();
+
+    result.files = files_;
+    result.directories = directories_;
+    result.bytes_freed = bytes_freed_;
+    result.errors = errors_;
+    result.first_error = first_error_;
+  }
+
+  void RemovedDirectory() { directories_++; }
+
+  void RecordError(const std::string& relative_path, int error_number) {
+    std::lock_guard<std::mutex> lock(error_mutex_);
+    if (errors_++ == 0) {
+      first_error_ = (relative_path.empty() ? std::string(".") : relative_path) + ": " +
+                     std::strerror(error_number);
+    }
+  }
+
+ private:
+  void OpenAndScan(const std::shared_ptr<RemoveDirectory>& parent, const std::string& name) {
+    const auto& parent_path = parent->relative_path;
+    auto relative_path = parent_path.empty() ? name : parent_path + '/' + name;
+    const int fd = openat(parent->fd, name.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0) {
+      RecordError(relative_path, errno);
+      return;
+    }
+
+    auto directory = std::make_shared<RemoveDirectory>(this, fd, parent, name);
+    directory->relative_path = std::move(relative_path);
+    ScanDirectory(directory);
+  }
+
+  void ScanDirectory(const std::shared_ptr<RemoveDirectory>& directory) {
+    thread_local std::unique_ptr<char[]> buffer(new char[kDirentBufferSize]);
+    const auto& relative_path = directory->relative_path;
+
+    while (true) {
+      const auto read = syscall(SYS_getdents64, directory->fd, buffer.get(), kDirentBufferSize);
+      if (read < 0) {
+        RecordError(relative_path, errno);
+        break;
+      }
+      if (read == 0) {
+        break;
+      }
+
+      for (long offset = 0; offset < read;) {
+        auto* dirent = reinterpret_cast<LinuxDirent64*>(buffer.get() + offset);
+        offset += dirent->d_reclen;
+
+        const char* name = dirent->d_name;
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+          continue;
+        }
+
+        struct stat entry_stat;
+        if (fstatat(directory->fd, name, &entry_stat, AT_SYMLINK_NOFOLLOW) != 0) {
+          RecordError(relative_path.empty() ? name : relative_path + '/' + name, errno);
+          continue;
+        }
+
+        if (S_ISDIR(entry_stat.st_mode)) {
+          // Opened by the task, so queued directories hold no descriptors
+          pool_.Submit([this, directory, child_name = std::string(name)] {
+            OpenAndScan(directory, child_name);
+          });
+          continue;
+        }
+
+        // Unlinks within one directory serialize on its inode lock anyway,
+        // so files are removed inline and only subdirectories fan out
+        if (unlinkat(directory->fd, name, 0) != 0) {
+          RecordError(relative_path.empty() ? name : relative_path + '/' + name, errno);
+          continue;
+        }
+
+        files_++;
+        if (entry_stat.st_nlink <= 1) {
+          bytes_freed_ += static_cast<uint64_t>(entry_stat.st_blocks) * 512;
+        }
+      }
+    }
+  }
+
+  WorkStealingPool pool_;
+  std::atomic<uint64_t> files_{0};
+  std::atomic<uint64_t> directories_{0};
+  std::atomic<uint64_t> bytes_freed_{0};
+  std::mutex error_mutex_;
+  uint64_t errors_ = 0;
+  std::string first_error_;
+};
+
+RemoveDirectory::~RemoveDirectory() {
+  close(fd);
+
+  if (parent == nullptr) {
+    return;
+  }
+  if (unlinkat(parent->fd, name.c_str(), AT_REMOVEDIR) != 0) {
+    remover->RecordError(relative_path, errno);
+    return;
+  }
+  remover->RemovedDirectory();
+}
+
+};
+
+bool RemoveTree(const char* path, const RemoveOptions& options, RemoveResult& result /*OUT*/,
+    std::string& error /*OUT*/) {
+  struct stat root_stat;
+  if (lstat(path, &root_stat) != 0) {
+    error = std::strerror(errno);
+
+    return false;
+  }
+
+  if (!S_ISDIR(root_stat.st_mode)) {
+    if (unlink(path) != 0) {
+      error = std::strerror(errno);
+
+      return false;
+    }
+
+    result.files = 1;
+    result.bytes_freed = root_stat.st_nlink <= 1
+      ? static_cast<uint64_t>(root_stat.st_blocks) * 512 : 0;
+    return true;
+  }
+
+  const int fd = open(path, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+  if (fd < 0) {
+    error = std::strerror(errno);
+
+    return false;
+  }
+
+  TreeRemover remover(options);
+  remover.Run(fd, result);
+
+  if (rmdir(path) != 0) {
+    // Entries that could not be removed already explain why the root is left over
+    if (result.errors == 0) {
+      error = std::strerror(errno);
+
+      return false;
+    }
+    return true;
+  }
+
+  result.directories++;
+  return true;
+}
+
+};
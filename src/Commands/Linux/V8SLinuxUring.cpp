@@ -0,0 +1,520 @@
+// This File contains the io_uring backend for batches of file system operations
+
+#include "V8SLinuxApi.h"
+
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+
+#include <memory>
+
+namespace Commands {
+
+namespace {
+
+// Operations in flight at once, every read holds a descriptor while it is
+constexpr unsigned int kRingEntries = 256;
+
+constexpr uint8_t kRequiredOps[] = {IORING_OP_STATX, IORING_OP_OPENAT, IORING_OP_READ,
+  IORING_OP_CLOSE, IORING_OP_UNLINKAT, IORING_OP_RENAMEAT, IORING_OP_MKDIRAT};
+
+/** A minimal io_uring: the submission and completion queues shared with the
+ *  kernel, used by a single thread. */
+class Ring {
+ public:
+  Ring() = default;
+  ~Ring() {
+    if (sqes_ != MAP_FAILED) {
+      munmap(sqes_, sqes_size_);
+    }
+    if (cq_ptr_ != MAP_FAILED && cq_ptr_ != sq_ptr_) {
+      munmap(cq_ptr_, cq_size_);
+    }
+    if (sq_ptr_ != MAP_FAILED) {
+      munmap(sq_ptr_, sq_size_);
+    }
+    if (fd_ != -1) {
+      close(fd_);
+    }
+  }
+
+  Ring(const Ring&) = delete;
+  Ring& operator=(const Ring&) = delete;
+
+  /** Sets up a ring and checks that the kernel knows all operations a batch
+   *  may use. Fails with the reason otherwise. */
+  bool Init(unsigned int entries, std::string& error /*OUT*/) {
+    io_uring_params params{};
+    fd_ = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if (fd_ == -1) {
+      error = std::strerror(errno);
+
+      return false;
+    }
+
+    sq_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    cq_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+      sq_size_ = cq_size_ = std::max(sq_size_, cq_size_);
+    }
+
+    sq_ptr_ = mmap(nullptr, sq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_,
+      IORING_OFF_SQ_RING);
+    if (sq_ptr_ == MAP_FAILED) {
+      error = std::strerror(errno);
+
+      return false;
+    }
+    cq_ptr_ = single_mmap ? sq_ptr_
+      : mmap(nullptr, cq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_,
+             IORING_OFF_CQ_RING);
+    if (cq_ptr_ == MAP_FAILED) {
+      error = std::strerror(errno);
+
+      return false;
+    }
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_,
+      IORING_OFF_SQES);
+    if (sqes_ == MAP_FAILED) {
+      error = std::strerror(errno);
+
+      return false;
+    }
+
+    auto* sq = static_cast<char*>(sq_ptr_);
+    sq_head_ = reinterpret_cast<unsigned int*>(sq + params.sq_off.head);
+    sq_tail_ = reinterpret_cast<unsigned int*>(sq + params.sq_off.tail);
+    sq_mask_ = *reinterpret_cast<unsigned int*>(sq + params.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<unsigned int*>(sq + params.sq_off.array);
+    sq_entries_ = params.sq_entries;
+    sqe_tail_ = *sq_tail_;
+
+    auto* cq = static_cast<char*>(cq_ptr_);
+    cq_head_ = reinterpret_cast<unsigned int*>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned int*>(cq + params.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<unsigned int*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    return SupportsRequiredOps(error);
+  }
+
+  /** Returns a cleared submission entry, or nullptr if the queue is full. */
+  io_uring_sqe* NextSqe() {
+    const auto head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+    if (sqe_tail_ - head >= sq_entries_) {
+      return nullptr;
+    }
+
+    const auto index = sqe_tail_ & sq_mask_;
+    auto* sqe = static_cast<io_uring_sqe*>(sqes_) + index;
+    std::memset(sqe, 0, sizeof(*sqe));
+    sq_array_[index] = index;
+    sqe_tail_++;
+    unsubmitted_++;
+
+    return sqe;
+  }
+
+  /** Hands all queued entries to the kernel and waits until at least one
+   *  operation completed. Returns false with the reason if the ring broke. */
+  bool SubmitAndWait(std::string& error /*OUT*/) {
+    __atomic_store_n(sq_tail_, sqe_tail_, __ATOMIC_RELEASE);
+
+    while (true) {
+      const auto submitted = syscall(__NR_io_uring_enter, fd_, unsubmitted_, 1,
+        IORING_ENTER_GETEVENTS, nullptr, 0);
+      if (submitted >= 0) {
+        unsubmitted_ -= static_cast<unsigned int>(submitted);
+        return true;
+      }
+      // Completions have to be reaped first, the caller comes back with them
+      if (errno == EAGAIN || errno == EBUSY) {
+        return true;
+      }
+      if (errno != EINTR) {
+        error = std::strerror(errno);
+
+        return false;
+      }
+    }
+  }
+
+  /** Calls on_completion(user_data, result) for every completed operation. */
+  template <typename Callback>
+  void Reap(Callback&& on_completion) {
+    auto head = *cq_head_;
+    const auto tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+
+    for (; head != tail; head++) {
+      const auto& cqe = cqes_[head & cq_mask_];
+      on_completion(cqe.user_data, cqe.res);
+    }
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+  }
+
+ private:
+  bool SupportsRequiredOps(std::string& error /*OUT*/) {
+    constexpr unsigned int kProbeOps = 256;
+    auto buffer = std::make_unique<char[]>(
+      sizeof(io_uring_probe) + kProbeOps * sizeof(io_uring_probe_op));
+    auto* probe = reinterpret_cast<io_uring_probe*>(buffer.get());
+
+    if (syscall(__NR_io_uring_register, fd_, IORING_REGISTER_PROBE, probe, kProbeOps) != 0) {
+      error = std::strerror(errno);
+
+      return false;
+    }
+
+    for (const auto op : kRequiredOps) {
+      if (op > probe->last_op || (probe->ops[op].flags & IO_URING_OP_SUPPORTED) == 0) {
+        error = "Kernel lacks io_uring operation " + std::to_string(op);
+
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  int fd_ = -1;
+  void* sq_ptr_ = MAP_FAILED;
+  void* cq_ptr_ = MAP_FAILED;
+  void* sqes_ = MAP_FAILED;
+  size_t sq_size_ = 0;
+  size_t cq_size_ = 0;
+  size_t sqes_size_ = 0;
+
+  unsigned int* sq_head_ = nullptr;
+  unsigned int* sq_tail_ = nullptr;
+  unsigned int* sq_array_ = nullptr;
+  unsigned int sq_mask_ = 0;
+  unsigned int sq_entries_ = 0;
+  // Local tail, published to the kernel on submission
+  unsigned int sqe_tail_ = 0;
+  unsigned int unsubmitted_ = 0;
+
+  unsigned int* cq_head_ = nullptr;
+  unsigned int* cq_tail_ = nullptr;
+  unsigned int cq_mask_ = 0;
+  io_uring_cqe* cqes_ = nullptr;
+};
+
+void FillPathStat(const struct statx& stx, PathStat& stat /*OUT*/) {
+  const auto mode = static_cast<mode_t>(stx.stx_mode);
+  stat.type = S_ISREG(mode)   ? WalkEntryType::kFile
+              : S_ISDIR(mode) ? WalkEntryType::kDirectory
+              : S_ISLNK(mode) ? WalkEntryType::kSymlink
+                              : WalkEntryType::kOther;
+  stat.size = stx.stx_size;
+  stat.mtime = static_cast<double>(stx.stx_mtime.tv_sec) * 1000.0 +
+               static_cast<double>(stx.stx_mtime.tv_nsec) / 1e6;
+  stat.mode = static_cast<uint32_t>(mode & 07777);
+}
+
+/** Drives the operations of a batch through a ring. Every operation has at
+ *  most one entry in flight, a read advances from statx over openat and
+ *  read to close, all others complete with their first entry. Operations
+ *  complete in whatever order the kernel finishes them, only the results
+ *  keep the order of ops. */
+class UringBatch {
+ public:
+  UringBatch(Ring& ring, const std::vector<BatchOp>& ops, std::vector<BatchOpResult>& results)
+    : ring_(ring), ops_(ops), results_(results), states_(ops.size()) {}
+
+  void Run() {
+    size_t next = 0;
+    std::string error;
+
+    while (true) {
+      while (next < ops_.size() && in_flight_ < kRingEntries) {
+        Start(next++);
+      }
+      if (in_flight_ == 0) {
+        return;
+      }
+
+      if (!ring_.SubmitAndWait(error)) {
+        Abandon(next, error);
+        return;
+      }
+      ring_.Reap([this](uint64_t index, int result) {
+        Continue(static_cast<size_t>(index), result);
+      });
+    }
+  }
+
+ private:
+  enum class Stage : uint8_t { kPending, kStat, kOpen, kRead, kClose, kDone };
+
+  struct OpState {
+    Stage stage = Stage::kPending;
+    int fd = -1;
+    size_t bytes_read = 0;
+    struct statx stx;
+  };
+
+  void Start(size_t index) {
+    const auto& op = ops_[index];
+    in_flight_++;
+
+    switch (op.type) {
+      case BatchOpType::kStat:
+      case BatchOpType::kRead:
+        QueueStatx(index, 0);
+        break;
+      case BatchOpType::kLstat:
+        QueueStatx(index, AT_SYMLINK_NOFOLLOW);
+        break;
+      case BatchOpType::kUnlink:
+      case BatchOpType::kRmdir: {
+        auto* sqe = Queue(index, IORING_OP_UNLINKAT);
+        sqe->fd = AT_FDCWD;
+        sqe->addr = reinterpret_cast<uint64_t>(op.path.c_str());
+        sqe->unlink_flags = op.type == BatchOpType::kRmdir ? AT_REMOVEDIR : 0;
+        break;
+      }
+      case BatchOpType::kRename: {
+        auto* sqe = Queue(index, IORING_OP_RENAMEAT);
+        sqe->fd = AT_FDCWD;
+        sqe->addr = reinterpret_cast<uint64_t>(op.path.c_str());
+        sqe->len = static_cast<uint32_t>(AT_FDCWD);
+        sqe->addr2 = reinterpret_cast<uint64_t>(op.target.c_str());
+        break;
+      }
+      case BatchOpType::kMkdir: {
+        auto* sqe = Queue(index, IORING_OP_MKDIRAT);
+        sqe->fd = AT_FDCWD;
+        sqe->addr = reinterpret_cast<uint64_t>(op.path.c_str());
+        sqe->len = 0777;
+        break;
+      }
+    }
+  }
+
+  void Continue(size_t index, int result) {
+    auto& state = states_[index];
+    auto& op_result = results_[index];
+
+    // A failed close changes nothing about the data that was read
+    if (result < 0 && state.stage != Stage::kClose) {
+      op_result.error = std::strerror(-result);
+      op_result.data.clear();
+      if (state.fd != -1) {
+        QueueClose(index);
+      } else {
+        Finish(index);
+      }
+      return;
+    }
+
+    switch (state.stage) {
+      case Stage::kStat:
+        FillPathStat(state.stx, op_result.stat);
+        if (ops_[index].type != BatchOpType::kRead) {
+          Finish(index);
+        } else if (op_result.stat.type == WalkEntryType::kDirectory) {
+          op_result.error = "Is a directory";
+          Finish(index);
+        } else {
+          // Never stored inline, an abandoned read has to be able to leak it
+          op_result.data.reserve(sizeof(std::string));
+          op_result.data.resize(static_cast<size_t>(op_result.stat.size));
+          op_result.stat = PathStat();
+          QueueOpen(index);
+        }
+        break;
+      case Stage::kOpen:
+        state.fd = result;
+        if (op_result.data.empty()) {
+          QueueClose(index);
+        } else {
+          QueueRead(index);
+        }
+        break;
+      case Stage::kRead:
+        state.bytes_read += static_cast<size_t>(result);
+        // The file shrank since it was stat'ed
+        if (result == 0) {
+          op_result.data.resize(state.bytes_read);
+        }
+        if (result == 0 || state.bytes_read == op_result.data.size()) {
+          QueueClose(index);
+        } else {
+          QueueRead(index);
+        }
+        break;
+      default:
+        Finish(index);
+        break;
+    }
+  }
+
+  io_uring_sqe* Queue(size_t index, uint8_t opcode) {
+    // Never fails, the ring has room for one entry of every operation in flight
+    auto* sqe = ring_.NextSqe();
+    sqe->opcode = opcode;
+    sqe->user_data = index;
+
+    return sqe;
+  }
+
+  void QueueStatx(size_t index, int flags) {
+    auto& state = states_[index];
+    state.stage = Stage::kStat;
+
+    auto* sqe = Queue(index, IORING_OP_STATX);
+    sqe->fd = AT_FDCWD;
+    sqe->addr = reinterpret_cast<uint64_t>(ops_[index].path.c_str());
+    sqe->len = STATX_BASIC_STATS;
+    sqe->off = reinterpret_cast<uint64_t>(&state.stx);
+    sqe->statx_flags = static_cast<uint32_t>(flags);
+  }
+
+  void QueueOpen(size_t index) {
+    states_[index].stage = Stage::kOpen;
+
+    auto* sqe = Queue(index, IORING_OP_OPENAT);
+    sqe->fd = AT_FDCWD;
+    sqe->addr = reinterpret_cast<uint64_t>(ops_[index].path.c_str());
+    sqe->open_flags = O_RDONLY | O_CLOEXEC;
+  }
+
+  void QueueRead(size_t index) {
+    auto& state = states_[index];
+    auto& data = results_[index].data;
+    state.stage = Stage::kRead;
+
+    auto* sqe = Queue(index, IORING_OP_READ);
+    sqe->fd = state.fd;
+    sqe->addr = reinterpret_cast<uint64_t>(data.data() + state.bytes_read);
+    sqe->len = static_cast<uint32_t>(std::min<size_t>(data.size() - state.bytes_read, 1u << 30));
+    sqe->off = state.bytes_read;
+  }
+
+  void QueueClose(size_t index) {
+    auto& state = states_[index];
+    state.stage = Stage::kClose;
+
+    auto* sqe = Queue(index, IORING_OP_CLOSE);
+    sqe->fd = state.fd;
+    state.fd = -1;
+  }
+
+  void Finish(size_t index) {
+    states_[index].stage = Stage::kDone;
+    in_flight_--;
+  }
+
+  /** Fails everything that did not finish once the ring itself broke. What
+   *  happened to the operations in flight is unknown, the kernel may still
+   *  complete them later. So the statx and read buffers they write into are
+   *  leaked instead of being freed under its hands. */
+  void Abandon(size_t started, const std::string& error) {
+    bool in_flight = false;
+    for (size_t index = 0; index < ops_.size(); index++) {
+      auto& state = states_[index];
+      if (index < started && state.stage == Stage::kDone) {
+        continue;
+      }
+
+      in_flight = in_flight || index < started;
+      if (index < started && state.stage == Stage::kRead) {
+        new std::string(std::move(results_[index].data));
+      }
+      if (state.fd != -1) {
+        close(state.fd);
+      }
+      results_[index].data.clear();
+      results_[index].error = error;
+    }
+    if (in_flight) {
+      new std::vector<OpState>(std::move(states_));
+    }
+  }
+
+  Ring& ring_;
+  const std::vector<BatchOp>& ops_;
+  std::vector<BatchOpResult>& results_;
+  std::vector<OpState> states_;
+  unsigned int in_flight_ = 0;
+};
+
+};
+
+/** Returns true if io_uring can run batches on this kernel. The answer is
+ *  probed once, seccomp filters and old kernels make it fail. */
+bool UringAvailable() {
+  static const bool available = []() {
+    Ring ring;
+    std::string error;
+    return ring.Init(2, error);
+  }();
+
+  return available;
+}
+
+/** Runs ops through io_uring, filling one result per operation at the index
+ *  of its operation. They run concurrently and complete in any order, so one
+ *  operation must not depend on another of the same batch. Returns false
+ *  without running anything if no ring could be set up. */
+bool RunBatchWithUring(const std::vector<BatchOp>& ops, std::vector<BatchOpResult>& results /*OUT*/,
+  std::string& error /*OUT*/) {
+  Ring ring;
+  if (!ring.Init(kRingEntries, error)) {
+    return false;
+  }
+
+  results.resize(ops.size());
+  UringBatch(ring, ops, results).Run();
+
+  return true;
+}
+
+/** Runs a single batch operation with plain system calls. */
+void RunBatchOp(const BatchOp& op, BatchOpResult& result /*OUT*/) {
+  int status = 0;
+
+  switch (op.type) {
+    case BatchOpType::kStat:
+    case BatchOpType::kLstat:
+      StatPath(op.path.c_str(), op.type == BatchOpType::kStat, result.stat, result.error);
+      return;
+    case BatchOpType::kRead: {
+      PathStat stat;
+      if (!StatPath(op.path.c_str(), true, stat, result.error)) {
+        return;
+      }
+      if (stat.type == WalkEntryType::kDirectory) {
+        result.error = "Is a directory";
+        return;
+      }
+
+      result.data.resize(static_cast<size_t>(stat.size));
+      if (!result.data.empty() &&
+          !ReadFileInto(op.path.c_str(), 0, result.data.data(), result.data.size(),
+                        result.error)) {
+        result.data.clear();
+      }
+      return;
+    }
+    case BatchOpType::kUnlink:
+      status = unlink(op.path.c_str());
+      break;
+    case BatchOpType::kRmdir:
+      status = rmdir(op.path.c_str());
+      break;
+    case BatchOpType::kRename:
+      status = rename(op.path.c_str(), op.target.c_str());
+      break;
+    case BatchOpType::kMkdir:
+      status = mkdir(op.path.c_str(), 0777);
+      break;
+  }
+
+  if (status != 0) {
+    result.error = std::strerror(errno);
+  }
+}
+
+};
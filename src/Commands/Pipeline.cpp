@@ -0,0 +1,233 @@
+// This File contains the process pipelines behind pipeline()
+
+#include <chrono>
+
+#include "Pipeline.h"
+
+namespace Commands {
+
+namespace {
+
+constexpr size_t kReadSize = 64 * 1024;
+
+/** The shell's ends of a running pipeline: the pipe feeding the first stage
+ *  and the pipe draining the last one. */
+class PipelineIo {
+ public:
+  PipelineIo(const PipelineOptions& options, const PipelineSink& sink, PipelineResult& result)
+    : options_(options), sink_(sink), result_(result) {}
+
+  ~PipelineIo() {
+    CloseDescriptor(feed_fd);
+    CloseDescriptor(drain_fd);
+    if (poller_ != kInvalidPoller) {
+      ClosePoller(poller_);
+    }
+  }
+
+  /** Moves data until the input is fed and the output ended. Returns false
+   *  if the sink stopped the pipeline early. */
+  bool Run(std::string& error /*OUT*/) {
+    if (feed_fd != -1 && options_.input_data.size == 0) {
+      Close(feed_fd);
+    }
+    if (feed_fd == -1 && drain_fd == -1) {
+      return true;
+    }
+
+    poller_ = CreatePoller(error);
+    if (poller_ == kInvalidPoller ||
+        (feed_fd != -1 && !WatchDescriptor(poller_, feed_fd, kPollWritable, error)) ||
+        (drain_fd != -1 && !WatchDescriptor(poller_, drain_fd, kPollReadable, error))) {
+      return false;
+    }
+
+    std::vector<PollEvent> events;
+    while (feed_fd != -1 || drain_fd != -1) {
+      if (!WaitForEvents(poller_, -1, events, error)) {
+        return false;
+      }
+
+      for (const auto& event : events) {
+        if (event.fd == feed_fd) {
+          Feed();
+        } else if (event.fd == drain_fd && !Drain()) {
+          Close(feed_fd);
+          Close(drain_fd);
+
+          return false;
+        }
+      }
+    }
+
+    return true;
+  }
+
+  int feed_fd = -1;
+  int drain_fd = -1;
+
+ private:
+  void Feed() {
+    const auto& data = options_.input_data;
+    const auto written = WriteAvailable(feed_fd, data.data + fed_, data.size - fed_);
+    // A first stage that stopped reading doesn't get the rest
+    if (written < 0 || (fed_ += static_cast<size_t>(written)) == data.size) {
+      Close(feed_fd);
+    }
+  }
+
+  bool Drain() {
+    char buffer[kReadSize];
+    while (true) {
+      const auto read = ReadAvailable(drain_fd, buffer, sizeof(buffer));
+      if (read < 0) {
+        return true;
+      }
+      if (read == 0) {
+        Close(drain_fd);
+
+        return true;
+      }
+
+      result_.output_bytes += static_cast<uint64_t>(read);
+      if (!sink_(buffer, static_cast<size_t>(read))) {
+        return false;
+      }
+    }
+  }
+
+  void Close(int& fd /*IN-OUT*/) {
+    if (fd == -1) {
+      return;
+    }
+    if (poller_ != kInvalidPoller) {
+      UnwatchDescriptor(poller_, fd);
+    }
+    CloseDescriptor(fd);
+    fd = -1;
+  }
+
+  const PipelineOptions& options_;
+  const PipelineSink& sink_;
+  PipelineResult& result_;
+  PollerHandle poller_ = kInvalidPoller;
+  size_t fed_ = 0;
+};
+
+};
+
+/** Runs stages connected by pipes, like a shell does for 'a | b | c', and
+ *  blocks until all of them exited. Stages pass data to each other through
+ *  the kernel directly, as do input and output files, which are handed to the
+ *  first and last stage as their stdin and stdout. The shell only relays
+ *  input data and output that goes to sink. stderr of all stages is inherited. */
+bool RunPipeline(const std::vector<ProcessJob>& stages, const PipelineOptions& options,
+  const PipelineSink& sink, PipelineResult& result /*OUT*/, std::string& error /*OUT*/) {
+  result = PipelineResult();
+  const auto start = std::chrono::steady_clock::now();
+
+  if (stages.empty()) {
+    error = "No stages passed";
+
+    return false;
+  }
+
+  PipelineIo io(options, sink, result);
+  int input_fd = -1;
+  int output_fd = -1;
+  bool opened = true;
+  switch (options.input) {
+    case PipelineInput::kFile:
+      input_fd = OpenDescriptor(options.input_path.c_str(), false, error);
+      if (input_fd == -1) {
+        error = options.input_path + ": " + error;
+        opened = false;
+      }
+      break;
+    case PipelineInput::kData:
+      opened = CreatePipe(input_fd, io.feed_fd, error);
+      if (opened) {
+        SetNonBlocking(io.feed_fd);
+      }
+      break;
+    default:
+      break;
+  }
+  switch (options.output) {
+    case PipelineOutput::kFile:
+      if (opened) {
+        output_fd = OpenDescriptor(options.output_path.c_str(), true, error);
+        if (output_fd == -1) {
+          error = options.output_path + ": " + error;
+          opened = false;
+        }
+      }
+      break;
+    case PipelineOutput::kStream:
+      opened = opened && CreatePipe(io.drain_fd, output_fd, error);
+      if (opened) {
+        SetNonBlocking(io.drain_fd);
+      }
+      break;
+    default:
+      break;
+  }
+
+  std::vector<ChildProcess> children;
+  auto stage_input = input_fd;
+  for (size_t i = 0; opened && i < stages.size(); i++) {
+    auto spawn_options = stages[i].options;
+    spawn_options.capture_stdout = false;
+    spawn_options.capture_stderr = false;
+    spawn_options.null_stdin = true;
+    spawn_options.stdin_fd = stage_input;
+    spawn_options.stdout_fd = output_fd;
+
+    int next_input = -1;
+    const bool last = i + 1 == stages.size();
+    if (!last && !CreatePipe(next_input, spawn_options.stdout_fd, error)) {
+      opened = false;
+      break;
+    }
+
+    ChildProcess child;
+    opened = SpawnChildProcess(stages[i].command, stages[i].args, spawn_options, child, error);
+    if (!opened) {
+      error = "Cannot start " + stages[i].command + ": " + error;
+      CloseDescriptor(next_input);
+    } else {
+      children.push_back(child);
+    }
+
+    // Only the stages keep their ends, so each sees the end of its input once
+    // the stage before it exited
+    CloseDescriptor(stage_input);
+    if (!last) {
+      CloseDescriptor(spawn_options.stdout_fd);
+    }
+    stage_input = next_input;
+  }
+  CloseDescriptor(stage_input);
+  CloseDescriptor(output_fd);
+
+  const bool completed = opened && io.Run(error);
+  if (!completed) {
+    for (const auto& child : children) {
+      TerminateChildProcess(child, false);
+    }
+  }
+
+  for (auto& child : children) {
+    ChildExit exit;
+    ReapChildProcess(child, true, exit);
+    CloseChildProcess(child);
+    result.exits.push_back(exit);
+  }
+  result.duration_ms = std::chrono::duration<double, std::milli>(
+    std::chrono::steady_clock::now() - start).count();
+
+  // A sink stopping the pipeline is not an error
+  return opened && (completed || error.empty());
+}
+
+};
@@ -0,0 +1,297 @@
+// This File contains the pooling ArrayBuffer allocator selected by --ab-allocator=pool
+
+#include <cstring>
+#include <string>
+
+#if _WIN32
+#include "V8SWindowsApi.h"
+#else // UNIX
+#include "V8SLinuxApi.h"
+#endif
+
+#include "PoolAllocator.h"
+
+namespace Commands {
+
+#if defined(V8_ENABLE_SANDBOX)
+PoolAllocator::PoolAllocator()
+  : granularity_(v8::V8::GetSandboxAddressSpace()->allocation_granularity()) {}
+#else
+PoolAllocator::PoolAllocator() : granularity_(MemoryPageSize()) {}
+#endif
+
+PoolAllocator::~PoolAllocator() {
+  for (auto& size_class : classes_) {
+    for (auto* slab : size_class.slabs) {
+      UnmapPages(slab, kSlabSize);
+    }
+  }
+
+  for (auto* cached : {&resident_pages_, &discarded_pages_}) {
+    for (auto& [size, pages] : *cached) {
+      UnmapPages(pages, size);
+    }
+  }
+}
+
+void* PoolAllocator::Allocate(size_t length) {
+  if (length > kMaxSmallSize) {
+    return AllocateLarge(length, true);
+  }
+
+  auto* data = AllocateSmall(length);
+  if (data != nullptr) {
+    memset(data, 0, length);
+  }
+
+  return data;
+}
+
+void* PoolAllocator::AllocateUninitialized(size_t length) {
+  return length > kMaxSmallSize ? AllocateLarge(length, false) : AllocateSmall(length);
+}
+
+void PoolAllocator::Free(void* data, size_t length) {
+  if (data == nullptr) {
+    return;
+  }
+
+  if (length > kMaxSmallSize) {
+    FreeLarge(data);
+  } else {
+    const auto index = ClassIndex(length);
+    auto& size_class = classes_[index];
+    std::lock_guard<std::mutex> lock(size_class.mutex);
+    size_class.free_blocks.push_back(data);
+    pooled_bytes_ += kMinSmallSize << index;
+  }
+
+  frees_++;
+  live_bytes_ -= length;
+}
+
+PoolAllocator::Stats PoolAllocator::GetStats() const {
+  Stats stats;
+  stats.allocations = allocations_;
+  stats.frees = frees_;
+  stats.reused = reused_;
+  stats.live_bytes = live_bytes_;
+  stats.peak_bytes = peak_bytes_;
+  stats.pooled_bytes = pooled_bytes_;
+  stats.resident_page_bytes = resident_page_bytes_;
+  stats.discarded_page_bytes = discarded_page_bytes_;
+
+  return stats;
+}
+
+/** Unmaps the freed pages kept for reuse. Free blocks of the size classes
+ *  stay, they share their slabs with live buffers. */
+void PoolAllocator::Trim() {
+  std::multimap<size_t, void*> resident_pages;
+  std::multimap<size_t, void*> discarded_pages;
+  {
+    std::lock_guard<std::mutex> lock(pages_mutex_);
+    resident_pages.swap(resident_pages_);
+    discarded_pages.swap(discarded_pages_);
+    resident_page_bytes_ = 0;
+    discarded_page_bytes_ = 0;
+  }
+
+  for (auto* cached : {&resident_pages, &discarded_pages}) {
+    for (auto& [size, pages] : *cached) {
+      UnmapPages(pages, size);
+    }
+  }
+}
+
+/** Index of the smallest size class that fits length. */
+size_t PoolAllocator::ClassIndex(size_t length) {
+  size_t index = 0;
+  for (auto size = kMinSmallSize; size < length; size <<= 1) {
+    index++;
+  }
+
+  return index;
+}
+
+/** Takes a block of the size class of length, splitting a new slab into
+ *  blocks if the free list is empty. */
+void* PoolAllocator::AllocateSmall(size_t length) {
+  const auto index = ClassIndex(length);
+  const auto block_size = kMinSmallSize << index;
+  auto& size_class = classes_[index];
+
+  std::lock_guard<std::mutex> lock(size_class.mutex);
+  const auto reused = !size_class.free_blocks.empty();
+  if (!reused) {
+    auto* slab = static_cast<char*>(MapPages(kSlabSize));
+    if (slab == nullptr) {
+      return nullptr;
+    }
+
+    size_class.slabs.push_back(slab);
+    // Handed out from the start of the slab first
+    for (auto offset = kSlabSize; offset != 0; offset -= block_size) {
+      size_class.free_blocks.push_back(slab + offset - block_size);
+    }
+    pooled_bytes_ += kSlabSize;
+  }
+
+  auto* block = size_class.free_blocks.back();
+  size_class.free_blocks.pop_back();
+  pooled_bytes_ -= block_size;
+  Allocated(length, reused);
+
+  return block;
+}
+
+/** Reuses freed pages that fit length, resident ones first, otherwise maps
+ *  new ones. Only resident pages have to be cleared, fresh and discarded
+ *  pages read as zeros. */
+void* PoolAllocator::AllocateLarge(size_t length, bool zeroed) {
+  const auto size = (length + granularity_ - 1) / granularity_ * granularity_;
+  void* pages = nullptr;
+  auto dirty = false;
+  {
+    std::lock_guard<std::mutex> lock(pages_mutex_);
+    auto cached_size = size;
+    pages = TakeCachedPages(resident_pages_, cached_size);
+    if (pages != nullptr) {
+      resident_page_bytes_ -= cached_size;
+      dirty = true;
+    } else {
+      pages = TakeCachedPages(discarded_pages_, cached_size);
+      if (pages != nullptr) {
+        discarded_page_bytes_ -= cached_size;
+        if (!ReusePages(pages, cached_size)) {
+          UnmapPages(pages, cached_size);
+          pages = nullptr;
+        }
+      }
+    }
+
+    if (pages != nullptr) {
+      page_sizes_[pages] = cached_size;
+    }
+  }
+
+  if (pages != nullptr) {
+    if (zeroed && dirty) {
+      memset(pages, 0, length);
+    }
+    Allocated(length, true);
+
+    return pages;
+  }
+
+  pages = MapPages(size);
+  if (pages == nullptr) {
+    return nullptr;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(pages_mutex_);
+    page_sizes_[pages] = size;
+  }
+  Allocated(length, false);
+
+  return pages;
+}
+
+/** Removes the smallest pages of cached that fit size without wasting more
+ *  than half of them, size is set to their actual size. */
+void* PoolAllocator::TakeCachedPages(std::multimap<size_t, void*>& cached, size_t& size) {
+  auto found = cached.lower_bound(size);
+  if (found == cached.end() || found->first / 2 > size) {
+    return nullptr;
+  }
+
+  auto* pages = found->second;
+  size = found->first;
+  cached.erase(found);
+
+  return pages;
+}
+
+/** Keeps the pages for reuse, with their memory given back once too many
+ *  are resident, and unmaps them once too many are cached at all. */
+void PoolAllocator::FreeLarge(void* data) {
+  size_t size = 0;
+  {
+    std::lock_guard<std::mutex> lock(pages_mutex_);
+    auto found = page_sizes_.find(data);
+    size = found->second;
+    page_sizes_.erase(found);
+
+    if (resident_page_bytes_ + size <= kMaxResidentPages) {
+      resident_pages_.emplace(size, data);
+      resident_page_bytes_ += size;
+
+      return;
+    }
+  }
+
+  if (discarded_page_bytes_ + size > kMaxDiscardedPages || !DiscardPages(data, size)) {
+    UnmapPages(data, size);
+
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(pages_mutex_);
+  discarded_pages_.emplace(size, data);
+  discarded_page_bytes_ += size;
+}
+
+void PoolAllocator::Allocated(size_t length, bool reused) {
+  allocations_++;
+  if (reused) {
+    reused_++;
+  }
+
+  const auto live_bytes = live_bytes_ += length;
+  auto peak_bytes = peak_bytes_.load();
+  while (live_bytes > peak_bytes && !peak_bytes_.compare_exchange_weak(peak_bytes, live_bytes)) {
+  }
+}
+
+#if defined(V8_ENABLE_SANDBOX)
+void* PoolAllocator::MapPages(size_t size) {
+  auto* space = v8::V8::GetSandboxAddressSpace();
+
+  return reinterpret_cast<void*>(space->AllocatePages(v8::VirtualAddressSpace::kNoHint, size,
+    granularity_, v8::PagePermissions::kReadWrite));
+}
+
+void PoolAllocator::UnmapPages(void* address, size_t size) {
+  v8::V8::GetSandboxAddressSpace()->FreePages(reinterpret_cast<uintptr_t>(address), size);
+}
+
+/** Decommitted pages read as zeros once they are made accessible again. */
+bool PoolAllocator::DiscardPages(void* address, size_t size) {
+  return v8::V8::GetSandboxAddressSpace()->DecommitPages(
+    reinterpret_cast<uintptr_t>(address), size);
+}
+
+bool PoolAllocator::ReusePages(void* address, size_t size) {
+  return v8::V8::GetSandboxAddressSpace()->SetPagePermissions(
+    reinterpret_cast<uintptr_t>(address), size, v8::PagePermissions::kReadWrite);
+}
+#else
+void* PoolAllocator::MapPages(size_t size) {
+  std::string error;
+
+  return MapMemory(size, error);
+}
+
+void PoolAllocator::UnmapPages(void* address, size_t size) { UnmapMemory(address, size); }
+
+bool PoolAllocator::DiscardPages(void* address, size_t size) {
+  DiscardMemory(address, size);
+
+  return true;
+}
+
+bool PoolAllocator::ReusePages(void* address, size_t size) { return true; }
+#endif
+
+};
@@ -0,0 +1,348 @@
+// This File contains the bounded process pool behind runAll() and captured runSync() calls
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <unordered_map>
+
+#include "ProcessPool.h"
+
+namespace Commands {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t kReadSize = 64 * 1024;
+
+struct RunningJob {
+  size_t index;
+  ChildProcess child;
+  Clock::time_point start;
+  Clock::time_point deadline;
+};
+
+class ProcessPool {
+ public:
+  ProcessPool(const std::vector<ProcessJob>& jobs, const ProcessPoolOptions& options,
+      std::vector<ProcessJobResult>& results)
+    : jobs_(jobs), options_(options), results_(results) {
+    concurrency_ = options.concurrency != 0
+      ? options.concurrency : std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  ~ProcessPool() {
+    if (poller_ != kInvalidPoller) {
+      ClosePoller(poller_);
+    }
+  }
+
+  bool Run(std::string& error /*OUT*/) {
+    results_.assign(jobs_.size(), ProcessJobResult());
+    if (jobs_.empty()) {
+      return true;
+    }
+
+    poller_ = CreatePoller(error);
+    if (poller_ == kInvalidPoller) {
+      return false;
+    }
+
+    LaunchJobs();
+    std::vector<PollEvent> events;
+    while (!running_.empty()) {
+      if (!WaitForEvents(poller_, NextTimeout(), events, error)) {
+        AbortRunningJobs();
+        return false;
+      }
+
+      for (const auto& event : events) {
+        auto owner = owners_.find(event.fd);
+        // Finished by an earlier event of this round
+        if (owner == owners_.end()) {
+          continue;
+        }
+        HandleEvent(owner->second, event.fd);
+      }
+
+      KillExpiredJobs();
+      LaunchJobs();
+    }
+
+    // Whatever was not started after a failure is reported as skipped
+    for (; next_job_ < jobs_.size(); next_job_++) {
+      results_[next_job_].skipped = true;
+    }
+
+    return true;
+  }
+
+ private:
+  void LaunchJobs() {
+    while (!stopped_ && running_.size() < concurrency_ && next_job_ < jobs_.size()) {
+      const auto index = next_job_++;
+      auto& result = results_[index];
+
+      auto options = jobs_[index].options;
+      options.capture_stdout = true;
+      options.capture_stderr = true;
+
+      RunningJob job{index, ChildProcess(), Clock::now(), Clock::time_point::max()};
+      if (options_.timeout_ms > 0) {
+        job.deadline = job.start + std::chrono::duration_cast<Clock::duration>(
+          std::chrono::duration<double, std::milli>(options_.timeout_ms));
+      }
+
+      if (!SpawnChildProcess(jobs_[index].command, jobs_[index].args, options, job.child,
+          result.error)) {
+        result.exit.code = -1;
+        JobFailed();
+        continue;
+      }
+
+      auto* running = new RunningJob(job);
+      std::string error;
+      for (auto fd : {running->child.pidfd, running->child.stdout_fd, running->child.stderr_fd}) {
+        if (fd != -1 && WatchDescriptor(poller_, fd, kPollReadable, error)) {
+          owners_[fd] = running;
+        }
+      }
+      running_.push_back(running);
+    }
+  }
+
+  int NextTimeout() const {
+    auto deadline = Clock::time_point::max();
+    for (const auto* job : running_) {
+      // A killed job's deadline passed for good, waking up for it would only spin
+      if (!results_[job->index].timed_out) {
+        deadline = std::min(deadline, job->deadline);
+      }
+    }
+    if (deadline == Clock::time_point::max()) {
+      return -1;
+    }
+
+    const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+      deadline - Clock::now()).count();
+    return static_cast<int>(std::max<int64_t>(remaining + 1, 0));
+  }
+
+  void HandleEvent(RunningJob* job, int fd) {
+    auto& child = job->child;
+    auto& result = results_[job->index];
+
+    if (fd == child.pidfd) {
+      ChildExit exit;
+      if (ReapChildProcess(child, false, exit)) {
+        Finish(job, exit);
+      }
+      return;
+    }
+
+    Collect(child.stdout_fd, result.stdout_data);
+    Collect(child.stderr_fd, result.stderr_data);
+
+    // Without a pidfd the end of both streams is the best sign of an exit
+    if (child.pidfd == -1 && child.stdout_fd == -1 && child.stderr_fd == -1) {
+      ChildExit exit;
+      ReapChildProcess(child, true, exit);
+      Finish(job, exit);
+    }
+  }
+
+  /** Reads what fd has to offer right now, closes it at the end of the stream. */
+  void Collect(int& fd /*IN-OUT*/, std::string& output /*OUT*/) {
+    if (fd == -1) {
+      return;
+    }
+
+    char buffer[kReadSize];
+    while (true) {
+      const auto read = ReadAvailable(fd, buffer, sizeof(buffer));
+      if (read < 0) {
+        return;
+      }
+      if (read == 0) {
+        Forget(fd);
+        CloseDescriptor(fd);
+        fd = -1;
+
+        return;
+      }
+      output.append(buffer, static_cast<size_t>(read));
+    }
+  }
+
+  void Forget(int fd) {
+    if (fd != -1 && owners_.erase(fd) != 0) {
+      UnwatchDescriptor(poller_, fd);
+    }
+  }
+
+  void Finish(RunningJob* job, const ChildExit& exit) {
+    auto& result = results_[job->index];
+    Collect(job->child.stdout_fd, result.stdout_data);
+    Collect(job->child.stderr_fd, result.stderr_data);
+    Forget(job->child.pidfd);
+    Forget(job->child.stdout_fd);
+    Forget(job->child.stderr_fd);
+    CloseChildProcess(job->child);
+
+    result.exit = exit;
+    result.duration_ms = std::chrono::duration<double, std::milli>(
+      Clock::now() - job->start).count();
+
+    running_.erase(std::find(running_.begin(), running_.end(), job));
+    delete job;
+
+    if (exit.code != 0) {
+      JobFailed();
+    }
+  }
+
+  void JobFailed() {
+    if (!options_.fail_fast || stopped_) {
+      return;
+    }
+
+    stopped_ = true;
+    for (const auto* job : running_) {
+      TerminateChildProcess(job->child, false);
+    }
+  }
+
+  void KillExpiredJobs() {
+    const auto now = Clock::now();
+    for (auto* job : running_) {
+      if (job->deadline <= now && !results_[job->index].timed_out) {
+        results_[job->index].timed_out = true;
+        TerminateChildProcess(job->child, true);
+      }
+    }
+  }
+
+  void AbortRunningJobs() {
+    for (auto* job : running_) {
+      TerminateChildProcess(job->child, true);
+      ChildExit exit;
+      ReapChildProcess(job->child, true, exit);
+      CloseChildProcess(job->child);
+      results_[job->index].exit = exit;
+      delete job;
+    }
+    running_.clear();
+    owners_.clear();
+  }
+
+  const std::vector<ProcessJob>& jobs_;
+  const ProcessPoolOptions& options_;
+  std::vector<ProcessJobResult>& results_;
+  unsigned int concurrency_;
+  PollerHandle poller_ = kInvalidPoller;
+  size_t next_job_ = 0;
+  bool stopped_ = false;
+  std::vector<RunningJob*> running_;
+  // Job each watched descriptor belongs to
+  std::unordered_map<int, RunningJob*> owners_;
+};
+
+};
+
+/** Runs jobs with at most options.concurrency children at once and blocks
+ *  until all of them finished. results has one entry per job, in job order. */
+bool RunProcessJobs(const std::vector<ProcessJob>& jobs, const ProcessPoolOptions& options,
+  std::vector<ProcessJobResult>& results /*OUT*/, std::string& error /*OUT*/) {
+  ProcessPool pool(jobs, options, results);
+
+  return pool.Run(error);
+}
+
+/** Runs a single job and blocks until it exited, passing its stdout and stderr
+ *  to sink as they arrive. If sink returns false, the child is terminated and
+ *  the rest of its output is discarded. */
+bool RunCapturing(const ProcessJob& job, const OutputSink& sink, ChildExit& exit /*OUT*/,
+  std::string& error /*OUT*/) {
+  auto options = job.options;
+  options.capture_stdout = true;
+  options.capture_stderr = true;
+
+  ChildProcess child;
+  if (!SpawnChildProcess(job.command, job.args, options, child, error)) {
+    error = "Cannot start " + job.command + ": " + error;
+
+    return false;
+  }
+
+  auto poller = CreatePoller(error);
+  bool watched = poller != kInvalidPoller &&
+                 WatchDescriptor(poller, child.stdout_fd, kPollReadable, error) &&
+                 WatchDescriptor(poller, child.stderr_fd, kPollReadable, error);
+
+  auto close_stream = [&](int& fd /*IN-OUT*/) {
+    if (fd != -1) {
+      if (poller != kInvalidPoller) {
+        UnwatchDescriptor(poller, fd);
+      }
+      CloseDescriptor(fd);
+      fd = -1;
+    }
+  };
+  // Reads what fd has to offer right now, false once the sink stopped the child
+  auto drain = [&](int& fd /*IN-OUT*/, OutputStream stream) {
+    char buffer[kReadSize];
+    while (fd != -1) {
+      const auto read = ReadAvailable(fd, buffer, sizeof(buffer));
+      if (read < 0) {
+        break;
+      }
+      if (read == 0) {
+        close_stream(fd);
+      } else if (!sink(stream, buffer, static_cast<size_t>(read))) {
+        return false;
+      }
+    }
+
+    return true;
+  };
+
+  std::vector<PollEvent> events;
+  while (watched && (child.stdout_fd != -1 || child.stderr_fd != -1)) {
+    if (!WaitForEvents(poller, -1, events, error)) {
+      watched = false;
+      break;
+    }
+
+    bool stopped = false;
+    for (const auto& event : events) {
+      if (event.fd == child.stdout_fd) {
+        stopped = !drain(child.stdout_fd, OutputStream::kStdout);
+      } else if (event.fd == child.stderr_fd) {
+        stopped = !drain(child.stderr_fd, OutputStream::kStderr);
+      }
+      if (stopped) {
+        break;
+      }
+    }
+    if (stopped) {
+      TerminateChildProcess(child, false);
+      break;
+    }
+  }
+
+  if (!watched) {
+    TerminateChildProcess(child, true);
+  }
+  close_stream(child.stdout_fd);
+  close_stream(child.stderr_fd);
+  if (poller != kInvalidPoller) {
+    ClosePoller(poller);
+  }
+
+  ReapChildProcess(child, true, exit);
+  CloseChildProcess(child);
+
+  return watched;
+}
+
+};
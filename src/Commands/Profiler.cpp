@@ -0,0 +1,326 @@
+// This File contains the profilers of an isolate
+
+#include <fstream>
+#include <utility>
+#include <vector>
+
+#include "Commands.h"
+#include "IsolateState.h"
+#include "Profiler.h"
+
+namespace Commands {
+
+namespace {
+
+/** Writes value as a quoted JSON string. */
+void WriteJsonString(std::ostream& out, const char* value) {
+  out << '"';
+  for (auto* c = value; *c != '\0'; c++) {
+    switch (*c) {
+      case '"':
+        out << "\\\"";
+        break;
+      case '\\':
+        out << "\\\\";
+        break;
+      case '\n':
+        out << "\\n";
+        break;
+      case '\r':
+        out << "\\r";
+        break;
+      case '\t':
+        out << "\\t";
+        break;
+      default:
+        if (static_cast<unsigned char>(*c) < 0x20) {
+          const char* hex = "0123456789abcdef";
+          out << "\\u00" << hex[(*c >> 4) & 0xf] << hex[*c & 0xf];
+        } else {
+          out << *c;
+        }
+    }
+  }
+  out << '"';
+}
+
+/** Writes the callFrame of a profile node, lines and columns are counted
+ *  from one by v8 and from zero by the DevTools. */
+void WriteCallFrame(std::ostream& out, const char* function_name, int script_id,
+  const char* url, int line_number, int column_number) {
+  out << "\"callFrame\":{\"functionName\":";
+  WriteJsonString(out, function_name);
+  out << ",\"scriptId\":\"" << script_id << "\",\"url\":";
+  WriteJsonString(out, url);
+  out << ",\"lineNumber\":" << line_number - 1 << ",\"columnNumber\":" << column_number - 1
+      << '}';
+}
+
+/** Hands the chunks of a serialized heap snapshot straight to a file. */
+class FileOutputStream : public v8::OutputStream {
+ public:
+  explicit FileOutputStream(std::ostream& out) : out_(out) {}
+
+  void EndOfStream() override { out_.flush(); }
+  int GetChunkSize() override { return 64 * 1024; }
+  WriteResult WriteAsciiChunk(char* data, int size) override {
+    out_.write(data, size);
+
+    return out_ ? kContinue : kAbort;
+  }
+
+ private:
+  std::ostream& out_;
+};
+
+void WriteAllocationNode(v8::Isolate* isolate, const v8::AllocationProfile::Node* node,
+  std::ostream& out) {
+  v8::String::Utf8Value name(isolate, node->name);
+  v8::String::Utf8Value url(isolate, node->script_name);
+  size_t self_size = 0;
+  for (const auto& allocation : node->allocations) {
+    self_size += allocation.size * allocation.count;
+  }
+
+  out << '{';
+  WriteCallFrame(out, *name != nullptr ? *name : "", node->script_id,
+    *url != nullptr ? *url : "", node->line_number, node->column_number);
+  out << ",\"selfSize\":" << self_size << ",\"id\":" << node->node_id << ",\"children\":[";
+  // As deep as the stack depth the sampling records
+  for (size_t i = 0; i < node->children.size(); i++) {
+    out << (i != 0 ? "," : "");
+    WriteAllocationNode(isolate, node->children[i], out);
+  }
+  out << "]}";
+}
+
+};
+
+Profiler::~Profiler() {
+  if (cpu_profiler_ != nullptr) {
+    cpu_profiler_->Dispose();
+  }
+  if (sampling_allocations_) {
+    isolate_->GetHeapProfiler()->StopSamplingHeapProfiler();
+  }
+}
+
+/** The first profile sets the sampling interval of the profiler, later ones
+ *  running alongside it sample at multiples of it. */
+bool Profiler::StartCpuProfile(v8::Local<v8::String> name, int sampling_interval_us,
+  std::string& error) {
+  if (cpu_profiler_ == nullptr) {
+    // Debug naming gives anonymous functions the names they were assigned to
+    cpu_profiler_ = v8::CpuProfiler::New(isolate_, v8::kDebugNaming);
+  }
+
+  if (recording_ == 0) {
+    cpu_profiler_->SetSamplingInterval(sampling_interval_us);
+    sampling_interval_us = 0;
+  }
+
+  const auto status = cpu_profiler_->StartProfiling(name,
+    v8::CpuProfilingOptions(v8::kLeafNodeLineNumbers, v8::CpuProfilingOptions::kNoSampleLimit,
+      sampling_interval_us));
+
+  switch (status) {
+    case v8::CpuProfilingStatus::kStarted:
+      recording_++;
+      return true;
+    case v8::CpuProfilingStatus::kAlreadyStarted:
+      error = "A profile of that name is already recorded";
+      return false;
+    default:
+      error = "Too many profiles are recorded";
+      return false;
+  }
+}
+
+v8::CpuProfile* Profiler::StopCpuProfile(v8::Local<v8::String> name) {
+  if (cpu_profiler_ == nullptr || recording_ == 0) {
+    return nullptr;
+  }
+
+  auto* profile = cpu_profiler_->StopProfiling(name);
+  if (profile != nullptr) {
+    recording_--;
+  }
+
+  return profile;
+}
+
+/** Writes the profile as a .cpuprofile: the call tree as a flat list of
+ *  nodes, plus the node and time delta of every sample. Native functions
+ *  such as the shell's hooks get nodes of their own without a url. */
+bool Profiler::WriteCpuProfile(const v8::CpuProfile* profile, std::ostream& out) {
+  auto* isolate = v8::Isolate::GetCurrent();
+
+  out << "{\"nodes\":[";
+  // Walked without recursion, call trees get as deep as the JS stack
+  std::vector<const v8::CpuProfileNode*> pending{profile->GetTopDownRoot()};
+  auto first = true;
+  while (!pending.empty()) {
+    const auto* node = pending.back();
+    pending.pop_back();
+
+    if (!first) {
+      out << ',';
+    }
+    first = false;
+
+    v8::HandleScope handle_scope(isolate);
+    v8::String::Utf8Value url(isolate, node->GetScriptResourceName());
+    out << "{\"id\":" << node->GetNodeId() << ',';
+    WriteCallFrame(out, node->GetFunctionNameStr(), node->GetScriptId(),
+      *url != nullptr ? *url : "", node->GetLineNumber(), node->GetColumnNumber());
+    out << ",\"hitCount\":" << node->GetHitCount() << ",\"children\":[";
+
+    const auto children = node->GetChildrenCount();
+    for (int i = 0; i < children; i++) {
+      const auto* child = node->GetChild(i);
+      out << (i != 0 ? "," : "") << child->GetNodeId();
+      pending.push_back(child);
+    }
+    out << "]}";
+  }
+
+  const auto samples = profile->GetSamplesCount();
+  out << "],\"startTime\":" << profile->GetStartTime()
+      << ",\"endTime\":" << profile->GetEndTime() << ",\"samples\":[";
+  for (int i = 0; i < samples; i++) {
+    out << (i != 0 ? "," : "") << profile->GetSample(i)->GetNodeId();
+  }
+
+  out << "],\"timeDeltas\":[";
+  auto previous = profile->GetStartTime();
+  for (int i = 0; i < samples; i++) {
+    const auto timestamp = profile->GetSampleTimestamp(i);
+    out << (i != 0 ? "," : "") << timestamp - previous;
+    previous = timestamp;
+  }
+  out << "]}";
+
+  return static_cast<bool>(out);
+}
+
+/** Takes a heap snapshot and serializes it in chunks into the file, the
+ *  snapshot's JSON is never held in memory as a whole. The snapshot itself
+ *  is deleted right after. */
+bool Profiler::WriteHeapSnapshot(const fs::path& path, std::string& error) {
+  std::ofstream output_file(path, std::ios::binary);
+  if (!output_file) {
+    error = "Cannot open " + path.string();
+    return false;
+  }
+
+  auto* heap_profiler = isolate_->GetHeapProfiler();
+  auto* snapshot = heap_profiler->TakeHeapSnapshot();
+  if (snapshot == nullptr) {
+    error = "Cannot take a heap snapshot";
+    return false;
+  }
+
+  FileOutputStream stream(output_file);
+  snapshot->Serialize(&stream, v8::HeapSnapshot::kJSON);
+  const_cast<v8::HeapSnapshot*>(snapshot)->Delete();
+
+  if (!output_file) {
+    error = "Cannot write " + path.string();
+    return false;
+  }
+
+  return true;
+}
+
+bool Profiler::StartAllocationSampling(uint64_t interval) {
+  if (sampling_allocations_) {
+    return false;
+  }
+
+  sampling_allocations_ = isolate_->GetHeapProfiler()->StartSamplingHeapProfiler(interval);
+
+  return sampling_allocations_;
+}
+
+std::unique_ptr<v8::AllocationProfile> Profiler::StopAllocationSampling() {
+  if (!sampling_allocations_) {
+    return nullptr;
+  }
+
+  auto* heap_profiler = isolate_->GetHeapProfiler();
+  std::unique_ptr<v8::AllocationProfile> profile(heap_profiler->GetAllocationProfile());
+  heap_profiler->StopSamplingHeapProfiler();
+  sampling_allocations_ = false;
+
+  return profile;
+}
+
+/** Writes the profile as a .heapprofile: the tree of the allocating call
+ *  sites with the bytes each of them keeps alive, plus the samples. */
+bool Profiler::WriteAllocationProfile(v8::AllocationProfile* profile, std::ostream& out) {
+  auto* isolate = v8::Isolate::GetCurrent();
+  v8::HandleScope handle_scope(isolate);
+
+  out << "{\"head\":";
+  WriteAllocationNode(isolate, profile->GetRootNode(), out);
+  out << ",\"samples\":[";
+  auto first = true;
+  for (const auto& sample : profile->GetSamples()) {
+    out << (first ? "" : ",") << "{\"size\":" << sample.size * sample.count
+        << ",\"nodeId\":" << sample.node_id << ",\"ordinal\":" << sample.sample_id << '}';
+    first = false;
+  }
+  out << "]}";
+
+  return static_cast<bool>(out);
+}
+
+ScopedCpuProfile::ScopedCpuProfile(v8::Isolate* isolate, std::string path)
+  : isolate_(isolate), path_(std::move(path)) {
+  if (path_.empty()) {
+    return;
+  }
+
+  std::string error;
+  v8::HandleScope handle_scope(isolate_);
+  auto* state = IsolateState::From(isolate_);
+  state->SetCpuProfile(this);
+  started_ = state->GetProfiler().StartCpuProfile(
+    v8::String::NewFromUtf8Literal(isolate_, kName), Profiler::kDefaultSamplingInterval, error);
+  if (!started_) {
+    PrintWarningTag();
+    std::cerr << " Cannot start the CPU profile: " << error << std::endl;
+  }
+}
+
+ScopedCpuProfile::~ScopedCpuProfile() {
+  Finish();
+  if (!path_.empty()) {
+    IsolateState::From(isolate_)->SetCpuProfile(nullptr);
+  }
+}
+
+/** Stops the profile and writes it to its file. Only the first call does
+ *  anything. */
+void ScopedCpuProfile::Finish() {
+  if (!started_) {
+    return;
+  }
+  started_ = false;
+
+  v8::HandleScope handle_scope(isolate_);
+  auto* profile = IsolateState::From(isolate_)->GetProfiler().StopCpuProfile(
+    v8::String::NewFromUtf8Literal(isolate_, kName));
+  if (profile == nullptr) {
+    return;
+  }
+
+  std::ofstream output_file(path_);
+  if (!Profiler::WriteCpuProfile(profile, output_file)) {
+    PrintErrorTag();
+    std::cerr << " Cannot write CPU profile " << path_ << std::endl;
+  }
+  profile->Delete();
+}
+
+};
@@ -1,4 +1,6 @@
 // This File contains functions with Windows-specific api calls
+#include <algorithm>
+
 #include "V8SWindowsApi.h"
 
 namespace Commands {
@@ -53,4 +55,462 @@ void CreateNewProcess(std::string& process_path, std::vector<std::string>& args,
   }
 }
 
+// The event loop and asynchronous processes need an IOCP based implementation,
+// until then these report that they are unavailable
+
+PollerHandle CreatePoller(std::string& error /*OUT*/) {
+  error = "Not supported on Windows yet";
+
+  return kInvalidPoller;
+}
+
+void ClosePoller(PollerHandle poller) {}
+
+bool WatchDescriptor(PollerHandle poller, int fd, uint32_t events, std::string& error /*OUT*/) {
+  error = "Not supported on Windows yet";
+
+  return false;
+}
+
+void UnwatchDescriptor(PollerHandle poller, int fd) {}
+
+bool WaitForEvents(PollerHandle poller, int timeout_ms, std::vector<PollEvent>& events /*OUT*/,
+  std::string& error /*OUT*/) {
+  events.clear();
+  error = "Not supported on Windows yet";
+
+  return false;
+}
+
+int CreateWakeup(std::string& error /*OUT*/) {
+  error = "Not supported on Windows yet";
+
+  return -1;
+}
+
+void SignalWakeup(int fd) {}
+
+void ClearWakeup(int fd) {}
+
+int OpenDescriptor(const char* path, bool writable, std::string& error /*OUT*/) {
+  error = "Not supported on Windows yet";
+
+  return -1;
+}
+
+bool CreatePipe(int& read_fd /*OUT*/, int& write_fd /*OUT*/, std::string& error /*OUT*/) {
+  read_fd = write_fd = -1;
+  error = "Not supported on Windows yet";
+
+  return false;
+}
+
+void SetNonBlocking(int fd) {}
+
+long ReadAvailable(int fd, char* buffer, size_t length) {
+  return 0;
+}
+
+long WriteAvailable(int fd, const char* buffer, size_t length) {
+  return -1;
+}
+
+void CloseDescriptor(int fd) {}
+
+bool SpawnChildProcess(const std::string& command, const std::vector<std::string>& args,
+  const SpawnOptions& options, ChildProcess& child /*OUT*/, std::string& error /*OUT*/) {
+  child = ChildProcess();
+  error = "Not supported on Windows yet";
+
+  return false;
+}
+
+bool ReapChildProcess(ChildProcess& child, bool block, ChildExit& exit /*OUT*/) {
+  exit = ChildExit();
+  exit.code = -1;
+
+  return true;
+}
+
+void TerminateChildProcess(const ChildProcess& child, bool force) {}
+
+void CloseChildProcess(ChildProcess& child) {}
+
+/** Maps length bytes of a file starting at offset into memory, length 0 maps
+ *  until the end of the file. Writable mappings are private copy-on-write views,
+ *  so changes never reach the file. */
+bool MapFile(const char* path, uint64_t offset, uint64_t length, bool writable,
+  MappedFile& file /*OUT*/, std::string& error /*OUT*/) {
+  file = MappedFile();
+
+  HANDLE file_handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+    nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file_handle == INVALID_HANDLE_VALUE) {
+    error = std::system_category().message(GetLastError());
+
+    return false;
+  }
+
+  LARGE_INTEGER file_size;
+  if (!GetFileSizeEx(file_handle, &file_size)) {
+    error = std::system_category().message(GetLastError());
+    CloseHandle(file_handle);
+
+    return false;
+  }
+
+  const auto size = static_cast<uint64_t>(file_size.QuadPart);
+  if (offset > size) {
+    error = "Offset is beyond the end of the file";
+    CloseHandle(file_handle);
+
+    return false;
+  }
+
+  if (length == 0 || length > size - offset) {
+    length = size - offset;
+  }
+
+  // Nothing to map, e.g. empty files
+  if (length == 0) {
+    CloseHandle(file_handle);
+
+    return true;
+  }
+
+  HANDLE mapping_handle = CreateFileMappingA(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  CloseHandle(file_handle);
+
+  if (mapping_handle == nullptr) {
+    error = std::system_category().message(GetLastError());
+
+    return false;
+  }
+
+  // View offsets must be aligned to the allocation granularity
+  SYSTEM_INFO system_info;
+  GetSystemInfo(&system_info);
+  const auto aligned_offset = offset - offset % system_info.dwAllocationGranularity;
+  const auto mapping_size = static_cast<size_t>(length + offset - aligned_offset);
+
+  void* mapping = MapViewOfFile(mapping_handle, writable ? FILE_MAP_COPY : FILE_MAP_READ,
+    static_cast<DWORD>(aligned_offset >> 32), static_cast<DWORD>(aligned_offset & 0xFFFFFFFF),
+    mapping_size);
+  // The view keeps the mapping alive
+  CloseHandle(mapping_handle);
+
+  if (mapping == nullptr) {
+    error = std::system_category().message(GetLastError());
+
+    return false;
+  }
+
+  file.mapping = mapping;
+  file.mapping_size = mapping_size;
+  file.data = static_cast<char*>(mapping) + (offset - aligned_offset);
+  file.size = static_cast<size_t>(length);
+
+  return true;
+}
+
+/** Releases a mapping created by MapFile. */
+void UnmapFile(MappedFile& file) {
+  if (file.mapping != nullptr) {
+    UnmapViewOfFile(file.mapping);
+  }
+
+  file = MappedFile();
+}
+
+size_t MemoryPageSize() {
+  static const auto page_size = []() {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+
+    return static_cast<size_t>(info.dwPageSize);
+  }();
+
+  return page_size;
+}
+
+uint64_t PhysicalMemorySize() {
+  MEMORYSTATUSEX status;
+  status.dwLength = sizeof(status);
+  if (!GlobalMemoryStatusEx(&status)) {
+    return 0;
+  }
+
+  return status.ullTotalPhys;
+}
+
+/** Maps size bytes of zeroed memory, size has to be a multiple of the page size. */
+void* MapMemory(size_t size, std::string& error /*OUT*/) {
+  auto* address = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+  if (address == nullptr) {
+    error = std::system_category().message(GetLastError());
+  }
+
+  return address;
+}
+
+void UnmapMemory(void* address, size_t size) { VirtualFree(address, 0, MEM_RELEASE); }
+
+/** Gives the physical pages of a mapping back to the system but keeps the
+ *  address range, it reads as zeros afterwards. */
+void DiscardMemory(void* address, size_t size) {
+  VirtualFree(address, size, MEM_DECOMMIT);
+  VirtualAlloc(address, size, MEM_COMMIT, PAGE_READWRITE);
+}
+
+/** Opens a file for writing, creating it if needed. The file is truncated
+ *  unless append is set. */
+FileHandle OpenFileForWriting(const char* path, bool append, std::string& error /*OUT*/) {
+  FileHandle file = CreateFileA(path, append ? FILE_APPEND_DATA : GENERIC_WRITE,
+    FILE_SHARE_READ, nullptr, append ? OPEN_ALWAYS : CREATE_ALWAYS,
+    FILE_ATTRIBUTE_NORMAL, nullptr);
+
+  if (file == kInvalidFileHandle) {
+    error = std::system_category().message(GetLastError());
+  }
+
+  return file;
+}
+
+/** Writes all buffers in order. Windows has no writev for regular files,
+ *  so each buffer is written with its own call. */
+bool WriteFileBuffers(FileHandle file, std::vector<WriteBuffer> buffers,
+  std::string& error /*OUT*/) {
+  for (auto& buffer : buffers) {
+    size_t total = 0;
+    while (total < buffer.size) {
+      // WriteFile takes at most a DWORD worth of bytes per call
+      const auto chunk = static_cast<DWORD>(std::min<size_t>(buffer.size - total, 1u << 30));
+      DWORD written = 0;
+
+      if (!::WriteFile(file, buffer.data + total, chunk, &written, nullptr)) {
+        error = std::system_category().message(GetLastError());
+
+        return false;
+      }
+      total += written;
+    }
+  }
+
+  return true;
+}
+
+/** Reads exactly length bytes of a file starting at offset into buffer. */
+bool ReadFileInto(const char* path, uint64_t offset, char* buffer, size_t length,
+  std::string& error /*OUT*/) {
+  HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+    nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    error = std::system_category().message(GetLastError());
+
+    return false;
+  }
+
+  LARGE_INTEGER position;
+  position.QuadPart = static_cast<LONGLONG>(offset);
+  if (!SetFilePointerEx(file, position, nullptr, FILE_BEGIN)) {
+    error = std::system_category().message(GetLastError());
+    CloseHandle(file);
+
+    return false;
+  }
+
+  size_t total = 0;
+  while (total < length) {
+    const auto chunk = static_cast<DWORD>(std::min<size_t>(length - total, 1u << 30));
+    DWORD bytes_read = 0;
+
+    if (!::ReadFile(file, buffer + total, chunk, &bytes_read, nullptr) || bytes_read == 0) {
+      error = bytes_read == 0 ? "Unexpected end of file"
+                              : std::system_category().message(GetLastError());
+      CloseHandle(file);
+
+      return false;
+    }
+    total += bytes_read;
+  }
+
+  CloseHandle(file);
+  return true;
+}
+
+/** Closes a file opened by OpenFileForWriting. */
+void CloseFile(FileHandle file) {
+  if (file != kInvalidFileHandle) {
+    CloseHandle(file);
+  }
+}
+
+/** Creates a uniquely named file next to target_path, to be renamed over it
+ *  once it is complete. */
+FileHandle CreateTempFileFor(const char* target_path, std::string& temp_path /*OUT*/,
+  std::string& error /*OUT*/) {
+  static unsigned int counter = 0;
+
+  for (auto attempt = 0; attempt < 100; attempt++) {
+    temp_path = std::string(target_path) + ".tmp-" + std::to_string(GetCurrentProcessId()) +
+      "-" + std::to_string(counter++);
+
+    FileHandle file = CreateFileA(temp_path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_NEW,
+      FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file != kInvalidFileHandle) {
+      return file;
+    }
+
+    if (GetLastError() != ERROR_FILE_EXISTS) {
+      break;
+    }
+  }
+
+  error = std::system_category().message(GetLastError());
+  return kInvalidFileHandle;
+}
+
+/** Flushes a file's contents to the storage device. */
+bool SyncFile(FileHandle file, std::string& error /*OUT*/) {
+  if (!FlushFileBuffers(file)) {
+    error = std::system_category().message(GetLastError());
+
+    return false;
+  }
+
+  return true;
+}
+
+/** Renames from to to, replacing to if it exists. */
+bool RenameFileOver(const char* from, const char* to, std::string& error /*OUT*/) {
+  if (!MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+    error = std::system_category().message(GetLastError());
+
+    return false;
+  }
+
+  return true;
+}
+
+/** Lists the entries of a directory. FindFirstFile reports sizes and
+ *  modification times for free, so with_stats makes no difference. */
+bool ListDirectory(const char* path, bool with_stats, std::vector<DirectoryEntry>& entries /*OUT*/,
+  std::string& error /*OUT*/) {
+  // Offset between the Windows (1601) and unix (1970) epoch in 100ns ticks
+  const uint64_t kEpochOffset = 116444736000000000ull;
+  const auto pattern = std::string(path) + "\\*";
+
+  WIN32_FIND_DATAA find_data;
+  HANDLE find_handle = FindFirstFileExA(pattern.c_str(), FindExInfoBasic, &find_data,
+    FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH);
+  if (find_handle == INVALID_HANDLE_VALUE) {
+    error = std::system_category().message(GetLastError());
+
+    return false;
+  }
+
+  do {
+    const char* name = find_data.cFileName;
+    if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
+      continue;
+    }
+
+    const auto is_directory = (find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+    const auto size = static_cast<uint64_t>(find_data.nFileSizeHigh) << 32 | find_data.nFileSizeLow;
+    const auto ticks = static_cast<uint64_t>(find_data.ftLastWriteTime.dwHighDateTime) << 32 |
+                       find_data.ftLastWriteTime.dwLowDateTime;
+
+    entries.push_back({name, is_directory, is_directory ? 0 : size,
+                       static_cast<double>(ticks - kEpochOffset) / 10000.0});
+  } while (FindNextFileA(find_handle, &find_data));
+
+  FindClose(find_handle);
+  return true;
+}
+
+/** Gets type, size and modification time of path. Reparse points are
+ *  reported as symlinks unless follow_symlinks is set. */
+bool StatPath(const char* path, bool follow_symlinks, PathStat& stat /*OUT*/,
+  std::string& error /*OUT*/) {
+  // Offset between the Windows (1601) and unix (1970) epoch in 100ns ticks
+  const uint64_t kEpochOffset = 116444736000000000ull;
+
+  WIN32_FILE_ATTRIBUTE_DATA data;
+  if (!GetFileAttributesExA(path, GetFileExInfoStandard, &data)) {
+    error = std::system_category().message(GetLastError());
+
+    return false;
+  }
+
+  const auto attributes = data.dwFileAttributes;
+  stat.type = !follow_symlinks && (attributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0
+                ? WalkEntryType::kSymlink
+              : (attributes & FILE_ATTRIBUTE_DIRECTORY) != 0 ? WalkEntryType::kDirectory
+                                                             : WalkEntryType::kFile;
+  stat.size = static_cast<uint64_t>(data.nFileSizeHigh) << 32 | data.nFileSizeLow;
+  const auto ticks = static_cast<uint64_t>(data.ftLastWriteTime.dwHighDateTime) << 32 |
+                     data.ftLastWriteTime.dwLowDateTime;
+  stat.mtime = static_cast<double>(ticks - kEpochOffset) / 10000.0;
+  stat.mode = 0;
+
+  return true;
+}
+
+/** io_uring is Linux-only, batches always run on the thread pool. */
+bool UringAvailable() {
+  return false;
+}
+
+bool RunBatchWithUring(const std::vector<BatchOp>& ops, std::vector<BatchOpResult>& results /*OUT*/,
+  std::string& error /*OUT*/) {
+  error = "Not supported on Windows yet";
+  return false;
+}
+
+/** Runs a single batch operation with plain api calls. */
+void RunBatchOp(const BatchOp& op, BatchOpResult& result /*OUT*/) {
+  BOOL succeeded = TRUE;
+
+  switch (op.type) {
+    case BatchOpType::kStat:
+    case BatchOpType::kLstat:
+      StatPath(op.path.c_str(), op.type == BatchOpType::kStat, result.stat, result.error);
+      return;
+    case BatchOpType::kRead: {
+      PathStat stat;
+      if (!StatPath(op.path.c_str(), true, stat, result.error)) {
+        return;
+      }
+      if (stat.type == WalkEntryType::kDirectory) {
+        result.error = "Is a directory";
+        return;
+      }
+
+      result.data.resize(static_cast<size_t>(stat.size));
+      if (!result.data.empty() &&
+          !ReadFileInto(op.path.c_str(), 0, result.data.data(), result.data.size(),
+                        result.error)) {
+        result.data.clear();
+      }
+      return;
+    }
+    case BatchOpType::kUnlink:
+      succeeded = DeleteFileA(op.path.c_str());
+      break;
+    case BatchOpType::kRmdir:
+      succeeded = RemoveDirectoryA(op.path.c_str());
+      break;
+    case BatchOpType::kRename:
+      succeeded = MoveFileExA(op.path.c_str(), op.target.c_str(), MOVEFILE_REPLACE_EXISTING);
+      break;
+    case BatchOpType::kMkdir:
+      succeeded = CreateDirectoryA(op.path.c_str(), nullptr);
+      break;
+  }
+
+  if (!succeeded) {
+    result.error = std::system_category().message(GetLastError());
+  }
+}
+
 };
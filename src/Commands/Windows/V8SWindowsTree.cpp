@@ -0,0 +1,557 @@
+#include "V8SWindowsApi.h"
+#include "ThreadPool.h"
+
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <utility>
+
+namespace fs = std::filesystem;
+
+namespace Commands {
+
+namespace {
+
+// Matches '*' and '?' wildcards, '*' also crosses '/' like fnmatch without FNM_PATHNAME
+bool GlobMatch(const char* pattern, const char* text) {
+  const char* star = nullptr;
+  const char* resume = nullptr;
+
+  while (*text != '\0') {
+    if (*pattern == '*') {
+      star = pattern++;
+      resume = text;
+    } else if (*pattern == '?' || *pattern == *text) {
+      pattern++;
+      text++;
+    } else if (star != nullptr) {
+      pattern = star + 1;
+      text = ++resume;
+    } else {
+      return false;
+    }
+  }
+
+  while (*pattern == '*') {
+    pattern++;
+  }
+
+  return *pattern == '\0';
+}
+
+bool MatchesAny(const std::vector<std::string>& patterns, const std::string& name,
+    const std::string& relative_path) {
+  for (const auto& pattern : patterns) {
+    const auto& subject = pattern.find('/') == std::string::npos ? name : relative_path;
+    if (GlobMatch(pattern.c_str(), subject.c_str())) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+double ToMilliseconds(fs::file_time_type time) {
+  const auto since_epoch = time.time_since_epoch() -
+    std::chrono::duration_cast<fs::file_time_type::duration>(std::chrono::seconds(11644473600LL));
+
+  return std::chrono::duration<double, std::milli>(since_epoch).count();
+}
+
+class TreeWalker {
+ public:
+  TreeWalker(const WalkOptions& options, const WalkSink& sink)
+    : options_(options), sink_(sink), pool_(options.threads) {}
+
+  void Run(const fs::path& root, WalkResult& result /*OUT*/) {
+    pool_.Submit([this, root] { ScanDirectory(root, std::string(), 0); });
+    pool_.Wait();
+
+    result.entries = entries_;
+    result.directories = directories_;
+    result.errors = errors_;
+    result.first_error = first_error_;
+  }
+
+ private:
+  bool Cancelled() const {
+    return options_.cancel != nullptr && options_.cancel->load(std::memory_order_relaxed);
+  }
+
+  void RecordError(const std::string& relative_path, const std::error_code& error) {
+    std::lock_guard<std::mutex> lock(error_mutex_);
+    if (errors_++ == 0) {
+      first_error_ = (relative_path.empty() ? std::string(".") : relative_path) + ": " +
+                     error.message();
+    }
+  }
+
+  // Returns false if the directory was seen before, which only happens through link cycles
+  bool RememberDirectory(const fs::path& directory) {
+    std::error_code error;
+    auto canonical = fs::canonical(directory, error);
+    if (error) {
+      return true;
+    }
+
+    std::lock_guard<std::mutex> lock(visited_mutex_);
+    return visited_.insert(canonical.u8string()).second;
+  }
+
+  void ScanDirectory(const fs::path& directory, const std::string& relative_path, int depth) {
+    if (Cancelled()) {
+      return;
+    }
+    if (options_.follow_symlinks && !RememberDirectory(directory)) {
+      return;
+    }
+
+    directories_++;
+
+    std::vector<WalkEntry> batch;
+    const int child_depth = depth + 1;
+    const bool report_children = options_.max_depth < 0 || child_depth <= options_.max_depth;
+    const bool descend = options_.max_depth < 0 || child_depth < options_.max_depth;
+
+    std::error_code error;
+    fs::directory_iterator iterator(directory, error);
+    if (error) {
+      RecordError(relative_path, error);
+      return;
+    }
+
+    for (const auto& dir_entry : iterator) {
+      const auto name = dir_entry.path().filename().u8string();
+      auto child_path = relative_path.empty() ? name : relative_path + '/' + name;
+      if (!options_.exclude.empty() && MatchesAny(options_.exclude, name, child_path)) {
+        continue;
+      }
+
+      WalkEntry entry;
+      const bool is_link = dir_entry.is_symlink(error);
+      const auto status = options_.follow_symlinks || !is_link
+        ? dir_entry.status(error) : dir_entry.symlink_status(error);
+
+      if (is_link && (!options_.follow_symlinks || error)) {
+        entry.type = WalkEntryType::kSymlink;
+      } else if (fs::is_regular_file(status)) {
+        entry.type = WalkEntryType::kFile;
+      } else if (fs::is_directory(status)) {
+        entry.type = WalkEntryType::kDirectory;
+      } else {
+        entry.type = WalkEntryType::kOther;
+      }
+
+      if (options_.stats) {
+        if (entry.type == WalkEntryType::kFile) {
+          entry.size = dir_entry.file_size(error);
+        }
+        entry.mtime = ToMilliseconds(dir_entry.last_write_time(error));
+      }
+
+      if (entry.type == WalkEntryType::kDirectory && descend) {
+        pool_.Submit([this, child = dir_entry.path(), child_path, child_depth] {
+          ScanDirectory(child, child_path, child_depth);
+        });
+      }
+
+      if (report_children &&
+          (options_.include.empty() || MatchesAny(options_.include, name, child_path))) {
+        entry.path = std::move(child_path);
+        batch.push_back(std::move(entry));
+
+        if (batch.size() >= options_.batch_size) {
+          Flush(batch);
+        }
+      }
+    }
+
+    Flush(batch);
+  }
+
+  void Flush(std::vector<WalkEntry>& batch) {
+    if (batch.empty()) {
+      return;
+    }
+
+    entries_ += batch.size();
+    sink_(batch);
+    batch.clear();
+  }
+
+  const WalkOptions& options_;
+  const WalkSink& sink_;
+  WorkStealingPool pool_;
+  std::atomic<uint64_t> entries_{0};
+  std::atomic<uint64_t> directories_{0};
+  std::mutex error_mutex_;
+  uint64_t errors_ = 0;
+  std::string first_error_;
+  std::mutex visited_mutex_;
+  std::set<std::string> visited_;
+};
+
+};
+
+bool WalkTree(const char* root, const WalkOptions& options, const WalkSink& sink,
+    WalkResult& result /*OUT*/, std::string& error /*OUT*/) {
+  std::error_code status_error;
+  if (!fs::is_directory(root, status_error)) {
+    error = status_error ? status_error.message() : "Not a directory";
+
+    return false;
+  }
+
+  auto walk_options = options;
+  if (walk_options.batch_size == 0) {
+    walk_options.batch_size = 1;
+  }
+
+  TreeWalker walker(walk_options, sink);
+  walker.Run(fs::u8path(root), result);
+
+  return true;
+}
+
+namespace {
+
+class TreeCopier;
+
+// A directory being copied. The last task referencing it restores the target's
+// timestamp, which has to happen after all its entries were written
+struct CopyDirectory {
+  CopyDirectory(TreeCopier* copier, fs::path source, fs::path target,
+      std::shared_ptr<CopyDirectory> parent)
+    : copier(copier), source(std::move(source)), target(std::move(target)),
+      parent(std::move(parent)) {}
+  ~CopyDirectory();
+
+  TreeCopier* const copier;
+  const fs::path source;
+  const fs::path target;
+  // Keeps the parent unfinished until this directory is done
+  const std::shared_ptr<CopyDirectory> parent;
+  std::string relative_path;
+};
+
+class TreeCopier {
+ public:
+  explicit TreeCopier(const CopyOptions& options) : pool_(options.threads) {}
+
+  void Run(const fs::path& source, const fs::path& target, CopyResult& result /*OUT*/) {
+    {
+      auto root = std::make_shared<CopyDirectory>(this, source, target, nullptr);
+      pool_.Submit([this, root] { ScanDirectory(root); });
+    }
+    pool_.Wait();
+
+    Collect(result);
+  }
+
+  /** Copies one regular file, CopyFile2 underneath keeps attributes and timestamps. */
+  bool CopyRegularFile(const fs::path& source, const fs::path& target,
+      const std::string& relative_path) {
+    std::error_code error;
+    const auto size = fs::file_size(source, error);
+    if (!error) {
+      fs::copy_file(source, target, fs::copy_options::overwrite_existing, error);
+    }
+    if (error) {
+      RecordError(relative_path, error.message());
+      return false;
+    }
+
+    files_++;
+    bytes_ += size;
+    return true;
+  }
+
+  void RecordError(const std::string& relative_path, const std::string& message) {
+    std::lock_guard<std::mutex> lock(error_mutex_);
+    if (errors_++ == 0) {
+      first_error_ = (relative_path.empty() ? std::string(".") : relative_path) + ": " + message;
+    }
+  }
+
+  void Collect(CopyResult& result /*OUT*/) {
+    result.files = files_;
+    result.directories = directories_;
+    result.bytes = bytes_;
+    result.errors = errors_;
+    result.first_error = first_error_;
+  }
+
+ private:
+  void ScanDirectory(const std::shared_ptr<CopyDirectory>& directory) {
+    directories_++;
+
+    std::error_code error;
+    fs::directory_iterator iterator(directory->source, error);
+    if (error) {
+      RecordError(directory->relative_path, error.message());
+      return;
+    }
+
+    for (const auto& dir_entry : iterator) {
+      const auto name = dir_entry.path().filename();
+      auto child_path = directory->relative_path.empty()
+        ? name.u8string() : directory->relative_path + '/' + name.u8string();
+      const auto status = dir_entry.symlink_status(error);
+      if (error) {
+        RecordError(child_path, error.message());
+        continue;
+      }
+
+      const auto target = directory->target / name;
+      if (fs::is_directory(status)) {
+        fs::create_directory(target, error);
+        if (error) {
+          RecordError(child_path, error.message());
+          continue;
+        }
+
+        auto child = std::make_shared<CopyDirectory>(this, dir_entry.path(), target, directory);
+        child->relative_path = std::move(child_path);
+        pool_.Submit([this, child] { ScanDirectory(child); });
+      } else if (fs::is_regular_file(status)) {
+        pool_.Submit([this, directory, source = dir_entry.path(), target, child_path] {
+          CopyRegularFile(source, target, child_path);
+        });
+      } else if (fs::is_symlink(status)) {
+        fs::copy_symlink(dir_entry.path(), target, error);
+        if (error) {
+          RecordError(child_path, error.message());
+        } else {
+          files_++;
+        }
+      } else {
+        RecordError(child_path, "Unsupported file type");
+      }
+    }
+  }
+
+  WorkStealingPool pool_;
+  std::atomic<uint64_t> files_{0};
+  std::atomic<uint64_t> directories_{0};
+  std::atomic<uint64_t> bytes_{0};
+  std::mutex error_mutex_;
+  uint64_t errors_ = 0;
+  std::string first_error_;
+};
+
+CopyDirectory::~CopyDirectory() {
+  std::error_code error;
+  const auto time = fs::last_write_time(source, error);
+  if (!error) {
+    fs::last_write_time(target, time, error);
+  }
+  if (error) {
+    copier->RecordError(relative_path, error.message());
+  }
+}
+
+};
+
+bool CopyTree(const char* from, const char* to, const CopyOptions& options,
+    CopyResult& result /*OUT*/, std::string& error /*OUT*/) {
+  const auto source = fs::u8path(from);
+  const auto target = fs::u8path(to);
+  std::error_code status_error;
+  const auto status = fs::status(source, status_error);
+  if (status_error) {
+    error = status_error.message();
+
+    return false;
+  }
+
+  // Block cloning needs ReFS and per-extent ioctls, plain copies are used instead
+  if (fs::is_regular_file(status)) {
+    auto single_file_options = options;
+    single_file_options.threads = 1;
+    TreeCopier copier(single_file_options);
+    const bool copied = copier.CopyRegularFile(source, target, to);
+    copier.Collect(result);
+    if (!copied) {
+      error = result.first_error;
+    }
+
+    return copied;
+  }
+
+  if (!fs::is_directory(status)) {
+    error = "Unsupported file type";
+
+    return false;
+  }
+  if (!options.recursive) {
+    error = "Is a directory, pass recursive to copy it";
+
+    return false;
+  }
+
+  fs::create_directory(target, status_error);
+  if (status_error) {
+    error = status_error.message();
+
+    return false;
+  }
+
+  TreeCopier copier(options);
+  copier.Run(source, target, result);
+
+  return true;
+}
+
+
+namespace {
+
+class TreeRemover;
+
+// A directory being emptied. The last task referencing it removes the directory
+// itself, which only succeeds once all its entries are gone
+struct RemoveDirectory {
+  RemoveDirectory(TreeRemover* remover, fs::path path, std::shared_ptr<RemoveDirectory> parent)
+    : remover(remover), path(std::move(path)), parent(std::move(parent)) {}
+  ~RemoveDirectory();
+
+  TreeRemover* const remover;
+  const fs::path path;
+  // Keeps the parent around until this directory is gone
+  const std::shared_ptr<RemoveDirectory> parent;
+  std::string relative_path;
+};
+
+class TreeRemover {
+ public:
+  explicit TreeRemover(const RemoveOptions& options) : pool_(options.threads) {}
+
+  void Run(const fs::path& root, RemoveResult& result /*OUT*/) {
+    {
+      auto directory = std::make_shared<RemoveDirectory>(this, root, nullptr);
+      pool_.Submit([this, directory] { ScanDirectory(directory); });
+    }
+    pool_.Wait();
+
+    result.files = files_;
+    result.directories = directories_;
+    result.bytes_freed = bytes_freed_;
+    result.errors = errors_;
+    result.first_error = first_error_;
+  }
+
+  void RemovedDirectory() { directories_++; }
+
+  void RecordError(const std::string& relative_path, const std::error_code& error) {
+    std::lock_guard<std::mutex> lock(error_mutex_);
+    if (errors_++ == 0) {
+      first_error_ = (relative_path.empty() ? std::string(".") : relative_path) + ": " +
+                     error.message();
+    }
+  }
+
+ private:
+  void ScanDirectory(const std::shared_ptr<RemoveDirectory>& directory) {
+    std::error_code error;
+    fs::directory_iterator iterator(directory->path, error);
+    if (error) {
+      RecordError(directory->relative_path, error);
+      return;
+    }
+
+    for (const auto& dir_entry : iterator) {
+      const auto name = dir_entry.path().filename().u8string();
+      auto child_path = directory->relative_path.empty()
+        ? name : directory->relative_path + '/' + name;
+      const auto status = dir_entry.symlink_status(error);
+      if (error) {
+        RecordError(child_path, error);
+        continue;
+      }
+
+      if (fs::is_directory(status)) {
+        auto child = std::make_shared<RemoveDirectory>(this, dir_entry.path(), directory);
+        child->relative_path = std::move(child_path);
+        pool_.Submit([this, child] { ScanDirectory(child); });
+        continue;
+      }
+
+      const auto size = fs::is_regular_file(status) ? dir_entry.file_size(error) : 0;
+      if (!fs::remove(dir_entry.path(), error)) {
+        RecordError(child_path, error);
+        continue;
+      }
+
+      files_++;
+      bytes_freed_ += size;
+    }
+  }
+
+  WorkStealingPool pool_;
+  std::atomic<uint64_t> files_{0};
+  std::atomic<uint64_t> directories_{0};
+  std::atomic<uint64_t> bytes_freed_{0};
+  std::mutex error_mutex_;
+  uint64_t errors_ = 0;
+  std::string first_error_;
+};
+
+RemoveDirectory::~RemoveDirectory() {
+  // The root is removed by RemoveTree() once the pool is done
+  if (parent == nullptr) {
+    return;
+  }
+
+  std::error_code error;
+  if (!fs::remove(path, error)) {
+    remover->RecordError(relative_path, error);
+    return;
+  }
+  remover->RemovedDirectory();
+}
+
+};
+
+bool RemoveTree(const char* path, const RemoveOptions& options, RemoveResult& result /*OUT*/,
+    std::string& error /*OUT*/) {
+  const auto root = fs::u8path(path);
+  std::error_code status_error;
+  const auto status = fs::symlink_status(root, status_error);
+  if (status_error) {
+    error = status_error.message();
+
+    return false;
+  }
+
+  if (!fs::is_directory(status)) {
+    const auto size = fs::is_regular_file(status) ? fs::file_size(root, status_error) : 0;
+    if (!fs::remove(root, status_error)) {
+      error = status_error ? status_error.message() : "No such file or directory";
+
+      return false;
+    }
+
+    result.files = 1;
+    result.bytes_freed = size;
+    return true;
+  }
+
+  TreeRemover remover(options);
+  remover.Run(root, result);
+
+  if (!fs::remove(root, status_error)) {
+    // Entries that could not be removed already explain why the root is left over
+    if (result.errors == 0) {
+      error = status_error.message();
+
+      return false;
+    }
+    return true;
+  }
+
+  result.directories++;
+  return true;
+}
+
+};
@@ -0,0 +1,572 @@
+// This File contains worker isolates that run scripts on threads of their own
+
+#include <unordered_map>
+
+#include "Commands.h"
+#include "Worker.h"
+
+namespace Commands {
+
+namespace {
+
+// Workers per host isolate, so a host can terminate its workers before it goes away
+std::mutex registry_mutex;
+std::unordered_map<v8::Isolate*, std::vector<std::shared_ptr<WorkerThread>>> registry;
+
+class Serializer : public v8::ValueSerializer::Delegate {
+ public:
+  Serializer(v8::Isolate* isolate, SerializedMessage& message)
+    : isolate_(isolate), message_(message), serializer_(isolate, this) {}
+
+  /** Writes value, transferring the ArrayBuffers in transfer_list. Returns
+   *  false with an exception scheduled if value cannot be cloned. */
+  bool Write(v8::Local<v8::Value> value, v8::Local<v8::Value> transfer_list) {
+    auto context = isolate_->GetCurrentContext();
+    std::vector<v8::Local<v8::ArrayBuffer>> transferred;
+
+    if (!transfer_list.IsEmpty() && transfer_list->IsArray()) {
+      auto array = transfer_list.As<v8::Array>();
+      for (uint32_t i = 0; i < array->Length(); i++) {
+        v8::Local<v8::Value> element;
+        if (!array->Get(context, i).ToLocal(&element)) {
+          return false;
+        }
+        if (!element->IsArrayBuffer()) {
+          isolate_->ThrowError("[Error] Only ArrayBuffers can be transferred");
+          return false;
+        }
+
+        auto buffer = element.As<v8::ArrayBuffer>();
+        if (!buffer->IsDetachable() ||
+            std::find(transferred.begin(), transferred.end(), buffer) != transferred.end()) {
+          isolate_->ThrowError("[Error] ArrayBuffer cannot be transferred");
+          return false;
+        }
+        serializer_.TransferArrayBuffer(static_cast<uint32_t>(transferred.size()), buffer);
+        transferred.push_back(buffer);
+      }
+    }
+
+    serializer_.WriteHeader();
+    if (!serializer_.WriteValue(context, value).FromMaybe(false)) {
+      return false;
+    }
+
+    // Only detached once the value was written, a failed clone leaves them usable
+    for (auto buffer : transferred) {
+      message_.transferred.push_back(buffer->GetBackingStore());
+      buffer->Detach(v8::Local<v8::Value>()).Check();
+    }
+
+    auto data = serializer_.Release();
+    message_.data.reset(data.first);
+    message_.size = data.second;
+
+    return true;
+  }
+
+  void ThrowDataCloneError(v8::Local<v8::String> message) override {
+    isolate_->ThrowException(v8::Exception::Error(message));
+  }
+
+  v8::Maybe<uint32_t> GetSharedArrayBufferId(v8::Isolate*,
+    v8::Local<v8::SharedArrayBuffer> buffer) override {
+    auto store = buffer->GetBackingStore();
+    for (size_t i = 0; i < message_.shared.size(); i++) {
+      if (message_.shared[i] == store) {
+        return v8::Just(static_cast<uint32_t>(i));
+      }
+    }
+
+    message_.shared.push_back(std::move(store));
+    return v8::Just(static_cast<uint32_t>(message_.shared.size() - 1));
+  }
+
+ private:
+  v8::Isolate* isolate_;
+  SerializedMessage& message_;
+  v8::ValueSerializer serializer_;
+};
+
+class Deserializer : public v8::ValueDeserializer::Delegate {
+ public:
+  explicit Deserializer(SerializedMessage& message) : message_(message) {}
+
+  v8::MaybeLocal<v8::SharedArrayBuffer> GetSharedArrayBufferFromId(v8::Isolate* isolate,
+    uint32_t clone_id) override {
+    if (clone_id >= message_.shared.size()) {
+      isolate->ThrowError("[Error] Invalid SharedArrayBuffer in message");
+      return {};
+    }
+
+    return v8::SharedArrayBuffer::New(isolate, message_.shared[clone_id]);
+  }
+
+ private:
+  SerializedMessage& message_;
+};
+
+/** The 'postMessage' function of a worker's global object. */
+void WorkerGlobalPostMessage(const v8::FunctionCallbackInfo<v8::Value>& args) {
+  auto* worker = static_cast<WorkerThread*>(args.Data().As<v8::External>()->Value());
+
+  SerializedMessage message;
+  if (SerializeMessage(args.GetIsolate(), args[0], args[1], message)) {
+    worker->PostToHost(std::move(message));
+  }
+}
+
+/** The 'close' function of a worker's global object, ends the worker once the
+ *  current callback returned. */
+void WorkerGlobalClose(const v8::FunctionCallbackInfo<v8::Value>& args) {
+  static_cast<WorkerThread*>(args.Data().As<v8::External>()->Value())->Close();
+}
+
+/** The 'quit' and 'exit' functions of a worker's global object. Unlike the
+ *  shell's, they only end the worker, right away and with an exit code. */
+void WorkerGlobalQuit(const v8::FunctionCallbackInfo<v8::Value>& args) {
+  auto* isolate = args.GetIsolate();
+  const auto exit_code = args[0]->Int32Value(isolate->GetCurrentContext()).FromMaybe(0);
+  static_cast<WorkerThread*>(args.Data().As<v8::External>()->Value())->Quit(exit_code);
+}
+
+};
+
+/** Serializes value for another isolate. transfer_list may be an array of
+ *  ArrayBuffers, which are detached here and handed over without a copy.
+ *  Returns false with an exception scheduled if value cannot be cloned. */
+bool SerializeMessage(v8::Isolate* isolate, v8::Local<v8::Value> value,
+  v8::Local<v8::Value> transfer_list, SerializedMessage& message /*OUT*/) {
+  return Serializer(isolate, message).Write(value, transfer_list);
+}
+
+/** Recreates a serialized value in isolate. Transferred ArrayBuffers take
+ *  over their backing stores. */
+v8::MaybeLocal<v8::Value> DeserializeMessage(v8::Isolate* isolate, SerializedMessage& message) {
+  auto context = isolate->GetCurrentContext();
+  Deserializer delegate(message);
+  v8::ValueDeserializer deserializer(isolate, message.data.get(), message.size, &delegate);
+
+  if (!deserializer.ReadHeader(context).FromMaybe(false)) {
+    return {};
+  }
+  for (size_t i = 0; i < message.transferred.size(); i++) {
+    deserializer.TransferArrayBuffer(static_cast<uint32_t>(i),
+      v8::ArrayBuffer::New(isolate, message.transferred[i]));
+  }
+
+  return deserializer.ReadValue(context);
+}
+
+/** Sets what worker isolates are created with, has to be called before the
+ *  first worker starts. */
+void WorkerThread::Configure(const WorkerEnvironment& environment) {
+  environment_ = environment;
+}
+
+/** Starts a worker running the script at script_path on behalf of host. */
+std::shared_ptr<WorkerThread> WorkerThread::Start(v8::Isolate* host,
+  const std::string& script_path, Mode mode, Handlers handlers) {
+  auto worker = std::make_shared<WorkerThread>(host, script_path, mode, std::move(handlers));
+  {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    registry[host].push_back(worker);
+  }
+
+  worker->host_loop_->Ref();
+  worker->thread_ = std::thread(&WorkerThread::Main, worker.get());
+
+  return worker;
+}
+
+/** Terminates all workers of host and waits for them, has to be called on
+ *  host's thread before it is disposed. Their exit isn't reported anymore. */
+void WorkerThread::TerminateAll(v8::Isolate* host) {
+  std::vector<std::shared_ptr<WorkerThread>> workers;
+  {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    auto found = registry.find(host);
+    if (found == registry.end()) {
+      return;
+    }
+    workers.swap(found->second);
+    registry.erase(found);
+  }
+
+  for (auto& worker : workers) {
+    worker->Terminate();
+  }
+  for (auto& worker : workers) {
+    if (worker->thread_.joinable()) {
+      worker->thread_.join();
+    }
+    worker->handlers_ = Handlers();
+  }
+}
+
+WorkerThread::WorkerThread(v8::Isolate* host, const std::string& script_path, Mode mode,
+  Handlers handlers)
+  : host_(host), host_loop_(EventLoop::From(host)), handlers_(std::move(handlers)),
+    script_path_(script_path), cwd_(IsolateState::From(host)->GetCWD()), mode_(mode) {}
+
+WorkerThread::~WorkerThread() {
+  if (thread_.joinable()) {
+    thread_.detach();
+  }
+}
+
+/** Queues a message for the worker's 'onmessage', called on the host's thread.
+ *  Messages to a worker that is terminating are dropped. */
+void WorkerThread::PostToWorker(SerializedMessage message) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (terminating_) {
+    return;
+  }
+
+  inbox_.push_back(std::move(message));
+  if (in_run_) {
+    loop_->Post([this]() { DeliverMessages(); });
+  }
+  wakeup_.notify_one();
+}
+
+/** Sends a message to the host, called on the worker's thread. */
+void WorkerThread::PostToHost(SerializedMessage message) {
+  auto shared_message = std::make_shared<SerializedMessage>(std::move(message));
+  host_loop_->Post([self = shared_from_this(), shared_message]() {
+    if (self->handlers_.on_message) {
+      self->handlers_.on_message(self->host_, *shared_message);
+    }
+  });
+}
+
+/** Stops the worker: running JavaScript is aborted, its loop returns and
+ *  pending messages are dropped. Called on the host's thread. */
+void WorkerThread::Terminate() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  terminating_ = true;
+  inbox_.clear();
+
+  if (loop_ != nullptr) {
+    loop_->Stop();
+  }
+  if (isolate_ != nullptr) {
+    isolate_->TerminateExecution();
+  }
+  wakeup_.notify_one();
+}
+
+/** Stops the worker from its own thread once the current callback returned. */
+void WorkerThread::Close() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  terminating_ = true;
+  inbox_.clear();
+  loop_->Stop();
+}
+
+/** Stops the worker from its own thread with exit_code, aborting the running
+ *  script like Terminate() does. */
+void WorkerThread::Quit(int exit_code) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  exit_code_ = exit_code;
+  terminating_ = true;
+  inbox_.clear();
+  loop_->Stop();
+  isolate_->TerminateExecution();
+}
+
+/** The worker's thread: sets up its isolate, runs the script and its loop,
+ *  and tells the host once it is done. */
+void WorkerThread::Main() {
+  v8::Isolate::CreateParams create_params;
+  create_params.array_buffer_allocator = environment_.allocator;
+  create_params.constraints = environment_.constraints;
+  auto* isolate = v8::Isolate::New(create_params);
+
+  {
+    v8::Isolate::Scope isolate_scope(isolate);
+    EventLoop loop(isolate, environment_.platform);
+    // Starts out in the host's working directory
+    IsolateState state(isolate);
+    state.SetCWD(cwd_);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      isolate_ = isolate;
+      loop_ = &loop;
+      if (terminating_) {
+        loop.Stop();
+        isolate->TerminateExecution();
+      }
+    }
+
+    {
+      v8::HandleScope handle_scope(isolate);
+      auto context = v8::Context::New(isolate, nullptr, environment_.global_template(isolate));
+      v8::Context::Scope context_scope(context);
+
+      auto self = v8::External::New(isolate, this);
+      auto global = context->Global();
+      global->Set(context, v8::String::NewFromUtf8Literal(isolate, "postMessage"),
+        v8::Function::New(context, WorkerGlobalPostMessage, self).ToLocalChecked()).Check();
+      global->Set(context, v8::String::NewFromUtf8Literal(isolate, "close"),
+        v8::Function::New(context, WorkerGlobalClose, self).ToLocalChecked()).Check();
+      // The shell's quit() would end the whole process
+      auto quit = v8::Function::New(context, WorkerGlobalQuit, self).ToLocalChecked();
+      global->Set(context, v8::String::NewFromUtf8Literal(isolate, "quit"), quit).Check();
+      global->Set(context, v8::String::NewFromUtf8Literal(isolate, "exit"), quit).Check();
+
+      if (RunScript(context)) {
+        RunLoop(context);
+      }
+
+      // Workers this worker started go down with it
+      TerminateAll(isolate);
+      map_function_.Reset();
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      isolate_ = nullptr;
+      loop_ = nullptr;
+      terminating_ = true;
+      inbox_.clear();
+    }
+  }
+  isolate->Dispose();
+
+  host_loop_->Post([self = shared_from_this()]() { self->Exited(); });
+}
+
+/** Runs the worker's script. In map mode its value has to be the function
+ *  the items are mapped with. Returns false if the worker cannot go on. */
+bool WorkerThread::RunScript(v8::Local<v8::Context> context) {
+  auto* isolate = context->GetIsolate();
+  v8::TryCatch try_catch(isolate);
+
+  auto file_content = ReadFile(isolate, script_path_.c_str());
+  v8::Local<v8::String> source;
+  if (!file_content.has_value() || !file_content->ToLocal(&source)) {
+    auto message = "Cannot read worker script " + script_path_;
+    if (mode_ == Mode::kScript) {
+      PrintErrorTag();
+      std::cerr << " " << message << std::endl;
+    }
+    host_loop_->Post([self = shared_from_this(), message]() {
+      if (self->handlers_.on_error) {
+        self->handlers_.on_error(self->host_, message);
+      }
+    });
+    return false;
+  }
+
+  v8::ScriptOrigin origin(isolate,
+    v8::String::NewFromUtf8(isolate, script_path_.c_str()).ToLocalChecked());
+  v8::Local<v8::Script> script;
+  v8::Local<v8::Value> result;
+  if (!v8::Script::Compile(context, source, &origin).ToLocal(&script) ||
+      !script->Run(context).ToLocal(&result)) {
+    ReportError(try_catch);
+    return false;
+  }
+
+  if (mode_ == Mode::kMap) {
+    if (!result->IsFunction()) {
+      isolate->ThrowError("[Error] Script does not evaluate to a function");
+      ReportError(try_catch);
+      return false;
+    }
+    map_function_.Reset(isolate, result.As<v8::Function>());
+  }
+
+  return true;
+}
+
+/** Runs the worker's loop, waiting for messages whenever it ran dry, until
+ *  the worker is terminated or has no reason to wait anymore. */
+void WorkerThread::RunLoop(v8::Local<v8::Context> context) {
+  while (true) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      in_run_ = true;
+    }
+    DeliverMessages();
+    loop_->Run();
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      in_run_ = false;
+      if (terminating_) {
+        return;
+      }
+      if (!inbox_.empty()) {
+        continue;
+      }
+    }
+
+    if (!Listening(context)) {
+      return;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    wakeup_.wait(lock, [this]() { return terminating_ || !inbox_.empty(); });
+    if (terminating_) {
+      return;
+    }
+  }
+}
+
+/** Returns true if the worker waits for messages. */
+bool WorkerThread::Listening(v8::Local<v8::Context> context) {
+  if (mode_ == Mode::kMap) {
+    return true;
+  }
+
+  auto* isolate = context->GetIsolate();
+  v8::HandleScope handle_scope(isolate);
+  v8::Local<v8::Value> handler;
+
+  return context->Global()->Get(context,
+    v8::String::NewFromUtf8Literal(isolate, "onmessage")).ToLocal(&handler) &&
+    handler->IsFunction();
+}
+
+/** Dispatches all messages in the inbox, on the worker's thread. */
+void WorkerThread::DeliverMessages() {
+  std::deque<SerializedMessage> messages;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    messages.swap(inbox_);
+  }
+
+  auto* isolate = isolate_;
+  for (auto& message : messages) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (terminating_) {
+        return;
+      }
+    }
+
+    v8::HandleScope handle_scope(isolate);
+    Dispatch(isolate->GetCurrentContext(), message);
+    isolate->PerformMicrotaskCheckpoint();
+  }
+}
+
+/** Hands a message to the worker's script: onmessage({data}) in script mode,
+ *  the map function for every item in map mode. */
+void WorkerThread::Dispatch(v8::Local<v8::Context> context, SerializedMessage& message) {
+  auto* isolate = context->GetIsolate();
+  v8::TryCatch try_catch(isolate);
+
+  v8::Local<v8::Value> data;
+  if (!DeserializeMessage(isolate, message).ToLocal(&data)) {
+    ReportError(try_catch);
+    return;
+  }
+
+  if (mode_ == Mode::kScript) {
+    v8::Local<v8::Value> handler;
+    if (!context->Global()->Get(context,
+        v8::String::NewFromUtf8Literal(isolate, "onmessage")).ToLocal(&handler) ||
+        !handler->IsFunction()) {
+      return;
+    }
+
+    auto event = v8::Object::New(isolate);
+    event->Set(context, v8::String::NewFromUtf8Literal(isolate, "data"), data).Check();
+    v8::Local<v8::Value> call_args[] = {event};
+    if (handler.As<v8::Function>()->Call(context, context->Global(), 1, call_args).IsEmpty()) {
+      ReportError(try_catch);
+    }
+    return;
+  }
+
+  auto start_key = v8::String::NewFromUtf8Literal(isolate, "start");
+  auto start = GetOption(isolate, data, "start");
+  auto items = GetOption(isolate, data, "items");
+  if (!start->IsNumber() || !items->IsArray()) {
+    return;
+  }
+
+  auto function = map_function_.Get(isolate);
+  auto item_array = items.As<v8::Array>();
+  const auto first_index = start->NumberValue(context).FromMaybe(0);
+  std::vector<v8::Local<v8::Value>> results;
+  results.reserve(item_array->Length());
+
+  for (uint32_t i = 0; i < item_array->Length(); i++) {
+    v8::Local<v8::Value> call_args[] = {item_array->Get(context, i).ToLocalChecked(),
+                                        v8::Number::New(isolate, first_index + i)};
+    v8::Local<v8::Value> result;
+    if (!function->Call(context, v8::Undefined(isolate), 2, call_args).ToLocal(&result)) {
+      ReportError(try_catch);
+      return;
+    }
+    results.push_back(result);
+  }
+
+  auto reply = v8::Object::New(isolate);
+  reply->Set(context, start_key, start).Check();
+  reply->Set(context, v8::String::NewFromUtf8Literal(isolate, "results"),
+    v8::Array::New(isolate, results.data(), results.size())).Check();
+
+  SerializedMessage reply_message;
+  if (!SerializeMessage(isolate, reply, v8::Local<v8::Value>(), reply_message)) {
+    ReportError(try_catch);
+    return;
+  }
+  PostToHost(std::move(reply_message));
+}
+
+/** Reports an uncaught exception of the worker. The host's error handler gets
+ *  its message, scripts print it as well like the main isolate does. */
+void WorkerThread::ReportError(v8::TryCatch& try_catch) {
+  // Termination isn't an error of the script
+  if (!try_catch.HasCaught() || try_catch.HasTerminated()) {
+    return;
+  }
+
+  auto* isolate = isolate_;
+  v8::String::Utf8Value exception(isolate, try_catch.Exception());
+  std::string message = ToCString(exception);
+  if (mode_ == Mode::kScript) {
+    ReportException(isolate, &try_catch);
+  }
+  try_catch.Reset();
+
+  host_loop_->Post([self = shared_from_this(), message]() {
+    if (self->handlers_.on_error) {
+      self->handlers_.on_error(self->host_, message);
+    }
+  });
+}
+
+/** Runs on the host's thread once the worker's thread is done. */
+void WorkerThread::Exited() {
+  {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    auto found = registry.find(host_);
+    if (found == registry.end()) {
+      return;
+    }
+    // Gone if the host terminated all its workers meanwhile
+    auto& workers = found->second;
+    auto worker = std::find(workers.begin(), workers.end(), shared_from_this());
+    if (worker == workers.end()) {
+      return;
+    }
+    workers.erase(worker);
+  }
+
+  thread_.join();
+  host_loop_->Unref();
+
+  auto handlers = std::move(handlers_);
+  handlers_ = Handlers();
+  if (handlers.on_exit) {
+    handlers.on_exit(host_, exit_code_);
+  }
+}
+
+};
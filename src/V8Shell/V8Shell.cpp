@@ -14,13 +14,22 @@ V8Shell::V8Shell(int argc, const char** argv, int& exit_code)
     return;
   }
 
-  // no arguments -> run shell, otherwise make it depend on the arguments
-  settings_.run_shell = (argc == 1);
-
   v8::V8::InitializePlatform(platform_.get());
   v8::V8::SetFlagsFromCommandLine(&argc, const_cast<char**>(argv), true);
   v8::V8::Initialize();
 
+  // v8 removes the flags it consumed from argv
+  argc_ = argc;
+
+  ParseStartupFlags();
+
+  // The snapshot creator owns its own isolate
+  if (!settings_.build_snapshot_file.empty()) {
+    exit_code = 0;
+
+    return;
+  }
+
   auto v8_setup_valid = SetupV8Isolate();
   if (!v8_setup_valid) {
     Commands::PrintErrorTag();
@@ -34,27 +43,252 @@ V8Shell::V8Shell(int argc, const char** argv, int& exit_code)
 }
 
 V8Shell::~V8Shell() {
-  isolate_->Dispose();
+  if (isolate_ != nullptr) {
+    Commands::WorkerThread::TerminateAll(isolate_);
+    event_loop_.reset();
+    // Flushes the writers scripts left open
+    isolate_state_.reset();
+    isolate_->Dispose();
+  }
+  // The pool allocator's pages live in the sandbox, which goes away with v8
+  delete create_params_.array_buffer_allocator;
+  Commands::RuntimeMemory::pool_allocator = nullptr;
+  Commands::GcTracker::CloseLog();
   v8::V8::Dispose();
   v8::V8::DisposePlatform();
-  delete create_params_.array_buffer_allocator;
+}
+
+/** Matches flags of the form '--name value' and '--name=value'. On a match
+ *  value is set and i is advanced past a separate value argument. */
+static bool MatchValueFlag(int argc, const char** argv, int& i,
+                           const char* name, std::string& value /*OUT*/) {
+  const auto name_length = strlen(name);
+  if (strncmp(argv[i], name, name_length) != 0) {
+    return false;
+  }
+
+  if (argv[i][name_length] == '=') {
+    value = argv[i] + name_length + 1;
+
+    return true;
+  }
+
+  if (argv[i][name_length] == '\0' && i + 1 < argc) {
+    value = argv[++i];
+
+    return true;
+  }
+
+  return false;
+}
+
+/** Consumes the flags that have to be known before the isolate is created. */
+void V8Shell::ParseStartupFlags() {
+  startup_args_.assign(argc_, false);
+  auto script_args = 0;
+
+  for (int i = 1; i < argc_; i++) {
+    const auto first = i;
+    std::string value;
+
+    if (strcmp(argv_[i], "--cpu-prof") == 0) {
+      settings_.cpu_profile_file = "V8Shell.cpuprofile";
+    } else if (strncmp(argv_[i], "--cpu-prof=", 11) == 0) {
+      settings_.cpu_profile_file = argv_[i] + 11;
+    } else if (MatchValueFlag(argc_, argv_, i, "--snapshot", value)) {
+      settings_.snapshot_file = value;
+    } else if (MatchValueFlag(argc_, argv_, i, "--build-snapshot", value)) {
+      settings_.build_snapshot_file = value;
+    } else if (MatchValueFlag(argc_, argv_, i, "--parallel", value)) {
+      settings_.parallel_jobs = static_cast<unsigned int>(std::strtoul(value.c_str(), nullptr, 10));
+      if (settings_.parallel_jobs == 0) {
+        settings_.parallel_jobs = Commands::WorkStealingPool::DefaultThreads();
+      }
+    } else if (MatchValueFlag(argc_, argv_, i, "--jobs-file", value)) {
+      settings_.jobs_file = value;
+    } else if (MatchValueFlag(argc_, argv_, i, "--ab-allocator", value)) {
+      if (value == "default" || value == "pool") {
+        settings_.ab_allocator = value;
+      } else {
+        Commands::PrintWarningTag();
+        std::cerr << " Unknown ArrayBuffer allocator " << value << ", using the default one"
+                  << std::endl;
+      }
+    } else if (MatchValueFlag(argc_, argv_, i, "--max-heap", value)) {
+      settings_.max_heap_size = std::strtoull(value.c_str(), nullptr, 10) * 1024 * 1024;
+    } else if (MatchValueFlag(argc_, argv_, i, "--young-gen-size", value)) {
+      settings_.young_generation_size = std::strtoull(value.c_str(), nullptr, 10) * 1024 * 1024;
+    } else if (MatchValueFlag(argc_, argv_, i, "--initial-heap", value)) {
+      settings_.initial_heap_size = std::strtoull(value.c_str(), nullptr, 10) * 1024 * 1024;
+    } else if (MatchValueFlag(argc_, argv_, i, "--gc-log", value)) {
+      if (!Commands::GcTracker::OpenLog(value)) {
+        Commands::PrintWarningTag();
+        std::cerr << " Cannot open GC log " << value << std::endl;
+      }
+    } else if (MatchValueFlag(argc_, argv_, i, "--code-cache-dir", value)) {
+      if (!Commands::RuntimeMemory::code_cache.SetDirectory(value)) {
+        Commands::PrintWarningTag();
+        std::cerr << " Cannot use code cache directory " << value << std::endl;
+      }
+    } else if (MatchValueFlag(argc_, argv_, i, "--code-cache-size", value)) {
+      // Size limit is given in MiB
+      Commands::RuntimeMemory::code_cache.SetMaxSize(
+          std::strtoull(value.c_str(), nullptr, 10) * 1024 * 1024);
+    } else {
+      script_args++;
+
+      continue;
+    }
+
+    for (auto j = first; j <= i; j++) {
+      startup_args_[j] = true;
+    }
+  }
+
+  // no arguments -> run shell, otherwise make it depend on the arguments
+  settings_.run_shell = (script_args == 0 && settings_.jobs_file.empty());
 }
 
 /** Setup the V8 Isolate. */
 bool V8Shell::SetupV8Isolate() {
-  create_params_.array_buffer_allocator =
-      v8::ArrayBuffer::Allocator::NewDefaultAllocator();
-  isolate_ = v8::Isolate::New(create_params_);
+  if (settings_.ab_allocator == "pool") {
+    Commands::RuntimeMemory::pool_allocator = new Commands::PoolAllocator();
+    create_params_.array_buffer_allocator = Commands::RuntimeMemory::pool_allocator;
+  } else {
+    create_params_.array_buffer_allocator =
+        v8::ArrayBuffer::Allocator::NewDefaultAllocator();
+  }
 
   if (create_params_.array_buffer_allocator == nullptr) {
     return false;
   }
 
+  ConfigureHeap();
+
+  if (!settings_.snapshot_file.empty() && LoadSnapshot()) {
+    create_params_.snapshot_blob = &snapshot_blob_;
+    create_params_.external_references = ExternalReferences();
+  }
+
+  isolate_ = v8::Isolate::New(create_params_);
+  if (isolate_ == nullptr) {
+    return false;
+  }
+
+  event_loop_ = std::make_unique<Commands::EventLoop>(isolate_, platform_.get());
+  isolate_state_ = std::make_unique<Commands::IsolateState>(isolate_);
+  // Workers share the allocator, so ArrayBuffers can be transferred between isolates
+  Commands::WorkerThread::Configure({platform_.get(), create_params_.array_buffer_allocator,
+    create_params_.constraints, &CreateGlobalTemplate});
+
   return true;
 }
 
+/** Reads the snapshot passed via --snapshot. Returns false and warns if the
+ *  snapshot cannot be used, the shell then boots without it. */
+bool V8Shell::LoadSnapshot() {
+  std::ifstream input_file(settings_.snapshot_file, std::ios::binary);
+  if (!input_file) {
+    Commands::PrintWarningTag();
+    std::cerr << " Cannot open snapshot " << settings_.snapshot_file
+              << ", booting without it" << std::endl;
+
+    return false;
+  }
+
+  std::string header;
+  std::getline(input_file, header);
+
+  // Snapshots are only valid for the exact hook table and v8 build they were made with
+  if (header != SnapshotHeader()) {
+    Commands::PrintWarningTag();
+    std::cerr << " Snapshot " << settings_.snapshot_file
+              << " was built by a different shell, booting without it" << std::endl;
+
+    return false;
+  }
+
+  snapshot_data_.assign(std::istreambuf_iterator<char>(input_file),
+                        std::istreambuf_iterator<char>());
+  snapshot_blob_.data = snapshot_data_.data();
+  snapshot_blob_.raw_size = static_cast<int>(snapshot_data_.size());
+
+  if (!snapshot_blob_.IsValid()) {
+    Commands::PrintWarningTag();
+    std::cerr << " Snapshot " << settings_.snapshot_file
+              << " is corrupted, booting without it" << std::endl;
+
+    return false;
+  }
+
+  return true;
+}
+
+/** Derives the heap sizes of all isolates from the physical memory like d8
+ *  does, then applies --max-heap, --young-gen-size and --initial-heap. */
+void V8Shell::ConfigureHeap() {
+  auto& constraints = create_params_.constraints;
+  constraints.ConfigureDefaults(Commands::PhysicalMemorySize(), 0);
+
+  if (settings_.max_heap_size != 0) {
+    constraints.set_max_old_generation_size_in_bytes(settings_.max_heap_size);
+  }
+  if (settings_.young_generation_size != 0) {
+    constraints.set_max_young_generation_size_in_bytes(settings_.young_generation_size);
+  }
+  if (settings_.initial_heap_size != 0) {
+    constraints.set_initial_old_generation_size_in_bytes(
+      std::min(settings_.initial_heap_size, constraints.max_old_generation_size_in_bytes()));
+  }
+}
+
+/** Serializes a fresh shell context into the file passed via --build-snapshot. */
+int V8Shell::BuildSnapshot() {
+  v8::StartupData blob;
+  {
+    v8::SnapshotCreator creator(ExternalReferences());
+    auto* isolate = creator.GetIsolate();
+    {
+      v8::HandleScope handle_scope(isolate);
+      auto context = v8::Context::New(isolate, nullptr, CreateGlobalTemplate(isolate));
+      creator.SetDefaultContext(context);
+    }
+    blob = creator.CreateBlob(v8::SnapshotCreator::FunctionCodeHandling::kClear);
+  }
+
+  if (blob.data == nullptr) {
+    Commands::PrintErrorTag();
+    std::cerr << " Failed to create snapshot" << std::endl;
+
+    return 1;
+  }
+
+  std::ofstream output_file(settings_.build_snapshot_file, std::ios::binary);
+  output_file << SnapshotHeader() << '\n';
+  output_file.write(blob.data, blob.raw_size);
+  output_file.close();
+  delete[] blob.data;
+
+  if (!output_file) {
+    Commands::PrintErrorTag();
+    std::cerr << " Cannot write snapshot " << settings_.build_snapshot_file
+              << std::endl;
+
+    return 1;
+  }
+
+  return 0;
+}
+
 /** Process remaining command line arguments, execute files and possibly enter shell. */
 int V8Shell::Run() {
+  if (!settings_.build_snapshot_file.empty()) {
+    return BuildSnapshot();
+  }
+  if (settings_.parallel_jobs != 0 || !settings_.jobs_file.empty()) {
+    return RunParallel();
+  }
+
   v8::Isolate::Scope isolate_scope(isolate_);
   v8::HandleScope handle_scope(isolate_);
   v8::Local<v8::Context> context = CreateShellContext();
@@ -66,11 +300,16 @@ int V8Shell::Run() {
     return 1;
   }
   v8::Context::Scope context_scope(context);
+  // Written when the run is over, however it ends
+  Commands::ScopedCpuProfile cpu_profile(isolate_, settings_.cpu_profile_file);
 
   // Process remaining command line arguments and execute files.
   for (int i = 1; i < argc_; i++) {
     const char* str = argv_[i];
-    if (strcmp(str, "--shell") == 0) {
+    if (startup_args_[i]) {
+      // Already handled before the isolate was created
+      continue;
+    } else if (strcmp(str, "--shell") == 0) {
       settings_.run_shell = true;
     } else if (strcmp(str, "--no-shell") == 0) {
       settings_.run_shell = false;
@@ -92,7 +331,7 @@ int V8Shell::Run() {
       bool success =
           Commands::ExecuteString(isolate_, source, file_name, false, true);
       settings_.run_shell = false;
-      while (v8::platform::PumpMessageLoop(platform_.get(), isolate_)) continue;
+      event_loop_->Run();
       if (!success) return 1;
     } else if (strncmp(str, "-", 1) == 0) {
       Commands::PrintWarningTag();
@@ -117,9 +356,9 @@ int V8Shell::Run() {
       }
 
       bool success =
-          Commands::ExecuteString(isolate_, source, file_name, false, true);
+          Commands::ExecuteString(isolate_, source, file_name, false, true, true);
 
-      while (v8::platform::PumpMessageLoop(platform_.get(), isolate_)) continue;
+      event_loop_->Run();
 
       if (!success) return 1;
     }
@@ -132,14 +371,174 @@ int V8Shell::Run() {
   return 0;
 }
 
+/** Gathers the script files of a --parallel run: the file arguments followed
+ *  by the paths listed in the jobs file. Empty lines and lines starting with
+ *  '#' in the jobs file are skipped. */
+bool V8Shell::CollectBatchScripts(std::vector<std::string>& scripts /*OUT*/) {
+  for (int i = 1; i < argc_; i++) {
+    if (startup_args_[i]) {
+      continue;
+    }
+
+    if (strcmp(argv_[i], "-e") == 0) {
+      Commands::PrintWarningTag();
+      std::cerr << " -e is ignored in parallel mode" << std::endl;
+      i++;
+    } else if (strncmp(argv_[i], "-", 1) != 0) {
+      scripts.emplace_back(argv_[i]);
+    }
+  }
+
+  if (settings_.jobs_file.empty()) {
+    return true;
+  }
+
+  std::ifstream jobs_file(settings_.jobs_file);
+  if (!jobs_file) {
+    Commands::PrintErrorTag();
+    std::cerr << " Cannot read jobs file " << settings_.jobs_file << std::endl;
+
+    return false;
+  }
+
+  std::string line;
+  while (std::getline(jobs_file, line)) {
+    if (!line.empty() && line.back() == '\r') {
+      line.pop_back();
+    }
+    if (!line.empty() && line.front() != '#') {
+      scripts.push_back(std::move(line));
+    }
+  }
+
+  return true;
+}
+
+/** Runs the batch scripts on settings_.parallel_jobs threads instead of
+ *  starting one process per script. Every thread creates an isolate once and
+ *  runs one script after the other on it, each in a fresh context with its
+ *  own cwd, event loop and output buffers. A script's output is written in
+ *  one piece once it finished, so concurrent scripts never interleave.
+ *  Returns 0 if all scripts succeeded, otherwise the exit code of the first
+ *  failed script in the order they were given. */
+int V8Shell::RunParallel() {
+  std::vector<std::string> scripts;
+  if (!CollectBatchScripts(scripts)) {
+    return 1;
+  }
+
+  if (!settings_.cpu_profile_file.empty()) {
+    Commands::PrintWarningTag();
+    std::cerr << " --cpu-prof is ignored in parallel mode" << std::endl;
+  }
+
+  const auto threads = std::min<size_t>(
+    settings_.parallel_jobs != 0 ? settings_.parallel_jobs
+                                 : Commands::WorkStealingPool::DefaultThreads(),
+    scripts.size());
+  std::atomic<size_t> next_script{0};
+  std::vector<int> exit_codes(scripts.size(), 0);
+  std::mutex output_mutex;
+
+  auto run_scripts = [&]() {
+    auto* isolate = v8::Isolate::New(create_params_);
+    if (isolate == nullptr) {
+      for (auto i = next_script++; i < scripts.size(); i = next_script++) {
+        exit_codes[i] = 1;
+      }
+
+      return;
+    }
+
+    {
+      v8::Isolate::Scope isolate_scope(isolate);
+      v8::HandleScope handle_scope(isolate);
+      // A snapshot's default context already has all hooks installed
+      auto global_template = create_params_.snapshot_blob != nullptr
+        ? v8::Local<v8::ObjectTemplate>() : CreateGlobalTemplate(isolate);
+
+      for (auto i = next_script++; i < scripts.size(); i = next_script++) {
+        Commands::IsolateState state(isolate);
+        state.SetBatchJob();
+        exit_codes[i] = RunBatchScript(isolate, global_template, scripts[i]);
+
+        std::lock_guard<std::mutex> lock(output_mutex);
+        std::cout << state.BufferedOut() << std::flush;
+        std::cerr << state.BufferedErr() << std::flush;
+      }
+    }
+    isolate->Dispose();
+  };
+
+  std::vector<std::thread> runners;
+  for (size_t i = 0; i < threads; i++) {
+    runners.emplace_back(run_scripts);
+  }
+  for (auto& runner : runners) {
+    runner.join();
+  }
+
+  const auto failed = std::count_if(exit_codes.begin(), exit_codes.end(),
+    [](int exit_code) { return exit_code != 0; });
+  if (failed == 0) {
+    return 0;
+  }
+
+  Commands::PrintErrorTag();
+  std::cerr << " " << failed << " of " << scripts.size() << " scripts failed" << std::endl;
+
+  return *std::find_if(exit_codes.begin(), exit_codes.end(),
+    [](int exit_code) { return exit_code != 0; });
+}
+
+/** Runs one script of a --parallel run to completion, including its event
+ *  loop, on the calling thread's isolate. Returns its exit code: the value
+ *  passed to quit(), otherwise 1 if it failed and 0 if not. */
+int V8Shell::RunBatchScript(v8::Isolate* isolate,
+  v8::Local<v8::ObjectTemplate> global_template, const std::string& script) {
+  v8::HandleScope handle_scope(isolate);
+  auto* state = Commands::IsolateState::From(isolate);
+
+  auto file_content = Commands::ReadFile(isolate, script.c_str());
+  v8::Local<v8::String> source;
+  if (!file_content.has_value() || !file_content->ToLocal(&source)) {
+    Commands::PrintErrorTag(state->Err());
+    state->Err() << " cannot read file " << script << std::endl;
+
+    return 1;
+  }
+
+  auto context = v8::Context::New(isolate, nullptr, global_template);
+  v8::Context::Scope context_scope(context);
+  auto success = false;
+  {
+    // Timers and workers the script left behind end with it
+    Commands::EventLoop loop(isolate, platform_.get());
+    auto file_name = v8::String::NewFromUtf8(isolate, script.c_str()).ToLocalChecked();
+    success = Commands::ExecuteString(isolate, source, file_name, false, true, true);
+    if (!state->ExitCode().has_value()) {
+      loop.Run();
+    }
+    Commands::WorkerThread::TerminateAll(isolate);
+  }
+
+  // quit() terminated the script
+  isolate->CancelTerminateExecution();
+  if (state->ExitCode().has_value()) {
+    return state->ExitCode().value();
+  }
+
+  return success ? 0 : 1;
+}
+
 /** The read-eval-execute loop of the shell. */
 void V8Shell::RunShell(v8::Local<v8::Context> context) {
   auto path = fs::current_path();
-  Commands::SetCWD(path);
+  Commands::SetCWD(isolate_, path);
 
   std::cout << "[V8Shell " << Settings::current_version << "] V8 version "
             << v8::V8::GetVersion() << std::endl;
-  Commands::PrintCWD();
+  Commands::PrintCWD(isolate_);
 
   static const int kBufferSize = 1024;
   char buffer[kBufferSize];
@@ -160,24 +559,85 @@ void V8Shell::RunShell(v8::Local<v8::Context> context) {
         v8::String::NewFromUtf8(context->GetIsolate(), str).ToLocalChecked(),
         name, print_expression_eval, true);
 
-    while (v8::platform::PumpMessageLoop(platform_.get(), context->GetIsolate()))
-      continue;
+    // Pending asynchronous work finishes before the next prompt
+    event_loop_->Run();
   }
   std::cout << std::endl;
 }
 
 /** Creates a new execution environment containing the built-in functions. */
 v8::Local<v8::Context> V8Shell::CreateShellContext() {
-  // Create a template for the global object.
-  v8::Local<v8::ObjectTemplate> global = v8::ObjectTemplate::New(isolate_);
+  // A snapshot's default context already has all hooks installed
+  if (create_params_.snapshot_blob != nullptr) {
+    return v8::Context::New(isolate_);
+  }
+
+  return v8::Context::New(isolate_, NULL, CreateGlobalTemplate(isolate_));
+}
+
+/** Creates a template for the global object with all c++ hooks registered.
+ *  A dotted hook name like 'fs.readAsync' puts the function on a namespace
+ *  object 'fs' instead of the global object. */
+v8::Local<v8::ObjectTemplate> V8Shell::CreateGlobalTemplate(v8::Isolate* isolate) {
+  v8::Local<v8::ObjectTemplate> global = v8::ObjectTemplate::New(isolate);
+  std::unordered_map<std::string, v8::Local<v8::ObjectTemplate>> namespaces;
 
   // Register c++ hooks to global functions
   for (auto& hook : cpp_hooks) {
-    global->Set(isolate_, std::get<0>(hook).c_str(),
-                v8::FunctionTemplate::New(isolate_, std::get<1>(hook)));
+    const auto& name = std::get<0>(hook);
+    auto function = v8::FunctionTemplate::New(isolate, std::get<1>(hook));
+
+    const auto dot = name.find('.');
+    if (dot == std::string::npos) {
+      global->Set(isolate, name.c_str(), function);
+      continue;
+    }
+
+    const auto namespace_name = name.substr(0, dot);
+    auto object = namespaces.find(namespace_name);
+    if (object == namespaces.end()) {
+      object = namespaces.emplace(namespace_name, v8::ObjectTemplate::New(isolate)).first;
+      global->Set(isolate, namespace_name.c_str(), object->second);
+    }
+    object->second->Set(isolate, name.substr(dot + 1).c_str(), function);
+  }
+
+  return global;
+}
+
+/** Returns the nullptr terminated list of native functions a snapshot may
+ *  reference, which are the callbacks of all c++ hooks. */
+const intptr_t* V8Shell::ExternalReferences() {
+  // Isolates keep a pointer to this list, so it is only built once
+  static std::vector<intptr_t> references;
+  if (!references.empty()) {
+    return references.data();
+  }
+
+  for (auto& hook : cpp_hooks) {
+    auto reference = reinterpret_cast<intptr_t>(std::get<1>(hook));
+    if (std::find(references.begin(), references.end(), reference) == references.end()) {
+      references.push_back(reference);
+    }
+  }
+  references.push_back(0);
+
+  return references.data();
+}
+
+/** First line of a snapshot file, identifying the shell build that wrote it. */
+std::string V8Shell::SnapshotHeader() {
+  // FNV-1a over the hook names, changes whenever the hook table does
+  uint64_t hooks_hash = 14695981039346656037ull;
+  for (auto& hook : cpp_hooks) {
+    for (auto c : std::get<0>(hook)) {
+      hooks_hash = (hooks_hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+    }
+    hooks_hash = (hooks_hash ^ ';') * 1099511628211ull;
   }
 
-  return v8::Context::New(isolate_, NULL, global);
+  return "V8Shell-snapshot " + Settings::current_version + " " +
+         v8::V8::GetVersion() + " " + std::to_string(hooks_hash);
 }
 
 /** Adds a new hook. If it couldn't be added because it would have added
@@ -0,0 +1,3 @@
+// Every batch script starts out in the process' cwd, whatever the others cd() into
+cd('test-dir');
+appendFile('parallel-batch-result.txt', 'ok');
@@ -0,0 +1,2 @@
+setTimeout(() => appendFile('test-dir/parallel-batch-result.txt', 'not ended by quit()'), 0);
+quit(3);
@@ -0,0 +1,12 @@
+function fibonacci(n) {
+  return n < 2 ? n : fibonacci(n - 1) + fibonacci(n - 2);
+}
+
+fibonacci(10);
+
+if (!codeCacheStats().enabled) {
+  throw new Error('code cache should be enabled');
+}
+
+// The file was compiled before it ran, so a cached compile is counted already
+writeFile('test-dir/code-cache-hits.txt', String(codeCacheStats().hits));
@@ -0,0 +1,35 @@
+mkdir('test-dir/copy-tree-src');
+mkdir('test-dir/copy-tree-src/nested');
+mkdir('test-dir/copy-tree-src/nested/deeper');
+writeFile('test-dir/copy-tree-src/one.txt', 'one');
+writeFile('test-dir/copy-tree-src/nested/two.txt', 'two!');
+writeFile('test-dir/copy-tree-src/nested/deeper/three.txt', 'three');
+
+const stats = copy('test-dir/copy-tree-src', 'test-dir/copy-tree-dst',
+  { recursive: true, threads: 4, verbose: false });
+if (stats.files !== 3 || stats.directories !== 3 || stats.bytes !== 12 || stats.errors !== 0) {
+  throw new Error('copy() reported unexpected statistics');
+}
+if (read('test-dir/copy-tree-dst/nested/deeper/three.txt') !== 'three') {
+  throw new Error('copy() did not copy nested files');
+}
+
+const source = walk('test-dir/copy-tree-src', { stats: true });
+const copied = walk('test-dir/copy-tree-dst', { stats: true });
+for (const entry of source) {
+  const twin = copied.find((other) => other.path === entry.path);
+  if (!twin || twin.type !== entry.type || twin.size !== entry.size ||
+      Math.floor(twin.mtime) !== Math.floor(entry.mtime)) {
+    throw new Error('copy() did not preserve ' + entry.path);
+  }
+}
+
+let threw = false;
+try {
+  copy('test-dir/copy-tree-src', 'test-dir/copy-tree-flat', { verbose: false });
+} catch (e) {
+  threw = true;
+}
+if (!threw) {
+  throw new Error('copy() of a directory without recursive did not fail');
+}
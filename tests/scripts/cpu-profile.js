@@ -0,0 +1,41 @@
+const checks = [];
+
+function spin(milliseconds) {
+  const end = Date.now() + milliseconds;
+  let value = 0;
+  while (Date.now() < end) {
+    value += Math.sqrt(value + 1);
+  }
+  return value;
+}
+
+profile.start('phase', { samplingIntervalUs: 100 });
+spin(200);
+for (let i = 0; i < 200; i++) {
+  ls(false);
+}
+const profileJson = profile.stop('phase');
+
+const cpuProfile = JSON.parse(profileJson);
+const names = cpuProfile.nodes.map((node) => node.callFrame.functionName);
+checks.push(cpuProfile.samples.length > 0 && cpuProfile.samples.length === cpuProfile.timeDeltas.length);
+checks.push(cpuProfile.endTime >= cpuProfile.startTime);
+checks.push(names.includes('spin'));
+// Time spent in the shell's functions is attributed to them
+checks.push(names.includes('ls'));
+
+// Stopped profiles are gone, names can be reused
+let threw = false;
+try {
+  profile.stop('phase');
+} catch (e) {
+  threw = true;
+}
+checks.push(threw);
+
+profile.start('phase');
+spin(20);
+profile.stop('phase', 'test-dir/phase.cpuprofile');
+checks.push(JSON.parse(read('test-dir/phase.cpuprofile')).nodes.length > 0);
+
+writeFile('test-dir/cpu-profile-result.txt', checks.every((check) => check) ? 'ok' : JSON.stringify(checks));
@@ -0,0 +1,44 @@
+const dir = 'test-dir/fs-async';
+const count = 200;
+const checks = [];
+
+async function main() {
+  // Left over from an earlier run, if at all
+  await fs.removeAsync(dir).catch(() => {});
+  await fs.mkdirAsync(`${dir}/files`, { recursive: true });
+
+  // All writes are in flight at once
+  await Promise.all(Array.from({ length: count },
+    (_, i) => fs.writeAsync(`${dir}/files/${i}.txt`, `file ${i}`)));
+
+  const entries = await fs.readdirAsync(`${dir}/files`);
+  checks.push(entries.length === count);
+
+  const texts = await Promise.all(entries.map((entry) => fs.readAsync(`${dir}/files/${entry.filename}`)));
+  checks.push(texts.every((text, i) => text === `file ${entries[i].filename.split('.')[0]}`));
+
+  const bytes = await fs.readBytesAsync(`${dir}/files/7.txt`);
+  checks.push(bytes.byteLength === 6 && new Uint8Array(bytes)[0] === 'f'.charCodeAt(0));
+
+  const stat = await fs.statAsync(`${dir}/files/7.txt`);
+  checks.push(stat.isFile && !stat.isDirectory && stat.size === 6 && stat.mtime > 0);
+
+  const copied = await fs.copyAsync(`${dir}/files`, `${dir}/copy`, { recursive: true });
+  checks.push(copied.files === count && copied.errors === 0);
+
+  await fs.moveAsync(`${dir}/copy`, `${dir}/moved`);
+  checks.push((await fs.statAsync(`${dir}/moved`)).isDirectory);
+
+  const removed = await fs.removeAsync(`${dir}/moved`);
+  checks.push(removed.files === count && removed.dirs === 1 && removed.errors === 0);
+
+  // Failures reject with the reason
+  const rejected = await fs.readAsync(`${dir}/missing.txt`).then(() => null, (error) => error);
+  checks.push(rejected instanceof Error && rejected.message.startsWith('[Error] Cannot read file'));
+
+  await fs.removeAsync(dir);
+}
+
+main().then(
+  () => writeFile('test-dir/fs-async-result.txt', checks.every((check) => check) ? 'ok' : JSON.stringify(checks)),
+  (error) => writeFile('test-dir/fs-async-result.txt', String(error)));
@@ -0,0 +1,48 @@
+const dir = 'test-dir/fs-batch';
+const count = 500;
+const checks = [];
+
+async function run(uring) {
+  await fs.removeAsync(dir).catch(() => {});
+
+  const names = Array.from({ length: count }, (_, i) => `${dir}/${i}.txt`);
+  const created = await fs.batch([{ op: 'mkdir', path: dir }, { op: 'mkdir', path: dir }], { uring });
+  checks.push(created[0].ok && !created[1].ok && typeof created[1].error === 'string');
+
+  await Promise.all(names.map((name, i) => fs.writeAsync(name, `file ${i}`)));
+
+  const reads = await fs.batch(names.map((path) => ({ op: 'read', path })), { uring });
+  checks.push(reads.every((result, i) => result.ok && result.data === `file ${i}`));
+
+  const stats = await fs.batch(names.map((path) => ({ op: 'stat', path })), { uring });
+  checks.push(stats.every((result, i) => result.ok && result.isFile && result.size === `file ${i}`.length));
+
+  const mixed = await fs.batch([
+    { op: 'rename', path: names[0], to: `${dir}/renamed.txt` },
+    { op: 'lstat', path: `${dir}/renamed.txt` },
+    { op: 'read', path: `${dir}/missing.txt` },
+    { op: 'read', path: dir },
+  ], { uring });
+  checks.push(mixed[0].ok && !mixed[2].ok && !mixed[3].ok);
+
+  const removed = await fs.batch(names.slice(1).map((path) => ({ op: 'unlink', path }))
+    .concat([{ op: 'unlink', path: `${dir}/renamed.txt` }]), { uring });
+  checks.push(removed.every((result) => result.ok));
+
+  const rmdir = await fs.batch([{ op: 'rmdir', path: dir }], { uring });
+  checks.push(rmdir[0].ok);
+}
+
+let invalid = false;
+try {
+  fs.batch([{ op: 'chmod', path: dir }]);
+} catch (error) {
+  invalid = true;
+}
+checks.push(invalid);
+
+run(true)
+  .then(() => run(false))
+  .then(
+    () => writeFile('test-dir/fs-batch-result.txt', checks.every((check) => check) ? 'ok' : JSON.stringify(checks)),
+    (error) => writeFile('test-dir/fs-batch-result.txt', String(error)));
@@ -0,0 +1,16 @@
+const checks = [];
+
+// Drops the garbage of a phase, the heap in use shrinks accordingly
+let phase = [];
+for (let i = 0; i < 100000; i++) {
+  phase.push({ index: i, label: `entry ${i}` });
+}
+const during = gc();
+phase = null;
+const after = gc();
+checks.push(typeof during === 'number' && typeof after === 'number' && after < during);
+
+const trimmed = lowMemory();
+checks.push(typeof trimmed === 'number' && trimmed > 0 && trimmed <= after * 2);
+
+writeFile('test-dir/heap-control-result.txt', checks.every((check) => check) ? 'ok' : JSON.stringify(checks));
@@ -0,0 +1,5 @@
+// Keeps everything it allocates until the heap is exhausted
+const hoard = [];
+while (true) {
+  hoard.push(new Array(1024).fill({ size: hoard.length }));
+}
@@ -0,0 +1,8 @@
+// Adds the isolate's current heap limit to the list the HeapExhaustion test compares
+let limits = '';
+try {
+  limits = read('test-dir/heap-limits.txt');
+} catch (error) {
+  limits = '';
+}
+writeFile('test-dir/heap-limits.txt', limits + heapStats().heapSizeLimit + '\n');
@@ -0,0 +1,40 @@
+const checks = [];
+
+// Kept alive until the end, so the sampling sees it
+const retained = [];
+function retain() {
+  for (let i = 0; i < 20000; i++) {
+    retained.push({ index: i, payload: new Array(16).fill(i) });
+  }
+}
+
+allocationSampling.start(1024);
+retain();
+const allocationProfile = JSON.parse(allocationSampling.stop());
+checks.push(allocationProfile.head.children !== undefined && allocationProfile.samples.length > 0);
+
+const names = [];
+const collect = (node) => {
+  names.push(node.callFrame.functionName);
+  node.children.forEach(collect);
+};
+collect(allocationProfile.head);
+checks.push(names.includes('retain'));
+
+// Only one sampling at a time
+allocationSampling.start();
+let threw = false;
+try {
+  allocationSampling.start();
+} catch (e) {
+  threw = true;
+}
+checks.push(threw);
+allocationSampling.stop('test-dir/session.heapprofile');
+checks.push(JSON.parse(read('test-dir/session.heapprofile')).head !== undefined);
+
+heapSnapshot('test-dir/heap.heapsnapshot');
+const snapshot = JSON.parse(read('test-dir/heap.heapsnapshot'));
+checks.push(snapshot.snapshot.node_count > 0 && snapshot.nodes.length > 0);
+
+writeFile('test-dir/heap-profile-result.txt', checks.every((check) => check) ? 'ok' : JSON.stringify(checks));
@@ -0,0 +1,21 @@
+const checks = [];
+
+let garbage = [];
+for (let i = 0; i < 200000; i++) {
+  garbage.push({ index: i });
+}
+garbage = null;
+gc();
+
+const stats = heapStats();
+checks.push(stats.usedHeapSize > 0 && stats.heapSizeLimit >= stats.totalHeapSize);
+checks.push(stats.spaces.length > 0 && stats.spaces.every((space) => typeof space.name === 'string'));
+
+// The collection requested by gc() is the last one recorded
+const { history } = stats.gc;
+const last = history[history.length - 1];
+checks.push(stats.gc.count >= history.length && history.length > 0);
+checks.push(last.type === 'mark-sweep-compact' && last.forced && last.pause >= 0);
+checks.push(history.every((event, i) => i === 0 || event.start >= history[i - 1].start));
+
+writeFile('test-dir/heap-stats-result.txt', checks.every((check) => check) ? 'ok' : JSON.stringify(checks));
@@ -0,0 +1,22 @@
+const writer = openWriter('test-dir/lines.txt');
+for (let i = 0; i < 50000; i++) {
+  writer.write(`line ${i}\n`);
+}
+writer.write('last line without newline');
+writer.close();
+
+let count = 0;
+let last;
+for (const batch of lines('test-dir/lines.txt', { chunkSize: 4096 })) {
+  for (const line of batch) {
+    if (count < 50000 && line !== `line ${count}`) {
+      throw new Error(`unexpected line ${line}`);
+    }
+    count++;
+    last = line;
+  }
+}
+
+if (count !== 50001 || last !== 'last line without newline') {
+  throw new Error('lines() yielded unexpected lines');
+}
@@ -0,0 +1,20 @@
+mkdir('test-dir/ls-dir');
+mkdir('test-dir/ls-dir/sub-dir');
+writeFile('test-dir/ls-dir/file.txt', '12345');
+cd('test-dir/ls-dir');
+
+const listing = ls({ columnar: true });
+const file = listing.names.indexOf('file.txt');
+const dir = listing.names.indexOf('sub-dir');
+if (listing.names.length !== 2 || file === -1 || dir === -1) {
+  throw new Error('ls({columnar: true}) returned unexpected names');
+}
+if (listing.isDirectory[file] !== 0 || listing.isDirectory[dir] !== 1 ||
+    listing.size[file] !== 5 || !(listing.mtime[file] > 0)) {
+  throw new Error('ls({columnar: true}) returned unexpected columns');
+}
+
+const entries = ls(false);
+if (entries.length !== 2 || entries.filter((entry) => entry.isDirectory).length !== 1) {
+  throw new Error('ls(false) returned unexpected entries');
+}
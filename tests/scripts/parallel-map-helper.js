@@ -0,0 +1,6 @@
+(item, index) => {
+  if (item === 'throw') {
+    throw new Error('cannot map');
+  }
+  return item * item + index;
+}
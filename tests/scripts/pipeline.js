@@ -0,0 +1,49 @@
+writeFile('test-dir/pipeline-input.txt', '3\n1\n2\n1\n3\n3\n');
+
+const counted = pipeline([['sort'], ['uniq', ['-c']], ['sort', ['-rn']]], {
+  stdin: 'test-dir/pipeline-input.txt',
+  stdoutTo: 'buffer',
+});
+
+const input = new Uint8Array(100000).fill(97);
+for (let i = 99; i < input.length; i += 100) {
+  input[i] = 10;
+}
+let lineCount = 0;
+let lineLength = 0;
+const streamed = pipeline([['cat'], ['tr', ['a', 'b']]], {
+  stdin: input,
+  stdoutTo: (lines) => {
+    lineCount += lines.length;
+    lineLength = lines[0].length;
+  },
+});
+
+// Far more than the pipes buffer, feeding and draining have to take turns
+const large = new Uint8Array(8 * 1024 * 1024).fill(120);
+const echoed = pipeline([['cat']], { stdin: large, stdoutTo: 'buffer' });
+
+const toFile = pipeline([['sh', ['-c', 'echo piped']], ['tr', ['a-z', 'A-Z']]], {
+  stdoutTo: 'test-dir/pipeline-output.txt',
+});
+const failing = pipeline([['sh', ['-c', 'echo x']], ['sh', ['-c', 'cat; exit 4']]], {
+  stdoutTo: 'buffer',
+});
+
+let stopped = false;
+try {
+  pipeline([['yes']], { stdoutTo: () => { throw new Error('stop'); } });
+} catch (error) {
+  stopped = error.message === 'stop';
+}
+
+const checks = [
+  counted.code === 0 && counted.stages.length === 3 && counted.bytes === 30,
+  counted.stdout instanceof ArrayBuffer && new Uint8Array(counted.stdout)[6] === 51,
+  streamed.code === 0 && lineCount === 1000 && lineLength === 99,
+  echoed.code === 0 && echoed.bytes === large.length && echoed.stdout.byteLength === large.length,
+  toFile.code === 0 && read('test-dir/pipeline-output.txt') === 'PIPED\n',
+  failing.code === 4 && failing.stages[0].code === 0 && failing.stdout.byteLength === 2,
+  stopped,
+];
+writeFile('test-dir/pipeline-result.txt', checks.every((check) => check) ? 'ok' : JSON.stringify(checks));
@@ -0,0 +1,22 @@
+const checks = [];
+
+checks.push(memoryStats().allocator === 'pool');
+
+// Freed memory comes back zeroed, small and large buffers alike
+for (const size of [1, 100, 4096, 65536, 65537, 1 << 20]) {
+  for (let round = 0; round < 3; round++) {
+    const bytes = new Uint8Array(size);
+    checks.push(bytes.every((byte) => byte === 0));
+    bytes.fill(0xab);
+  }
+  gc();
+}
+
+// Copies are filled by v8 and never zeroed first
+const source = new Uint8Array(1 << 20).fill(7);
+checks.push(source.slice().every((byte) => byte === 7));
+
+const stats = memoryStats();
+checks.push(stats.reused > 0 && stats.peakBytes >= 1 << 20);
+
+writeFile('test-dir/pool-allocator-result.txt', checks.every((check) => check) ? 'ok' : JSON.stringify(checks));
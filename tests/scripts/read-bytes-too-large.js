@@ -0,0 +1,9 @@
+// test-dir/too-large.bin is a sparse 1 TiB file, larger than any ArrayBuffer
+let result = 'no exception';
+try {
+  readBytes('test-dir/too-large.bin');
+} catch (e) {
+  result = e instanceof RangeError && e.message === 'Array buffer allocation failed' ? 'ok' : String(e);
+}
+
+writeFile('test-dir/read-bytes-too-large-result.txt', result);
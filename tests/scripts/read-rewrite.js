@@ -0,0 +1,27 @@
+// Large ASCII files are read into external strings. Rewriting or truncating
+// the file, from the shell or from outside of it, must not change them.
+const path = 'test-dir/read-rewrite.txt';
+const contents = 'abcdefghij'.repeat(100000);
+const checks = [];
+
+writeFile(path, contents);
+const first = read(path);
+writeFile(path, 'short');
+checks.push(first.length === contents.length && first.endsWith('hij') && first === contents);
+checks.push(read(path) === 'short');
+
+writeFile(path, contents);
+const second = read(path);
+writeBytes(path, new Uint8Array([0x41]));
+const writer = openWriter(path);
+writer.write('B');
+writer.close();
+checks.push(second.indexOf('j', contents.length - 2) === contents.length - 1);
+checks.push(read(path) === 'B');
+
+writeFile(path, contents);
+const third = read(path);
+runSync('sh', ['-c', `printf x | dd of=${path} conv=notrunc status=none && : > ${path}`]);
+checks.push(third === contents);
+
+writeFile('test-dir/read-rewrite-result.txt', checks.every((check) => check) ? 'ok' : JSON.stringify(checks));
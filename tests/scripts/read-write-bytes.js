@@ -0,0 +1,12 @@
+const data = new Uint8Array([0, 1, 2, 255, 128, 64]);
+writeBytes('test-dir/bytes.bin', data);
+
+const whole = new Uint8Array(readBytes('test-dir/bytes.bin'));
+if (whole.length !== 6 || whole[3] !== 255) {
+  throw new Error('readBytes returned unexpected content');
+}
+
+const region = new Uint8Array(readBytes('test-dir/bytes.bin', { offset: 2, length: 2 }));
+if (region.length !== 2 || region[0] !== 2 || region[1] !== 255) {
+  throw new Error('readBytes returned unexpected region');
+}
@@ -0,0 +1,15 @@
+mkdir('test-dir/rm-tree');
+for (let i = 0; i < 8; i++) {
+  mkdir('test-dir/rm-tree/dir-' + i);
+  mkdir('test-dir/rm-tree/dir-' + i + '/nested');
+  for (let j = 0; j < 16; j++) {
+    writeFile('test-dir/rm-tree/dir-' + i + '/nested/file-' + j + '.txt', 'content');
+  }
+}
+writeFile('test-dir/rm-tree/top.txt', 'top');
+
+const summary = rm('test-dir/rm-tree', { threads: 4 });
+if (summary.files !== 8 * 16 + 1 || summary.dirs !== 8 * 2 + 1 || summary.errors !== 0 ||
+    !(summary.elapsedMs >= 0) || !(summary.bytesFreed >= 0)) {
+  throw new Error('rm() returned an unexpected summary: ' + JSON.stringify(summary));
+}
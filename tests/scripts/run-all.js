@@ -0,0 +1,23 @@
+const jobs = [];
+for (let i = 0; i < 12; i++) {
+  jobs.push(['sh', ['-c', `sleep 0.0${i % 3}; echo job${i}`]]);
+}
+jobs.push({ cmd: 'sh', args: ['-c', 'echo $RUN_TEST'], env: { RUN_TEST: 'from-env' } });
+jobs.push(['sh', ['-c', 'sleep 5']]);
+
+const results = runAll(jobs, { concurrency: 4, timeoutMs: 500 });
+const failFast = runAll([
+  ['sh', ['-c', 'exit 1']],
+  ['sh', ['-c', 'sleep 5']],
+  ['sh', ['-c', 'echo late']],
+], { concurrency: 2, failFast: true });
+
+const checks = [
+  results.length === jobs.length,
+  results.slice(0, 12).every((result, i) => result.code === 0 && result.stdout === `job${i}\n`),
+  results[12].stdout === 'from-env\n',
+  results[13].timedOut && results[13].signal === 'SIGKILL',
+  results.every((result) => result.maxRssKb > 0 && result.durationMs >= 0),
+  failFast[0].code === 1 && failFast[1].signal === 'SIGTERM' && failFast[2].skipped,
+];
+writeFile('test-dir/run-all-result.txt', checks.every((check) => check) ? 'ok' : JSON.stringify(results));
@@ -0,0 +1,41 @@
+const script = 'for i in $(seq 1 20000); do echo "line $i"; done; echo oops >&2; exit 2';
+
+const buffered = runSync('sh', ['-c', script], { capture: 'buffer' });
+const bufferedText = new Uint8Array(buffered.stdout);
+
+let stdoutLines = 0;
+let lastLine = '';
+let stderrLines = [];
+const streamed = runSync('sh', ['-c', script], {
+  capture: 'lines',
+  onLines: (lines, stream) => {
+    if (stream === 'stdout') {
+      stdoutLines += lines.length;
+      lastLine = lines[lines.length - 1];
+    } else {
+      stderrLines = stderrLines.concat(lines);
+    }
+  },
+});
+
+const tail = runSync('sh', ['-c', script], { capture: 'tail', tailKb: 1 });
+
+let stopped = false;
+try {
+  runSync('yes', [], { capture: 'lines', onLines: () => { throw new Error('stop'); } });
+} catch (error) {
+  stopped = error.message === 'stop';
+}
+
+const checks = [
+  buffered.code === 2 && buffered.stdout instanceof ArrayBuffer,
+  buffered.stdout.byteLength === buffered.stdoutBytes && buffered.stdoutBytes === 208894,
+  bufferedText[0] === 108 && bufferedText[bufferedText.length - 1] === 10,
+  buffered.stderr.byteLength === 5,
+  streamed.code === 2 && stdoutLines === 20000 && lastLine === 'line 20000',
+  stderrLines.length === 1 && stderrLines[0] === 'oops' && streamed.stdout === undefined,
+  tail.stdout.length === 1024 && tail.stdout.endsWith('line 20000\n') && tail.stderr === 'oops\n',
+  tail.stdoutBytes === 208894,
+  stopped,
+];
+writeFile('test-dir/run-sync-capture-result.txt', checks.every((check) => check) ? 'ok' : JSON.stringify(checks));
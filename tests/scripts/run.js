@@ -0,0 +1,18 @@
+const pending = [
+  run('sh', ['-c', 'echo out; echo err >&2; exit 3']),
+  run('sh', ['-c', 'kill -TERM $$']),
+  run('sh', ['-c', 'pwd'], { cwd: 'test-dir' }),
+  run('sh', ['-c', 'echo $RUN_TEST'], { env: { RUN_TEST: 'from-env' } }),
+];
+
+Promise.all(pending).then((results) => {
+  const [exited, killed, cwd, env] = results;
+  const checks = [
+    exited.code === 3 && exited.signal === null,
+    exited.stdout === 'out\n' && exited.stderr === 'err\n' && exited.durationMs >= 0,
+    killed.code === -1 && killed.signal === 'SIGTERM',
+    cwd.stdout.trim().endsWith('test-dir'),
+    env.stdout === 'from-env\n',
+  ];
+  writeFile('test-dir/run-result.txt', checks.every((check) => check) ? 'ok' : JSON.stringify(results));
+});
@@ -0,0 +1,16 @@
+// Runs on a context deserialized from test-dir/shell.snapshot, so every hook
+// called here goes through the snapshot's external reference table
+const checks = [];
+
+checks.push(typeof version() === 'string' && version().length > 0);
+
+writeFile('test-dir/snapshot-boot.txt', 'from snapshot');
+checks.push(read('test-dir/snapshot-boot.txt') === 'from snapshot');
+checks.push(Array.isArray(ls(false)));
+
+fs.statAsync('test-dir/snapshot-boot.txt').then((stats) => {
+  checks.push(stats.size === 13);
+  setTimeout(() => {
+    writeFile('test-dir/snapshot-boot-result.txt', checks.every((check) => check) ? 'ok' : JSON.stringify(checks));
+  }, 1);
+});
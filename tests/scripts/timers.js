@@ -0,0 +1,30 @@
+const order = [];
+const start = Date.now();
+
+setTimeout(() => order.push('b'), 20);
+setTimeout((value) => order.push(value), 0, 'a');
+const cancelled = setTimeout(() => order.push('never'), 10);
+clearTimeout(cancelled);
+
+let ticks = 0;
+const interval = setInterval(() => {
+  ticks++;
+  if (ticks === 3) {
+    clearInterval(interval);
+  }
+}, 5);
+
+setTimeout(() => {
+  // Promise callbacks run before the next timer
+  Promise.resolve().then(() => order.push('microtask'));
+}, 30);
+setTimeout(() => order.push('c'), 30);
+
+setTimeout(() => {
+  const checks = [
+    order.join(',') === 'a,b,microtask,c',
+    ticks === 3,
+    Date.now() - start >= 50,
+  ];
+  writeFile('test-dir/timers-result.txt', checks.every((check) => check) ? 'ok' : JSON.stringify(order));
+}, 50);
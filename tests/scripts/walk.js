@@ -0,0 +1,39 @@
+mkdir('test-dir/walk-dir');
+mkdir('test-dir/walk-dir/a');
+mkdir('test-dir/walk-dir/a/b');
+mkdir('test-dir/walk-dir/skip');
+writeFile('test-dir/walk-dir/one.txt', '1');
+writeFile('test-dir/walk-dir/a/two.js', '22');
+writeFile('test-dir/walk-dir/a/b/three.txt', '333');
+writeFile('test-dir/walk-dir/skip/four.txt', '4444');
+
+const paths = (entries) => entries.map((entry) => entry.path).sort().join(',');
+
+const all = walk('test-dir/walk-dir', { threads: 4 });
+if (paths(all) !== 'a,a/b,a/b/three.txt,a/two.js,one.txt,skip,skip/four.txt') {
+  throw new Error('walk() returned unexpected entries: ' + paths(all));
+}
+if (all.find((entry) => entry.path === 'a/b').type !== 'directory') {
+  throw new Error('walk() reported a wrong type');
+}
+
+const filtered = walk('test-dir/walk-dir', { include: '*.txt', exclude: 'skip' });
+if (paths(filtered) !== 'a/b/three.txt,one.txt') {
+  throw new Error('walk() ignored include/exclude: ' + paths(filtered));
+}
+
+const shallow = walk('test-dir/walk-dir', { maxDepth: 1, stats: true });
+if (paths(shallow) !== 'a,one.txt,skip' ||
+    shallow.find((entry) => entry.path === 'one.txt').size !== 1) {
+  throw new Error('walk() ignored maxDepth or stats');
+}
+
+let streamed = 0;
+let chunks = 0;
+const summary = walk('test-dir/walk-dir', { chunkSize: 1 }, (chunk) => {
+  chunks++;
+  streamed += chunk.length;
+});
+if (streamed !== 7 || chunks !== 7 || summary.entries !== 7 || summary.directories !== 4) {
+  throw new Error('walk() streamed unexpected chunks');
+}
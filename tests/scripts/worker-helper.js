@@ -0,0 +1,13 @@
+onmessage = (event) => {
+  const { numbers, shared } = event.data;
+  const view = new Float64Array(numbers);
+  for (let i = 0; i < view.length; i++) {
+    view[i] *= 2;
+  }
+
+  // Seen by the shell without another message
+  Atomics.store(new Int32Array(shared), 0, 42);
+
+  postMessage({ numbers, length: view.length }, [numbers]);
+  close();
+};
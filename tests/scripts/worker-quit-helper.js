@@ -0,0 +1,3 @@
+postMessage('before');
+quit(7);
+postMessage('after');
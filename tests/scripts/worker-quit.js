@@ -0,0 +1,10 @@
+// quit() in a worker ends the worker, the shell keeps running
+const messages = [];
+const worker = new Worker('../../../tests/scripts/worker-quit-helper.js');
+worker.onmessage = (event) => messages.push(event.data);
+worker.onexit = (code) => {
+  setTimeout(() => {
+    const checks = [code === 7, messages.join(',') === 'before'];
+    writeFile('test-dir/worker-quit-result.txt', checks.every((check) => check) ? 'ok' : JSON.stringify(checks));
+  }, 10);
+};
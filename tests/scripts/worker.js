@@ -0,0 +1,27 @@
+const checks = [];
+const result = 'test-dir/worker-result.txt';
+
+const worker = new Worker('../../../tests/scripts/worker-helper.js');
+const numbers = Float64Array.from([1, 2, 3, 4]);
+const shared = new SharedArrayBuffer(4);
+
+worker.onmessage = (event) => {
+  // The buffer went back and forth without copies
+  checks.push(numbers.buffer.byteLength === 0);
+  checks.push(event.data.length === 4);
+  checks.push(new Float64Array(event.data.numbers).join(',') === '2,4,6,8');
+  checks.push(Atomics.load(new Int32Array(shared), 0) === 42);
+
+  const items = Array.from({ length: 1000 }, (_, i) => i);
+  parallelMap(items, '../../../tests/scripts/parallel-map-helper.js', { threads: 3 })
+    .then((mapped) => {
+      checks.push(mapped.length === items.length && mapped.every((value, i) => value === i * i + i));
+      return parallelMap([1, 'throw', 3], '../../../tests/scripts/parallel-map-helper.js', { threads: 2 })
+        .then(() => false, (error) => error.message.includes('cannot map'));
+    })
+    .then((rejected) => {
+      checks.push(rejected);
+      writeFile(result, checks.every((check) => check) ? 'ok' : JSON.stringify(checks));
+    });
+};
+worker.postMessage({ numbers: numbers.buffer, shared }, [numbers.buffer]);
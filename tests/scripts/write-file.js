@@ -0,0 +1,13 @@
+writeFile('test-dir/write-file.txt', 'first\n', { atomic: true });
+appendFile('test-dir/write-file.txt', 'second\n');
+
+const writer = openWriter('test-dir/write-file.txt', { append: true, bufferSize: 4096 });
+for (let i = 0; i < 10000; i++) {
+  writer.write(`record ${i}\n`);
+}
+writer.close();
+
+const lines = read('test-dir/write-file.txt').split('\n');
+if (lines[0] !== 'first' || lines[1] !== 'second' || lines[10001] !== 'record 9999') {
+  throw new Error('written file has unexpected content');
+}
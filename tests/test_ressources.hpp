@@ -105,6 +105,197 @@ struct MoveFileTo {
   inline static std::string target_file = "test-dir/move-to/move-me.txt";
 };
 
+struct BuildSnapshot {
+  inline static int argc = 3;
+  inline static const char* argv[] = {"tests", "--build-snapshot", "test-dir/shell.snapshot"};
+  inline static std::string target_file = "test-dir/shell.snapshot";
+};
+
+struct BootSnapshot {
+  inline static int argc = 4;
+  inline static const char* argv[] = {"tests", "--snapshot", "test-dir/shell.snapshot",
+                                      "../../../tests/scripts/snapshot-boot.js"};
+  inline static std::string result_file = "test-dir/snapshot-boot-result.txt";
+};
+
+struct ReadBytesTooLarge {
+  inline static int argc = 2;
+  inline static const char* argv[] = {"tests", "../../../tests/scripts/read-bytes-too-large.js"};
+  inline static std::string source_file = "test-dir/too-large.bin";
+  inline static std::string result_file = "test-dir/read-bytes-too-large-result.txt";
+};
+
+struct ReadRewrite {
+  inline static int argc = 2;
+  inline static const char* argv[] = {"tests", "../../../tests/scripts/read-rewrite.js"};
+  inline static std::string result_file = "test-dir/read-rewrite-result.txt";
+};
+
+struct CodeCache {
+  inline static int argc = 4;
+  inline static const char* argv[] = {"tests", "--code-cache-dir", "test-dir/code-cache",
+                                      "../../../tests/scripts/code-cache.js"};
+  inline static std::string target_dir = "test-dir/code-cache";
+  inline static std::string hits_file = "test-dir/code-cache-hits.txt";
+};
+
+struct ReadWriteBytes {
+  inline static int argc = 2;
+  inline static const char* argv[] = {"tests", "../../../tests/scripts/read-write-bytes.js"};
+  inline static std::string target_file = "test-dir/bytes.bin";
+};
+
+struct WriteFile {
+  inline static int argc = 2;
+  inline static const char* argv[] = {"tests", "../../../tests/scripts/write-file.js"};
+  inline static std::string target_file = "test-dir/write-file.txt";
+};
+
+struct Lines {
+  inline static int argc = 2;
+  inline static const char* argv[] = {"tests", "../../../tests/scripts/lines.js"};
+};
+
+struct ListFilesColumnar {
+  inline static int argc = 2;
+  inline static const char* argv[] = {"tests", "../../../tests/scripts/ls-columnar.js"};
+};
+
+struct Walk {
+  inline static int argc = 2;
+  inline static const char* argv[] = {"tests", "../../../tests/scripts/walk.js"};
+};
+
+struct CopyTree {
+  inline static int argc = 2;
+  inline static const char* argv[] = {"tests", "../../../tests/scripts/copy-tree.js"};
+  inline static std::string target_file = "test-dir/copy-tree-dst/nested/two.txt";
+};
+
+struct RemoveTree {
+  inline static int argc = 2;
+  inline static const char* argv[] = {"tests", "../../../tests/scripts/rm-tree.js"};
+  inline static std::string target_dir = "test-dir/rm-tree";
+};
+
+#if !_WIN32
+struct RunProcess {
+  inline static int argc = 2;
+  inline static const char* argv[] = {"tests", "../../../tests/scripts/run.js"};
+  inline static std::string result_file = "test-dir/run-result.txt";
+};
+#endif
+
+#if !_WIN32
+struct RunAll {
+  inline static int argc = 2;
+  inline static const char* argv[] = {"tests", "../../../tests/scripts/run-all.js"};
+  inline static std::string result_file = "test-dir/run-all-result.txt";
+};
+#endif
+
+#if !_WIN32
+struct Pipeline {
+  inline static int argc = 2;
+  inline static const char* argv[] = {"tests", "../../../tests/scripts/pipeline.js"};
+  inline static std::string result_file = "test-dir/pipeline-result.txt";
+};
+#endif
+
+#if !_WIN32
+struct RunSyncCapture {
+  inline static int argc = 2;
+  inline static const char* argv[] = {"tests", "../../../tests/scripts/run-sync-capture.js"};
+  inline static std::string result_file = "test-dir/run-sync-capture-result.txt";
+};
+#endif
+
+struct Timers {
+  inline static int argc = 2;
+  inline static const char* argv[] = {"tests", "../../../tests/scripts/timers.js"};
+  inline static std::string result_file = "test-dir/timers-result.txt";
+};
+
+struct FsAsync {
+  inline static int argc = 2;
+  inline static const char* argv[] = {"tests", "../../../tests/scripts/fs-async.js"};
+  inline static std::string result_file = "test-dir/fs-async-result.txt";
+};
+
+struct FsBatch {
+  inline static int argc = 2;
+  inline static const char* argv[] = {"tests", "../../../tests/scripts/fs-batch.js"};
+  inline static std::string result_file = "test-dir/fs-batch-result.txt";
+};
+
+struct Worker {
+  inline static int argc = 2;
+  inline static const char* argv[] = {"tests", "../../../tests/scripts/worker.js"};
+  inline static std::string result_file = "test-dir/worker-result.txt";
+};
+
+struct WorkerQuit {
+  inline static int argc = 2;
+  inline static const char* argv[] = {"tests", "../../../tests/scripts/worker-quit.js"};
+  inline static std::string result_file = "test-dir/worker-quit-result.txt";
+};
+
+struct PoolAllocator {
+  inline static int argc = 4;
+  inline static const char* argv[] = {"tests", "--expose-gc", "--ab-allocator=pool",
+                                      "../../../tests/scripts/pool-allocator.js"};
+  inline static std::string result_file = "test-dir/pool-allocator-result.txt";
+};
+
+struct HeapControl {
+  inline static int argc = 6;
+  inline static const char* argv[] = {"tests", "--max-heap", "256", "--young-gen-size", "16",
+                                      "../../../tests/scripts/heap-control.js"};
+  inline static std::string result_file = "test-dir/heap-control-result.txt";
+};
+
+struct HeapExhaustion {
+  inline static int argc = 10;
+  inline static const char* argv[] = {"tests", "--max-heap", "16", "--young-gen-size", "4",
+                                      "--parallel", "1",
+                                      "../../../tests/scripts/heap-limit.js",
+                                      "../../../tests/scripts/heap-exhaust.js",
+                                      "../../../tests/scripts/heap-limit.js"};
+  inline static std::string limits_file = "test-dir/heap-limits.txt";
+};
+
+struct HeapStats {
+  inline static int argc = 4;
+  inline static const char* argv[] = {"tests", "--gc-log", "test-dir/gc-log.jsonl",
+                                      "../../../tests/scripts/heap-stats.js"};
+  inline static std::string result_file = "test-dir/heap-stats-result.txt";
+  inline static std::string gc_log_file = "test-dir/gc-log.jsonl";
+};
+
+struct CpuProfile {
+  inline static int argc = 3;
+  inline static const char* argv[] = {"tests", "--cpu-prof=test-dir/shell.cpuprofile",
+                                      "../../../tests/scripts/cpu-profile.js"};
+  inline static std::string result_file = "test-dir/cpu-profile-result.txt";
+  inline static std::string profile_file = "test-dir/shell.cpuprofile";
+};
+
+struct HeapProfile {
+  inline static int argc = 2;
+  inline static const char* argv[] = {"tests", "../../../tests/scripts/heap-profile.js"};
+  inline static std::string result_file = "test-dir/heap-profile-result.txt";
+};
+
+struct ParallelBatch {
+  inline static int argc = 6;
+  inline static const char* argv[] = {"tests", "--parallel", "2", "--jobs-file",
+                                      "../../../tests/scripts/batch-jobs.txt",
+                                      "../../../tests/scripts/batch-job.js"};
+  inline static std::string result_file = "test-dir/parallel-batch-result.txt";
+  // Exit code batch-quit.js passes to quit()
+  inline static int exit_code = 3;
+};
+
 #if _WIN32
 struct SpawnProcessSyncNoArgs {
   inline static int argc = 2;
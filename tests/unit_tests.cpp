@@ -3,15 +3,34 @@
 #include "test_ressources.hpp"
 #include "V8Shell.h"
 
+/** Runs the script of a test whose script writes "ok" to its result file
+ *  once all of its checks passed. The shell is gone when this returns. */
+template <typename ScriptTest>
+void RunScriptExpectOk() {
+  int exit_code = 0;
+  {
+    V8Shell shell(ScriptTest::argc, ScriptTest::argv, exit_code);
+    exit_code = shell.Run();
+  }
+
+  std::ifstream result_file(ScriptTest::result_file);
+  std::string result((std::istreambuf_iterator<char>(result_file)),
+                     std::istreambuf_iterator<char>());
+
+  EXPECT_EQ(exit_code, test::EXIT_CODE_OK);
+  EXPECT_EQ(result, "ok");
+}
+
 TEST(PretestUtils, CleanupTestdir) { 
   test::PretestCleanup(); 
 }
 
 TEST(CommandsUtils, GettingSettingsCWD) {
+  Commands::IsolateState state;
   const auto path = fs::current_path();
-  Commands::SetCWD(path);
+  state.SetCWD(path);
 
-  ASSERT_EQ(path, Commands::GetCWD());
+  ASSERT_EQ(path, state.GetCWD());
 }
 
 TEST(V8Shell, BootV8Shell) {
@@ -154,6 +173,242 @@ TEST(V8Shell, MoveFileTo) {
   EXPECT_TRUE(fs::exists(test::MoveFileTo::target_file));
 }
 
+TEST(V8Shell, BuildSnapshot) {
+  int exit_code = 0;
+  V8Shell shell(test::BuildSnapshot::argc, test::BuildSnapshot::argv,
+                exit_code);
+  exit_code = shell.Run();
+
+  EXPECT_EQ(exit_code, test::EXIT_CODE_OK);
+  EXPECT_TRUE(fs::exists(test::BuildSnapshot::target_file));
+}
+
+// Boots from the snapshot written by BuildSnapshot
+TEST(V8Shell, BootSnapshot) {
+  ASSERT_TRUE(fs::exists(test::BuildSnapshot::target_file));
+
+  testing::internal::CaptureStderr();
+  RunScriptExpectOk<test::BootSnapshot>();
+  const auto errors = testing::internal::GetCapturedStderr();
+
+  // A rejected snapshot falls back to a normal boot with a warning
+  EXPECT_EQ(errors.find("booting without it"), std::string::npos) << errors;
+}
+
+TEST(V8Shell, CodeCache) {
+  // The counters are process-wide, the second run has to add a hit
+  int hits[2] = {0, 0};
+  for (auto& run_hits : hits) {
+    int exit_code = 0;
+    {
+      V8Shell shell(test::CodeCache::argc, test::CodeCache::argv,
+                    exit_code);
+      exit_code = shell.Run();
+    }
+    ASSERT_EQ(exit_code, test::EXIT_CODE_OK);
+
+    std::ifstream hits_file(test::CodeCache::hits_file);
+    ASSERT_TRUE(hits_file >> run_hits);
+  }
+
+  ASSERT_TRUE(fs::is_directory(test::CodeCache::target_dir));
+  EXPECT_FALSE(fs::is_empty(test::CodeCache::target_dir));
+  EXPECT_GT(hits[1], hits[0]);
+}
+
+#if !_WIN32
+TEST(V8Shell, ReadBytesTooLarge) {
+  // Sparse, so it takes no space on disk
+  {
+    std::ofstream source_file(test::ReadBytesTooLarge::source_file);
+  }
+  fs::resize_file(test::ReadBytesTooLarge::source_file, 1ull << 40);
+
+  RunScriptExpectOk<test::ReadBytesTooLarge>();
+  fs::remove(test::ReadBytesTooLarge::source_file);
+}
+
+TEST(V8Shell, ReadRewrite) {
+  RunScriptExpectOk<test::ReadRewrite>();
+}
+#endif
+
+TEST(V8Shell, ReadWriteBytes) {
+  int exit_code = 0;
+  V8Shell shell(test::ReadWriteBytes::argc, test::ReadWriteBytes::argv,
+                exit_code);
+  exit_code = shell.Run();
+
+  EXPECT_EQ(exit_code, test::EXIT_CODE_OK);
+  ASSERT_TRUE(fs::exists(test::ReadWriteBytes::target_file));
+  EXPECT_EQ(fs::file_size(test::ReadWriteBytes::target_file), 6);
+}
+
+TEST(V8Shell, WriteFile) {
+  int exit_code = 0;
+  V8Shell shell(test::WriteFile::argc, test::WriteFile::argv,
+                exit_code);
+  exit_code = shell.Run();
+
+  EXPECT_EQ(exit_code, test::EXIT_CODE_OK);
+  EXPECT_TRUE(fs::exists(test::WriteFile::target_file));
+}
+
+TEST(V8Shell, Lines) {
+  int exit_code = 0;
+  V8Shell shell(test::Lines::argc, test::Lines::argv,
+                exit_code);
+  exit_code = shell.Run();
+
+  EXPECT_EQ(exit_code, test::EXIT_CODE_OK);
+}
+
+TEST(V8Shell, ListFilesColumnar) {
+  int exit_code = 0;
+  V8Shell shell(test::ListFilesColumnar::argc, test::ListFilesColumnar::argv,
+                exit_code);
+  exit_code = shell.Run();
+
+  EXPECT_EQ(exit_code, test::EXIT_CODE_OK);
+}
+
+TEST(V8Shell, Walk) {
+  int exit_code = 0;
+  V8Shell shell(test::Walk::argc, test::Walk::argv, exit_code);
+  exit_code = shell.Run();
+
+  EXPECT_EQ(exit_code, test::EXIT_CODE_OK);
+}
+
+TEST(V8Shell, CopyTree) {
+  int exit_code = 0;
+  V8Shell shell(test::CopyTree::argc, test::CopyTree::argv, exit_code);
+  exit_code = shell.Run();
+
+  EXPECT_EQ(exit_code, test::EXIT_CODE_OK);
+  EXPECT_TRUE(fs::exists(test::CopyTree::target_file));
+}
+
+TEST(V8Shell, RemoveTree) {
+  int exit_code = 0;
+  V8Shell shell(test::RemoveTree::argc, test::RemoveTree::argv, exit_code);
+  exit_code = shell.Run();
+
+  EXPECT_EQ(exit_code, test::EXIT_CODE_OK);
+  EXPECT_FALSE(fs::exists(test::RemoveTree::target_dir));
+}
+
+#if !_WIN32
+TEST(V8Shell, RunProcess) {
+  RunScriptExpectOk<test::RunProcess>();
+}
+#endif
+
+#if !_WIN32
+TEST(V8Shell, RunAll) {
+  RunScriptExpectOk<test::RunAll>();
+}
+#endif
+
+#if !_WIN32
+TEST(V8Shell, Pipeline) {
+  RunScriptExpectOk<test::Pipeline>();
+}
+#endif
+
+#if !_WIN32
+TEST(V8Shell, RunSyncCapture) {
+  RunScriptExpectOk<test::RunSyncCapture>();
+}
+#endif
+
+TEST(V8Shell, Timers) {
+  RunScriptExpectOk<test::Timers>();
+}
+
+TEST(V8Shell, FsAsync) {
+  RunScriptExpectOk<test::FsAsync>();
+}
+
+TEST(V8Shell, FsBatch) {
+  RunScriptExpectOk<test::FsBatch>();
+}
+
+TEST(V8Shell, Worker) {
+  RunScriptExpectOk<test::Worker>();
+}
+
+TEST(V8Shell, WorkerQuit) {
+  RunScriptExpectOk<test::WorkerQuit>();
+}
+
+TEST(V8Shell, PoolAllocator) {
+  RunScriptExpectOk<test::PoolAllocator>();
+}
+
+TEST(V8Shell, HeapControl) {
+  RunScriptExpectOk<test::HeapControl>();
+}
+
+TEST(V8Shell, HeapExhaustion) {
+  fs::remove(test::HeapExhaustion::limits_file);
+
+  // The script running out of heap is terminated instead of aborting the process
+  int exit_code = 0;
+  V8Shell shell(test::HeapExhaustion::argc, test::HeapExhaustion::argv, exit_code);
+  exit_code = shell.Run();
+
+  std::ifstream limits_file(test::HeapExhaustion::limits_file);
+  std::string before;
+  std::string after;
+  std::getline(limits_file, before);
+  std::getline(limits_file, after);
+
+  EXPECT_EQ(exit_code, 1);
+  ASSERT_FALSE(before.empty());
+  // The raised limit doesn't outlive the script that needed it
+  EXPECT_EQ(before, after);
+}
+
+TEST(V8Shell, HeapStats) {
+  RunScriptExpectOk<test::HeapStats>();
+
+  // The log is complete once the shell is gone
+  std::ifstream gc_log(test::HeapStats::gc_log_file);
+  std::string line;
+  ASSERT_TRUE(std::getline(gc_log, line));
+  EXPECT_EQ(line.front(), '{');
+  EXPECT_NE(line.find("\"type\":"), std::string::npos);
+}
+
+TEST(V8Shell, CpuProfile) {
+  RunScriptExpectOk<test::CpuProfile>();
+
+  // Written when Run() returns
+  std::ifstream profile_file(test::CpuProfile::profile_file);
+  std::string profile((std::istreambuf_iterator<char>(profile_file)),
+                      std::istreambuf_iterator<char>());
+  EXPECT_EQ(profile.rfind("{\"nodes\":[", 0), 0);
+  EXPECT_NE(profile.find("\"timeDeltas\":["), std::string::npos);
+}
+
+TEST(V8Shell, HeapProfile) {
+  RunScriptExpectOk<test::HeapProfile>();
+}
+
+TEST(V8Shell, ParallelBatch) {
+  int exit_code = 0;
+  V8Shell shell(test::ParallelBatch::argc, test::ParallelBatch::argv, exit_code);
+  exit_code = shell.Run();
+
+  std::ifstream result_file(test::ParallelBatch::result_file);
+  std::string result((std::istreambuf_iterator<char>(result_file)),
+                     std::istreambuf_iterator<char>());
+
+  EXPECT_EQ(exit_code, test::ParallelBatch::exit_code);
+  EXPECT_EQ(result, "okokok");
+}
+
 #if _WIN32
 TEST(V8Shell, SpawnProcessSyncNoArgs) {
   int exit_code = 0;